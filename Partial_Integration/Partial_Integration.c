@@ -1,146 +1,354 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h" 
-#include "hardware/gpio.h"
-#include "hardware/pwm.h"
 #include "pico/time.h"
+#include "FreeRTOS.h"
+#include "message_buffer.h"
+#include "rtos_cores.h"
+#include "task.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
 #include "hardware/irq.h"
-#include "hardware/timer.h"
+#include "barcode.h"
+#include "behavior.h"
+#include "board_pins.h"
+#include "command.h"
+#include "compass.h"
+#include "encoder.h"
+#include "grid.h"
+#include "histogram.h"
+#include "irsensor.h"
+#include "line_follow.h"
+#include "log.h"
+#include "log_messages.h"
+#include "log_udp.h"
+#include "magnetometer.h"
+#include "motion.h"
+#include "motor.h"
+#include "odometry.h"
+#include "planner.h"
+#include "runtime_stats.h"
+#include "sensor_frame.h"
+#include "speed_control.h"
+#include "telemetry.h"
+#include "ultrasonic.h"
+#include "wifi.h"
 
-// Define GPIO pins for ULTRASONIC SENSOR  
-#define TRIGGER_PIN 12
-#define ECHO_PIN 13
+// GPIO pins for all sensors and motors come from board_pins.h
 
-// Define GPIO pins for PWM SIGNALS and MOTOR DIRECTIONS
-#define motorPWMR 0
-#define motorPWML 1
+// Distance reported when the echo times out (nothing within range)
+#define ULTRASONIC_OUT_OF_RANGE_CM 500.0f
 
-#define motorDirR01 3
-#define motorDirR02 4
-#define motorDirL01 6
-#define motorDirL02 5
+// IR SENSOR calibration sweep at boot: spin in place each way for this long
+#define IR_CAL_SWEEP_MS 1500
+#define IR_CAL_SWEEP_SPEED Q16(10.0)    // cm/s per wheel
 
-// Define GPIO pins for IR SENSORS
-#define IR_SENSOR_LEFT 26
-#define IR_SENSOR_RIGHT 27
-#define IR_SENSOR_BOTTOM 28
+// Build with IR_FORCE_CALIBRATION=1 to recalibrate even if flash holds a calibration
+#ifndef IR_FORCE_CALIBRATION
+#define IR_FORCE_CALIBRATION 0
+#endif
 
-// Define GPIO pin for ENCODER OUTPUT 
-#define ENCODER_OUT_PIN 2 
+// COMPASS calibration at boot: spin in place for a little over one full turn
+#define COMPASS_CAL_SPIN_MS 4000
+#define COMPASS_CAL_SPIN_SPEED Q16(10.0) // cm/s per wheel
 
-// PWM Slices
-uint slice_num01;
-uint slice_num02;
+// Build with MAZE_EXPLORE=1 to explore the maze by the planner instead of
+// following the line
+#ifndef MAZE_EXPLORE
+#define MAZE_EXPLORE 0
+#endif
 
-// Variable to count the ENCODER PULSES 
-volatile int pulseCount = 0; 
+// Build with ROBOT_SENSOR_CORE1=1 (CMake option) to run all sensor
+// acquisition bare-metal on core 1, with FreeRTOS keeping core 0
+#ifndef ROBOT_SENSOR_CORE1
+#define ROBOT_SENSOR_CORE1 0
+#endif
 
-float get_distance() 
-{
-    // Triggering the ULTRASONIC SENSOR 
-    gpio_put(TRIGGER_PIN, 1);
-    sleep_us(10);
-    gpio_put(TRIGGER_PIN, 0);
+#if ROBOT_SENSOR_CORE1 && RTOS_SMP
+#error "ROBOT_SENSOR_CORE1 needs core 1 to itself: build without ROBOT_SMP"
+#endif
 
-    // Measuring the pulse duration from the ECHO PIN
-    while (gpio_get(ECHO_PIN) == 0) {}
-    uint32_t start_time = time_us_32();
-    while (gpio_get(ECHO_PIN) == 1) {}
-    uint32_t end_time = time_us_32();
+// Planner work per sensor snapshot, in cells looked at: a full rebuild of
+// the field takes about 40 snapshots
+#define PLANNER_BUDGET 3000
 
-    // Calculate distance in CM
-    float pulse_duration = (float)(end_time - start_time);
-    float distance = (pulse_duration / 2) * 0.000343 * 100;
+// Wheel speed used by the move_* functions
+#define CRUISE_SPEED Q16(25.0)  // cm/s
 
-    return distance;
-}
+// Status printout period; printing every pass would dominate the loop time
+#define STATUS_PRINT_MS 500
 
-void gpio_ultrasonic_initialization() 
-{
-    // Initialize GPIO pins for ULTRASONIC SENSOR 
-    gpio_init(TRIGGER_PIN);
-    gpio_init(ECHO_PIN);
+// Binary UDP telemetry to TELEMETRY_HOST (a CMake cache variable), off when
+// it is empty. Records wait at most TELEMETRY_PERIOD_MS before they are sent
+#ifndef TELEMETRY_HOST
+#define TELEMETRY_HOST ""
+#endif
+#define TELEMETRY_PERIOD_MS 50
+#define WIFI_CONNECT_TIMEOUT_MS 30000
 
-    // Set GPIO pins to output(trigger) and input(echo) for ULTRASONIC SENSOR 
-    gpio_set_dir(TRIGGER_PIN, GPIO_OUT);
-    gpio_set_dir(ECHO_PIN, GPIO_IN);
+// The binary log goes to TELEMETRY_HOST too, on LOG_UDP_PORT, if telemetry
+// is on, and to the USB console otherwise. Either way it is drained this often
+#define LOG_DRAIN_MS 100
 
-    // Set the ULTRASONIC SENSOR to logic low 
-    gpio_put(TRIGGER_PIN, 0);
+// Build with ROBOT_REMOTE_COMMANDS=1 (CMake option) to take binary commands
+// on COMMAND_PORT, UDP or TCP (tools/command_client.c)
+#ifndef ROBOT_REMOTE_COMMANDS
+#define ROBOT_REMOTE_COMMANDS 0
+#endif
 
-    sleep_ms(500);  // Allow the ULTRASONIC SENSOR to settle
-}
+// Telemetry record fields, one record per planning pass
+enum {
+    TELEMETRY_X,                // Q16.16 cm
+    TELEMETRY_Y,                // Q16.16 cm
+    TELEMETRY_THETA,            // Q16.16 degrees
+    TELEMETRY_SPEED_LEFT,       // Q16.16 cm/s, measured
+    TELEMETRY_SPEED_RIGHT,      // Q16.16 cm/s, measured
+    TELEMETRY_DISTANCE_MM,
+    TELEMETRY_LINE_ERROR,       // Q16.16, -1..1
+    TELEMETRY_LINE_CONFIDENCE,  // Q16.16, 0..1
+    TELEMETRY_STATE,            // behavior_state_t
+    TELEMETRY_MOTION,           // motion_state_t
+    TELEMETRY_CPU_LOAD,         // permille of all cores, last status period
+    TELEMETRY_JITTER_MAX,       // us, worst control wake-up in the last status period
+    TELEMETRY_FIELD_COUNT,
+};
+
+// FreeRTOS tasks, highest priority first. The control task sits above the
+// cyw43 and lwIP tasks, so network traffic cannot delay a control tick
+#define CONTROL_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define SENSOR_TASK_PRIORITY (tskIDLE_PRIORITY + 6)
+#define PLANNING_TASK_PRIORITY (tskIDLE_PRIORITY + 5)
+#define COMMS_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+
+// Stack depths in words
+#define CONTROL_TASK_STACK 512
+#define SENSOR_TASK_STACK 1024
+#define PLANNING_TASK_STACK 1024
+#define COMMS_TASK_STACK 1024
+
+// Control tick period in kernel ticks (configTICK_RATE_HZ is 1000)
+#define CONTROL_PERIOD_TICKS pdMS_TO_TICKS(SPEED_CONTROL_PERIOD_US / 1000)
+
+// The sensor task is woken after every SENSOR_DIVIDER control ticks
+#define SENSOR_DIVIDER 5
+
+// Sensor snapshots the planning task may fall behind by before they are dropped
+#define SNAPSHOT_BUFFER_MESSAGES 4
+#define BARCODE_BUFFER_BYTES 128
+
+// ENCODER state: pulse timestamps are queued by the ISR and drained by the speed control tick
+encoder_t encoder_left;
+encoder_t encoder_right;
+
+// COMPASS calibration, fitted at boot and used by the heading maneuvers.
+// Without an LSM303 the car runs on the encoders alone
+static compass_calibration_t compass_cal;
+static bool compass_present;
+
+// Maze map built from ULTRASONIC readings and the odometry pose, and the
+// planner working on it
+static grid_t grid;
+static planner_t planner;
+
+// The map leaves the car as its serialized record (grid_encode()), cut into
+// LOG_MAP_CHUNK messages of MAP_CHUNK_WORDS little-endian words and sent a
+// few per snapshot so the log ring never fills with it. sim/map_decoder
+// puts it back together from tools/log_decoder's output
+#define MAP_STREAM_MS 2000
+#define MAP_CHUNK_WORDS 5
+#define MAP_CHUNKS_PER_SNAPSHOT 2
+#define MAP_CHUNK_BYTES (4 * MAP_CHUNK_WORDS)
+static uint8_t map_record[(GRID_RECORD_SIZE + MAP_CHUNK_BYTES - 1) / MAP_CHUNK_BYTES * MAP_CHUNK_BYTES];
+static uint map_offset = sizeof(map_record);
+
+// BARCODE transitions from the bottom IR SENSOR, queued by the ADC DMA IRQ as
+// position | colour << 31 and decoded in the sensor task
+#define BARCODE_RING_SIZE 64
+static spsc_ring_t barcode_ring;
+static uint32_t barcode_storage[BARCODE_RING_SIZE];
+
+// Remote commands as the planning task runs them. While manual is set the
+// behaviours are off and only commands move the car
+typedef struct {
+    uint32_t executed;
+    uint32_t latency_us_max;    // frame received to maneuver started
+    bool manual;
+} command_state_t;
+
+static command_state_t remote;
 
-void encoder_pulse_handler() 
+// Status for the comms task, sent by the planning task every STATUS_PRINT_MS
+typedef struct {
+    behavior_state_t state;
+    behavior_stats_t stats;
+    pose_t pose;
+    float distance_cm;
+    bool left_on_line;
+    bool right_on_line;
+    uint32_t pulses_left;
+    uint32_t pulses_right;
+    command_state_t remote;
+} status_report_t;
+
+// Period jitter of the control task: how far each wake-up lands from one
+// period after the previous one. Written by the control task and copied by
+// readers in a critical section, which also holds across cores
+typedef struct {
+    uint32_t periods;
+    int32_t jitter_min_us;
+    int32_t jitter_max_us;
+    uint32_t overruns;          // wake-ups a whole period or more late
+    uint32_t tick_us_max;       // time spent in speed_control_tick()
+    int32_t window_max_us;      // worst jitter since the comms task last looked
+    histogram_t jitter;
+} control_timing_t;
+
+static control_timing_t control_timing = {
+    .jitter_min_us = INT32_MAX,
+    .jitter_max_us = INT32_MIN,
+    .window_max_us = INT32_MIN,
+};
+
+// Control jitter histogram: 8 us buckets from -64 us to +64 us
+#define JITTER_HISTOGRAM_ORIGIN -64
+#define JITTER_HISTOGRAM_SHIFT 3
+
+// Run-time statistics of the last status period, sampled by the comms task
+// for the telemetry. A STATS command asks for the full report
+static volatile uint32_t cpu_load_permille;
+static volatile int32_t jitter_window_max_us;
+static volatile bool stats_requested;
+
+// Snapshots the sensor task could not queue for the planning task
+static volatile uint32_t snapshots_dropped;
+
+static TaskHandle_t sensor_task_handle;
+
+// Sensor snapshots to the planning task, status reports and BARCODE text
+// to the comms task. Each buffer has a single writer and a single reader
+static MessageBufferHandle_t snapshot_buffer;
+static MessageBufferHandle_t status_buffer;
+static MessageBufferHandle_t barcode_buffer;
+
+void gpio_ultrasonic_initialization() 
 {
-    // Increment pulse count on each edge transition 
-    pulseCount++;
+    // Configure trigger/echo pins and the echo edge interrupt for the ULTRASONIC SENSOR
+    ultrasonic_init(ULTRASONIC_TRIGGER_PIN, ULTRASONIC_ECHO_PIN);
+
+    sleep_ms(500);  // Allow the ULTRASONIC SENSOR to settle
 }
 
-void setup_encoder_interrupt() 
+// Fire the next ping if the last one is done and pick up any finished reading.
+// Never blocks: the last known distance is kept until a new reading arrives.
+// Returns true if distance holds a new reading, taken at *timestamp_us
+bool update_distance(float *distance, uint32_t *timestamp_us)
 {
-    // Configuring interrupt on the GPIO pin ENCODER_OUT_PIN to trigger when a falling edge is detected
-    gpio_set_irq_enabled_with_callback(ENCODER_OUT_PIN, GPIO_IRQ_EDGE_FALL, true, &encoder_pulse_handler);
+    ultrasonic_result_t result;
+    bool updated = false;
+
+    while (ultrasonic_poll(&result))
+    {
+        if (result.status == ULTRASONIC_OK)
+        {
+            *distance = result.distance_cm;
+            *timestamp_us = result.timestamp_us;
+            updated = true;
+        }
+        else if (result.status == ULTRASONIC_ERR_TIMEOUT)
+        {
+            // Echo longer than the sensor range: nothing in front of the car
+            *distance = ULTRASONIC_OUT_OF_RANGE_CM;
+            *timestamp_us = result.timestamp_us;
+            updated = true;
+        }
+        else
+        {
+            LOG(LOG_ULTRASONIC_NO_ECHO);
+        }
+    }
+
+    ultrasonic_start();
+    return updated;
 }
 
 void gpio_encoder_initialization()
 {
-    // Initialize GPIO pins for ENCODER 
-    gpio_init(ENCODER_OUT_PIN);
-
-    // Set GPIO directions to input for ENCODER 
-    gpio_set_dir(ENCODER_OUT_PIN, GPIO_IN);
+    // Initialize the ENCODER pins and their edge interrupts, which only timestamp pulses
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
 }
    
 void gpio_ir_sensor_initialization()
 {
-    // Initialize GPIO pins for IR SENSORS
-    gpio_init(IR_SENSOR_LEFT);
-    gpio_init(IR_SENSOR_RIGHT);
-    gpio_init(IR_SENSOR_BOTTOM);
+    // Sample the IR SENSORS continuously through the ADC FIFO and DMA
+    ir_adc_start(NULL);
+}
 
-    // Set GPIO directions to input for IR SENSORS
-    gpio_set_dir(IR_SENSOR_LEFT, GPIO_IN);
-    gpio_set_dir(IR_SENSOR_RIGHT, GPIO_IN);
-    gpio_set_dir(IR_SENSOR_BOTTOM, GPIO_IN);
+void gpio_compass_initialization()
+{
+    // Configure the LSM303DLHC once, then sample it in the background
+    if (!lsm303_init(NULL))
+    {
+        printf("Compass: LSM303DLHC not responding, driving on the encoders\n");
+        return;
+    }
+    lsm303_start();
+    compass_present = true;
 }
 
 void gpio_motor_initialization()
 {
-    // GPIO initialization for MOTOR CONTROL
-    gpio_init(motorDirR01);
-    gpio_init(motorDirR02);
-    gpio_init(motorDirL01);
-    gpio_init(motorDirL02);
+    // Direction pins and PWM slices for MOTOR CONTROL, motors stopped
+    motor_init();
+}
 
-    // Set GPIO directions to output for MOTOR CONTROL
-    gpio_set_dir(motorDirR01, GPIO_OUT);
-    gpio_set_dir(motorDirR02, GPIO_OUT);
-    gpio_set_dir(motorDirL01, GPIO_OUT);
-    gpio_set_dir(motorDirL02, GPIO_OUT);
+// Distance travelled by the middle of the car, Q16.16 cm
+static uint32_t travelled_position(void)
+{
+    uint32_t pulses = (encoder_left.pulse_count + encoder_right.pulse_count) / 2;
+    return pulses * (uint32_t)ENCODER_CM_PER_PULSE_Q16;
+}
 
-    // Set GPIO functions for PWM
-    gpio_set_function(motorPWMR, GPIO_FUNC_PWM);
-    gpio_set_function(motorPWML, GPIO_FUNC_PWM);
+// Runs in the ADC DMA IRQ for every black/white crossing of the bottom IR SENSOR.
+// The pulse count is only as fresh as the last control tick, so back off by
+// the distance covered since the crossing was sampled
+static void bottom_ir_edge(uint32_t timestamp_us, bool black)
+{
+    q16_t speed = (speed_control_get_left_speed() + speed_control_get_right_speed()) / 2;
+    uint32_t age_us = time_us_32() - timestamp_us;
+    uint32_t position = travelled_position() - (uint32_t)((int64_t)speed * age_us / 1000000);
 
-    // Assigning variables for PWM slices 
-    slice_num01 = pwm_gpio_to_slice_num(motorPWMR);
-    slice_num02 = pwm_gpio_to_slice_num(motorPWML);
+    if (!spsc_ring_push(&barcode_ring, (position & BARCODE_POSITION_MASK) | ((uint32_t)black << 31)))
+    {
+        LOG(LOG_BARCODE_OVERFLOW, position);
+    }
+}
 
-    // Configure PWM settings (clock divider and wrap value)
-    pwm_set_clkdiv(slice_num01, 100);
-    pwm_set_wrap(slice_num01, 12500);
-    pwm_set_clkdiv(slice_num02, 100);
-    pwm_set_wrap(slice_num02, 12500);
+// Feed queued BARCODE transitions to the decoder and pass anything it reads
+// on to the comms task
+void update_barcode(barcode_decoder_t *decoder)
+{
+    char text[BARCODE_MAX_ELEMENTS / 10 + 1];
+    uint32_t edge;
 
-    // Enable PWM slices
-    pwm_set_enabled(slice_num01, true);
-    pwm_set_enabled(slice_num02, true);
+    while (spsc_ring_pop(&barcode_ring, &edge))
+    {
+        if (barcode_feed(decoder, edge & BARCODE_POSITION_MASK, edge >> 31, text, sizeof(text)))
+        {
+            xMessageBufferSend(barcode_buffer, text, strlen(text), 0);
+        }
+    }
+
+    if (barcode_idle(decoder, travelled_position() & BARCODE_POSITION_MASK, text, sizeof(text)))
+    {
+        xMessageBufferSend(barcode_buffer, text, strlen(text), 0);
+    }
 }
 
 // Function to print statements when IR SENSORS detect a black line
-void printIRSensorStatus()
+void printIRSensorStatus(bool left_on_line, bool right_on_line)
 {
-    if (gpio_get(IR_SENSOR_LEFT))
+    if (left_on_line)
     {
         printf("Left IR Sensor: Black line detected!\n");
     }
@@ -149,7 +357,7 @@ void printIRSensorStatus()
         printf("Left IR Sensor: No black line detected.\n");
     }
 
-    if (gpio_get(IR_SENSOR_RIGHT))
+    if (right_on_line)
     {
         printf("Right IR Sensor: Black line detected!\n");
     }
@@ -159,123 +367,772 @@ void printIRSensorStatus()
     }
 }
 
+// Spin in place over the line in both directions while recording the range
+// of every IR SENSOR, then store the result in flash for the next boot.
+// Waits for the control task's wake-up between readings: a snapshot comes
+// every 8 ms and the sensor task is woken every 5
+void calibrate_ir_sensors(ir_calibration_t *cal)
+{
+    printf("IR calibration: sweeping sensors over the line\n");
+
+    ir_cal_begin(cal);
+    uint32_t last_sequence = 0;
+
+    for (int sweep = 0; sweep < 2; sweep++)
+    {
+        q16_t speed = sweep == 0 ? IR_CAL_SWEEP_SPEED : -IR_CAL_SWEEP_SPEED;
+        speed_control_set_target(-speed, speed);
+
+        absolute_time_t sweep_end = make_timeout_time_ms(IR_CAL_SWEEP_MS);
+        while (!time_reached(sweep_end))
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            ir_adc_snapshot_t ir;
+            ir_adc_get_snapshot(&ir);
+            if (ir.sequence != last_sequence)
+            {
+                last_sequence = ir.sequence;
+                ir_cal_add(cal, &ir);
+            }
+        }
+    }
+    speed_control_set_target(0, 0);
+
+    if (!ir_cal_finish(cal))
+    {
+        printf("IR calibration failed: not enough contrast, using defaults\n");
+        return;
+    }
+
+    // The other core is parked for the flash write; on two cores the
+    // scheduler must not try to hand it a task meanwhile
+#if RTOS_SMP
+    vTaskSuspendAll();
+#endif
+    bool saved = ir_cal_save(cal);
+#if RTOS_SMP
+    xTaskResumeAll();
+#endif
+    printf(saved ? "IR calibration saved\n" : "IR calibration not saved: flash busy\n");
+}
+
+// Spin in place while recording the magnetometer range for the hard/soft-iron
+// fit. The field changes with the surroundings, so this runs on every boot.
+// Paced by the sensor task's wake-ups like the IR sweep
+void calibrate_compass(compass_calibration_t *cal)
+{
+    printf("Compass calibration: spinning in place\n");
+
+    compass_cal_begin(cal);
+    uint32_t last_sequence = 0;
+
+    speed_control_set_target(-COMPASS_CAL_SPIN_SPEED, COMPASS_CAL_SPIN_SPEED);
+
+    absolute_time_t spin_end = make_timeout_time_ms(COMPASS_CAL_SPIN_MS);
+    while (!time_reached(spin_end))
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        lsm303_sample_t sample;
+        lsm303_get_sample(&sample);
+        if (sample.mag_sequence != last_sequence)
+        {
+            last_sequence = sample.mag_sequence;
+            compass_cal_add(cal, sample.mag);
+        }
+    }
+    speed_control_set_target(0, 0);
+
+    if (!compass_cal_finish(cal))
+    {
+        printf("Compass calibration failed: field did not turn, using defaults\n");
+    }
+}
+
+// Heading source for the odometry fusion, called from the control tick.
+// The heading is only recomputed when the magnetometer has a new sample
+static q16_t compass_heading_now(void)
+{
+    static uint32_t last_sequence;
+    static q16_t heading;
+
+    lsm303_sample_t sample;
+    lsm303_get_sample(&sample);
+    if (sample.mag_sequence != last_sequence)
+    {
+        last_sequence = sample.mag_sequence;
+        heading = compass_heading(&compass_cal, sample.accel, sample.mag);
+    }
+    return heading;
+}
+
 // Function to STOP the robot car 
 void move_stop()
 {
-    pwm_set_chan_level(slice_num01, PWM_CHAN_A, 0);
-    pwm_set_chan_level(slice_num02, PWM_CHAN_B, 0);
-    gpio_put(motorDirR01, 0);
-    gpio_put(motorDirR02, 0);
-    gpio_put(motorDirL01, 0);
-    gpio_put(motorDirL02, 0);
+    motion_abort();
 }
 
 // Function to drive the robot car FORWARDS
 void move_forward()
 {
-    pwm_set_chan_level(slice_num01, PWM_CHAN_A, 12500 / 1.5);
-    pwm_set_chan_level(slice_num02, PWM_CHAN_B, 12500 / 1.5);
-    gpio_put(motorDirR01, 1);
-    gpio_put(motorDirR02, 0);
-    gpio_put(motorDirL01, 1);
-    gpio_put(motorDirL02, 0);
+    speed_control_set_target(CRUISE_SPEED, CRUISE_SPEED);
 }
 
 // Function to drive the robot car BACKWARDS 
 void move_backward()
 {
-    pwm_set_chan_level(slice_num01, PWM_CHAN_A, 12500 / 1.5);
-    pwm_set_chan_level(slice_num02, PWM_CHAN_B, 12500 / 1.5);
-    gpio_put(motorDirR01, 0);
-    gpio_put(motorDirR02, 1);
-    gpio_put(motorDirL01, 0);
-    gpio_put(motorDirL02, 1);
+    speed_control_set_target(-CRUISE_SPEED, -CRUISE_SPEED);
 }
 
 // Function to turn the robot car RIGHT
 void move_forward_right()
 {
-    pwm_set_chan_level(slice_num01, PWM_CHAN_A, 0);
-    pwm_set_chan_level(slice_num02, PWM_CHAN_B, 12500 / 1.5);
-    gpio_put(motorDirR01, 1);
-    gpio_put(motorDirR02, 0);
-    gpio_put(motorDirL01, 1);
-    gpio_put(motorDirL02, 0);
+    speed_control_set_target(CRUISE_SPEED, 0);
 }
 
 // Function to turn the robot car LEFT
 void move_forward_left()
 {
-    pwm_set_chan_level(slice_num01, PWM_CHAN_A, 12500 / 1.5);
-    pwm_set_chan_level(slice_num02, PWM_CHAN_B, 0);
-    gpio_put(motorDirR01, 1);
-    gpio_put(motorDirR02, 0);
-    gpio_put(motorDirL01, 1);
-    gpio_put(motorDirL02, 0);
+    speed_control_set_target(0, CRUISE_SPEED);
 }
 
-int main()
+// Remote command handlers, indexed by opcode. Each one only starts a
+// maneuver or sets targets, like a behaviour action
+typedef void (*command_handler_t)(const command_t *command);
+
+static void command_stop(const command_t *command)
 {
-    stdio_init_all();
+    move_stop();
+    remote.manual = true;
+}
 
-    setup_encoder_interrupt();
+static void command_drive(const command_t *command)
+{
+    motion_drive(command->arg[0]);
+}
+
+static void command_turn_by(const command_t *command)
+{
+    // By compass if there is one, otherwise by encoder distance
+    if (!motion_turn_by(command->arg[0]))
+        motion_arc(command->arg[0]);
+}
+
+static void command_turn_to(const command_t *command)
+{
+    motion_turn_to_heading(command->arg[0]);
+}
+
+static void command_set_speed(const command_t *command)
+{
+    // A running maneuver would overwrite the targets on its next tick
+    motion_abort();
+    speed_control_set_target(command->arg[0], command->arg[1]);
+}
+
+static void command_manual(const command_t *command)
+{
+    remote.manual = command->arg[0] != 0;
+}
+
+static void command_stats(const command_t *command)
+{
+    stats_requested = true;
+}
+
+static const command_handler_t command_handlers[COMMAND_OPCODE_COUNT] = {
+    [COMMAND_STOP] = command_stop,
+    [COMMAND_DRIVE] = command_drive,
+    [COMMAND_TURN_BY] = command_turn_by,
+    [COMMAND_TURN_TO] = command_turn_to,
+    [COMMAND_SET_SPEED] = command_set_speed,
+    [COMMAND_MANUAL] = command_manual,
+    [COMMAND_STATS] = command_stats,
+};
+
+// Run every queued remote command, oldest first
+static void run_commands(void)
+{
+    command_t command;
+
+    while (command_receive(&command))
+    {
+        // The server only queues opcodes below COMMAND_OPCODE_COUNT
+        command_handler_t handler = command_handlers[command.opcode];
+        if (handler)
+            handler(&command);
+
+        uint32_t latency = time_us_32() - command.received_us;
+        LOG(LOG_COMMAND, command.opcode, command.sequence, command.arg[0], command.arg[1], latency);
+        remote.executed++;
+        if (latency > remote.latency_us_max)
+            remote.latency_us_max = latency;
+    }
+}
+
+#if ROBOT_SENSOR_CORE1
+// Core 1: every sensor interrupt is enabled here, so the encoder, echo, ADC
+// and I2C handlers never preempt the control task. Nothing below blocks: a
+// frame goes out as soon as there is a new IR snapshot or ULTRASONIC reading
+static void sensor_core_main(void)
+{
+    // Lets core 0 park this core while it writes the IR calibration to flash
+    flash_safe_execute_core_init();
 
     gpio_encoder_initialization();
 
     gpio_ir_sensor_initialization();
 
-    gpio_motor_initialization();
-
     gpio_ultrasonic_initialization();
 
-    while (1)
+    gpio_compass_initialization();
+
+    // Sensors are up: core 0 may start the control loop
+    multicore_fifo_push_blocking(0);
+
+    sensor_frame_t frame = {
+        .distance_cm = ULTRASONIC_OUT_OF_RANGE_CM,
+    };
+
+    while (true)
     {
-        // Print statements for encoder
-        printf("Pulse Count: %d\n", pulseCount);
+        ir_adc_snapshot_t ir;
+        ir_adc_get_snapshot(&ir);
+        bool new_distance = update_distance(&frame.distance_cm, &frame.distance_timestamp_us);
+        if (new_distance || ir.sequence != frame.ir.sequence)
+        {
+            frame.ir = ir;
+            sensor_frame_publish(&frame);
+        }
+    }
+}
+#endif
 
-        // Print statements for IR sensors
-        printIRSensorStatus();
+// Fixed-period control: wheel PIDs, maneuvers and odometry on every kernel
+// tick, with the sensor task woken in step every SENSOR_DIVIDER ticks
+static void control_task(__unused void *params)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t last_start = time_us_32();
+    uint32_t ticks = 0;
 
-        // Print statements for ULTRASONIC SENSOR
-        float distance = get_distance();
-        printf("Distance: %.2f cm\n", distance);
+    while (true)
+    {
+        vTaskDelayUntil(&last_wake, CONTROL_PERIOD_TICKS);
 
-        // Set ULTRASONIC SENSOR threshold distance to REVERSE robot car  
-        float threshold_distance = 10;  
+        uint32_t start = time_us_32();
+        speed_control_tick();
+        uint32_t tick_us = time_us_32() - start;
 
-        // Robot logic 
-        if (distance < threshold_distance) 
+        int32_t jitter = (int32_t)(start - last_start) - SPEED_CONTROL_PERIOD_US;
+        last_start = start;
+        control_timing_t *timing = &control_timing;
+        taskENTER_CRITICAL();
+        if (ticks > 0)
         {
-            // ULTRASONIC SENSOR threshold reached: REVERSE robot car for 1.2 seconds
-            move_backward(); 
-            sleep_ms(1200);    
-            move_stop();
+            timing->periods++;
+            if (jitter < timing->jitter_min_us)
+                timing->jitter_min_us = jitter;
+            if (jitter > timing->jitter_max_us)
+                timing->jitter_max_us = jitter;
+            if (jitter >= SPEED_CONTROL_PERIOD_US)
+                timing->overruns++;
+            if (jitter > timing->window_max_us)
+                timing->window_max_us = jitter;
+            histogram_add(&timing->jitter, jitter);
         }
+        if (tick_us > timing->tick_us_max)
+            timing->tick_us_max = tick_us;
+        taskEXIT_CRITICAL();
 
-        else if (!gpio_get(IR_SENSOR_LEFT) && !gpio_get(IR_SENSOR_RIGHT))
+        if (ticks > 0 && jitter >= SPEED_CONTROL_PERIOD_US)
         {
-            // Neither IR SENSOR on the line: robot car moves FORWARDS
-            move_forward();
+            LOG(LOG_CONTROL_OVERRUN, jitter, tick_us);
         }
-        else if (!gpio_get(IR_SENSOR_LEFT) && gpio_get(IR_SENSOR_RIGHT))
+
+        if (++ticks % SENSOR_DIVIDER == 0)
         {
-            // Right IR SENSOR on the line: robot car turns LEFT
-            move_forward_left(); 
-            sleep_ms(400);
+            xTaskNotifyGive(sensor_task_handle);
         }
-        else if (gpio_get(IR_SENSOR_LEFT) && !gpio_get(IR_SENSOR_RIGHT))
+    }
+}
+
+// Calibrate, then sample every sensor into one snapshot per wake-up and
+// queue it for the planning task
+static void sensor_task(__unused void *params)
+{
+    // IR SENSOR calibration from flash, or a fresh sweep if there is none.
+    // Both calibrations drive the car, so the control task must be running
+    ir_calibration_t ir_cal;
+    if (IR_FORCE_CALIBRATION || !ir_cal_load(&ir_cal))
+    {
+        calibrate_ir_sensors(&ir_cal);
+    }
+
+    if (compass_present)
+    {
+        // COMPASS hard/soft-iron calibration
+        calibrate_compass(&compass_cal);
+
+        // Pose from both wheel ENCODERS, heading fused with the calibrated COMPASS
+        odometry_init(&encoder_left, &encoder_right, compass_heading_now);
+
+        // Closed-loop turns and heading hold on the fused heading
+        motion_set_heading_source(odometry_get_heading);
+    }
+    else
+    {
+        // Dead reckoning; the heading maneuvers stay refused and turns fall
+        // back to encoder arcs
+        odometry_init(&encoder_left, &encoder_right, NULL);
+    }
+
+    // BARCODE reading on the bottom IR SENSOR, using its calibrated thresholds
+    barcode_decoder_t barcode;
+    barcode_init(&barcode);
+    spsc_ring_init(&barcode_ring, barcode_storage, BARCODE_RING_SIZE);
+    ir_adc_set_edge_callback(IR_ADC_BOTTOM, ir_cal.threshold_low[IR_ADC_BOTTOM],
+                             ir_cal.threshold_high[IR_ADC_BOTTOM], bottom_ir_edge);
+
+    behavior_snapshot_t snapshot = {
+        .distance_cm = ULTRASONIC_OUT_OF_RANGE_CM,
+    };
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        snapshot.now_us = time_us_32();
+
+        // One IR snapshot per pass, so every decision sees the same readings
+        ir_adc_snapshot_t ir;
+#if ROBOT_SENSOR_CORE1
+        // Newest frame from core 1, which has already polled the ULTRASONIC SENSOR
+        sensor_frame_t frame;
+        sensor_frame_read(&frame);
+        ir = frame.ir;
+        snapshot.distance_cm = frame.distance_cm;
+        snapshot.distance_timestamp_us = frame.distance_timestamp_us;
+#else
+        ir_adc_get_snapshot(&ir);
+        update_distance(&snapshot.distance_cm, &snapshot.distance_timestamp_us);
+#endif
+        snapshot.ir_sequence = ir.sequence;
+        snapshot.ir_timestamp_us = ir.timestamp_us;
+        snapshot.left_on_line = ir_cal_on_line(&ir_cal, IR_ADC_LEFT, ir.value[IR_ADC_LEFT],
+                                               snapshot.left_on_line);
+        snapshot.right_on_line = ir_cal_on_line(&ir_cal, IR_ADC_RIGHT, ir.value[IR_ADC_RIGHT],
+                                                snapshot.right_on_line);
+        line_estimate(ir.value[IR_ADC_LEFT], ir.value[IR_ADC_RIGHT], &ir_cal, &snapshot.line);
+
+        odometry_get_pose(&snapshot.pose);
+        snapshot.motion = motion_get_status(&snapshot.maneuver);
+
+        // BARCODE under the car, if any
+        update_barcode(&barcode);
+
+        if (xMessageBufferSend(snapshot_buffer, &snapshot, sizeof(snapshot), 0) != sizeof(snapshot))
+        {
+            snapshots_dropped++;
+            LOG(LOG_SNAPSHOT_DROPPED, snapshots_dropped);
+        }
+    }
+}
+
+// Next chunks of the map record, starting a new copy of the map every
+// MAP_STREAM_MS
+static void stream_map(absolute_time_t *next_map)
+{
+    if (map_offset >= sizeof(map_record))
+    {
+        if (!time_reached(*next_map))
+        {
+            return;
+        }
+        *next_map = make_timeout_time_ms(MAP_STREAM_MS);
+        grid_encode(&grid, map_record);
+        map_offset = 0;
+    }
+
+    for (int i = 0; i < MAP_CHUNKS_PER_SNAPSHOT && map_offset < sizeof(map_record); i++)
+    {
+        const uint8_t *chunk = map_record + map_offset;
+        LOG(LOG_MAP_CHUNK, map_offset, get_le32(chunk), get_le32(chunk + 4), get_le32(chunk + 8),
+            get_le32(chunk + 12), get_le32(chunk + 16));
+        map_offset += MAP_CHUNK_BYTES;
+    }
+}
+
+// Map, plan and decide on every snapshot; the only task that starts maneuvers
+static void planning_task(__unused void *params)
+{
+    // Line following and obstacle handling as a state machine on the sensor
+    // snapshots; with MAZE_EXPLORE the planner drives CRUISE
+    line_follower_t follower;
+    behavior_t behavior;
+    behavior_init(&behavior, &follower, MAZE_EXPLORE ? &planner : NULL);
+
+    behavior_snapshot_t snapshot;
+    uint32_t last_distance_us = 0;
+    absolute_time_t next_report = make_timeout_time_ms(STATUS_PRINT_MS);
+    absolute_time_t next_map = make_timeout_time_ms(MAP_STREAM_MS);
+
+    while (true)
+    {
+        if (xMessageBufferReceive(snapshot_buffer, &snapshot, sizeof(snapshot), portMAX_DELAY) != sizeof(snapshot))
+        {
+            continue;
+        }
+
+        // Every new ULTRASONIC reading goes into the map
+        if (snapshot.distance_timestamp_us != last_distance_us)
+        {
+            last_distance_us = snapshot.distance_timestamp_us;
+            grid_add_reading(&grid, &snapshot.pose, snapshot.distance_cm);
+        }
+
+        stream_map(&next_map);
+
+        // Bounded slice of path planning, when the planner is driving
+        snapshot.plan_ready = MAZE_EXPLORE && planner_step(&planner, PLANNER_BUDGET);
+
+        // Remote commands first, so they act on this pass
+        run_commands();
+
+        // Robot logic: maneuvers run in the control task, so a tick only
+        // starts them and never waits
+        if (!remote.manual)
+        {
+            behavior_tick(&behavior, &snapshot);
+        }
+
+        // Never waits for the network: the record is dropped if it falls behind
+        telemetry_record_t record = {
+            .timestamp_us = snapshot.now_us,
+            .field = {
+                [TELEMETRY_X] = snapshot.pose.x,
+                [TELEMETRY_Y] = snapshot.pose.y,
+                [TELEMETRY_THETA] = snapshot.pose.theta,
+                [TELEMETRY_SPEED_LEFT] = speed_control_get_left_speed(),
+                [TELEMETRY_SPEED_RIGHT] = speed_control_get_right_speed(),
+                [TELEMETRY_DISTANCE_MM] = (int32_t)(snapshot.distance_cm * 10.0f),
+                [TELEMETRY_LINE_ERROR] = snapshot.line.error,
+                [TELEMETRY_LINE_CONFIDENCE] = snapshot.line.confidence,
+                [TELEMETRY_STATE] = behavior.state,
+                [TELEMETRY_MOTION] = snapshot.motion,
+                [TELEMETRY_CPU_LOAD] = cpu_load_permille,
+                [TELEMETRY_JITTER_MAX] = jitter_window_max_us,
+            },
+        };
+        telemetry_record(&record);
+
+        if (time_reached(next_report))
+        {
+            next_report = make_timeout_time_ms(STATUS_PRINT_MS);
+
+            status_report_t report = {
+                .state = behavior.state,
+                .stats = behavior.stats,
+                .pose = snapshot.pose,
+                .distance_cm = snapshot.distance_cm,
+                .left_on_line = snapshot.left_on_line,
+                .right_on_line = snapshot.right_on_line,
+                .pulses_left = encoder_left.pulse_count,
+                .pulses_right = encoder_right.pulse_count,
+                .remote = remote,
+            };
+            xMessageBufferSend(status_buffer, &report, sizeof(report), 0);
+        }
+    }
+}
+
+static void print_status(const status_report_t *report)
+{
+    // Print statements for encoder
+    printf("Pulse Count: L %lu R %lu\n",
+           (unsigned long)report->pulses_left, (unsigned long)report->pulses_right);
+
+    // Print statements for IR sensors
+    printIRSensorStatus(report->left_on_line, report->right_on_line);
+
+    // Print statements for ODOMETRY, heading fused with the COMPASS
+    printf("Pose: x %.1f cm, y %.1f cm, heading %.1f deg\n",
+           report->pose.x / 65536.0f, report->pose.y / 65536.0f, report->pose.theta / 65536.0f);
+
+    // Print statements for ULTRASONIC SENSOR
+    printf("Distance: %.2f cm\n", report->distance_cm);
+
+    // Print statements for the state machine: tick cost and the worst time
+    // from a sensor sample to the transition it caused
+    const behavior_stats_t *stats = &report->stats;
+    printf("Behavior: %s, %lu transitions, tick avg %lu us max %lu us, latency max %lu us\n",
+           behavior_state_name(report->state), (unsigned long)stats->transitions,
+           (unsigned long)(stats->ticks ? stats->tick_us_total / stats->ticks : 0),
+           (unsigned long)stats->tick_us_max, (unsigned long)stats->latency_us_max);
+    printf("Sensor to decision: IR age avg %lu us max %lu us\n",
+           (unsigned long)(stats->ticks ? stats->ir_age_us_total / stats->ticks : 0),
+           (unsigned long)stats->ir_age_us_max);
+
+#if ROBOT_SENSOR_CORE1
+    // Print statements for the core 1 handoff
+    sensor_frame_stats_t frames;
+    sensor_frame_get_stats(&frames);
+    printf("Core 1: %lu frames, %lu read, %lu skipped, age avg %lu us max %lu us\n",
+           (unsigned long)frames.published, (unsigned long)frames.reads, (unsigned long)frames.skipped,
+           (unsigned long)(frames.reads ? frames.age_us_total / frames.reads : 0),
+           (unsigned long)frames.age_us_max);
+#endif
+
+    // Print statements for the control task period
+    control_timing_t timing;
+    taskENTER_CRITICAL();
+    timing = control_timing;
+    taskEXIT_CRITICAL();
+    if (timing.periods > 0)
+    {
+        printf("Control: %lu periods, jitter %ld..%ld us, %lu overruns, tick max %lu us, %lu snapshots dropped\n",
+               (unsigned long)timing.periods, (long)timing.jitter_min_us, (long)timing.jitter_max_us,
+               (unsigned long)timing.overruns, (unsigned long)timing.tick_us_max,
+               (unsigned long)snapshots_dropped);
+    }
+
+    // Print statements for telemetry
+    telemetry_stats_t telemetry;
+    telemetry_get_stats(&telemetry);
+    if (telemetry.records > 0)
+    {
+        printf("Telemetry: %lu records, %lu dropped, %lu frames, %lu bytes, %lu send errors\n",
+               (unsigned long)telemetry.records, (unsigned long)telemetry.dropped,
+               (unsigned long)telemetry.frames, (unsigned long)telemetry.bytes,
+               (unsigned long)telemetry.send_errors);
+    }
+
+    // Print statements for the binary log
+    log_stats_t log;
+    log_get_stats(&log);
+    printf("Log: %lu records, %lu dropped, %lu frames, %lu bytes\n",
+           (unsigned long)log.records, (unsigned long)log.dropped,
+           (unsigned long)log.frames, (unsigned long)log.bytes);
+
+    // Print statements for remote commands
+    command_stats_t commands;
+    command_get_stats(&commands);
+    if (commands.received > 0)
+    {
+        printf("Commands: %lu received, %lu run, %lu malformed, %lu unknown, %lu busy, latency max %lu us%s\n",
+               (unsigned long)commands.received, (unsigned long)report->remote.executed,
+               (unsigned long)commands.malformed, (unsigned long)commands.unknown,
+               (unsigned long)commands.busy, (unsigned long)report->remote.latency_us_max,
+               report->remote.manual ? ", manual" : "");
+    }
+}
+
+// Interrupts whose handlers are timed: sensors (GPIO edges, ADC and IMU
+// DMA, I2C), the IMU poll timer and, once it is up, cyw43
+static const uint timed_irqs[] = {
+    IO_IRQ_BANK0,
+    DMA_IRQ_0,
+    DMA_IRQ_1,
+    I2C0_IRQ,
+    I2C1_IRQ,
+    TIMER_IRQ_0 + PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM,
+};
+
+// CPU share of every task, stack high-water marks, ISR times and the
+// control jitter histogram. The load and the worst jitter of the period go
+// into the telemetry; everything is printed and logged when asked for
+static void update_runtime_stats(bool detail)
+{
+    task_stats_t tasks[RUNTIME_STATS_MAX_TASKS];
+    uint task_count = runtime_stats_sample(tasks, RUNTIME_STATS_MAX_TASKS);
+
+    uint32_t idle_permille = 0;
+    for (uint i = 0; i < task_count; i++)
+    {
+        if (strncmp(tasks[i].name, "IDLE", 4) == 0)
+            idle_permille += tasks[i].cpu_permille;
+    }
+    cpu_load_permille = idle_permille < 1000 ? 1000 - idle_permille : 0;
+
+    control_timing_t timing;
+    taskENTER_CRITICAL();
+    timing = control_timing;
+    control_timing.window_max_us = INT32_MIN;
+    taskEXIT_CRITICAL();
+    jitter_window_max_us = timing.window_max_us;
+
+    const histogram_t *jitter = &timing.jitter;
+    if (jitter->samples > 0)
+    {
+        printf("CPU: load %lu.%lu%%, control jitter p50 <= %ld us, p99 <= %ld us, max %ld us\n",
+               (unsigned long)cpu_load_permille / 10, (unsigned long)cpu_load_permille % 10,
+               (long)histogram_percentile(jitter, 500), (long)histogram_percentile(jitter, 990),
+               (long)jitter->max);
+    }
+    if (!detail)
+    {
+        return;
+    }
+
+    // Print statements for every task: CPU share and the least free stack
+    for (uint i = 0; i < task_count; i++)
+    {
+        const char *name = tasks[i].name;
+        printf("Task %-16s priority %2u, cpu %3lu.%lu%%, stack free %lu words\n",
+               name, tasks[i].priority,
+               (unsigned long)tasks[i].cpu_permille / 10, (unsigned long)tasks[i].cpu_permille % 10,
+               (unsigned long)tasks[i].stack_free_words);
+        // The decoder has no strings: the first four characters stand in
+        char tag[4] = {' ', ' ', ' ', ' '};
+        for (int c = 0; c < 4 && name[c]; c++)
+            tag[c] = name[c];
+        LOG(LOG_TASK_STATS, tag[0], tag[1], tag[2], tag[3], tasks[i].cpu_permille, tasks[i].stack_free_words);
+    }
+
+    // Print statements for the timed interrupt handlers
+    isr_stats_t isrs[RUNTIME_STATS_MAX_IRQS];
+    uint isr_count = runtime_stats_isr(isrs, RUNTIME_STATS_MAX_IRQS);
+    for (uint i = 0; i < isr_count; i++)
+    {
+        const histogram_t *time = &isrs[i].time_us;
+        if (time->samples == 0)
+            continue;
+        int32_t p99 = histogram_percentile(time, 990);
+        printf("IRQ %2u: %lu calls, p50 <= %ld us, p99 <= %ld us, max %ld us\n",
+               isrs[i].irq, (unsigned long)time->samples, (long)histogram_percentile(time, 500),
+               (long)p99, (long)time->max);
+        LOG(LOG_ISR_STATS, isrs[i].irq, time->samples, p99, time->max);
+    }
+
+    // Print statements for the jitter histogram, one count per bucket
+    printf("Jitter histogram from %d us, %d us buckets:", JITTER_HISTOGRAM_ORIGIN, 1 << JITTER_HISTOGRAM_SHIFT);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        printf(" %lu", (unsigned long)jitter->count[i]);
+    }
+    printf("\n");
+    LOG(LOG_JITTER_STATS, jitter->samples, histogram_percentile(jitter, 500),
+        histogram_percentile(jitter, 990), jitter->max, timing.overruns);
+}
+
+// Everything that talks to the outside world, at the lowest priority
+static void comms_task(__unused void *params)
+{
+    status_report_t report;
+    char text[BARCODE_MAX_ELEMENTS / 10 + 1];
+
+    // Telemetry and remote commands need the network, the car does not:
+    // carry on without it
+    bool telemetry_on = TELEMETRY_HOST[0] != '\0';
+    bool log_over_udp = false;
+    if ((telemetry_on || ROBOT_REMOTE_COMMANDS) && !wifi_connect(WIFI_CONNECT_TIMEOUT_MS))
+    {
+        printf("Wi-Fi: not connected, telemetry and remote commands off\n");
+    }
+    else
+    {
+        telemetry_config_t telemetry = {
+            .host = TELEMETRY_HOST,
+            .port = TELEMETRY_PORT,
+            .period_ms = TELEMETRY_PERIOD_MS,
+            .field_count = TELEMETRY_FIELD_COUNT,
+        };
+        if (telemetry_on && !telemetry_start(&telemetry))
         {
-            // Left IR SENSOR on the line: robot car turns RIGHT
-            move_forward_right(); 
-            sleep_ms(400);
+            printf("Telemetry: not started\n");
         }
-        else if (gpio_get(IR_SENSOR_LEFT) && gpio_get(IR_SENSOR_RIGHT))
+        log_over_udp = telemetry_on && log_udp_start(TELEMETRY_HOST, LOG_UDP_PORT, LOG_DRAIN_MS);
+        if (ROBOT_REMOTE_COMMANDS && !command_server_start(COMMAND_PORT, COMMAND_OPCODE_COUNT))
         {
-            // Both IR SENSORS on the line: robot car moves BACKWARDS for 1.2 seconds
-            move_backward(); 
-            sleep_ms(1200);      
+            printf("Commands: server not started\n");
         }
     }
 
+    // Every handler is installed now, cyw43's included
+    for (uint i = 0; i < count_of(timed_irqs); i++)
+    {
+        runtime_stats_time_irq(timed_irqs[i]);
+    }
+
+    while (true)
+    {
+        if (xMessageBufferReceive(status_buffer, &report, sizeof(report), pdMS_TO_TICKS(LOG_DRAIN_MS)) == sizeof(report))
+        {
+            print_status(&report);
+            // Read and cleared together, or a STATS landing in between is lost
+            taskENTER_CRITICAL();
+            bool detail = stats_requested;
+            stats_requested = false;
+            taskEXIT_CRITICAL();
+            update_runtime_stats(detail);
+        }
+
+        // Binary frames between the status text; tools/log_decoder passes
+        // the text through
+        if (!log_over_udp)
+        {
+            log_drain_stdio();
+        }
+
+        size_t length;
+        while ((length = xMessageBufferReceive(barcode_buffer, text, sizeof(text) - 1, 0)) > 0)
+        {
+            text[length] = '\0';
+            printf("Barcode: %s\n", text);
+        }
+    }
+}
+
+int main()
+{
+    stdio_init_all();
+
+#if ROBOT_SENSOR_CORE1
+    // Sensor interrupts are enabled on the core that sets them up; wait until
+    // core 1 has, before anything reads the sensors
+    multicore_launch_core1(sensor_core_main);
+    multicore_fifo_pop_blocking();
+#else
+    gpio_encoder_initialization();
+
+    gpio_ir_sensor_initialization();
+
+    gpio_ultrasonic_initialization();
+
+    gpio_compass_initialization();
+#endif
+
+    gpio_motor_initialization();
+
+    histogram_init(&control_timing.jitter, JITTER_HISTOGRAM_ORIGIN, JITTER_HISTOGRAM_SHIFT);
+
+    // Closed-loop wheel speed control, ticked by the control task
+    speed_control_init(&encoder_left, &encoder_right);
+
+    // Encoder-distance maneuvers with trapezoidal speed ramps, run from the control tick
+    motion_init(&encoder_left, &encoder_right);
+
+    // Empty maze map, origin where the car starts, explored by the planner
+    grid_init(&grid);
+    planner_init(&planner, &grid);
+
+    // Each message costs its length plus a size_t header
+    snapshot_buffer = xMessageBufferCreate(SNAPSHOT_BUFFER_MESSAGES * (sizeof(behavior_snapshot_t) + sizeof(size_t)));
+    status_buffer = xMessageBufferCreate(2 * (sizeof(status_report_t) + sizeof(size_t)));
+    barcode_buffer = xMessageBufferCreate(BARCODE_BUFFER_BYTES);
+
+    // On two cores (ROBOT_SMP) control and sensors keep core 0, where the
+    // sensor and encoder interrupts were enabled above, and planning and comms
+    // share core 1 with the network. The message buffers work across cores
+    TaskHandle_t task;
+    xTaskCreate(control_task, "Control", CONTROL_TASK_STACK, NULL, CONTROL_TASK_PRIORITY, &task);
+    rtos_pin_task(task, RTOS_CONTROL_CORE);
+    xTaskCreate(sensor_task, "Sensor", SENSOR_TASK_STACK, NULL, SENSOR_TASK_PRIORITY, &sensor_task_handle);
+    rtos_pin_task(sensor_task_handle, RTOS_CONTROL_CORE);
+    xTaskCreate(planning_task, "Planning", PLANNING_TASK_STACK, NULL, PLANNING_TASK_PRIORITY, &task);
+    rtos_pin_task(task, RTOS_NETWORK_CORE);
+    xTaskCreate(comms_task, "Comms", COMMS_TASK_STACK, NULL, COMMS_TASK_PRIORITY, &task);
+    rtos_pin_task(task, RTOS_NETWORK_CORE);
+
+    vTaskStartScheduler();
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,177 @@
+#include "barcode.h"
+
+#define ELEMENTS_PER_CHAR 9
+#define WIDE_PER_CHAR 3
+
+// Code 39 characters and their 9-element patterns, first element in the
+// most significant bit, 1 = wide
+static const char code39_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%*";
+static const uint16_t code39_patterns[] = {
+    0x034, 0x121, 0x061, 0x160, 0x031, 0x130, 0x070, 0x025, 0x124, 0x064, // 0-9
+    0x109, 0x049, 0x148, 0x019, 0x118, 0x058, 0x00D, 0x10C, 0x04C, 0x01C, // A-J
+    0x103, 0x043, 0x142, 0x013, 0x112, 0x052, 0x007, 0x106, 0x046, 0x016, // K-T
+    0x181, 0x0C1, 0x1C0, 0x091, 0x190, 0x0D0, 0x085, 0x184, 0x0C4, 0x0A8, // U-$
+    0x0A2, 0x08A, 0x02A, 0x094,                                           // /+%*
+};
+
+static char lookup(uint16_t pattern)
+{
+    for (uint i = 0; i < sizeof(code39_patterns) / sizeof(code39_patterns[0]); i++) {
+        if (code39_patterns[i] == pattern)
+            return code39_chars[i];
+    }
+    return 0;
+}
+
+// Classify one character's nine widths. Every Code 39 character has exactly
+// three wide elements, so taking the three widest normalizes each character
+// on its own and tolerates speed changes along the barcode
+static char decode_char(const q16_t *widths, uint first, int step)
+{
+    q16_t w[ELEMENTS_PER_CHAR];
+    for (int i = 0; i < ELEMENTS_PER_CHAR; i++)
+        w[i] = widths[first + step * i];
+
+    uint16_t pattern = 0;
+    q16_t narrowest_wide = INT32_MAX;
+    for (int n = 0; n < WIDE_PER_CHAR; n++) {
+        int widest = -1;
+        for (int i = 0; i < ELEMENTS_PER_CHAR; i++) {
+            if (!(pattern & (0x100 >> i)) && (widest < 0 || w[i] > w[widest]))
+                widest = i;
+        }
+        pattern |= 0x100 >> widest;
+        narrowest_wide = w[widest];
+    }
+
+    q16_t widest_narrow = 0;
+    for (int i = 0; i < ELEMENTS_PER_CHAR; i++) {
+        if (!(pattern & (0x100 >> i)) && w[i] > widest_narrow)
+            widest_narrow = w[i];
+    }
+    if (narrowest_wide < q16_mul(widest_narrow, BARCODE_MIN_WIDE_RATIO))
+        return 0;
+
+    return lookup(pattern);
+}
+
+// Decode in one direction; step is 1 (as scanned) or -1 (reversed)
+static bool decode_direction(const q16_t *widths, uint count, int step, char *text, size_t text_len)
+{
+    uint chars = (count + 1) / (ELEMENTS_PER_CHAR + 1);
+    if (chars < 3 || chars - 2 >= text_len)
+        return false;
+
+    uint start = step > 0 ? 0 : count - 1;
+    size_t len = 0;
+    for (uint c = 0; c < chars; c++) {
+        // Characters are 9 elements plus one inter-character gap
+        uint first = start + step * (int)(c * (ELEMENTS_PER_CHAR + 1));
+        char ch = decode_char(widths, first, step);
+        if (!ch)
+            return false;
+
+        bool delimiter = c == 0 || c == chars - 1;
+        if ((ch == '*') != delimiter)
+            return false;
+        if (!delimiter)
+            text[len++] = ch;
+    }
+    text[len] = '\0';
+    return true;
+}
+
+bool barcode_decode(const q16_t *widths, uint count, char *text, size_t text_len)
+{
+    // Merge noise: a too-short element joins the ones either side of it
+    q16_t merged[BARCODE_MAX_ELEMENTS];
+    uint n = 0;
+    for (uint i = 0; i < count && i < BARCODE_MAX_ELEMENTS; i++) {
+        if (widths[i] < BARCODE_MIN_ELEMENT && n > 0 && i + 1 < count) {
+            merged[n - 1] += widths[i] + widths[i + 1];
+            i++;
+            continue;
+        }
+        merged[n++] = widths[i];
+    }
+
+    if (n % (ELEMENTS_PER_CHAR + 1) != ELEMENTS_PER_CHAR)
+        return false;
+
+    // '*' reversed is not '*', so only the right direction passes
+    return decode_direction(merged, n, 1, text, text_len) ||
+           decode_direction(merged, n, -1, text, text_len);
+}
+
+void barcode_init(barcode_decoder_t *decoder)
+{
+    decoder->count = 0;
+    decoder->narrowest = INT32_MAX;
+    decoder->last_edge = 0;
+    decoder->black = false;
+    decoder->overflow = false;
+}
+
+static bool is_quiet(const barcode_decoder_t *decoder, q16_t width)
+{
+    return width >= BARCODE_MIN_QUIET &&
+           (decoder->narrowest == INT32_MAX || width >= decoder->narrowest * BARCODE_QUIET_RATIO);
+}
+
+static void push(barcode_decoder_t *decoder, q16_t width)
+{
+    if (decoder->count == BARCODE_MAX_ELEMENTS) {
+        decoder->overflow = true;
+        return;
+    }
+    decoder->widths[decoder->count++] = width;
+    if (width >= BARCODE_MIN_ELEMENT && width < decoder->narrowest)
+        decoder->narrowest = width;
+}
+
+// End of a scan: decode whatever was collected and start over
+static bool finish(barcode_decoder_t *decoder, char *text, size_t text_len)
+{
+    bool ok = !decoder->overflow && decoder->count > 0 &&
+              barcode_decode(decoder->widths, decoder->count, text, text_len);
+    decoder->count = 0;
+    decoder->narrowest = INT32_MAX;
+    decoder->overflow = false;
+    return ok;
+}
+
+bool barcode_feed(barcode_decoder_t *decoder, uint32_t position, bool black, char *text, size_t text_len)
+{
+    if (black == decoder->black)
+        return false;
+
+    q16_t width = (q16_t)((position - decoder->last_edge) & BARCODE_POSITION_MASK);
+    bool decoded = false;
+
+    if (black) {
+        // A space just ended. After a quiet zone this bar starts a new scan
+        if (decoder->count > 0 && is_quiet(decoder, width))
+            decoded = finish(decoder, text, text_len);
+        else if (decoder->count > 0)
+            push(decoder, width);
+    } else {
+        // A bar just ended. The very first bar of a scan starts the list
+        push(decoder, width);
+    }
+
+    decoder->last_edge = position;
+    decoder->black = black;
+    return decoded;
+}
+
+bool barcode_idle(barcode_decoder_t *decoder, uint32_t position, char *text, size_t text_len)
+{
+    if (decoder->black || decoder->count == 0)
+        return false;
+
+    q16_t width = (q16_t)((position - decoder->last_edge) & BARCODE_POSITION_MASK);
+    if (!is_quiet(decoder, width))
+        return false;
+
+    return finish(decoder, text, text_len);
+}
@@ -0,0 +1,56 @@
+#ifndef BARCODE_H
+#define BARCODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "fixed.h"
+
+// Streaming Code 39 decoder. It is fed black/white transitions tagged with
+// the car's travelled distance, so bar widths do not depend on speed, and
+// it reads barcodes in either direction.
+//
+// Positions are Q16.16 cm taken modulo 2^31 (the top bit is free for the
+// colour when transitions are queued as one 32-bit word); only differences
+// between positions are used.
+#define BARCODE_POSITION_MASK 0x7FFFFFFFu
+
+// Up to 12 characters including the start/stop '*'
+#define BARCODE_MAX_ELEMENTS 120
+
+// Bars/spaces shorter than this are sensor noise and merged into their neighbours
+#define BARCODE_MIN_ELEMENT Q16(0.08)   // cm
+
+// A space this many times the narrowest element (and at least
+// BARCODE_MIN_QUIET) is a quiet zone: the barcode before it is complete
+#define BARCODE_QUIET_RATIO 5
+#define BARCODE_MIN_QUIET Q16(1.5)      // cm
+
+// The narrowest wide element must be at least this many times the widest
+// narrow one for a character to be accepted (Code 39 allows 2:1 to 3:1)
+#define BARCODE_MIN_WIDE_RATIO Q16(1.5)
+
+typedef struct {
+    q16_t widths[BARCODE_MAX_ELEMENTS];     // bar, space, bar, ... in cm
+    uint count;
+    q16_t narrowest;
+    uint32_t last_edge;                     // position of the last transition
+    bool black;                             // colour since last_edge
+    bool overflow;                          // scan too long, dropped
+} barcode_decoder_t;
+
+void barcode_init(barcode_decoder_t *decoder);
+
+// Feed one transition. Returns true and writes the NUL terminated text
+// (without the '*' delimiters) when it completes a barcode
+bool barcode_feed(barcode_decoder_t *decoder, uint32_t position, bool black, char *text, size_t text_len);
+
+// Call with the current position while no transitions arrive: once the car
+// has travelled a quiet zone past the last bar, the barcode is decoded
+bool barcode_idle(barcode_decoder_t *decoder, uint32_t position, char *text, size_t text_len);
+
+// Decode a complete list of element widths (first one a bar). Pure function
+bool barcode_decode(const q16_t *widths, uint count, char *text, size_t text_len);
+
+#endif
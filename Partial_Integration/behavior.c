@@ -0,0 +1,243 @@
+#include "behavior.h"
+#include "fixed_trig.h"
+#include "log.h"
+#include "log_messages.h"
+#include "pico/time.h"
+#include "speed_control.h"
+
+// Events in priority order: when several hold, the first one the current
+// state has a transition for wins
+typedef enum {
+    EV_OBSTACLE = 0,    // something closer than BEHAVIOR_OBSTACLE_CM, recently measured
+    EV_STALLED,         // the running maneuver stopped making progress
+    EV_BOTH_ON_LINE,    // both IR sensors over black: a cross line
+    EV_DONE,            // no maneuver running (finished or timed out)
+    EV_LINE_SEEN,
+    EV_LINE_LOST,       // no line for BEHAVIOR_LINE_LOST_MS
+    EV_TIMEOUT,         // the state's own timeout expired
+    EV_COUNT,
+} behavior_event_t;
+
+// Row entries are state + 1 so that 0 (the default) means "stay"
+#define TO(state) ((state) + 1)
+
+typedef void (*behavior_action_t)(behavior_t *behavior, const behavior_snapshot_t *snapshot);
+
+typedef struct {
+    const char *name;
+    behavior_action_t entry;
+    behavior_action_t tick;
+    behavior_action_t exit;
+    uint32_t timeout_ms;        // 0: none
+    uint8_t next[EV_COUNT];
+} behavior_row_t;
+
+// The snapshot is taken on another task and may predate the maneuver the
+// last tick started: until it catches up, that maneuver counts as running
+static motion_state_t maneuver_state(const behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    return snapshot->maneuver == behavior->maneuver ? snapshot->motion : MOTION_RUNNING;
+}
+
+static void stop_entry(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    motion_abort();
+}
+
+// Drive to the next planner waypoint: turn towards it by compass, then
+// straight to it. Only while no maneuver is running
+static void follow_plan(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    if (maneuver_state(behavior, snapshot) == MOTION_RUNNING || !snapshot->plan_ready)
+        return;
+
+    const pose_t *pose = &snapshot->pose;
+    q16_t x, y;
+    planner_route_t route = planner_next_waypoint(behavior->planner, pose, &x, &y);
+
+    if (route == PLANNER_ARRIVED) {
+        // At the frontier: look around, the map grows and the planner moves it on
+        motion_turn_by(BEHAVIOR_TURN_DEG);
+        return;
+    }
+    if (route == PLANNER_NO_ROUTE) {
+        speed_control_set_target(0, 0);
+        return;
+    }
+
+    q16_t dx = x - pose->x;
+    q16_t dy = y - pose->y;
+    q16_t heading = q16_wrap_360(q16_atan2_deg(dx, dy));
+    if (q16_abs(q16_angle_diff_deg(heading, pose->theta)) > BEHAVIOR_WAYPOINT_TURN_DEG) {
+        motion_turn_to_heading(heading);
+    } else {
+        q16_t distance = (q16_t)isqrt64((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy));
+        motion_drive_straight(distance, heading);
+    }
+}
+
+static void cruise_tick(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    if (behavior->planner)
+        follow_plan(behavior, snapshot);
+    else
+        speed_control_set_target(BEHAVIOR_CRUISE_SPEED, BEHAVIOR_CRUISE_SPEED);
+}
+
+static void cruise_exit(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    // A waypoint maneuver would keep overriding the next state's targets
+    if (maneuver_state(behavior, snapshot) == MOTION_RUNNING)
+        motion_abort();
+}
+
+static void line_entry(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    line_follower_init(behavior->follower);
+}
+
+static void line_tick(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    // Steer once per new IR snapshot
+    if (snapshot->ir_sequence == behavior->last_ir_sequence)
+        return;
+    behavior->last_ir_sequence = snapshot->ir_sequence;
+
+    q16_t left_speed, right_speed;
+    line_follower_update(behavior->follower, &snapshot->line, &left_speed, &right_speed);
+    speed_control_set_target(left_speed, right_speed);
+}
+
+static void avoid_entry(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    motion_drive(-BEHAVIOR_REVERSE_CM);
+}
+
+static void recover_entry(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    // By compass if there is one, otherwise by encoder distance
+    if (!motion_turn_by(BEHAVIOR_TURN_DEG))
+        motion_arc(BEHAVIOR_TURN_DEG);
+}
+
+static const behavior_row_t table[BEHAVIOR_STATE_COUNT] = {
+    [BEHAVIOR_STOP] = {
+        "stop", stop_entry, NULL, NULL, BEHAVIOR_STOP_HOLD_MS,
+        { [EV_TIMEOUT] = TO(BEHAVIOR_CRUISE) },
+    },
+    [BEHAVIOR_CRUISE] = {
+        "cruise", NULL, cruise_tick, cruise_exit, 0,
+        {
+            [EV_OBSTACLE] = TO(BEHAVIOR_AVOID),
+            [EV_STALLED] = TO(BEHAVIOR_STOP),
+            [EV_BOTH_ON_LINE] = TO(BEHAVIOR_AVOID),
+            [EV_LINE_SEEN] = TO(BEHAVIOR_LINE_FOLLOW),
+        },
+    },
+    [BEHAVIOR_LINE_FOLLOW] = {
+        "line-follow", line_entry, line_tick, NULL, 0,
+        {
+            [EV_OBSTACLE] = TO(BEHAVIOR_AVOID),
+            [EV_BOTH_ON_LINE] = TO(BEHAVIOR_AVOID),
+            [EV_LINE_LOST] = TO(BEHAVIOR_CRUISE),
+        },
+    },
+    [BEHAVIOR_AVOID] = {
+        "avoid", avoid_entry, NULL, NULL, 0,
+        {
+            [EV_STALLED] = TO(BEHAVIOR_STOP),
+            [EV_DONE] = TO(BEHAVIOR_RECOVER),
+        },
+    },
+    [BEHAVIOR_RECOVER] = {
+        "recover", recover_entry, NULL, NULL, 0,
+        {
+            [EV_OBSTACLE] = TO(BEHAVIOR_AVOID),
+            [EV_STALLED] = TO(BEHAVIOR_STOP),
+            [EV_DONE] = TO(BEHAVIOR_CRUISE),
+        },
+    },
+};
+
+void behavior_init(behavior_t *behavior, line_follower_t *follower, planner_t *planner)
+{
+    behavior->state = BEHAVIOR_CRUISE;
+    behavior->entered_us = time_us_32();
+    behavior->last_line_us = behavior->entered_us;
+    behavior->last_ir_sequence = 0;
+    behavior->maneuver = motion_get_maneuver();
+    behavior->follower = follower;
+    behavior->planner = planner;
+    behavior->stats = (behavior_stats_t){0};
+}
+
+void behavior_tick(behavior_t *behavior, const behavior_snapshot_t *snapshot)
+{
+    uint32_t now = snapshot->now_us;
+    const behavior_row_t *row = &table[behavior->state];
+
+    if (snapshot->line.confidence >= LINE_MIN_CONFIDENCE)
+        behavior->last_line_us = now;
+
+    // Which events hold, and when the sensor reading behind each was taken
+    bool events[EV_COUNT];
+    uint32_t since[EV_COUNT];
+    events[EV_OBSTACLE] = snapshot->distance_cm < BEHAVIOR_OBSTACLE_CM &&
+                          now - snapshot->distance_timestamp_us <= BEHAVIOR_DISTANCE_MAX_AGE_MS * 1000;
+    since[EV_OBSTACLE] = snapshot->distance_timestamp_us;
+    motion_state_t motion = maneuver_state(behavior, snapshot);
+    events[EV_STALLED] = motion == MOTION_STALLED;
+    since[EV_STALLED] = now;
+    events[EV_BOTH_ON_LINE] = snapshot->left_on_line && snapshot->right_on_line;
+    since[EV_BOTH_ON_LINE] = snapshot->ir_timestamp_us;
+    events[EV_DONE] = motion != MOTION_RUNNING;
+    since[EV_DONE] = now;
+    events[EV_LINE_SEEN] = snapshot->line.confidence >= LINE_MIN_CONFIDENCE;
+    since[EV_LINE_SEEN] = snapshot->ir_timestamp_us;
+    events[EV_LINE_LOST] = now - behavior->last_line_us > BEHAVIOR_LINE_LOST_MS * 1000;
+    since[EV_LINE_LOST] = now;
+    events[EV_TIMEOUT] = row->timeout_ms && now - behavior->entered_us > row->timeout_ms * 1000;
+    since[EV_TIMEOUT] = now;
+
+    for (int ev = 0; ev < EV_COUNT; ev++) {
+        if (!events[ev] || !row->next[ev])
+            continue;
+
+        behavior_state_t previous = behavior->state;
+        behavior_state_t next = row->next[ev] - 1;
+        if (row->exit)
+            row->exit(behavior, snapshot);
+        behavior->state = next;
+        behavior->entered_us = now;
+        row = &table[next];
+        if (row->entry)
+            row->entry(behavior, snapshot);
+
+        behavior->stats.transitions++;
+        uint32_t latency = time_us_32() - since[ev];
+        LOG(LOG_BEHAVIOR_TRANSITION, previous, next, ev, latency);
+        if (latency > behavior->stats.latency_us_max)
+            behavior->stats.latency_us_max = latency;
+        break;
+    }
+
+    if (row->tick)
+        row->tick(behavior, snapshot);
+    behavior->maneuver = motion_get_maneuver();
+
+    uint32_t end = time_us_32();
+    uint32_t tick_us = end - now;
+    uint32_t ir_age_us = end - snapshot->ir_timestamp_us;
+    behavior->stats.ticks++;
+    behavior->stats.tick_us_total += tick_us;
+    behavior->stats.ir_age_us_total += ir_age_us;
+    if (tick_us > behavior->stats.tick_us_max)
+        behavior->stats.tick_us_max = tick_us;
+    if (ir_age_us > behavior->stats.ir_age_us_max)
+        behavior->stats.ir_age_us_max = ir_age_us;
+}
+
+const char *behavior_state_name(behavior_state_t state)
+{
+    return state < BEHAVIOR_STATE_COUNT ? table[state].name : "?";
+}
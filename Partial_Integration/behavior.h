@@ -0,0 +1,86 @@
+#ifndef BEHAVIOR_H
+#define BEHAVIOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed.h"
+#include "line_follow.h"
+#include "motion.h"
+#include "odometry.h"
+#include "planner.h"
+
+// Car behaviours as a table-driven state machine. Every tick gets one
+// snapshot of the sensors, turns it into events, and takes at most one
+// transition: the first event in priority order that the current state's
+// row maps to another state. Entry, exit and tick actions only set targets
+// or start maneuvers, so a tick never blocks.
+
+#define BEHAVIOR_OBSTACLE_CM 10.0f      // ultrasonic distance that triggers AVOID
+#define BEHAVIOR_DISTANCE_MAX_AGE_MS 200 // older readings (echoes stopped) are ignored
+#define BEHAVIOR_REVERSE_CM Q16(15.0)   // AVOID backs away this far
+#define BEHAVIOR_TURN_DEG Q16(90.0)     // RECOVER turns this far clockwise
+#define BEHAVIOR_CRUISE_SPEED Q16(25.0) // cm/s, CRUISE without a planner
+#define BEHAVIOR_LINE_LOST_MS 300       // LINE_FOLLOW gives up after this long
+#define BEHAVIOR_STOP_HOLD_MS 1000      // STOP waits this long before CRUISE
+
+// Turn on the spot first if a waypoint is further off the heading than this
+#define BEHAVIOR_WAYPOINT_TURN_DEG Q16(10.0)
+
+typedef enum {
+    BEHAVIOR_STOP = 0,
+    BEHAVIOR_CRUISE,        // no line: straight ahead, or the planner's waypoints
+    BEHAVIOR_LINE_FOLLOW,
+    BEHAVIOR_AVOID,         // back away from an obstacle or a cross line
+    BEHAVIOR_RECOVER,       // turn onto a new heading
+    BEHAVIOR_STATE_COUNT,
+} behavior_state_t;
+
+// Everything one tick decides on, read once at the start of the tick
+typedef struct {
+    uint32_t now_us;
+
+    uint32_t ir_sequence;
+    uint32_t ir_timestamp_us;
+    bool left_on_line;
+    bool right_on_line;
+    line_estimate_t line;
+
+    float distance_cm;
+    uint32_t distance_timestamp_us;
+
+    pose_t pose;
+    motion_state_t motion;
+    uint32_t maneuver;          // the maneuver motion belongs to (motion_get_status())
+    bool plan_ready;
+} behavior_snapshot_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t transitions;
+    uint32_t tick_us_max;       // snapshot start to end of tick
+    uint64_t tick_us_total;
+    uint32_t latency_us_max;    // triggering sensor sample to transition done
+    uint32_t ir_age_us_max;     // IR sample to the end of the tick that used it
+    uint64_t ir_age_us_total;
+} behavior_stats_t;
+
+typedef struct {
+    behavior_state_t state;
+    uint32_t entered_us;
+    uint32_t last_line_us;
+    uint32_t last_ir_sequence;
+    uint32_t maneuver;          // latest maneuver when the last tick ended
+    line_follower_t *follower;
+    planner_t *planner;         // NULL: CRUISE drives straight ahead
+    behavior_stats_t stats;
+} behavior_t;
+
+void behavior_init(behavior_t *behavior, line_follower_t *follower, planner_t *planner);
+
+// One tick: events from the snapshot, at most one transition, the state's
+// tick action. Constant time apart from the planner waypoint lookup
+void behavior_tick(behavior_t *behavior, const behavior_snapshot_t *snapshot);
+
+const char *behavior_state_name(behavior_state_t state);
+
+#endif
@@ -0,0 +1,157 @@
+#include <string.h>
+#include "grid.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "fixed_trig.h"
+
+#define GRID_MAGIC 0x44495247u  // "GRID"
+
+#define CELL_Q16 q16_from_int(GRID_CELL_CM)
+
+void grid_init(grid_t *grid)
+{
+    memset(grid, 0, sizeof(*grid));
+}
+
+static bool in_grid(int cx, int cy)
+{
+    return cx >= 0 && cx < GRID_WIDTH && cy >= 0 && cy < GRID_HEIGHT;
+}
+
+static void set_cell(grid_t *grid, int cx, int cy, bool occupied)
+{
+    uint index = (uint)cy * GRID_WIDTH + (uint)cx;
+    uint8_t bit = 1u << (index & 7);
+    uint8_t known = grid->known[index >> 3];
+    uint8_t was_occupied = grid->occupied[index >> 3];
+
+    grid->known[index >> 3] = known | bit;
+    if (occupied)
+        grid->occupied[index >> 3] |= bit;
+    else
+        grid->occupied[index >> 3] &= ~bit;
+
+    // Log the cell for the planner if it changed
+    if ((known & bit) && (grid->occupied[index >> 3] & bit) == (was_occupied & bit))
+        return;
+    if (grid->change_count < GRID_CHANGE_LOG)
+        grid->changes[grid->change_count++] = index;
+    else
+        grid->changes_lost = true;
+}
+
+void grid_cell_center(int cx, int cy, q16_t *x, q16_t *y)
+{
+    *x = (cx - GRID_ORIGIN_X) * CELL_Q16 + CELL_Q16 / 2;
+    *y = (cy - GRID_ORIGIN_Y) * CELL_Q16 + CELL_Q16 / 2;
+}
+
+grid_cell_t grid_get(const grid_t *grid, int cx, int cy)
+{
+    if (!in_grid(cx, cy))
+        return GRID_UNKNOWN;
+
+    uint index = (uint)cy * GRID_WIDTH + (uint)cx;
+    uint8_t bit = 1u << (index & 7);
+    if (!(grid->known[index >> 3] & bit))
+        return GRID_UNKNOWN;
+    return (grid->occupied[index >> 3] & bit) ? GRID_OCCUPIED : GRID_FREE;
+}
+
+bool grid_cell_at(q16_t x, q16_t y, int *cx, int *cy)
+{
+    // Floor division, so cells left of / below the origin do not share cell 0
+    int32_t col = x >= 0 ? x / CELL_Q16 : -((-x + CELL_Q16 - 1) / CELL_Q16);
+    int32_t row = y >= 0 ? y / CELL_Q16 : -((-y + CELL_Q16 - 1) / CELL_Q16);
+    *cx = GRID_ORIGIN_X + col;
+    *cy = GRID_ORIGIN_Y + row;
+    return in_grid(*cx, *cy);
+}
+
+void grid_add_reading(grid_t *grid, const pose_t *pose, float distance_cm)
+{
+    bool hit = distance_cm <= GRID_MAX_RANGE_CM;
+    q16_t range = q16_from_int(GRID_SENSOR_OFFSET_CM) +
+                  (hit ? (q16_t)(distance_cm * Q16_ONE) : q16_from_int(GRID_MAX_RANGE_CM));
+
+    q16_t sin_theta, cos_theta;
+    q16_sincos_deg(pose->theta, &sin_theta, &cos_theta);
+
+    // The beam starts at the sensor, ahead of the axle
+    q16_t sensor_x = pose->x + GRID_SENSOR_OFFSET_CM * sin_theta;
+    q16_t sensor_y = pose->y + GRID_SENSOR_OFFSET_CM * cos_theta;
+    q16_t end_x = pose->x + q16_mul(range, sin_theta);
+    q16_t end_y = pose->y + q16_mul(range, cos_theta);
+
+    int x0, y0, x1, y1;
+    grid_cell_at(sensor_x, sensor_y, &x0, &y0);
+    grid_cell_at(end_x, end_y, &x1, &y1);
+
+    // Bresenham from the sensor cell to the end cell, stopping at the edge
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+    int step_x = x0 < x1 ? 1 : -1;
+    int step_y = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+
+    while (x0 != x1 || y0 != y1) {
+        if (!in_grid(x0, y0))
+            return;
+        set_cell(grid, x0, y0, false);
+
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += step_x;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += step_y;
+        }
+    }
+    if (in_grid(x1, y1))
+        set_cell(grid, x1, y1, hit);
+}
+
+void grid_encode(const grid_t *grid, uint8_t record[GRID_RECORD_SIZE])
+{
+    put_le32(record, GRID_MAGIC);
+    put_le16(record + 4, GRID_VERSION);
+    put_le16(record + 6, GRID_PAYLOAD_SIZE);
+    put_le16(record + 8, GRID_WIDTH);
+    put_le16(record + 10, GRID_HEIGHT);
+    record[12] = GRID_CELL_CM;
+    record[13] = GRID_ORIGIN_X;
+    record[14] = GRID_ORIGIN_Y;
+    record[15] = 0;     // reserved
+
+    // Cell (x, y) is bit (y * width + x) % 8 of byte (y * width + x) / 8
+    uint8_t *p = record + GRID_HEADER_SIZE;
+    memcpy(p, grid->known, GRID_PLANE_BYTES);
+    memcpy(p + GRID_PLANE_BYTES, grid->occupied, GRID_PLANE_BYTES);
+
+    put_le32(p + GRID_PAYLOAD_SIZE, crc32(record, GRID_HEADER_SIZE + GRID_PAYLOAD_SIZE));
+}
+
+bool grid_decode(const uint8_t *record, grid_t *grid)
+{
+    if (get_le32(record) != GRID_MAGIC ||
+        get_le16(record + 4) != GRID_VERSION ||
+        get_le16(record + 6) != GRID_PAYLOAD_SIZE ||
+        get_le16(record + 8) != GRID_WIDTH ||
+        get_le16(record + 10) != GRID_HEIGHT ||
+        record[12] != GRID_CELL_CM)
+        return false;
+
+    const uint8_t *p = record + GRID_HEADER_SIZE;
+    if (get_le32(p + GRID_PAYLOAD_SIZE) != crc32(record, GRID_HEADER_SIZE + GRID_PAYLOAD_SIZE))
+        return false;
+
+    memcpy(grid->known, p, GRID_PLANE_BYTES);
+    memcpy(grid->occupied, p + GRID_PLANE_BYTES, GRID_PLANE_BYTES);
+
+    // Everything may have changed
+    grid->change_count = 0;
+    grid->changes_lost = true;
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "fixed.h"
+#include "odometry.h"
+
+// Occupancy grid of the maze around the start point, two bits per cell:
+// a "known" plane and an "occupied" plane. 64 x 64 cells of 5 cm cover
+// 3.2 m square in 1 KB. The size can be set at build time (powers of two)
+#define GRID_CELL_CM 5
+#ifndef GRID_WIDTH
+#define GRID_WIDTH 64
+#endif
+#ifndef GRID_HEIGHT
+#define GRID_HEIGHT 64
+#endif
+#define GRID_CELLS (GRID_WIDTH * GRID_HEIGHT)
+#define GRID_PLANE_BYTES (GRID_CELLS / 8)
+
+// Cell holding the odometry origin (where the car started)
+#define GRID_ORIGIN_X (GRID_WIDTH / 2)
+#define GRID_ORIGIN_Y (GRID_HEIGHT / 2)
+
+// Readings beyond this are only trusted to say the path is clear up to here
+#define GRID_MAX_RANGE_CM 150
+
+// Ultrasonic sensor position ahead of the wheel axle centre
+#define GRID_SENSOR_OFFSET_CM 5
+
+// Cells whose state changed since the planner last looked
+#define GRID_CHANGE_LOG 64
+
+typedef enum {
+    GRID_UNKNOWN = 0,
+    GRID_FREE,
+    GRID_OCCUPIED,
+} grid_cell_t;
+
+typedef struct {
+    uint8_t known[GRID_PLANE_BYTES];
+    uint8_t occupied[GRID_PLANE_BYTES];
+
+    // Indices (y * width + x) of cells that changed state; changes_lost is
+    // set instead once the log is full
+    uint16_t changes[GRID_CHANGE_LOG];
+    uint change_count;
+    bool changes_lost;
+} grid_t;
+
+// Serialized record: magic, version, payload length, width, height, cell
+// size, origin, both planes, then CRC-32 of everything (little endian)
+#define GRID_VERSION 1
+#define GRID_HEADER_SIZE 16
+#define GRID_PAYLOAD_SIZE (2 * GRID_PLANE_BYTES)
+#define GRID_CRC_SIZE 4
+#define GRID_RECORD_SIZE (GRID_HEADER_SIZE + GRID_PAYLOAD_SIZE + GRID_CRC_SIZE)
+
+void grid_init(grid_t *grid);
+
+// Ray-cast one ultrasonic reading taken at pose: cells along the beam become
+// free and the cell it ended in occupied. Costs O(cells touched)
+void grid_add_reading(grid_t *grid, const pose_t *pose, float distance_cm);
+
+// Cell containing a floor position (cm, odometry frame). Returns false outside the grid
+bool grid_cell_at(q16_t x, q16_t y, int *cx, int *cy);
+
+// Centre of a cell in cm, odometry frame
+void grid_cell_center(int cx, int cy, q16_t *x, q16_t *y);
+
+grid_cell_t grid_get(const grid_t *grid, int cx, int cy);
+
+void grid_encode(const grid_t *grid, uint8_t record[GRID_RECORD_SIZE]);
+bool grid_decode(const uint8_t *record, grid_t *grid);
+
+#endif
@@ -0,0 +1,62 @@
+#include "line_follow.h"
+
+// 0 over white, 1 over black
+static q16_t normalize(uint16_t raw, uint16_t white, uint16_t black)
+{
+    if (black <= white)
+        return 0;
+    if (raw <= white)
+        return 0;
+    if (raw >= black)
+        return Q16_ONE;
+    return (q16_t)(((uint32_t)(raw - white) << Q16_SHIFT) / (uint32_t)(black - white));
+}
+
+void line_estimate(uint16_t raw_left, uint16_t raw_right, const ir_calibration_t *cal,
+                   line_estimate_t *estimate)
+{
+    q16_t left = normalize(raw_left, cal->min[IR_ADC_LEFT], cal->max[IR_ADC_LEFT]);
+    q16_t right = normalize(raw_right, cal->min[IR_ADC_RIGHT], cal->max[IR_ADC_RIGHT]);
+
+    // The difference moves smoothly as the line slides from one sensor to
+    // the other, unlike the on/off comparator outputs
+    estimate->error = right - left;
+    estimate->confidence = left > right ? left : right;
+}
+
+void line_follower_init(line_follower_t *follower)
+{
+    follower->last_error = 0;
+    follower->base_speed = LINE_SLOW_SPEED;
+    for (int i = 0; i < LINE_WINDOW; i++)
+        follower->abs_errors[i] = 0;
+    follower->abs_error_sum = 0;
+    follower->count = 0;
+}
+
+void line_follower_update(line_follower_t *follower, const line_estimate_t *estimate,
+                          q16_t *left_speed, q16_t *right_speed)
+{
+    // Line lost: keep steering the way it was last seen
+    q16_t error = estimate->confidence >= LINE_MIN_CONFIDENCE ? estimate->error : follower->last_error;
+    follower->last_error = error;
+
+    // Running sum over the window, O(1) per update
+    uint32_t slot = follower->count++ & (LINE_WINDOW - 1);
+    q16_t abs_error = q16_abs(error);
+    follower->abs_error_sum += abs_error - follower->abs_errors[slot];
+    follower->abs_errors[slot] = abs_error;
+
+    bool stable = follower->count >= LINE_WINDOW &&
+                  follower->abs_error_sum / LINE_WINDOW < LINE_STABLE_ERROR;
+    q16_t target = stable ? LINE_FAST_SPEED : LINE_SLOW_SPEED;
+    if (follower->base_speed < target)
+        follower->base_speed = q16_clamp(follower->base_speed + LINE_SPEED_STEP, 0, target);
+    else
+        follower->base_speed = q16_clamp(follower->base_speed - LINE_SPEED_STEP, target, LINE_FAST_SPEED);
+
+    // Positive error (line under the right sensor) turns left: right wheel faster
+    q16_t steer = q16_mul(LINE_STEER_KP, error);
+    *left_speed = follower->base_speed - steer;
+    *right_speed = follower->base_speed + steer;
+}
@@ -0,0 +1,48 @@
+#ifndef LINE_FOLLOW_H
+#define LINE_FOLLOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed.h"
+#include "irsensor.h"
+
+// Steering: wheel speed difference (cm/s) per unit of lateral error
+#define LINE_STEER_KP Q16(20.0)
+
+// Speed scheduling: run fast once the mean |error| over the window has
+// stayed below the threshold, otherwise slow down
+#define LINE_WINDOW 16                  // estimates, power of two
+#define LINE_STABLE_ERROR Q16(0.15)
+#define LINE_SLOW_SPEED Q16(18.0)       // cm/s
+#define LINE_FAST_SPEED Q16(35.0)       // cm/s
+#define LINE_SPEED_STEP Q16(0.5)        // cm/s change per update
+
+// Below this confidence neither sensor sees the line
+#define LINE_MIN_CONFIDENCE Q16(0.2)
+
+typedef struct {
+    q16_t error;        // -1..1: positive when the line is under the right sensor
+    q16_t confidence;   // 0..1: how dark the darker sensor is
+} line_estimate_t;
+
+typedef struct {
+    q16_t last_error;
+    q16_t base_speed;
+    q16_t abs_errors[LINE_WINDOW];
+    q16_t abs_error_sum;
+    uint32_t count;
+} line_follower_t;
+
+// Turn raw left/right readings into a lateral error and confidence, using the
+// per-sensor min (white) / max (black) from the IR calibration
+void line_estimate(uint16_t raw_left, uint16_t raw_right, const ir_calibration_t *cal,
+                   line_estimate_t *estimate);
+
+void line_follower_init(line_follower_t *follower);
+
+// One steering step: produces wheel speed targets (Q16.16 cm/s) from the
+// latest estimate. Constant time, never blocks
+void line_follower_update(line_follower_t *follower, const line_estimate_t *estimate,
+                          q16_t *left_speed, q16_t *right_speed);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+#include "log_codec.h"
+
+// Every binary log message of the car, as LOG(id, args...) takes them.
+// tools/log_decoder.c includes this file for the format strings, so append
+// new messages at the end: a decoder built from an older list still reads
+// the IDs it knows
+#define LOG_MESSAGES(X) \
+    X(LOG_ULTRASONIC_NO_ECHO, "Ultrasonic: no echo") \
+    X(LOG_CONTROL_OVERRUN, "Control: tick %d us late, took %u us") \
+    X(LOG_SNAPSHOT_DROPPED, "Sensor: snapshot %u dropped, planning behind") \
+    X(LOG_BARCODE_OVERFLOW, "Barcode: edge at %q cm lost, ring full") \
+    X(LOG_BEHAVIOR_TRANSITION, "Behavior: state %u -> %u on event %u, %u us after the sample") \
+    X(LOG_COMMAND, "Command: opcode %u sequence %u args %d %d, %u us after receipt") \
+    X(LOG_TASK_STATS, "Task %c%c%c%c: cpu %u permille, stack free %u words") \
+    X(LOG_ISR_STATS, "IRQ %u: %u calls, p99 <= %d us, max %d us") \
+    X(LOG_JITTER_STATS, "Control jitter: %u periods, p50 <= %d us, p99 <= %d us, max %d us, %u overruns") \
+    X(LOG_MAP_CHUNK, "Map: record at %u: %08x %08x %08x %08x %08x")
+
+enum {
+    LOG_MESSAGES(LOG_ENUM)
+    LOG_MESSAGE_COUNT,
+};
+
+#endif
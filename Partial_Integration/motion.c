@@ -0,0 +1,298 @@
+#include "motion.h"
+#include "fixed_trig.h"
+#include "speed_control.h"
+
+#define DEG_TO_RAD (3.14159265358979 / 180.0)
+
+// Speed change per control tick, and 1 / (2a) for the braking distance v^2 / 2a
+#define ACCEL_STEP Q16(MOTION_ACCEL * SPEED_CONTROL_PERIOD_US / 1e6)
+#define INV_TWO_ACCEL Q16(1.0 / (2.0 * MOTION_ACCEL))
+
+// Outer wheel travel per degree of arc when pivoting on the inner wheel
+#define ARC_CM_PER_DEG Q16(WHEEL_BASE_CM * DEG_TO_RAD)
+
+#define STALL_TICKS (MOTION_STALL_TIMEOUT_MS * 1000 / SPEED_CONTROL_PERIOD_US)
+#define SETTLE_TICKS (MOTION_TURN_SETTLE_MS * 1000 / SPEED_CONTROL_PERIOD_US)
+#define TURN_TIMEOUT_TICKS (MOTION_TURN_TIMEOUT_MS * 1000 / SPEED_CONTROL_PERIOD_US)
+
+typedef enum {
+    MOVE_DISTANCE,      // encoder distance only
+    MOVE_STRAIGHT,      // encoder distance, steering onto target_heading
+    MOVE_TURN,          // spin in place onto target_heading
+} move_kind_t;
+
+static encoder_t *left_encoder;
+static encoder_t *right_encoder;
+
+// Written by the planning task under speed_control_lock(), advanced by the control tick
+static volatile motion_state_t state = MOTION_IDLE;
+static volatile uint32_t maneuver;      // bumped by every start()
+static move_kind_t kind;
+static int left_sign;           // -1, 0 or 1 per wheel
+static int right_sign;
+static q16_t goal;              // cm the driven wheel(s) must travel
+static q16_t speed;             // current profile speed, cm/s
+static uint32_t left_start;     // pulse counts when the maneuver started
+static uint32_t right_start;
+static q16_t last_travelled;
+static uint32_t stall_ticks;
+
+// Heading maneuvers
+static volatile motion_heading_source_t heading_source;
+static volatile q16_t heading;  // low-passed compass heading
+static bool heading_valid;
+static q16_t target_heading;
+static uint32_t elapsed_ticks;
+static uint32_t settle_ticks;
+
+// Mean encoder travel of the wheels that are being driven
+static q16_t travelled(void)
+{
+    q16_t total = 0;
+    int wheels = 0;
+
+    if (left_sign != 0) {
+        total += (q16_t)(left_encoder->pulse_count - left_start) * ENCODER_CM_PER_PULSE_Q16;
+        wheels++;
+    }
+    if (right_sign != 0) {
+        total += (q16_t)(right_encoder->pulse_count - right_start) * ENCODER_CM_PER_PULSE_Q16;
+        wheels++;
+    }
+    return wheels == 2 ? total / 2 : total;
+}
+
+// Smooth the compass every tick; differences are taken the short way round
+// so the filter does not swing through 180 when the heading wraps at 0/360
+static void update_heading(void)
+{
+    motion_heading_source_t source = heading_source;
+    if (!source)
+        return;
+
+    q16_t raw = source();
+    if (!heading_valid) {
+        heading = raw;
+        heading_valid = true;
+        return;
+    }
+    heading = q16_wrap_360(heading + (q16_angle_diff_deg(raw, heading) >> MOTION_HEADING_FILTER_SHIFT));
+}
+
+static void finish(motion_state_t final_state)
+{
+    speed = 0;
+    speed_control_set_target(0, 0);
+    state = final_state;
+}
+
+static void turn_tick(void)
+{
+    if (++elapsed_ticks > TURN_TIMEOUT_TICKS) {
+        finish(MOTION_TIMEOUT);
+        return;
+    }
+
+    q16_t error = q16_angle_diff_deg(target_heading, heading);
+    if (q16_abs(error) <= MOTION_TURN_TOLERANCE) {
+        // Hold still; done once the heading has stayed in the band
+        speed = 0;
+        stall_ticks = 0;
+        last_travelled = travelled();
+        speed_control_set_target(0, 0);
+        if (++settle_ticks >= SETTLE_TICKS)
+            finish(MOTION_DONE);
+        return;
+    }
+    settle_ticks = 0;
+
+    q16_t done = travelled();
+    if (done != last_travelled) {
+        last_travelled = done;
+        stall_ticks = 0;
+    } else if (++stall_ticks > STALL_TICKS) {
+        finish(MOTION_STALLED);
+        return;
+    }
+
+    // Proportional wheel speed, ramped up at the profile acceleration but
+    // dropped at once as the error shrinks
+    q16_t wanted = q16_clamp(q16_mul(MOTION_TURN_KP, q16_abs(error)), MOTION_TURN_MIN_SPEED,
+                             MOTION_TURN_MAX_SPEED);
+    if (wanted > speed + ACCEL_STEP)
+        speed = speed + ACCEL_STEP < MOTION_TURN_MIN_SPEED ? MOTION_TURN_MIN_SPEED : speed + ACCEL_STEP;
+    else
+        speed = wanted;
+
+    // Clockwise: left wheel forwards, right wheel backwards
+    int direction = error > 0 ? 1 : -1;
+    speed_control_set_target(speed * direction, -speed * direction);
+}
+
+static void motion_tick(void)
+{
+    update_heading();
+
+    if (state != MOTION_RUNNING)
+        return;
+
+    if (kind == MOVE_TURN) {
+        turn_tick();
+        return;
+    }
+
+    q16_t done = travelled();
+    q16_t remaining = goal - done;
+    if (remaining <= 0) {
+        finish(MOTION_DONE);
+        return;
+    }
+
+    if (done != last_travelled) {
+        last_travelled = done;
+        stall_ticks = 0;
+    } else if (++stall_ticks > STALL_TICKS) {
+        finish(MOTION_STALLED);
+        return;
+    }
+
+    // Ramp up until the braking distance at the current speed reaches what is
+    // left, then ramp down; comparing v^2 / 2a avoids a square root
+    q16_t braking = q16_mul(q16_mul(speed, speed), INV_TWO_ACCEL);
+    if (braking >= remaining) {
+        speed -= ACCEL_STEP;
+        if (speed < MOTION_MIN_SPEED)
+            speed = MOTION_MIN_SPEED;
+    } else if (speed < MOTION_MAX_SPEED) {
+        speed += ACCEL_STEP;
+        if (speed > MOTION_MAX_SPEED)
+            speed = MOTION_MAX_SPEED;
+    }
+
+    q16_t left_speed = speed * left_sign;
+    q16_t right_speed = speed * right_sign;
+    if (kind == MOVE_STRAIGHT) {
+        // Clockwise correction speeds up the left wheel, in either direction;
+        // never enough to stop the slower wheel
+        q16_t limit = speed / 2 < MOTION_STRAIGHT_MAX_STEER ? speed / 2 : MOTION_STRAIGHT_MAX_STEER;
+        q16_t steer = q16_clamp(q16_mul(MOTION_STRAIGHT_KP, q16_angle_diff_deg(target_heading, heading)), -limit, limit);
+        left_speed += steer;
+        right_speed -= steer;
+    }
+    speed_control_set_target(left_speed, right_speed);
+}
+
+static void start(move_kind_t move, int left, int right, q16_t distance, q16_t heading_deg)
+{
+    uint32_t saved = speed_control_lock();
+    kind = move;
+    target_heading = q16_wrap_360(heading_deg);
+    elapsed_ticks = 0;
+    settle_ticks = 0;
+    left_sign = left;
+    right_sign = right;
+    goal = distance;
+    speed = move == MOVE_TURN ? 0 : MOTION_MIN_SPEED;
+    left_start = left_encoder->pulse_count;
+    right_start = right_encoder->pulse_count;
+    last_travelled = 0;
+    stall_ticks = 0;
+    state = MOTION_RUNNING;
+    maneuver++;
+    speed_control_unlock(saved);
+}
+
+void motion_init(encoder_t *left, encoder_t *right)
+{
+    left_encoder = left;
+    right_encoder = right;
+    speed_control_add_tick_hook(motion_tick);
+}
+
+void motion_drive(q16_t distance_cm)
+{
+    if (distance_cm < 0)
+        start(MOVE_DISTANCE, -1, -1, -distance_cm, 0);
+    else
+        start(MOVE_DISTANCE, 1, 1, distance_cm, 0);
+}
+
+void motion_arc(q16_t angle_deg)
+{
+    // Turning right drives the left wheel around a stopped right wheel
+    if (angle_deg < 0)
+        start(MOVE_DISTANCE, 0, 1, q16_mul(-angle_deg, ARC_CM_PER_DEG), 0);
+    else
+        start(MOVE_DISTANCE, 1, 0, q16_mul(angle_deg, ARC_CM_PER_DEG), 0);
+}
+
+void motion_set_heading_source(motion_heading_source_t source)
+{
+    uint32_t saved = speed_control_lock();
+    heading_source = source;
+    heading_valid = false;
+    speed_control_unlock(saved);
+}
+
+bool motion_turn_to_heading(q16_t heading_deg)
+{
+    if (!heading_source)
+        return false;
+    // Both wheels turn, so stall detection watches both encoders
+    start(MOVE_TURN, 1, 1, 0, heading_deg);
+    return true;
+}
+
+bool motion_turn_by(q16_t angle_deg)
+{
+    return motion_turn_to_heading(heading + angle_deg);
+}
+
+bool motion_drive_straight(q16_t distance_cm, q16_t heading_deg)
+{
+    if (!heading_source)
+        return false;
+    if (distance_cm < 0)
+        start(MOVE_STRAIGHT, -1, -1, -distance_cm, heading_deg);
+    else
+        start(MOVE_STRAIGHT, 1, 1, distance_cm, heading_deg);
+    return true;
+}
+
+q16_t motion_get_heading(void)
+{
+    return heading;
+}
+
+void motion_abort(void)
+{
+    uint32_t saved = speed_control_lock();
+    finish(MOTION_IDLE);
+    speed_control_unlock(saved);
+}
+
+motion_state_t motion_get_state(void)
+{
+    return state;
+}
+
+motion_state_t motion_get_status(uint32_t *number)
+{
+    uint32_t saved = speed_control_lock();
+    motion_state_t current = state;
+    *number = maneuver;
+    speed_control_unlock(saved);
+    return current;
+}
+
+uint32_t motion_get_maneuver(void)
+{
+    return maneuver;
+}
+
+int motion_get_direction(void)
+{
+    if (state != MOTION_RUNNING)
+        return 0;
+    return (left_sign < 0 || right_sign < 0) ? -1 : 1;
+}
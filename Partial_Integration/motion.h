@@ -0,0 +1,95 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdbool.h>
+#include "encoder.h"
+#include "fixed.h"
+
+// Distance between the wheel contact points, used to turn arc angles into
+// outer wheel travel. Measure on the car
+#define WHEEL_BASE_CM 11.0
+
+// Trapezoidal profile limits
+#define MOTION_MAX_SPEED Q16(25.0)      // cm/s
+#define MOTION_MIN_SPEED Q16(4.0)       // cm/s, creep speed near the goal
+#define MOTION_ACCEL 60.0               // cm/s^2
+
+// A maneuver that makes no encoder progress for this long is abandoned
+#define MOTION_STALL_TIMEOUT_MS 500
+
+// Heading turns: spin in place at a wheel speed proportional to the heading
+// error, and finish once the error has stayed inside the tolerance
+#define MOTION_TURN_KP Q16(0.5)         // cm/s per degree of error
+#define MOTION_TURN_MAX_SPEED Q16(20.0) // cm/s per wheel
+#define MOTION_TURN_MIN_SPEED Q16(3.0)  // cm/s, enough to overcome friction
+#define MOTION_TURN_TOLERANCE Q16(2.0)  // degrees
+#define MOTION_TURN_SETTLE_MS 150
+#define MOTION_TURN_TIMEOUT_MS 3000
+
+// Heading hold while driving straight: wheel speed difference per degree
+#define MOTION_STRAIGHT_KP Q16(0.4)     // cm/s per degree of error
+#define MOTION_STRAIGHT_MAX_STEER Q16(6.0)
+
+// Compass readings are smoothed with a 1/2^N low-pass every control tick
+#define MOTION_HEADING_FILTER_SHIFT 4
+
+typedef enum {
+    MOTION_IDLE = 0,
+    MOTION_RUNNING,
+    MOTION_DONE,        // last maneuver reached its encoder distance
+    MOTION_STALLED,     // last maneuver was abandoned, wheels not turning
+    MOTION_TIMEOUT,     // last turn did not settle on its heading in time
+} motion_state_t;
+
+// Current compass heading in Q16.16 degrees clockwise from north, 0..360.
+// Called from the control tick, so it must be quick and never block
+typedef q16_t (*motion_heading_source_t)(void);
+
+// Hook the executor into the speed control tick. The wheel encoders must be
+// the ones passed to speed_control_init()
+void motion_init(encoder_t *left, encoder_t *right);
+
+// Drive straight for distance_cm (Q16.16); negative reverses
+void motion_drive(q16_t distance_cm);
+
+// Pivot around the inner wheel by angle_deg (Q16.16); positive turns right
+// (clockwise, like the heading maneuvers below), negative turns left
+void motion_arc(q16_t angle_deg);
+
+// Install the compass for the heading maneuvers below, which are refused
+// (return false) until there is one
+void motion_set_heading_source(motion_heading_source_t source);
+
+// Spin in place onto an absolute heading (Q16.16 degrees), the short way round
+bool motion_turn_to_heading(q16_t heading_deg);
+
+// Spin in place by angle_deg from the current heading; positive turns right
+// (clockwise, like compass headings), negative turns left
+bool motion_turn_by(q16_t angle_deg);
+
+// Drive distance_cm like motion_drive(), steering to hold heading_deg
+bool motion_drive_straight(q16_t distance_cm, q16_t heading_deg);
+
+// Filtered compass heading used by the maneuvers, Q16.16 degrees
+q16_t motion_get_heading(void);
+
+// Stop at once and drop the current maneuver
+void motion_abort(void);
+
+motion_state_t motion_get_state(void);
+
+// Every maneuver started gets the next number. motion_get_status() reads the
+// state together with the number of the maneuver it belongs to, so a reader
+// on another task can tell a finished maneuver from one it has not seen yet
+motion_state_t motion_get_status(uint32_t *maneuver);
+uint32_t motion_get_maneuver(void);
+
+static inline bool motion_busy(void)
+{
+    return motion_get_state() == MOTION_RUNNING;
+}
+
+// Direction of the running maneuver: -1 reversing, 1 forwards/arcing, 0 idle
+int motion_get_direction(void);
+
+#endif
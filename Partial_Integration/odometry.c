@@ -0,0 +1,118 @@
+#include "odometry.h"
+#include "fixed_trig.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+#include "motion.h"
+#include "speed_control.h"
+
+// Heading change per cm of left-minus-right wheel travel
+#define DEG_PER_CM Q16(180.0 / (3.14159265358979 * WHEEL_BASE_CM))
+
+static encoder_t *left_encoder;
+static encoder_t *right_encoder;
+static odometry_heading_source_t heading_source;
+
+// Only touched by the control tick, apart from odometry_reset()
+static uint32_t last_left;
+static uint32_t last_right;
+static bool started;
+static q16_t x;
+static q16_t y;
+static q16_t theta;
+
+// Seqlock: odd while the tick is writing the pose
+static volatile uint32_t pose_seq = 0;
+static pose_t pose;
+
+static void publish(void)
+{
+    pose_seq++;
+    __dmb();
+    pose.x = x;
+    pose.y = y;
+    pose.theta = theta;
+    pose.timestamp_us = time_us_32();
+    pose.sequence++;
+    __dmb();
+    pose_seq++;
+}
+
+static void odometry_tick(void)
+{
+    uint32_t left_count = left_encoder->pulse_count;
+    uint32_t right_count = right_encoder->pulse_count;
+
+    if (!started) {
+        // Start on the compass heading rather than converging onto it
+        started = true;
+        if (heading_source)
+            theta = heading_source();
+        last_left = left_count;
+        last_right = right_count;
+        publish();
+        return;
+    }
+
+    // The encoders only count; the sign comes from the drive direction
+    int32_t left_pulses = (int32_t)(left_count - last_left) * speed_control_get_left_direction();
+    int32_t right_pulses = (int32_t)(right_count - last_right) * speed_control_get_right_direction();
+    last_left = left_count;
+    last_right = right_count;
+
+    if (left_pulses != 0 || right_pulses != 0) {
+        q16_t left = left_pulses * ENCODER_CM_PER_PULSE_Q16;
+        q16_t right = right_pulses * ENCODER_CM_PER_PULSE_Q16;
+        q16_t distance = (left + right) / 2;
+        q16_t turn = q16_mul(left - right, DEG_PER_CM);
+
+        // Advance along the heading halfway through the step
+        q16_t sin_theta, cos_theta;
+        q16_sincos_deg(theta + turn / 2, &sin_theta, &cos_theta);
+        x += q16_mul(distance, sin_theta);
+        y += q16_mul(distance, cos_theta);
+        theta = q16_wrap_360(theta + turn);
+    }
+
+    if (heading_source)
+        theta = q16_wrap_360(theta + (q16_angle_diff_deg(heading_source(), theta) >> ODOMETRY_COMPASS_SHIFT));
+
+    publish();
+}
+
+void odometry_init(encoder_t *left, encoder_t *right, odometry_heading_source_t source)
+{
+    left_encoder = left;
+    right_encoder = right;
+    heading_source = source;
+    started = false;
+    x = 0;
+    y = 0;
+    theta = 0;
+    speed_control_add_tick_hook(odometry_tick);
+}
+
+void odometry_reset(q16_t new_x, q16_t new_y, q16_t new_theta)
+{
+    uint32_t saved = speed_control_lock();
+    x = new_x;
+    y = new_y;
+    theta = q16_wrap_360(new_theta);
+    publish();
+    speed_control_unlock(saved);
+}
+
+void odometry_get_pose(pose_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = pose_seq;
+        __dmb();
+        *out = pose;
+        __dmb();
+    } while ((seq & 1) || seq != pose_seq);
+}
+
+q16_t odometry_get_heading(void)
+{
+    return theta;
+}
@@ -0,0 +1,41 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdint.h>
+#include "encoder.h"
+#include "fixed.h"
+
+// Complementary filter: every control tick the heading is pulled 1/2^N of
+// the way towards the compass. 11 at 1 kHz is a ~2 s time constant, so the
+// encoders carry quick turns and the compass removes their slow drift
+#define ODOMETRY_COMPASS_SHIFT 11
+
+// Pose in the floor frame: x east, y north (cm from where odometry started),
+// theta clockwise from north like a compass heading
+typedef struct {
+    q16_t x;                // cm
+    q16_t y;                // cm
+    q16_t theta;            // degrees, 0..360
+    uint32_t timestamp_us;
+    uint32_t sequence;
+} pose_t;
+
+// Heading in Q16.16 degrees clockwise from north, 0..360. Called from the
+// control tick, so it must be quick and never block
+typedef q16_t (*odometry_heading_source_t)(void);
+
+// Integrate wheel travel from the speed control tick. The encoders must be
+// the ones passed to speed_control_init(). With a heading source the pose
+// starts on its heading and theta is fused with it; NULL is dead reckoning
+void odometry_init(encoder_t *left, encoder_t *right, odometry_heading_source_t heading_source);
+
+// Move the pose, e.g. onto a known spot of the map
+void odometry_reset(q16_t x, q16_t y, q16_t theta);
+
+// Consistent copy of the latest pose. Safe from thread context
+void odometry_get_pose(pose_t *pose);
+
+// Fused heading alone, also usable as a motion heading source
+q16_t odometry_get_heading(void);
+
+#endif
@@ -0,0 +1,43 @@
+#include "pid.h"
+
+void pid_init(pid_controller_t *pid, q16_t kp, q16_t ki, q16_t kd, q16_t out_min, q16_t out_max)
+{
+    pid->kp = kp;
+    pid->ki = ki;
+    pid->kd = kd;
+    pid->out_min = out_min;
+    pid->out_max = out_max;
+    pid_reset(pid);
+}
+
+void pid_reset(pid_controller_t *pid)
+{
+    pid->integral = 0;
+    pid->prev_error = 0;
+    pid->has_prev = false;
+}
+
+q16_t pid_update(pid_controller_t *pid, q16_t error, q16_t feedforward)
+{
+    q16_t p = q16_mul(pid->kp, error);
+
+    q16_t d = 0;
+    if (pid->has_prev)
+        d = q16_mul(pid->kd, error - pid->prev_error);
+    pid->prev_error = error;
+    pid->has_prev = true;
+
+    // Anti-windup: only integrate when the output is not already saturated in
+    // the direction the error would push it, and never let the integral alone
+    // move the output further than across its whole range. The bound is
+    // symmetric so the integral can also take back an over-driving feedforward
+    q16_t unclamped = feedforward + p + pid->integral + d;
+    q16_t i_step = q16_mul(pid->ki, error);
+    q16_t i_max = pid->out_max - pid->out_min;
+    if (!(unclamped >= pid->out_max && i_step > 0) &&
+        !(unclamped <= pid->out_min && i_step < 0)) {
+        pid->integral = q16_clamp(pid->integral + i_step, -i_max, i_max);
+    }
+
+    return q16_clamp(feedforward + p + pid->integral + d, pid->out_min, pid->out_max);
+}
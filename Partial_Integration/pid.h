@@ -0,0 +1,30 @@
+#ifndef PID_H
+#define PID_H
+
+#include <stdbool.h>
+#include "fixed.h"
+
+// Fixed-point PID for a loop that runs at a fixed rate. The tick period is
+// folded into ki and kd, so there is no dt term and no division per update
+typedef struct {
+    q16_t kp;
+    q16_t ki;           // per tick
+    q16_t kd;           // per tick
+    q16_t out_min;
+    q16_t out_max;
+
+    q16_t integral;     // already scaled by ki, within +/-(out_max - out_min)
+    q16_t prev_error;
+    bool has_prev;
+} pid_controller_t;
+
+void pid_init(pid_controller_t *pid, q16_t kp, q16_t ki, q16_t kd, q16_t out_min, q16_t out_max);
+
+// Forget the integral and derivative history (e.g. on a new setpoint direction)
+void pid_reset(pid_controller_t *pid);
+
+// One controller step. feedforward is added before clamping so the integral
+// only has to make up the model error. Returns the clamped output
+q16_t pid_update(pid_controller_t *pid, q16_t error, q16_t feedforward);
+
+#endif
@@ -0,0 +1,352 @@
+#include "planner.h"
+
+#define CELL_MASK (GRID_CELLS - 1)
+
+// Work is counted in cells looked at (grid_get() calls and neighbour reads)
+#define WINDOW_SIDE (2 * PLANNER_CLEARANCE_CELLS + 1)
+#define WINDOW_CELLS (WINDOW_SIDE * WINDOW_SIDE)
+#define CLASSIFY_COST (1 + WINDOW_CELLS + 4)    // the cell, its clearance, its frontier
+#define UPDATE_COST (CLASSIFY_COST + 4)         // and maybe seeding from the neighbours
+#define RAISE_COST (4 + 4 * 4)                  // neighbours, and who else supports each
+#define LOWER_COST 4
+
+// Neighbour offsets: north, east, south, west
+static const int8_t step_x[4] = {0, 1, 0, -1};
+static const int8_t step_y[4] = {1, 0, -1, 0};
+
+static bool bit_get(const uint8_t *plane, uint cell)
+{
+    return plane[cell >> 3] & (1u << (cell & 7));
+}
+
+static void bit_put(uint8_t *plane, uint cell, bool value)
+{
+    if (value)
+        plane[cell >> 3] |= 1u << (cell & 7);
+    else
+        plane[cell >> 3] &= ~(1u << (cell & 7));
+}
+
+static void queue_push(planner_queue_t *queue, uint cell)
+{
+    if (bit_get(queue->queued, cell))
+        return;
+    bit_put(queue->queued, cell, true);
+    queue->cells[queue->tail++ & CELL_MASK] = cell;
+}
+
+static bool queue_pop(planner_queue_t *queue, uint *cell)
+{
+    if (queue->head == queue->tail)
+        return false;
+    *cell = queue->cells[queue->head++ & CELL_MASK];
+    bit_put(queue->queued, *cell, false);
+    return true;
+}
+
+// Neighbour of cell in direction dir, or -1 off the grid
+static int neighbour(uint cell, int dir)
+{
+    int x = (int)(cell % GRID_WIDTH) + step_x[dir];
+    int y = (int)(cell / GRID_WIDTH) + step_y[dir];
+    if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT)
+        return -1;
+    return y * GRID_WIDTH + x;
+}
+
+static bool near_occupied(const grid_t *grid, int cx, int cy)
+{
+    for (int dy = -PLANNER_CLEARANCE_CELLS; dy <= PLANNER_CLEARANCE_CELLS; dy++) {
+        for (int dx = -PLANNER_CLEARANCE_CELLS; dx <= PLANNER_CLEARANCE_CELLS; dx++) {
+            if (grid_get(grid, cx + dx, cy + dy) == GRID_OCCUPIED)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Work out from the grid whether a cell is a target and whether it can be
+// driven through
+static void classify(const planner_t *planner, uint cell, bool *target, bool *passable)
+{
+    int cx = cell % GRID_WIDTH;
+    int cy = cell / GRID_WIDTH;
+    grid_cell_t state = grid_get(planner->grid, cx, cy);
+    bool clear = !near_occupied(planner->grid, cx, cy);
+
+    if (planner->mode == PLANNER_EXPLORE) {
+        // Frontier: unknown, next to known free space
+        *target = false;
+        if (clear && state == GRID_UNKNOWN) {
+            for (int dir = 0; dir < 4; dir++) {
+                if (grid_get(planner->grid, cx + step_x[dir], cy + step_y[dir]) == GRID_FREE)
+                    *target = true;
+            }
+        }
+    } else {
+        *target = cx == planner->goal_x && cy == planner->goal_y;
+    }
+
+    *passable = *target ||
+                (clear && (state == GRID_FREE || (state == GRID_UNKNOWN && planner->mode == PLANNER_SEEK)));
+}
+
+// Smallest neighbour distance + 1, for a cell that is not a target
+static uint16_t distance_from_neighbours(const planner_t *planner, uint cell)
+{
+    uint16_t best = PLANNER_UNREACHABLE;
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbour(cell, dir);
+        if (n >= 0 && planner->distance[n] < best)
+            best = planner->distance[n];
+    }
+    return best == PLANNER_UNREACHABLE ? best : best + 1;
+}
+
+static void seed(planner_t *planner, uint cell)
+{
+    uint16_t d = distance_from_neighbours(planner, cell);
+    if (d < planner->distance[cell]) {
+        planner->distance[cell] = d;
+        queue_push(&planner->lower, cell);
+    }
+}
+
+// Re-read one cell from the grid and queue whatever its change implies
+static void update_cell(planner_t *planner, uint cell)
+{
+    bool was_target = bit_get(planner->target, cell);
+    bool was_passable = !bit_get(planner->blocked, cell);
+    bool target, passable;
+    classify(planner, cell, &target, &passable);
+    bit_put(planner->target, cell, target);
+    bit_put(planner->blocked, cell, !passable);
+
+    if (target) {
+        if (planner->distance[cell] != 0) {
+            planner->distance[cell] = 0;
+            queue_push(&planner->lower, cell);
+        }
+    } else if (was_target || (was_passable && !passable)) {
+        // Distances may have been routed through it
+        if (planner->distance[cell] != PLANNER_UNREACHABLE)
+            queue_push(&planner->raise, cell);
+    } else if (!was_passable && passable) {
+        seed(planner, cell);
+    }
+}
+
+// Does some other neighbour still give cell its current distance?
+static bool supported(const planner_t *planner, uint cell)
+{
+    uint16_t want = planner->distance[cell] - 1;
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbour(cell, dir);
+        if (n >= 0 && planner->distance[n] == want)
+            return true;
+    }
+    return false;
+}
+
+// Invalidate a cell, and every neighbour that had its distance only through it
+static void raise_cell(planner_t *planner, uint cell)
+{
+    uint16_t old = planner->distance[cell];
+    if (old == PLANNER_UNREACHABLE || bit_get(planner->target, cell))
+        return;
+
+    planner->distance[cell] = PLANNER_UNREACHABLE;
+    bit_put(planner->raised, cell, true);
+    planner->seed_cursor = 0;
+
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbour(cell, dir);
+        if (n >= 0 && planner->distance[n] == old + 1 && !bit_get(planner->target, n) &&
+            !supported(planner, n))
+            queue_push(&planner->raise, n);
+    }
+}
+
+// Wavefront: offer cell's distance + 1 to its neighbours
+static void lower_cell(planner_t *planner, uint cell)
+{
+    uint16_t d = planner->distance[cell];
+    if (d == PLANNER_UNREACHABLE)
+        return;
+
+    for (int dir = 0; dir < 4; dir++) {
+        int n = neighbour(cell, dir);
+        if (n < 0 || bit_get(planner->blocked, n) || bit_get(planner->target, n))
+            continue;
+        if (planner->distance[n] > d + 1) {
+            planner->distance[n] = d + 1;
+            queue_push(&planner->lower, n);
+        }
+    }
+}
+
+// O(1): rebuild_cell() clears each cell's bits as the rebuild reaches it, and
+// nothing is queued or raised before the rebuild has passed
+static void start_rebuild(planner_t *planner)
+{
+    planner->raise.head = planner->raise.tail = 0;
+    planner->lower.head = planner->lower.tail = 0;
+    planner->rebuild_cursor = 0;
+    planner->seed_cursor = GRID_PLANE_BYTES;
+    planner->change_cursor = 0;
+    planner->window_cursor = 0;
+    planner->grid->change_count = 0;
+    planner->grid->changes_lost = false;
+}
+
+static void rebuild_cell(planner_t *planner, uint cell)
+{
+    bool target, passable;
+    classify(planner, cell, &target, &passable);
+    bit_put(planner->target, cell, target);
+    bit_put(planner->blocked, cell, !passable);
+    bit_put(planner->raised, cell, false);
+    bit_put(planner->raise.queued, cell, false);
+    bit_put(planner->lower.queued, cell, false);
+    planner->distance[cell] = target ? 0 : PLANNER_UNREACHABLE;
+    if (target)
+        queue_push(&planner->lower, cell);
+}
+
+void planner_init(planner_t *planner, grid_t *grid)
+{
+    planner->grid = grid;
+    planner_explore(planner);
+}
+
+void planner_explore(planner_t *planner)
+{
+    planner->mode = PLANNER_EXPLORE;
+    start_rebuild(planner);
+}
+
+void planner_set_goal(planner_t *planner, int cx, int cy, bool known_only)
+{
+    planner->mode = known_only ? PLANNER_RETURN : PLANNER_SEEK;
+    planner->goal_x = cx;
+    planner->goal_y = cy;
+    start_rebuild(planner);
+}
+
+static uint charge(uint budget, uint cost)
+{
+    return budget > cost ? budget - cost : 0;
+}
+
+bool planner_step(planner_t *planner, uint budget)
+{
+    grid_t *grid = planner->grid;
+
+    while (budget > 0) {
+        uint cell;
+
+        if (planner->rebuild_cursor < GRID_CELLS) {
+            rebuild_cell(planner, planner->rebuild_cursor++);
+            budget = charge(budget, CLASSIFY_COST);
+        } else if (grid->changes_lost) {
+            start_rebuild(planner);
+            budget = charge(budget, 1);
+        } else if (planner->change_cursor < grid->change_count) {
+            // A changed cell can alter the clearance and frontier status of
+            // everything within the clearance radius: one cell of that window
+            // per pass
+            uint changed = grid->changes[planner->change_cursor];
+            int x = (int)(changed % GRID_WIDTH) + (int)(planner->window_cursor % WINDOW_SIDE) - PLANNER_CLEARANCE_CELLS;
+            int y = (int)(changed / GRID_WIDTH) + (int)(planner->window_cursor / WINDOW_SIDE) - PLANNER_CLEARANCE_CELLS;
+            if (x >= 0 && x < GRID_WIDTH && y >= 0 && y < GRID_HEIGHT) {
+                update_cell(planner, y * GRID_WIDTH + x);
+                budget = charge(budget, UPDATE_COST);
+            } else {
+                budget = charge(budget, 1);
+            }
+
+            if (++planner->window_cursor == WINDOW_CELLS) {
+                planner->window_cursor = 0;
+                if (++planner->change_cursor == grid->change_count) {
+                    planner->change_cursor = 0;
+                    grid->change_count = 0;
+                }
+            }
+        } else if (queue_pop(&planner->raise, &cell)) {
+            raise_cell(planner, cell);
+            budget = charge(budget, RAISE_COST);
+        } else if (planner->seed_cursor < GRID_PLANE_BYTES) {
+            // Raised cells take the best distance their neighbours still offer
+            uint byte = planner->seed_cursor++;
+            uint8_t raised = planner->raised[byte];
+            uint cost = 1;
+            planner->raised[byte] = 0;
+            for (uint bit = 0; raised; bit++, raised >>= 1) {
+                cell = byte * 8 + bit;
+                if ((raised & 1) && !bit_get(planner->blocked, cell) && !bit_get(planner->target, cell)) {
+                    seed(planner, cell);
+                    cost += 4;
+                }
+            }
+            budget = charge(budget, cost);
+        } else if (queue_pop(&planner->lower, &cell)) {
+            lower_cell(planner, cell);
+            budget = charge(budget, LOWER_COST);
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t planner_distance(const planner_t *planner, int cx, int cy)
+{
+    if (cx < 0 || cx >= GRID_WIDTH || cy < 0 || cy >= GRID_HEIGHT)
+        return PLANNER_UNREACHABLE;
+    return planner->distance[cy * GRID_WIDTH + cx];
+}
+
+planner_route_t planner_next_waypoint(const planner_t *planner, const pose_t *pose, q16_t *x, q16_t *y)
+{
+    int cx, cy;
+    if (!grid_cell_at(pose->x, pose->y, &cx, &cy))
+        return PLANNER_NO_ROUTE;
+
+    uint cell = cy * GRID_WIDTH + cx;
+    if (bit_get(planner->target, cell))
+        return PLANNER_ARRIVED;
+
+    // Walk downhill, keeping the first direction for as long as it descends.
+    // A car inside a clearance zone (unreachable) steps to its best neighbour
+    int heading = -1;
+    uint steps = 0;
+    while (steps < PLANNER_MAX_STRAIGHT_CELLS) {
+        uint16_t here = planner->distance[cell];
+        int best_dir = -1;
+        uint16_t best = here;
+        for (int dir = 0; dir < 4; dir++) {
+            int n = neighbour(cell, dir);
+            if (n < 0)
+                continue;
+            uint16_t d = planner->distance[n];
+            if (d < best || (d == best && d < here && dir == heading)) {
+                best = d;
+                best_dir = dir;
+            }
+        }
+        if (best_dir < 0 || (heading >= 0 && best_dir != heading))
+            break;
+
+        heading = best_dir;
+        cell = neighbour(cell, best_dir);
+        steps++;
+        if (bit_get(planner->target, cell))
+            break;
+    }
+
+    if (steps == 0)
+        return PLANNER_NO_ROUTE;
+
+    grid_cell_center(cell % GRID_WIDTH, cell / GRID_WIDTH, x, y);
+    return PLANNER_ROUTE;
+}
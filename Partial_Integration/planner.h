@@ -0,0 +1,83 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "fixed.h"
+#include "grid.h"
+#include "odometry.h"
+
+// Wavefront planner on the occupancy grid. A distance field (cells to the
+// nearest target, 4-connected) is kept up to date incrementally: when cells
+// change, only the distances that depended on them are raised and then
+// lowered again, instead of flooding the whole grid. All work is done in
+// planner_step() under a budget, so it can run a little on every loop pass.
+
+// Cells this close to an occupied cell are not driven through (car half width)
+#define PLANNER_CLEARANCE_CELLS 2
+
+// Longest straight run handed out as one waypoint
+#define PLANNER_MAX_STRAIGHT_CELLS 8
+
+#define PLANNER_UNREACHABLE UINT16_MAX
+
+typedef enum {
+    PLANNER_EXPLORE,    // targets: the nearest unknown cells next to free space
+    PLANNER_SEEK,       // target: the goal, unknown cells assumed open
+    PLANNER_RETURN,     // target: the goal, through known free cells only
+} planner_mode_t;
+
+typedef enum {
+    PLANNER_ROUTE,      // waypoint written
+    PLANNER_ARRIVED,    // on a target cell
+    PLANNER_NO_ROUTE,   // no target reachable (yet)
+} planner_route_t;
+
+// FIFO of cell indices; each cell is queued at most once, so it never fills
+typedef struct {
+    uint16_t cells[GRID_CELLS];
+    uint32_t head;
+    uint32_t tail;
+    uint8_t queued[GRID_PLANE_BYTES];
+} planner_queue_t;
+
+typedef struct {
+    grid_t *grid;
+    planner_mode_t mode;
+    int goal_x;
+    int goal_y;
+
+    uint16_t distance[GRID_CELLS];
+    uint8_t blocked[GRID_PLANE_BYTES];
+    uint8_t target[GRID_PLANE_BYTES];
+    uint8_t raised[GRID_PLANE_BYTES];   // set to unreachable, to be re-seeded
+
+    planner_queue_t raise;
+    planner_queue_t lower;
+    uint rebuild_cursor;                // < GRID_CELLS while rebuilding
+    uint seed_cursor;                   // < GRID_PLANE_BYTES while re-seeding
+    uint change_cursor;
+    uint window_cursor;                 // cell of the changed cell's clearance window
+} planner_t;
+
+// Start exploring on grid. planner_step() then has to build the field
+void planner_init(planner_t *planner, grid_t *grid);
+
+// Switch target: both rebuild the distance field from scratch
+void planner_explore(planner_t *planner);
+void planner_set_goal(planner_t *planner, int cx, int cy, bool known_only);
+
+// Do up to budget units of work, a unit being one cell looked at (about 30
+// to re-classify a cell, 4 to pass a distance on), picking up grid changes
+// first. The last operation may overrun the budget by at most 34 units.
+// Returns true once the field matches the grid
+bool planner_step(planner_t *planner, uint budget);
+
+uint16_t planner_distance(const planner_t *planner, int cx, int cy);
+
+// Next waypoint from pose along the field: the far end of the straight run
+// of cells leading downhill, in cm (odometry frame)
+planner_route_t planner_next_waypoint(const planner_t *planner, const pose_t *pose, q16_t *x, q16_t *y);
+
+#endif
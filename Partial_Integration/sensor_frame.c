@@ -0,0 +1,58 @@
+#include "sensor_frame.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+static sensor_frame_t slots[2];
+static volatile uint32_t slot_seq[2];   // per slot, odd while being written
+static volatile uint32_t latest;        // slot holding the newest frame
+static volatile uint32_t published;
+
+// Reader side only
+static uint32_t last_sequence;
+static sensor_frame_stats_t stats;
+
+void sensor_frame_publish(const sensor_frame_t *frame)
+{
+    uint32_t slot = latest ^ 1;
+
+    slot_seq[slot]++;
+    __dmb();
+    slots[slot] = *frame;
+    slots[slot].timestamp_us = time_us_32();
+    slots[slot].sequence = published + 1;
+    __dmb();
+    slot_seq[slot]++;
+    __dmb();
+    latest = slot;
+    published++;
+}
+
+bool sensor_frame_read(sensor_frame_t *frame)
+{
+    uint32_t slot, seq;
+    do {
+        slot = latest;
+        seq = slot_seq[slot];
+        __dmb();
+        *frame = slots[slot];
+        __dmb();
+    } while ((seq & 1) || seq != slot_seq[slot]);
+
+    if (frame->sequence == last_sequence)
+        return false;
+
+    uint32_t age = time_us_32() - frame->timestamp_us;
+    stats.reads++;
+    stats.skipped += frame->sequence - last_sequence - 1;
+    stats.age_us_total += age;
+    if (age > stats.age_us_max)
+        stats.age_us_max = age;
+    last_sequence = frame->sequence;
+    return true;
+}
+
+void sensor_frame_get_stats(sensor_frame_stats_t *out)
+{
+    *out = stats;
+    out->published = published;
+}
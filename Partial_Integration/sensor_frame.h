@@ -0,0 +1,39 @@
+#ifndef SENSOR_FRAME_H
+#define SENSOR_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "irsensor.h"
+
+// Sample frames from the sensor core to the control core through a
+// lock-free double buffer. The writer fills the slot the reader is not
+// pointed at and then flips the pointer, so neither side ever waits; a
+// reader only retries if the writer laps it during its copy.
+
+typedef struct {
+    ir_adc_snapshot_t ir;
+    float distance_cm;              // last ULTRASONIC reading
+    uint32_t distance_timestamp_us; // when it finished
+    uint32_t timestamp_us;          // when the frame was published
+    uint32_t sequence;              // 0: nothing published yet
+} sensor_frame_t;
+
+typedef struct {
+    uint32_t published;     // frames written by the sensor core
+    uint32_t reads;         // frames taken by the reader
+    uint32_t skipped;       // frames superseded before any read saw them
+    uint32_t age_us_max;    // publish to read
+    uint64_t age_us_total;
+} sensor_frame_stats_t;
+
+// Writer side, one core only. Stamps timestamp_us and sequence
+void sensor_frame_publish(const sensor_frame_t *frame);
+
+// Reader side, one task only. Copies the newest frame; returns false if
+// there has not been a new one since the last call
+bool sensor_frame_read(sensor_frame_t *frame);
+
+// Counters are copied without locking, good enough for a status print
+void sensor_frame_get_stats(sensor_frame_stats_t *stats);
+
+#endif
@@ -0,0 +1,131 @@
+#include "speed_control.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "motor.h"
+
+static wheel_control_t left_wheel;
+static wheel_control_t right_wheel;
+static speed_control_hook_t tick_hooks[SPEED_CONTROL_MAX_HOOKS];
+static volatile uint hook_count;
+static struct repeating_timer control_timer;
+static spin_lock_t *control_lock;
+
+static void wheel_measure(wheel_control_t *wheel)
+{
+    encoder_update(wheel->encoder);
+    wheel->measured = encoder_get_speed_q16(wheel->encoder);
+}
+
+static void wheel_control(wheel_control_t *wheel)
+{
+    q16_t target = wheel->target;
+    if (target == 0) {
+        pid_reset(&wheel->pid);
+        wheel->duty = 0;
+        return;
+    }
+
+    // The encoder cannot tell direction, so the loop runs on speed magnitude
+    // and starts fresh whenever the commanded direction flips. The duty can
+    // be clamped to 0, so the last direction driven is what counts
+    if ((target < 0 ? -1 : 1) != wheel->direction)
+        pid_reset(&wheel->pid);
+
+    q16_t magnitude = q16_abs(target);
+    q16_t duty = pid_update(&wheel->pid, magnitude - wheel->measured, q16_mul(SPEED_KF, magnitude));
+    wheel->duty = target < 0 ? -duty : duty;
+    if (wheel->duty != 0)
+        wheel->direction = wheel->duty < 0 ? -1 : 1;
+}
+
+void speed_control_tick(void)
+{
+    wheel_measure(&left_wheel);
+    wheel_measure(&right_wheel);
+
+    uint32_t saved = speed_control_lock();
+    for (uint i = 0; i < hook_count; i++)
+        tick_hooks[i]();
+    speed_control_unlock(saved);
+
+    wheel_control(&left_wheel);
+    wheel_control(&right_wheel);
+    motor_set_duty(left_wheel.duty, right_wheel.duty);
+}
+
+static bool control_timer_callback(__unused struct repeating_timer *t)
+{
+    speed_control_tick();
+    return true;
+}
+
+static void wheel_init(wheel_control_t *wheel, encoder_t *encoder)
+{
+    wheel->encoder = encoder;
+    wheel->target = 0;
+    wheel->measured = 0;
+    wheel->duty = 0;
+    wheel->direction = 0;
+    pid_init(&wheel->pid, SPEED_KP, SPEED_KI, SPEED_KD, 0, Q16_ONE);
+}
+
+void speed_control_init(encoder_t *left, encoder_t *right)
+{
+    wheel_init(&left_wheel, left);
+    wheel_init(&right_wheel, right);
+    control_lock = spin_lock_instance(spin_lock_claim_unused(true));
+}
+
+void speed_control_start_timer(void)
+{
+    // Negative period: fixed rate from one tick start to the next
+    add_repeating_timer_us(-SPEED_CONTROL_PERIOD_US, control_timer_callback, NULL, &control_timer);
+}
+
+void speed_control_set_target(q16_t left, q16_t right)
+{
+    left_wheel.target = left;
+    right_wheel.target = right;
+}
+
+uint32_t speed_control_lock(void)
+{
+    return spin_lock_blocking(control_lock);
+}
+
+void speed_control_unlock(uint32_t saved)
+{
+    spin_unlock(control_lock, saved);
+}
+
+bool speed_control_add_tick_hook(speed_control_hook_t hook)
+{
+    if (hook_count == SPEED_CONTROL_MAX_HOOKS)
+        return false;
+
+    // Fill the slot before the tick can see it
+    tick_hooks[hook_count] = hook;
+    __dmb();
+    hook_count++;
+    return true;
+}
+
+q16_t speed_control_get_left_speed(void)
+{
+    return left_wheel.measured;
+}
+
+q16_t speed_control_get_right_speed(void)
+{
+    return right_wheel.measured;
+}
+
+int speed_control_get_left_direction(void)
+{
+    return left_wheel.direction;
+}
+
+int speed_control_get_right_direction(void)
+{
+    return right_wheel.direction;
+}
@@ -0,0 +1,68 @@
+#ifndef SPEED_CONTROL_H
+#define SPEED_CONTROL_H
+
+#include <stdbool.h>
+#include "encoder.h"
+#include "fixed.h"
+#include "pid.h"
+
+// Control tick: 1 kHz
+#define SPEED_CONTROL_PERIOD_US 1000
+
+// Gains work on Q16.16 cm/s in and Q16.16 duty (-1..1) out. Starting values,
+// tune on the car
+#define SPEED_KP Q16(0.02)              // duty per cm/s of error
+#define SPEED_KI Q16(0.0002)            // duty per cm/s of error per tick
+#define SPEED_KD Q16(0.0)
+#define SPEED_KF Q16(1.0 / 60.0)        // open-loop duty per cm/s (full duty ~60 cm/s)
+
+// Called every tick after the wheel speeds are measured and before the PIDs
+// run, so a motion profile can move the targets in step with the loop
+typedef void (*speed_control_hook_t)(void);
+
+// Hooks run in the order they were added
+#define SPEED_CONTROL_MAX_HOOKS 4
+
+typedef struct {
+    encoder_t *encoder;
+    pid_controller_t pid;
+    q16_t target;       // cm/s, sign is direction
+    q16_t measured;     // cm/s, always >= 0 (single-channel encoder)
+    q16_t duty;         // last output, signed duty -1..1
+    int direction;      // sign of the last non-zero duty: the way the wheel
+                        // turns, or coasts after the duty drops to 0
+} wheel_control_t;
+
+// Set up both wheel loops, motors stopped. Each tick drains the wheel
+// encoders, so nothing else may call encoder_update() on them, and drives the
+// motors through motor_set_duty(). motor_init() must have been called
+void speed_control_init(encoder_t *left, encoder_t *right);
+
+// One control tick, every SPEED_CONTROL_PERIOD_US: from a fixed-period task,
+// or from the repeating timer started by speed_control_start_timer()
+void speed_control_tick(void);
+void speed_control_start_timer(void);
+
+// New wheel targets in Q16.16 cm/s; negative drives the wheel backwards.
+// Picked up by the next tick
+void speed_control_set_target(q16_t left, q16_t right);
+
+// Exclusion against the tick hooks, for state they share with other code:
+// interrupts off on this core and a hardware spin lock against the other, so
+// it holds whichever core the tick runs on. Keep it short
+uint32_t speed_control_lock(void);
+void speed_control_unlock(uint32_t saved);
+
+// Add a per-tick hook. Returns false if all SPEED_CONTROL_MAX_HOOKS are taken
+bool speed_control_add_tick_hook(speed_control_hook_t hook);
+
+// Last measured wheel speeds in Q16.16 cm/s
+q16_t speed_control_get_left_speed(void);
+q16_t speed_control_get_right_speed(void);
+
+// Direction each wheel is turning: 1 forwards, -1 backwards, 0 never driven.
+// The encoders cannot tell, so this follows the drive direction
+int speed_control_get_left_direction(void);
+int speed_control_get_right_direction(void);
+
+#endif
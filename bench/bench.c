@@ -0,0 +1,305 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "behavior.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "fixed_trig.h"
+#include "grid.h"
+#include "irsensor.h"
+#include "line_follow.h"
+#include "magnetometer.h"
+#include "motion.h"
+#include "odometry.h"
+#include "planner.h"
+#include "speed_control.h"
+
+// Every benchmark runs warm (after a few untimed calls) and then cold,
+// with the instruction cache flushed before each sample. Interrupts stay
+// on, as they are in the firmware, so the tails include the IR DMA and
+// USB handlers.
+//
+// One JSON object per line on stdout: a header, then one line per
+// benchmark and cache state, times in ns:
+//
+//   {"suite":"robot_bench","platform":"rp2040","timer":"systick","cpu_hz":125000000,"firmware":"..."}
+//   {"bench":"encoder_isr","cache":"warm","samples":1000,"min":..,"median":..,"p99":..,"max":..,"mean":..}
+//
+// Nothing else: text the benchmarked code prints, such as
+// printIRSensorStatus(), is sent away by bench_console_off() while it runs.
+
+#ifndef BENCH_FIRMWARE_VERSION
+#define BENCH_FIRMWARE_VERSION "unknown"
+#endif
+
+#define WARMUP_CALLS 10
+
+// The work of one sensor period in Partial_Integration.c: SENSOR_DIVIDER
+// control ticks, then the sensor task's snapshot and the planning task's
+// pass over it with PLANNER_BUDGET (as built with MAZE_EXPLORE)
+#define LOOP_CONTROL_TICKS 5
+#define LOOP_PLANNER_BUDGET 3000
+
+// fixed_atan2 and atan2f take one vector per sample from a ring of inputs
+// spread round the circle at magnetometer-like magnitudes. The CORDIC
+// result must stay within ATAN2_MAX_ERROR_DEG of atan2 over all of them
+#define ATAN2_VECTORS 256
+#define ATAN2_MAX_ERROR_DEG 0.01
+
+// Defined in Partial_Integration.c, built in with its main() renamed
+void gpio_encoder_initialization(void);
+void gpio_ir_sensor_initialization(void);
+void gpio_ultrasonic_initialization(void);
+bool update_distance(float *distance, uint32_t *timestamp_us);
+void printIRSensorStatus(bool left_on_line, bool right_on_line);
+extern encoder_t encoder_left;
+extern encoder_t encoder_right;
+
+static uint32_t samples[BENCH_WARM_SAMPLES > BENCH_COLD_SAMPLES ? BENCH_WARM_SAMPLES : BENCH_COLD_SAMPLES];
+
+// State the benchmarked paths work on
+static float distance_cm;
+static uint32_t distance_timestamp_us;
+static ir_calibration_t ir_cal;
+static line_follower_t follower;
+static behavior_t behavior;
+static behavior_snapshot_t snapshot;
+static grid_t grid;
+static planner_t planner;
+static uint32_t last_distance_us;
+static int32_t atan2_y[ATAN2_VECTORS];
+static int32_t atan2_x[ATAN2_VECTORS];
+static uint atan2_next;
+static volatile q16_t fixed_sink;
+static volatile float float_sink;
+
+static void run_update_distance(void)
+{
+    update_distance(&distance_cm, &distance_timestamp_us);
+}
+
+// Encoder edges come from the pad's input override, so the pin need not
+// move: the time covers the register write, interrupt entry, the ISR and
+// its return. encoder_edge_no_irq is the same write with the IRQ off
+static void encoder_edge_prepare(void)
+{
+    gpio_set_inover(ENCODER_LEFT_PIN, GPIO_OVERRIDE_LOW);
+    encoder_update(&encoder_left);
+}
+
+static void encoder_edge_end(void)
+{
+    gpio_set_inover(ENCODER_LEFT_PIN, GPIO_OVERRIDE_NORMAL);
+    encoder_update(&encoder_left);
+}
+
+static void run_encoder_isr(void)
+{
+    gpio_set_inover(ENCODER_LEFT_PIN, GPIO_OVERRIDE_HIGH);
+    while (spsc_ring_count(&encoder_left.ring) == 0)
+        tight_loop_contents();
+}
+
+static void encoder_irq_off(void)
+{
+    gpio_set_irq_enabled(ENCODER_LEFT_PIN, GPIO_IRQ_EDGE_RISE, false);
+}
+
+static void encoder_irq_on(void)
+{
+    encoder_edge_end();
+    gpio_set_irq_enabled(ENCODER_LEFT_PIN, GPIO_IRQ_EDGE_RISE, true);
+}
+
+static void run_encoder_edge_no_irq(void)
+{
+    gpio_set_inover(ENCODER_LEFT_PIN, GPIO_OVERRIDE_HIGH);
+}
+
+static void run_print_ir_status(void)
+{
+    printIRSensorStatus(true, false);
+}
+
+static void run_lsm303_read_mag(void)
+{
+    int16_t mag[3];
+    lsm303_read_mag(mag);
+}
+
+static void run_lsm303_read_accel(void)
+{
+    int16_t accel[3];
+    lsm303_read_accel(accel);
+}
+
+// Fills the input ring and checks the CORDIC error bound, failing the
+// whole run if it is exceeded
+static void atan2_begin(void)
+{
+    double max_error = 0;
+    for (uint i = 0; i < ATAN2_VECTORS; i++) {
+        double angle = (i * 360.0 / ATAN2_VECTORS + 0.37) * M_PI / 180.0;
+        double length = i % 4 == 0 ? 40.0 : i % 4 == 1 ? 600.0 : i % 4 == 2 ? 4000.0 : 30000.0;
+        atan2_y[i] = (int32_t)lround(length * sin(angle));
+        atan2_x[i] = (int32_t)lround(length * cos(angle));
+
+        double expected = atan2(atan2_y[i], atan2_x[i]) * 180.0 / M_PI;
+        double error = fabs(q16_atan2_deg(atan2_y[i], atan2_x[i]) / (double)Q16_ONE - expected);
+        if (error > 180.0)
+            error = 360.0 - error;
+        if (error > max_error)
+            max_error = error;
+    }
+    if (max_error > ATAN2_MAX_ERROR_DEG) {
+        fprintf(stderr, "bench: fixed_atan2 is off by %.4f degrees, over %.4f\n", max_error,
+                ATAN2_MAX_ERROR_DEG);
+        exit(1);
+    }
+    atan2_next = 0;
+}
+
+static void run_fixed_atan2(void)
+{
+    uint i = atan2_next++ % ATAN2_VECTORS;
+    fixed_sink = q16_atan2_deg(atan2_y[i], atan2_x[i]);
+}
+
+static void run_atan2f(void)
+{
+    uint i = atan2_next++ % ATAN2_VECTORS;
+    float_sink = atan2f((float)atan2_y[i], (float)atan2_x[i]);
+}
+
+static void run_control_tick(void)
+{
+    speed_control_tick();
+}
+
+static void run_loop_iteration(void)
+{
+    for (int i = 0; i < LOOP_CONTROL_TICKS; i++)
+        speed_control_tick();
+
+    // Sensor task
+    snapshot.now_us = time_us_32();
+    ir_adc_snapshot_t ir;
+    ir_adc_get_snapshot(&ir);
+    update_distance(&snapshot.distance_cm, &snapshot.distance_timestamp_us);
+    snapshot.ir_sequence = ir.sequence;
+    snapshot.ir_timestamp_us = ir.timestamp_us;
+    snapshot.left_on_line = ir_cal_on_line(&ir_cal, IR_ADC_LEFT, ir.value[IR_ADC_LEFT], snapshot.left_on_line);
+    snapshot.right_on_line = ir_cal_on_line(&ir_cal, IR_ADC_RIGHT, ir.value[IR_ADC_RIGHT], snapshot.right_on_line);
+    line_estimate(ir.value[IR_ADC_LEFT], ir.value[IR_ADC_RIGHT], &ir_cal, &snapshot.line);
+    odometry_get_pose(&snapshot.pose);
+    snapshot.motion = motion_get_status(&snapshot.maneuver);
+
+    // Planning task
+    if (snapshot.distance_timestamp_us != last_distance_us) {
+        last_distance_us = snapshot.distance_timestamp_us;
+        grid_add_reading(&grid, &snapshot.pose, snapshot.distance_cm);
+    }
+    snapshot.plan_ready = planner_step(&planner, LOOP_PLANNER_BUDGET);
+    behavior_tick(&behavior, &snapshot);
+}
+
+static const benchmark_t benchmarks[] = {
+    {"update_distance", NULL, NULL, run_update_distance, NULL, 5000},
+    {"encoder_isr", NULL, encoder_edge_prepare, run_encoder_isr, encoder_edge_end, 100},
+    {"encoder_edge_no_irq", encoder_irq_off, encoder_edge_prepare, run_encoder_edge_no_irq, encoder_irq_on, 100},
+    {"print_ir_status", NULL, NULL, run_print_ir_status, NULL, 1000},
+    {"lsm303_read_mag", NULL, NULL, run_lsm303_read_mag, NULL, 500},
+    {"lsm303_read_accel", NULL, NULL, run_lsm303_read_accel, NULL, 500},
+    {"fixed_atan2", atan2_begin, NULL, run_fixed_atan2, NULL, 0},
+    {"atan2f", atan2_begin, NULL, run_atan2f, NULL, 0},
+    {"control_tick", NULL, NULL, run_control_tick, NULL, 100},
+    {"loop_iteration", NULL, NULL, run_loop_iteration, NULL, 1000},
+};
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void measure(const benchmark_t *bench, bool cold, uint count)
+{
+    bench_console_off();
+    for (uint i = 0; i < count; i++) {
+        if (bench->prepare)
+            bench->prepare();
+        if (cold)
+            bench_flush_cache();
+        bench_start();
+        bench->run();
+        samples[i] = bench_stop();
+        if (bench->gap_us)
+            sleep_us(bench->gap_us);
+    }
+    bench_console_on();
+
+    // Nearest-rank percentiles
+    qsort(samples, count, sizeof(samples[0]), compare_u32);
+    uint64_t total = 0;
+    for (uint i = 0; i < count; i++)
+        total += samples[i];
+    printf("{\"bench\":\"%s\",\"cache\":\"%s\",\"samples\":%u,\"min\":%lu,\"median\":%lu,"
+           "\"p99\":%lu,\"max\":%lu,\"mean\":%lu}\n",
+           bench->name, cold ? "cold" : "warm", count, (unsigned long)samples[0],
+           (unsigned long)samples[(count - 1) / 2], (unsigned long)samples[(count * 99 + 99) / 100 - 1],
+           (unsigned long)samples[count - 1], (unsigned long)(total / count));
+}
+
+static void run_benchmark(const benchmark_t *bench)
+{
+    bench_console_off();
+    if (bench->begin)
+        bench->begin();
+    for (uint j = 0; j < WARMUP_CALLS; j++) {
+        if (bench->prepare)
+            bench->prepare();
+        bench->run();
+    }
+    bench_console_on();
+    measure(bench, false, BENCH_WARM_SAMPLES);
+    measure(bench, true, BENCH_COLD_SAMPLES);
+    if (bench->end) {
+        bench_console_off();
+        bench->end();
+        bench_console_on();
+    }
+}
+
+void bench_main(const benchmark_t *extra, uint32_t extra_count)
+{
+    gpio_encoder_initialization();
+    gpio_ir_sensor_initialization();
+    gpio_ultrasonic_initialization();
+
+    // Blocking register reads only: lsm303_start() would share the bus
+    lsm303_init(NULL);
+
+    // No motor_init(): the control code runs in full but the PWM pins
+    // stay off, so the wheels never turn
+    speed_control_init(&encoder_left, &encoder_right);
+    motion_init(&encoder_left, &encoder_right);
+    odometry_init(&encoder_left, &encoder_right, NULL);
+    ir_cal_default(&ir_cal);
+    behavior_init(&behavior, &follower, NULL);
+    grid_init(&grid);
+    planner_init(&planner, &grid);
+    snapshot.distance_cm = 500.0f;
+
+    printf("{\"suite\":\"robot_bench\",\"platform\":\"%s\",\"timer\":\"%s\",\"cpu_hz\":%lu,\"firmware\":\"%s\"}\n",
+           bench_platform, bench_timer, (unsigned long)bench_cpu_hz(), BENCH_FIRMWARE_VERSION);
+
+    for (uint i = 0; i < count_of(benchmarks); i++)
+        run_benchmark(&benchmarks[i]);
+    for (uint i = 0; i < extra_count; i++)
+        run_benchmark(&extra[i]);
+    printf("{\"done\":true}\n");
+}
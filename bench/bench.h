@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Microbenchmarks of the robot's hot paths (bench.c). The same benchmarks
+// build for the Pico (bench_rp2040.c) and for the host against the mock
+// HAL (sim/bench_host.c); each platform supplies the timer and the cache
+// flush below. Results are JSON lines (see bench.c) so runs can be diffed.
+
+#define BENCH_WARM_SAMPLES 1000
+#define BENCH_COLD_SAMPLES 200
+
+// "rp2040" or "host", what bench_start()/bench_stop() count, and the CPU
+// clock where that is known (0 otherwise)
+extern const char *const bench_platform;
+extern const char *const bench_timer;
+uint32_t bench_cpu_hz(void);
+
+// Time one sample: bench_stop() returns ns since the matching bench_start()
+void bench_start(void);
+uint32_t bench_stop(void);
+
+// Empty the instruction cache (the XIP cache on the Pico), so the next
+// sample fetches its code from flash
+void bench_flush_cache(void);
+
+// While a benchmark runs, whatever it prints goes somewhere other than
+// the results (the UART on the Pico, /dev/null on the host)
+void bench_console_off(void);
+void bench_console_on(void);
+
+typedef struct {
+    const char *name;
+    void (*begin)(void);        // once before the samples, or NULL
+    void (*prepare)(void);      // before every sample, not timed, or NULL
+    void (*run)(void);          // the timed part
+    void (*end)(void);          // once after the samples, or NULL
+    uint32_t gap_us;            // idle time between samples
+} benchmark_t;
+
+// Runs every benchmark, then the platform's own extra ones, and prints the
+// results. After the platform is up
+void bench_main(const benchmark_t *extra, uint32_t extra_count);
+
+#endif
@@ -0,0 +1,86 @@
+#include "bench.h"
+#include "pico/stdlib.h"
+#include "pico/stdio_uart.h"
+#include "pico/stdio_usb.h"
+#include "hardware/clocks.h"
+#include "hardware/regs/m0plus.h"
+#include "hardware/structs/systick.h"
+#include "hardware/structs/xip_ctrl.h"
+
+// SysTick counts CPU cycles down from 2^24 - 1, wrapping every 134 ms at
+// 125 MHz. Samples longer than SYSTICK_SPAN_US are taken from the 64-bit
+// microsecond timer instead
+#define SYSTICK_MAX M0PLUS_SYST_RVR_RELOAD_BITS
+#define SYSTICK_SPAN_US 100000
+
+const char *const bench_platform = "rp2040";
+const char *const bench_timer = "systick";
+
+static uint64_t start_us;
+static uint32_t start_cycles;
+
+uint32_t bench_cpu_hz(void)
+{
+    return clock_get_hz(clk_sys);
+}
+
+void bench_start(void)
+{
+    start_us = time_us_64();
+    start_cycles = systick_hw->cvr;
+}
+
+uint32_t bench_stop(void)
+{
+    uint32_t cycles = (start_cycles - systick_hw->cvr) & SYSTICK_MAX;
+    uint64_t us = time_us_64() - start_us;
+    if (us >= SYSTICK_SPAN_US)
+        return us < UINT32_MAX / 1000 ? (uint32_t)(us * 1000) : UINT32_MAX;
+    return (uint32_t)((uint64_t)cycles * 1000000000u / clock_get_hz(clk_sys));
+}
+
+void bench_flush_cache(void)
+{
+    // Reads back once the flush has finished
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush;
+}
+
+// The results stay on USB, text from the benchmarks goes out on the UART.
+// Flushed first, so a line is not split between the two
+void bench_console_off(void)
+{
+    stdio_flush();
+    stdio_set_driver_enabled(&stdio_usb, false);
+    stdio_set_driver_enabled(&stdio_uart, true);
+}
+
+void bench_console_on(void)
+{
+    stdio_flush();
+    stdio_set_driver_enabled(&stdio_uart, false);
+    stdio_set_driver_enabled(&stdio_usb, true);
+}
+
+int main()
+{
+    stdio_init_all();
+    stdio_set_driver_enabled(&stdio_uart, false);
+
+    // Nothing to report to until the USB console is open
+    while (!stdio_usb_connected())
+    {
+        sleep_ms(100);
+    }
+
+    systick_hw->rvr = SYSTICK_MAX;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+
+    bench_main(NULL, 0);
+
+    while (true)
+    {
+        tight_loop_contents();
+    }
+}
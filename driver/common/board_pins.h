@@ -0,0 +1,35 @@
+#ifndef BOARD_PINS_H
+#define BOARD_PINS_H
+
+// Pin map of the robot car. Every driver, demo and the integrated firmware
+// take their pins from here, so rewiring only touches this file
+
+// Motor driver: PWM enable per wheel. Both pins sit on PWM slice 0
+#define MOTOR_PWM_RIGHT_PIN 0
+#define MOTOR_PWM_LEFT_PIN 1
+
+// Motor driver: direction inputs (01 high = forwards, 02 high = backwards)
+#define MOTOR_DIR_R01_PIN 3
+#define MOTOR_DIR_R02_PIN 4
+#define MOTOR_DIR_L01_PIN 6
+#define MOTOR_DIR_L02_PIN 5
+
+// Wheel encoders
+#define ENCODER_LEFT_PIN 2
+#define ENCODER_RIGHT_PIN 7
+
+// Ultrasonic sensor
+#define ULTRASONIC_TRIGGER_PIN 12
+#define ULTRASONIC_ECHO_PIN 13
+
+// IMU (LSM303DLHC) on I2C0
+#define IMU_I2C_PORT i2c0
+#define IMU_SDA_PIN 16
+#define IMU_SCL_PIN 17
+
+// IR line sensors, also ADC0..ADC2
+#define IR_SENSOR_LEFT_PIN 26
+#define IR_SENSOR_RIGHT_PIN 27
+#define IR_SENSOR_BOTTOM_PIN 28
+
+#endif
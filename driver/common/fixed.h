@@ -0,0 +1,52 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+// Q16.16 signed fixed point. The RP2040 has no FPU, so anything that runs
+// every control tick works in q16_t instead of float
+typedef int32_t q16_t;
+
+#define Q16_SHIFT 16
+#define Q16_ONE (1 << Q16_SHIFT)
+
+// Compile-time constant from a float literal, e.g. Q16(0.5)
+#define Q16(x) ((q16_t)((x) * Q16_ONE + ((x) >= 0 ? 0.5 : -0.5)))
+
+static inline q16_t q16_from_int(int32_t x)
+{
+    return x * Q16_ONE;
+}
+
+// Truncates towards minus infinity
+static inline int32_t q16_to_int(q16_t x)
+{
+    return x >> Q16_SHIFT;
+}
+
+static inline int32_t q16_round(q16_t x)
+{
+    return (x + (Q16_ONE / 2)) >> Q16_SHIFT;
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b)
+{
+    return (q16_t)(((int64_t)a * b) >> Q16_SHIFT);
+}
+
+static inline q16_t q16_div(q16_t a, q16_t b)
+{
+    return (q16_t)(((int64_t)a << Q16_SHIFT) / b);
+}
+
+static inline q16_t q16_clamp(q16_t x, q16_t lo, q16_t hi)
+{
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+static inline q16_t q16_abs(q16_t x)
+{
+    return x < 0 ? -x : x;
+}
+
+#endif
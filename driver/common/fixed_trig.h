@@ -0,0 +1,146 @@
+#ifndef FIXED_TRIG_H
+#define FIXED_TRIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed.h"
+
+// CORDIC iterations; the last step is atan(2^-15) = 0.0017 degrees
+#define CORDIC_ITERATIONS 16
+
+// atan(2^-i) in Q16.16 degrees
+static const q16_t cordic_atan_table[CORDIC_ITERATIONS] = {
+    2949120, 1740967, 919879, 466945, 234379, 117304, 58666, 29335,
+    14668, 7334, 3667, 1833, 917, 458, 229, 115,
+};
+
+// atan2(y, x) in Q16.16 degrees, -180..180, using only shifts and adds
+// (atan2f is a software-float library call on the RP2040). The vector is
+// scaled to just under 2^29 first: small inputs keep their precision and
+// the CORDIC gain of ~1.65 cannot overflow
+static inline q16_t q16_atan2_deg(int64_t y, int64_t x)
+{
+    if (x == 0 && y == 0)
+        return 0;
+
+    // Rotate the left half-plane by 180 degrees into the right one
+    q16_t angle = 0;
+    if (x < 0) {
+        angle = y >= 0 ? q16_from_int(180) : q16_from_int(-180);
+        x = -x;
+        y = -y;
+    }
+
+    while (x > (1 << 29) || y > (1 << 29) || y < -(1 << 29)) {
+        x >>= 1;
+        y >>= 1;
+    }
+    while (x < (1 << 28) && y < (1 << 28) && y > -(1 << 28)) {
+        x <<= 1;
+        y <<= 1;
+    }
+    int32_t xi = (int32_t)x;
+    int32_t yi = (int32_t)y;
+
+    // Vectoring mode: rotate onto the x axis, summing the rotation angles
+    for (int i = 0; i < CORDIC_ITERATIONS; i++) {
+        int32_t dx = yi >> i;
+        int32_t dy = xi >> i;
+        if (yi > 0) {
+            xi += dx;
+            yi -= dy;
+            angle += cordic_atan_table[i];
+        } else {
+            xi -= dx;
+            yi += dy;
+            angle -= cordic_atan_table[i];
+        }
+    }
+    return angle;
+}
+
+// 1 / CORDIC gain in Q2.30, the starting length for rotation mode
+#define CORDIC_INV_GAIN_Q30 652032874
+
+// sin and cos of an angle in Q16.16 degrees, as Q16.16, by CORDIC rotation
+static inline void q16_sincos_deg(q16_t deg, q16_t *sin_out, q16_t *cos_out)
+{
+    // Bring the angle into -90..90, where the rotation converges
+    deg %= q16_from_int(360);
+    if (deg > q16_from_int(180))
+        deg -= q16_from_int(360);
+    else if (deg < q16_from_int(-180))
+        deg += q16_from_int(360);
+
+    bool flip = false;
+    if (deg > q16_from_int(90)) {
+        deg -= q16_from_int(180);
+        flip = true;
+    } else if (deg < q16_from_int(-90)) {
+        deg += q16_from_int(180);
+        flip = true;
+    }
+
+    // Rotation mode: rotate (1/K, 0) by the angle; the gain brings it to unit length
+    int32_t x = CORDIC_INV_GAIN_Q30;
+    int32_t y = 0;
+    q16_t z = deg;
+    for (int i = 0; i < CORDIC_ITERATIONS; i++) {
+        int32_t dx = y >> i;
+        int32_t dy = x >> i;
+        if (z >= 0) {
+            x -= dx;
+            y += dy;
+            z -= cordic_atan_table[i];
+        } else {
+            x += dx;
+            y -= dy;
+            z += cordic_atan_table[i];
+        }
+    }
+
+    // Q2.30 to Q16.16, rounded
+    x = (x + (1 << 13)) >> 14;
+    y = (y + (1 << 13)) >> 14;
+    *sin_out = flip ? -y : y;
+    *cos_out = flip ? -x : x;
+}
+
+// Wrap an angle in Q16.16 degrees into 0..360
+static inline q16_t q16_wrap_360(q16_t deg)
+{
+    while (deg < 0)
+        deg += q16_from_int(360);
+    while (deg >= q16_from_int(360))
+        deg -= q16_from_int(360);
+    return deg;
+}
+
+// Signed shortest rotation from current to target in Q16.16 degrees,
+// -180..180; positive is clockwise for compass headings
+static inline q16_t q16_angle_diff_deg(q16_t target, q16_t current)
+{
+    q16_t diff = q16_wrap_360(target - current);
+    return diff > q16_from_int(180) ? diff - q16_from_int(360) : diff;
+}
+
+// Integer square root, rounded down
+static inline uint32_t isqrt64(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// Fixed-size histogram with equal power-of-two bucket widths, cheap enough
+// for an ISR: a subtract, a shift and an increment. Values below the first
+// bucket count in the first, values past the last in the last, so the edge
+// buckets read as "at most" and "at least". Single writer; a reader on
+// another core may see a sample half-added, which is fine for statistics.
+
+#define HISTOGRAM_BUCKETS 16
+
+typedef struct {
+    int32_t origin;             // lower edge of bucket 0
+    uint8_t shift;              // bucket width is 1 << shift
+    uint32_t count[HISTOGRAM_BUCKETS];
+    uint32_t samples;
+    int32_t max;
+} histogram_t;
+
+static inline void histogram_init(histogram_t *h, int32_t origin, uint8_t shift)
+{
+    *h = (histogram_t){.origin = origin, .shift = shift, .max = INT32_MIN};
+}
+
+static inline void histogram_add(histogram_t *h, int32_t value)
+{
+    int32_t offset = value - h->origin;
+    uint32_t bucket = offset < 0 ? 0 : (uint32_t)offset >> h->shift;
+    if (bucket >= HISTOGRAM_BUCKETS)
+        bucket = HISTOGRAM_BUCKETS - 1;
+    h->count[bucket]++;
+    h->samples++;
+    if (value > h->max)
+        h->max = value;
+}
+
+// Upper edge of the bucket holding the permille-th sample: the value at
+// most that share of samples lies below. The last bucket reports max
+static inline int32_t histogram_percentile(const histogram_t *h, uint32_t permille)
+{
+    uint32_t wanted = (uint32_t)(((uint64_t)h->samples * permille + 999) / 1000);
+    uint32_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+        seen += h->count[i];
+        if (seen >= wanted && seen > 0)
+            return h->origin + ((int32_t)(i + 1) << h->shift);
+    }
+    return h->max;
+}
+
+#endif
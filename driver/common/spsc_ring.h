@@ -0,0 +1,67 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "hardware/sync.h"
+
+// Single-producer/single-consumer ring of 32-bit samples (e.g. time_us_32()
+// timestamps). One side (typically an ISR) only pushes, the other (thread
+// context) only pops, so neither side needs to disable interrupts.
+//
+// head is written only by the producer, tail only by the consumer. Both are
+// free-running; the storage size must be a power of two.
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t overflows;    // pushes rejected because the ring was full
+    uint32_t mask;
+    uint32_t *buffer;
+} spsc_ring_t;
+
+static inline void spsc_ring_init(spsc_ring_t *ring, uint32_t *storage, uint32_t size)
+{
+    // size must be a power of two so the free-running indices wrap cleanly
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overflows = 0;
+    ring->mask = size - 1;
+    ring->buffer = storage;
+}
+
+// Producer side. Returns false (and counts an overflow) if the ring is full
+static inline bool spsc_ring_push(spsc_ring_t *ring, uint32_t value)
+{
+    uint32_t head = ring->head;
+    if (head - ring->tail > ring->mask) {
+        ring->overflows++;
+        return false;
+    }
+    ring->buffer[head & ring->mask] = value;
+    // Publish the sample before the new head becomes visible to the consumer
+    __dmb();
+    ring->head = head + 1;
+    return true;
+}
+
+// Consumer side. Returns false if the ring is empty
+static inline bool spsc_ring_pop(spsc_ring_t *ring, uint32_t *value)
+{
+    uint32_t tail = ring->tail;
+    if (tail == ring->head)
+        return false;
+    __dmb();
+    *value = ring->buffer[tail & ring->mask];
+    // Finish reading the slot before handing it back to the producer
+    __dmb();
+    ring->tail = tail + 1;
+    return true;
+}
+
+static inline uint32_t spsc_ring_count(const spsc_ring_t *ring)
+{
+    return ring->head - ring->tail;
+}
+
+#endif
@@ -1,40 +1,114 @@
-#include <stdio.h>
+#include "encoder.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/timer.h"
 
-#define ENCODER_PIN 2  // GPIO pin connected to the wheel encoder //
-
-// Define the properties of your wheel and encoder
-#define PPR 360       // Example: 360 pulses per wheel revolution
-#define WHEEL_CIRCUMFERENCE 21.0  // Example: 21 cm
-
-volatile uint32_t pulse_count = 0;
-volatile uint32_t last_pulse_time = 0;
-
-void encoder_isr() {
-    pulse_count++;
-    uint32_t current_time = time_us_32();
-    uint32_t time_since_last_pulse = current_time - last_pulse_time;
-    
-    if (time_since_last_pulse > 0) {
-        float speed_hz = 1.0 / (time_since_last_pulse * 1e-6);  // Speed in Hz
-        float speed_cm_per_sec = speed_hz * (WHEEL_CIRCUMFERENCE / PPR);  // Speed in cm/s
-        float distance_cm = (float)pulse_count * (WHEEL_CIRCUMFERENCE / PPR);  // Distance in cm
-        printf("Distance: %.2f cm, Speed: %.2f cm/s\n", distance_cm, speed_cm_per_sec);
+#define CM_PER_PULSE (WHEEL_CIRCUMFERENCE / PPR)
+
+// cm/s = CM_PER_PULSE * 1e6 / period_us; kept in Q16 so one 32-bit divide
+// (done by the RP2040 hardware divider) gives the speed
+#define SPEED_DIVIDEND_Q16 ((uint32_t)(CM_PER_PULSE * 1e6 * Q16_ONE))
+
+static encoder_t *encoders[ENCODER_MAX_COUNT];
+static uint encoder_count = 0;
+
+// Keep the ISR to a timestamp and a ring push: no float maths, no printf
+static inline void encoder_isr(encoder_t *encoder)
+{
+    if (gpio_get_irq_event_mask(encoder->pin) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(encoder->pin, GPIO_IRQ_EDGE_RISE);
+        spsc_ring_push(&encoder->ring, time_us_32());
     }
-    
-    last_pulse_time = current_time;
 }
 
-int main() {
-    stdio_init_all();
-    gpio_init(ENCODER_PIN);
-    gpio_set_dir(ENCODER_PIN, GPIO_IN);
-    gpio_set_irq_enabled_with_callback(ENCODER_PIN, GPIO_IRQ_EDGE_RISE, true, &encoder_isr);
-    
-    while (1) {
-        tight_loop_contents();
+// One raw handler per slot, each shared IRQ handler must be unique
+static void encoder_isr_0(void) { encoder_isr(encoders[0]); }
+static void encoder_isr_1(void) { encoder_isr(encoders[1]); }
+
+static const irq_handler_t encoder_handlers[ENCODER_MAX_COUNT] = {
+    encoder_isr_0,
+    encoder_isr_1,
+};
+
+void encoder_init(encoder_t *encoder, uint pin)
+{
+    hard_assert(encoder_count < ENCODER_MAX_COUNT);
+
+    encoder->pin = pin;
+    spsc_ring_init(&encoder->ring, encoder->storage, ENCODER_RING_SIZE);
+    encoder->pulse_count = 0;
+    encoder->last_pulse_time = 0;
+    encoder->period_us = 0;
+    encoder->dropped = 0;
+    encoder->seen_overflows = 0;
+    irq_handler_t handler = encoder_handlers[encoder_count];
+    encoders[encoder_count++] = encoder;
+
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+
+    // Raw handler so other drivers can still use the GPIO IRQ callback
+    gpio_add_raw_irq_handler(pin, handler);
+    gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void encoder_update(encoder_t *encoder)
+{
+    uint32_t timestamp;
+
+    while (spsc_ring_pop(&encoder->ring, &timestamp)) {
+        if (encoder->pulse_count == 0) {
+            // First pulse: distance starts counting, no period yet
+            encoder->pulse_count = 1;
+            encoder->last_pulse_time = timestamp;
+            continue;
+        }
+
+        uint32_t period = timestamp - encoder->last_pulse_time;
+        if (period < ENCODER_MIN_PERIOD_US) {
+            encoder->dropped++;
+            continue;
+        }
+
+        encoder->pulse_count++;
+        encoder->period_us = period;
+        encoder->last_pulse_time = timestamp;
+    }
+
+    // Pulses that did not fit in the ring lost their timestamp but still
+    // moved the wheel, so distance keeps counting them
+    uint32_t overflows = encoder->ring.overflows;
+    encoder->pulse_count += overflows - encoder->seen_overflows;
+    encoder->seen_overflows = overflows;
+
+    uint32_t since_last = time_us_32() - encoder->last_pulse_time;
+    if (since_last > ENCODER_STOP_TIMEOUT_US) {
+        encoder->period_us = 0;
+    } else if (encoder->period_us != 0 && since_last > encoder->period_us) {
+        // Wheel is slowing down: the next pulse is at least this far away
+        encoder->period_us = since_last;
     }
-    
-    return 0;
+}
+
+float encoder_get_distance_cm(const encoder_t *encoder)
+{
+    return (float)encoder->pulse_count * CM_PER_PULSE;
+}
+
+float encoder_get_speed_cm_s(const encoder_t *encoder)
+{
+    if (encoder->period_us == 0)
+        return 0.0f;
+
+    return CM_PER_PULSE * 1e6f / (float)encoder->period_us;
+}
+
+q16_t encoder_get_speed_q16(const encoder_t *encoder)
+{
+    if (encoder->period_us == 0)
+        return 0;
+
+    return (q16_t)(SPEED_DIVIDEND_Q16 / encoder->period_us);
 }
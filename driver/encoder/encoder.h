@@ -0,0 +1,70 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "fixed.h"
+#include "spsc_ring.h"
+
+// Define the properties of your wheel and encoder
+#define PPR 360       // Example: 360 pulses per wheel revolution
+#define WHEEL_CIRCUMFERENCE 21.0  // Example: 21 cm
+
+// Distance per pulse in Q16.16 cm, for integer-only distance maths
+#define ENCODER_CM_PER_PULSE_Q16 Q16(WHEEL_CIRCUMFERENCE / PPR)
+
+// Timestamps buffered between the ISR and encoder_update() (power of two)
+#define ENCODER_RING_SIZE 64
+
+// Pulses closer together than this are contact bounce / noise, not wheel slots
+#define ENCODER_MIN_PERIOD_US 100
+
+// No pulse for this long means the wheel has stopped
+#define ENCODER_STOP_TIMEOUT_US 200000
+
+// Up to this many encoders can share the GPIO IRQ (e.g. left and right wheel)
+#define ENCODER_MAX_COUNT 2
+
+typedef struct {
+    uint pin;
+
+    // Filled by the ISR, drained by encoder_update()
+    spsc_ring_t ring;
+    uint32_t storage[ENCODER_RING_SIZE];
+
+    // Thread-context state, only touched by encoder_update()
+    uint32_t pulse_count;
+    uint32_t last_pulse_time;
+    uint32_t period_us;         // time between the last two pulses (or since the
+                                // last one if longer), 0 = stopped
+    uint32_t dropped;           // pulses rejected as glitches
+    uint32_t seen_overflows;    // ring overflows already added to pulse_count
+} encoder_t;
+
+// Set up pin as an input and push a timestamp for every rising edge
+void encoder_init(encoder_t *encoder, uint pin);
+
+// Drain the ISR ring and update pulse count and period. Call from thread
+// context often enough that the ring does not overflow
+void encoder_update(encoder_t *encoder);
+
+float encoder_get_distance_cm(const encoder_t *encoder);
+float encoder_get_speed_cm_s(const encoder_t *encoder);
+
+// Wheel speed in Q16.16 cm/s, integer-only so it is cheap in a control tick
+q16_t encoder_get_speed_q16(const encoder_t *encoder);
+
+// Pulses lost because the ring was full (encoder_update() not called often enough)
+static inline uint32_t encoder_get_overflows(const encoder_t *encoder)
+{
+    return encoder->ring.overflows;
+}
+
+// Pulses discarded as glitches by encoder_update()
+static inline uint32_t encoder_get_dropped(const encoder_t *encoder)
+{
+    return encoder->dropped;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "board_pins.h"
+#include "encoder.h"
+
+static encoder_t encoder;
+
+int main() {
+    stdio_init_all();
+    encoder_init(&encoder, ENCODER_LEFT_PIN);
+
+    uint32_t last_pulse_count = 0;
+
+    while (1) {
+        // Distance and speed are worked out here, not in the ISR
+        encoder_update(&encoder);
+
+        if (encoder.pulse_count != last_pulse_count) {
+            last_pulse_count = encoder.pulse_count;
+            printf("Distance: %.2f cm, Speed: %.2f cm/s (overflows %lu, dropped %lu)\n",
+                   encoder_get_distance_cm(&encoder),
+                   encoder_get_speed_cm_s(&encoder),
+                   (unsigned long)encoder_get_overflows(&encoder),
+                   (unsigned long)encoder_get_dropped(&encoder));
+        }
+
+        sleep_ms(100);
+    }
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "irsensor.h"
+
+#define PRINT_INTERVAL_MS 25  // 25 ms
+
+int main() {
+    stdio_init_all();
+
+    // Sample all three IR sensors in the background through the ADC FIFO and DMA
+    ir_adc_start(NULL);
+
+    while (true) {
+        ir_adc_snapshot_t ir;
+        ir_adc_get_snapshot(&ir);
+
+        // Print IR sensor values every 25 ms, from the main loop rather than an IRQ
+        uint32_t milliseconds = ir.timestamp_us / 1000;
+
+        printf("%02d:%02d:%02d.%03d -> IR Sensor Values: L %d R %d B %d\n",
+               (int)(milliseconds / 3600000) % 24,
+               (int)((milliseconds / 60000) % 60),
+               (int)((milliseconds / 1000) % 60),
+               (int)(milliseconds % 1000),
+               ir.value[IR_ADC_LEFT], ir.value[IR_ADC_RIGHT], ir.value[IR_ADC_BOTTOM]);
+
+        sleep_ms(PRINT_INTERVAL_MS);
+    }
+
+    return 0;
+}
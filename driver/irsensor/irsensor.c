@@ -0,0 +1,28 @@
+#include "irsensor.h"
+#include "hardware/adc.h"
+
+void ir_sensor_init(void)
+{
+    const uint32_t mask = (1u << IR_SENSOR_LEFT_PIN) | (1u << IR_SENSOR_RIGHT_PIN) |
+                          (1u << IR_SENSOR_BOTTOM_PIN);
+
+    gpio_init_mask(mask);
+    gpio_set_dir_in_masked(mask);
+}
+
+void ir_sensor_adc_init(uint pin)
+{
+    // adc_init() only resets the ADC, so it is fine to call once per sensor
+    static bool adc_ready = false;
+    if (!adc_ready) {
+        adc_init();
+        adc_ready = true;
+    }
+    adc_gpio_init(pin);
+}
+
+uint16_t ir_sensor_adc_read(uint pin)
+{
+    adc_select_input(pin - IR_ADC_BASE_PIN);
+    return adc_read();
+}
@@ -0,0 +1,129 @@
+#ifndef IRSENSOR_H
+#define IRSENSOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "board_pins.h"
+
+// First GPIO with an ADC input (ADC0); ADC channel = pin - IR_ADC_BASE_PIN
+#define IR_ADC_BASE_PIN 26
+
+// Digital (comparator) mode: left, right and bottom sensors as GPIO inputs
+void ir_sensor_init(void);
+
+// High when the sensor sees a black line
+static inline bool ir_sensor_on_line(uint pin)
+{
+    return gpio_get(pin);
+}
+
+// Analog mode: route pin to the ADC. A pin used this way can no longer be
+// read with ir_sensor_on_line()
+void ir_sensor_adc_init(uint pin);
+
+// One blocking 12-bit conversion of the sensor on pin
+uint16_t ir_sensor_adc_read(uint pin);
+
+// Free-running acquisition: the ADC round-robins ADC0..ADC2 (left, right,
+// bottom) into its FIFO, two chained DMA channels ping-pong the samples into
+// a double buffer, and the DMA IRQ averages each block into a snapshot.
+// No CPU time is spent waiting on conversions
+#define IR_ADC_CHANNELS 3
+#define IR_ADC_LEFT 0
+#define IR_ADC_RIGHT 1
+#define IR_ADC_BOTTOM 2
+
+// Total conversion rate over all channels, i.e. 2 kHz per sensor
+#define IR_ADC_SAMPLE_RATE_HZ 6000
+
+// Samples per DMA block (a multiple of IR_ADC_CHANNELS so every block
+// starts on ADC0): 16 per channel, one block every 8 ms
+#define IR_ADC_BLOCK_SAMPLES (IR_ADC_CHANNELS * 16)
+
+typedef struct {
+    uint16_t value[IR_ADC_CHANNELS];    // averaged 12-bit reading per channel
+    uint32_t timestamp_us;              // when the newest average was published
+    uint32_t sequence;                  // number of snapshots published so far
+} ir_adc_snapshot_t;
+
+// Start free-running acquisition on all three sensors. decimation[ch] is how
+// many DMA blocks are averaged into one published value for that channel
+// (NULL = 1 for every channel)
+void ir_adc_start(const uint8_t decimation[IR_ADC_CHANNELS]);
+
+// Copy out the latest averaged values. Never waits on the ADC or the DMA;
+// retries only if the IRQ published a new snapshot during the copy
+void ir_adc_get_snapshot(ir_adc_snapshot_t *snapshot);
+
+// Calibration: min/max per channel seen while sweeping the sensors over the
+// floor and the line, and the on-line thresholds derived from them. Saved in
+// the last flash sector so the car boots calibrated
+#define IR_CAL_VERSION 1
+
+// Used until a calibration has been loaded or recorded
+#define IR_CAL_DEFAULT_MIN 200
+#define IR_CAL_DEFAULT_MAX 3500
+
+// A channel whose max - min is smaller than this never saw the line
+#define IR_CAL_MIN_SPAN 400
+
+// Hysteresis band around the midpoint, as a fraction (1/N) of the span
+#define IR_CAL_HYSTERESIS_DIV 8
+
+// Serialized record: header, four u16 per channel, CRC-32. Fits in one
+// flash page
+#define IR_CAL_HEADER_SIZE 12
+#define IR_CAL_PAYLOAD_SIZE (IR_ADC_CHANNELS * 8)
+#define IR_CAL_CRC_SIZE 4
+#define IR_CAL_RECORD_SIZE (IR_CAL_HEADER_SIZE + IR_CAL_PAYLOAD_SIZE + IR_CAL_CRC_SIZE)
+
+typedef struct {
+    uint16_t min[IR_ADC_CHANNELS];          // over white floor
+    uint16_t max[IR_ADC_CHANNELS];          // over the black line
+    uint16_t threshold_low[IR_ADC_CHANNELS];    // leave the line below this
+    uint16_t threshold_high[IR_ADC_CHANNELS];   // enter the line above this
+} ir_calibration_t;
+
+void ir_cal_default(ir_calibration_t *cal);
+
+// Calibration sweep: reset min/max, feed every new snapshot, then compute the
+// thresholds. ir_cal_finish() returns false if a channel never saw contrast;
+// such channels fall back to the defaults
+void ir_cal_begin(ir_calibration_t *cal);
+void ir_cal_add(ir_calibration_t *cal, const ir_adc_snapshot_t *snapshot);
+bool ir_cal_finish(ir_calibration_t *cal);
+
+// Hysteresis on-line test for one channel; was_on_line is the previous result
+static inline bool ir_cal_on_line(const ir_calibration_t *cal, uint ch, uint16_t raw, bool was_on_line)
+{
+    return raw > (was_on_line ? cal->threshold_low[ch] : cal->threshold_high[ch]);
+}
+
+// Record layout (little endian): magic, version, payload length, per channel
+// min/max/threshold_low/threshold_high as u16, then CRC-32 of everything
+// before it. Pure functions, no hardware
+void ir_cal_encode(const ir_calibration_t *cal, uint8_t record[IR_CAL_RECORD_SIZE]);
+bool ir_cal_decode(const uint8_t *record, ir_calibration_t *cal);
+
+// Persist to / restore from the reserved flash sector. ir_cal_load() returns
+// false (leaving cal untouched) if there is no valid record. ir_cal_save()
+// returns false if the other core could not be parked (flash_safe_execute()):
+// a core running bare-metal code must have called flash_safe_execute_core_init()
+bool ir_cal_load(ir_calibration_t *cal);
+bool ir_cal_save(const ir_calibration_t *cal);
+
+// Called from the DMA IRQ for every black/white transition on the edge
+// channel, with the time the crossing sample was converted
+typedef void (*ir_adc_edge_callback_t)(uint32_t timestamp_us, bool black);
+
+// Watch one channel sample by sample (IR_ADC_SAMPLE_RATE_HZ / 3 resolution)
+// for crossings of a hysteresis band. NULL callback turns detection off
+void ir_adc_set_edge_callback(uint ch, uint16_t threshold_low, uint16_t threshold_high,
+                              ir_adc_edge_callback_t callback);
+
+// De-interleave count round-robin samples (first sample from channel 0) and
+// add each channel's samples to sums[channel]. Pure function, no hardware
+void ir_adc_accumulate(const uint16_t *samples, uint count, uint32_t sums[IR_ADC_CHANNELS]);
+
+#endif
@@ -0,0 +1,184 @@
+#include <string.h>
+#include "irsensor.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+// ADC runs from the 48 MHz USB clock; one conversion takes 96 cycles
+#define ADC_CLOCK_HZ 48000000
+#define ADC_CLKDIV ((float)ADC_CLOCK_HZ / IR_ADC_SAMPLE_RATE_HZ - 1)
+
+#define SAMPLES_PER_CHANNEL (IR_ADC_BLOCK_SAMPLES / IR_ADC_CHANNELS)
+
+// Time between two conversions (any channel), in ns to keep precision
+#define SAMPLE_PERIOD_NS (1000000000u / IR_ADC_SAMPLE_RATE_HZ)
+
+static uint16_t buffers[2][IR_ADC_BLOCK_SAMPLES];
+static uint dma_chan[2];
+
+// Per-channel decimation, touched only by the DMA IRQ after start
+static uint8_t decimate[IR_ADC_CHANNELS];
+static uint8_t blocks_seen[IR_ADC_CHANNELS];
+static uint32_t channel_sums[IR_ADC_CHANNELS];
+
+// Threshold crossing detection on one channel, run from the DMA IRQ
+static ir_adc_edge_callback_t volatile edge_callback;
+static uint edge_channel;
+static uint16_t edge_low;
+static uint16_t edge_high;
+static bool edge_black;
+
+// Seqlock: odd while the IRQ is writing the snapshot
+static volatile uint32_t snapshot_seq = 0;
+static ir_adc_snapshot_t snapshot;
+
+void ir_adc_accumulate(const uint16_t *samples, uint count, uint32_t sums[IR_ADC_CHANNELS])
+{
+    uint i = 0;
+    for (; i + IR_ADC_CHANNELS <= count; i += IR_ADC_CHANNELS) {
+        sums[0] += samples[i];
+        sums[1] += samples[i + 1];
+        sums[2] += samples[i + 2];
+    }
+    // Trailing partial frame, if any
+    for (uint ch = 0; i < count; i++, ch++)
+        sums[ch] += samples[i];
+}
+
+// Report every hysteresis crossing in the block with the time its sample
+// was converted, not the (up to a block later) time the IRQ ran
+static void detect_edges(const uint16_t *block, uint32_t block_end_us, ir_adc_edge_callback_t callback)
+{
+    for (uint i = edge_channel; i < IR_ADC_BLOCK_SAMPLES; i += IR_ADC_CHANNELS) {
+        uint16_t value = block[i];
+        bool black = edge_black ? value > edge_low : value > edge_high;
+        if (black == edge_black)
+            continue;
+
+        edge_black = black;
+        uint32_t age_ns = (IR_ADC_BLOCK_SAMPLES - 1 - i) * SAMPLE_PERIOD_NS;
+        callback(block_end_us - age_ns / 1000, black);
+    }
+}
+
+static void publish(const uint16_t *block)
+{
+    ir_adc_edge_callback_t callback = edge_callback;
+    if (callback)
+        detect_edges(block, time_us_32(), callback);
+
+    uint32_t sums[IR_ADC_CHANNELS] = {0};
+    ir_adc_accumulate(block, IR_ADC_BLOCK_SAMPLES, sums);
+
+    bool changed = false;
+    uint16_t values[IR_ADC_CHANNELS];
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        channel_sums[ch] += sums[ch];
+        values[ch] = snapshot.value[ch];
+        if (++blocks_seen[ch] >= decimate[ch]) {
+            values[ch] = channel_sums[ch] / (SAMPLES_PER_CHANNEL * blocks_seen[ch]);
+            channel_sums[ch] = 0;
+            blocks_seen[ch] = 0;
+            changed = true;
+        }
+    }
+    if (!changed)
+        return;
+
+    snapshot_seq++;
+    __dmb();
+    memcpy(snapshot.value, values, sizeof(values));
+    snapshot.timestamp_us = time_us_32();
+    snapshot.sequence++;
+    __dmb();
+    snapshot_seq++;
+}
+
+static void ir_adc_dma_handler(void)
+{
+    for (uint i = 0; i < 2; i++) {
+        if (!dma_channel_get_irq0_status(dma_chan[i]))
+            continue;
+        dma_channel_acknowledge_irq0(dma_chan[i]);
+
+        // The other channel is already filling its half, so this one can be
+        // processed and re-armed for when the chain comes back to it
+        publish(buffers[i]);
+        dma_channel_set_write_addr(dma_chan[i], buffers[i], false);
+    }
+}
+
+void ir_adc_start(const uint8_t decimation[IR_ADC_CHANNELS])
+{
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        decimate[ch] = (decimation && decimation[ch]) ? decimation[ch] : 1;
+        blocks_seen[ch] = 0;
+        channel_sums[ch] = 0;
+    }
+
+    ir_sensor_adc_init(IR_SENSOR_LEFT_PIN);
+    ir_sensor_adc_init(IR_SENSOR_RIGHT_PIN);
+    ir_sensor_adc_init(IR_SENSOR_BOTTOM_PIN);
+
+    // Start on ADC0 and cycle through ADC0..ADC2
+    adc_select_input(0);
+    adc_set_round_robin((1u << IR_ADC_CHANNELS) - 1);
+    adc_fifo_setup(true,    // write conversions to the FIFO
+                   true,    // raise DREQ for the DMA
+                   1,       // as soon as one sample is there
+                   false,   // no error bit, keep samples 12-bit
+                   false);
+    adc_set_clkdiv(ADC_CLKDIV);
+
+    dma_chan[0] = dma_claim_unused_channel(true);
+    dma_chan[1] = dma_claim_unused_channel(true);
+
+    for (uint i = 0; i < 2; i++) {
+        dma_channel_config c = dma_channel_get_default_config(dma_chan[i]);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+        channel_config_set_read_increment(&c, false);
+        channel_config_set_write_increment(&c, true);
+        channel_config_set_dreq(&c, DREQ_ADC);
+        // Ping-pong: each channel hands over to the other when its block is full
+        channel_config_set_chain_to(&c, dma_chan[1 - i]);
+        dma_channel_configure(dma_chan[i], &c, buffers[i], &adc_hw->fifo, IR_ADC_BLOCK_SAMPLES, false);
+        dma_channel_set_irq0_enabled(dma_chan[i], true);
+    }
+
+    irq_add_shared_handler(DMA_IRQ_0, ir_adc_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    adc_fifo_drain();
+    dma_channel_start(dma_chan[0]);
+    adc_run(true);
+}
+
+void ir_adc_get_snapshot(ir_adc_snapshot_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = snapshot_seq;
+        __dmb();
+        *out = snapshot;
+        __dmb();
+    } while ((seq & 1) || seq != snapshot_seq);
+}
+
+void ir_adc_set_edge_callback(uint ch, uint16_t threshold_low, uint16_t threshold_high,
+                              ir_adc_edge_callback_t callback)
+{
+    // The DMA IRQ may run on the other core, so the callback is cleared
+    // while the thresholds change and set again last
+    uint32_t irq_state = save_and_disable_interrupts();
+    edge_callback = NULL;
+    __dmb();
+    edge_channel = ch;
+    edge_low = threshold_low;
+    edge_high = threshold_high;
+    edge_black = false;
+    __dmb();
+    edge_callback = callback;
+    restore_interrupts(irq_state);
+}
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "irsensor.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+#define IR_CAL_MAGIC 0x4C435249u   // "IRCL"
+
+_Static_assert(IR_CAL_RECORD_SIZE <= FLASH_PAGE_SIZE, "IR calibration record must fit one flash page");
+
+// Last sector of flash, well clear of the program image
+#define IR_CAL_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+// How long to wait for the other core to step out of flash
+#define IR_CAL_SAVE_TIMEOUT_MS 100
+
+static void set_thresholds(ir_calibration_t *cal, uint ch)
+{
+    uint16_t mid = (cal->min[ch] + cal->max[ch]) / 2;
+    uint16_t band = (cal->max[ch] - cal->min[ch]) / IR_CAL_HYSTERESIS_DIV;
+    cal->threshold_low[ch] = mid - band;
+    cal->threshold_high[ch] = mid + band;
+}
+
+void ir_cal_default(ir_calibration_t *cal)
+{
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        cal->min[ch] = IR_CAL_DEFAULT_MIN;
+        cal->max[ch] = IR_CAL_DEFAULT_MAX;
+        set_thresholds(cal, ch);
+    }
+}
+
+void ir_cal_begin(ir_calibration_t *cal)
+{
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        cal->min[ch] = UINT16_MAX;
+        cal->max[ch] = 0;
+    }
+}
+
+void ir_cal_add(ir_calibration_t *cal, const ir_adc_snapshot_t *snapshot)
+{
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        if (snapshot->value[ch] < cal->min[ch])
+            cal->min[ch] = snapshot->value[ch];
+        if (snapshot->value[ch] > cal->max[ch])
+            cal->max[ch] = snapshot->value[ch];
+    }
+}
+
+bool ir_cal_finish(ir_calibration_t *cal)
+{
+    bool ok = true;
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        if (cal->max[ch] < cal->min[ch] || cal->max[ch] - cal->min[ch] < IR_CAL_MIN_SPAN) {
+            // Keep the channel usable with the defaults
+            cal->min[ch] = IR_CAL_DEFAULT_MIN;
+            cal->max[ch] = IR_CAL_DEFAULT_MAX;
+            ok = false;
+        }
+        set_thresholds(cal, ch);
+    }
+    return ok;
+}
+
+void ir_cal_encode(const ir_calibration_t *cal, uint8_t record[IR_CAL_RECORD_SIZE])
+{
+    put_le32(record, IR_CAL_MAGIC);
+    put_le16(record + 4, IR_CAL_VERSION);
+    put_le16(record + 6, IR_CAL_PAYLOAD_SIZE);
+    put_le32(record + 8, 0);     // reserved
+
+    uint8_t *p = record + IR_CAL_HEADER_SIZE;
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++, p += 8) {
+        put_le16(p, cal->min[ch]);
+        put_le16(p + 2, cal->max[ch]);
+        put_le16(p + 4, cal->threshold_low[ch]);
+        put_le16(p + 6, cal->threshold_high[ch]);
+    }
+
+    put_le32(p, crc32(record, IR_CAL_HEADER_SIZE + IR_CAL_PAYLOAD_SIZE));
+}
+
+bool ir_cal_decode(const uint8_t *record, ir_calibration_t *cal)
+{
+    if (get_le32(record) != IR_CAL_MAGIC ||
+        get_le16(record + 4) != IR_CAL_VERSION ||
+        get_le16(record + 6) != IR_CAL_PAYLOAD_SIZE)
+        return false;
+
+    const uint8_t *p = record + IR_CAL_HEADER_SIZE;
+    if (get_le32(p + IR_CAL_PAYLOAD_SIZE) != crc32(record, IR_CAL_HEADER_SIZE + IR_CAL_PAYLOAD_SIZE))
+        return false;
+
+    ir_calibration_t decoded;
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++, p += 8) {
+        decoded.min[ch] = get_le16(p);
+        decoded.max[ch] = get_le16(p + 2);
+        decoded.threshold_low[ch] = get_le16(p + 4);
+        decoded.threshold_high[ch] = get_le16(p + 6);
+
+        // A record that passed the CRC but makes no sense is still rejected
+        if (decoded.min[ch] >= decoded.max[ch] ||
+            decoded.threshold_low[ch] > decoded.threshold_high[ch])
+            return false;
+    }
+
+    *cal = decoded;
+    return true;
+}
+
+bool ir_cal_load(ir_calibration_t *cal)
+{
+    // Flash is memory mapped through XIP
+    return ir_cal_decode((const uint8_t *)(XIP_BASE + IR_CAL_FLASH_OFFSET), cal);
+}
+
+static void write_record(void *page)
+{
+    flash_range_erase(IR_CAL_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(IR_CAL_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+}
+
+bool ir_cal_save(const ir_calibration_t *cal)
+{
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    ir_cal_encode(cal, page);
+
+    // Nothing may run from flash while it is erased/programmed, on either
+    // core: this disables interrupts here and parks the other core in RAM
+    return flash_safe_execute(write_record, page, IR_CAL_SAVE_TIMEOUT_MS) == PICO_OK;
+}
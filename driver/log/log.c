@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include "log.h"
+#include "pico/platform.h"
+#include "pico/stdlib.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+#define RING_MASK (LOG_RING_WORDS - 1)
+
+// One ring per core. head is written only by that core, under masked
+// interrupts so a record from an ISR cannot land inside one from a task;
+// tail only by the drain
+typedef struct {
+    uint32_t words[LOG_RING_WORDS];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t records;
+    volatile uint32_t dropped;
+    uint32_t reported_drops;    // drain side
+    uint16_t sequence;          // drain side
+} log_ring_t;
+
+static log_ring_t rings[NUM_CORES];
+static uint next_core;          // drain side: the ring to try first
+static uint32_t frames;
+static uint32_t bytes;
+
+void log_write(const uint32_t *words, uint count)
+{
+    // Ring layout: id | args << 16, timestamp, args
+    uint32_t args = count - 1;
+    uint32_t needed = args + 2;
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    log_ring_t *ring = &rings[get_core_num()];
+    uint32_t h = ring->head;
+    if (args > LOG_MAX_ARGS || LOG_RING_WORDS - (h - ring->tail) < needed) {
+        ring->dropped++;
+        restore_interrupts(irq_state);
+        return;
+    }
+    ring->words[h & RING_MASK] = (words[0] & 0xFFFF) | args << 16;
+    ring->words[(h + 1) & RING_MASK] = time_us_32();
+    for (uint32_t i = 0; i < args; i++)
+        ring->words[(h + 2 + i) & RING_MASK] = words[1 + i];
+    __dmb();
+    ring->head = h + needed;
+    ring->records++;
+    restore_interrupts(irq_state);
+}
+
+static size_t drain_ring(log_ring_t *ring, uint core, uint8_t *frame, size_t size)
+{
+    uint32_t t = ring->tail;
+    uint32_t h = ring->head;
+    if (t == h)
+        return 0;
+    __dmb();
+
+    uint8_t *out = frame + LOG_HEADER_SIZE;
+    uint8_t *end = frame + size - LOG_CRC_SIZE;
+    while (t != h) {
+        uint32_t first = ring->words[t & RING_MASK];
+        uint32_t args = first >> 16;
+        if (end - out < LOG_RECORD_SIZE(args))
+            break;
+        put_le16(out, (uint16_t)first);
+        out[2] = (uint8_t)args;
+        put_le32(out + 3, ring->words[(t + 1) & RING_MASK]);
+        for (uint32_t i = 0; i < args; i++)
+            put_le32(out + 7 + 4 * i, ring->words[(t + 2 + i) & RING_MASK]);
+        out += LOG_RECORD_SIZE(args);
+        t += args + 2;
+    }
+
+    // Done reading the words before the writer may reuse them
+    __dmb();
+    ring->tail = t;
+
+    uint32_t dropped = ring->dropped;
+    uint16_t length = (out - frame) + LOG_CRC_SIZE;
+    log_header_t header = {
+        .length = length,
+        .sequence = ring->sequence++,
+        .dropped = dropped - ring->reported_drops > UINT16_MAX ? UINT16_MAX : dropped - ring->reported_drops,
+        .core = core,
+    };
+    ring->reported_drops = dropped;
+    log_put_header(frame, &header);
+    log_put_crc(frame, length);
+    return length;
+}
+
+size_t log_drain(uint8_t *frame, size_t size)
+{
+    if (size > LOG_FRAME_MAX)
+        size = LOG_FRAME_MAX;
+    if (size < LOG_HEADER_SIZE + LOG_RECORD_SIZE(LOG_MAX_ARGS) + LOG_CRC_SIZE)
+        return 0;
+
+    // Take turns, so a busy core cannot starve the other
+    for (uint i = 0; i < NUM_CORES; i++) {
+        uint core = (next_core + i) % NUM_CORES;
+        size_t length = drain_ring(&rings[core], core, frame, size);
+        if (length > 0) {
+            next_core = (core + 1) % NUM_CORES;
+            frames++;
+            bytes += length;
+            return length;
+        }
+    }
+    return 0;
+}
+
+void log_drain_stdio(void)
+{
+    uint8_t frame[LOG_FRAME_MAX];
+    size_t length;
+
+    // Raw: CR/LF translation would corrupt the binary
+    stdio_flush();
+    while ((length = log_drain(frame, sizeof(frame))) > 0) {
+        for (size_t i = 0; i < length; i++)
+            putchar_raw(frame[i]);
+    }
+    stdio_flush();
+}
+
+void log_get_stats(log_stats_t *stats)
+{
+    stats->records = 0;
+    stats->dropped = 0;
+    for (uint core = 0; core < NUM_CORES; core++) {
+        stats->records += rings[core].records;
+        stats->dropped += rings[core].dropped;
+    }
+    stats->frames = frames;
+    stats->bytes = bytes;
+}
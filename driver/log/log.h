@@ -0,0 +1,63 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "log_codec.h"
+
+// Deferred-formatting binary log. A call site stores a message ID and its
+// raw arguments in its core's ring and returns; formatting happens on the
+// host (tools/log_decoder.c) from the same catalogue the IDs come from.
+// Safe from any task or ISR on either core: each core only writes its own
+// ring, with interrupts masked on that core for the few words of a record.
+// A record that does not fit is dropped and counted.
+//
+// The application lists its messages once, as an X-macro (one X per line,
+// continued with backslashes):
+//
+//   #define LOG_MESSAGES(X)
+//       X(LOG_NO_ECHO, "Ultrasonic: no echo")
+//       X(LOG_SPEED, "Speed: %q cm/s after %u us")
+//
+//   enum { LOG_MESSAGES(LOG_ENUM) };
+//
+// and logs with LOG(LOG_SPEED, speed, elapsed_us). Formats take printf
+// conversions on 32-bit integers, plus %q for Q16.16 and %f for floats
+// passed through log_float().
+
+#define LOG_RING_WORDS 512      // per core, power of two
+
+// First element: the message ID, then up to LOG_MAX_ARGS arguments
+#define LOG(...) log_write((const uint32_t[]){__VA_ARGS__}, \
+                           sizeof((const uint32_t[]){__VA_ARGS__}) / sizeof(uint32_t))
+
+typedef struct {
+    uint32_t records;       // written, both cores
+    uint32_t dropped;       // ring full, both cores
+    uint32_t frames;        // drained
+    uint32_t bytes;
+} log_stats_t;
+
+static inline uint32_t log_float(float value)
+{
+    union { float f; uint32_t u; } bits = {.f = value};
+    return bits.u;
+}
+
+// words[0] is the message ID, words[1..count - 1] its arguments
+void log_write(const uint32_t *words, uint count);
+
+// Pack waiting records from one core into a frame of at most size bytes
+// (at most LOG_FRAME_MAX). Returns its length, 0 if nothing is waiting.
+// Single consumer
+size_t log_drain(uint8_t *frame, size_t size);
+
+// Drain everything to the USB/UART console, frames written raw between
+// any text
+void log_drain_stdio(void);
+
+void log_get_stats(log_stats_t *stats);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "byte_order.h"
+#include "crc32.h"
+
+// Binary log frames, shared by the firmware and the host decoder
+// (tools/log_decoder.c), so it only uses the C standard library.
+//
+// Format strings never leave the host: a record is a message ID from the
+// application's catalogue plus its raw 32-bit arguments. Little endian:
+//   0  u16 magic        LOG_MAGIC
+//   2  u16 length       whole frame, CRC included
+//   4  u16 sequence     per core
+//   6  u16 dropped      records that core lost since its previous frame
+//   8  u8  core
+//   9  u8  reserved
+// then records:
+//   u16 id, u8 arg count, u32 timestamp (time_us_32()), u32 args...
+// and a CRC-32 of everything before it. Frames may be interleaved with
+// plain text on the USB console; the decoder resynchronises on the magic.
+
+#define LOG_MAGIC 0x474C        // "LG" on the wire
+#define LOG_HEADER_SIZE 10
+#define LOG_CRC_SIZE 4
+#define LOG_FRAME_MAX 256
+#define LOG_MAX_ARGS 6
+
+#define LOG_RECORD_SIZE(args) (7 + 4 * (args))
+
+// Expands a message catalogue (see log.h) into its IDs
+#define LOG_ENUM(id, format) id,
+
+typedef struct {
+    uint16_t length;
+    uint16_t sequence;
+    uint16_t dropped;
+    uint8_t core;
+} log_header_t;
+
+typedef struct {
+    uint16_t id;
+    uint8_t arg_count;
+    uint32_t timestamp_us;
+    uint32_t arg[LOG_MAX_ARGS];
+} log_record_t;
+
+static inline void log_put_header(uint8_t out[LOG_HEADER_SIZE], const log_header_t *header)
+{
+    put_le16(out, LOG_MAGIC);
+    put_le16(out + 2, header->length);
+    put_le16(out + 4, header->sequence);
+    put_le16(out + 6, header->dropped);
+    out[8] = header->core;
+    out[9] = 0;
+}
+
+// Appends the CRC over the first length - LOG_CRC_SIZE bytes
+static inline void log_put_crc(uint8_t *frame, uint16_t length)
+{
+    put_le32(frame + length - LOG_CRC_SIZE, crc32(frame, length - LOG_CRC_SIZE));
+}
+
+// Checks a candidate frame at the start of data: 0 if there is none (wrong
+// magic, length or CRC), otherwise its length. available is how many bytes
+// data holds; a frame that may still be arriving returns 0 too
+static inline size_t log_get_header(const uint8_t *data, size_t available, log_header_t *header)
+{
+    if (available < LOG_HEADER_SIZE + LOG_CRC_SIZE || get_le16(data) != LOG_MAGIC)
+        return 0;
+    header->length = get_le16(data + 2);
+    if (header->length < LOG_HEADER_SIZE + LOG_CRC_SIZE || header->length > LOG_FRAME_MAX ||
+        header->length > available)
+        return 0;
+    if (crc32(data, header->length - LOG_CRC_SIZE) != get_le32(data + header->length - LOG_CRC_SIZE))
+        return 0;
+    header->sequence = get_le16(data + 4);
+    header->dropped = get_le16(data + 6);
+    header->core = data[8];
+    return header->length;
+}
+
+// Decodes the record at in, or returns NULL if it runs past end
+static inline const uint8_t *log_get_record(const uint8_t *in, const uint8_t *end, log_record_t *record)
+{
+    if (end - in < LOG_RECORD_SIZE(0))
+        return NULL;
+    record->id = get_le16(in);
+    record->arg_count = in[2];
+    record->timestamp_us = get_le32(in + 3);
+    if (record->arg_count > LOG_MAX_ARGS || end - in < LOG_RECORD_SIZE(record->arg_count))
+        return NULL;
+    for (int i = 0; i < record->arg_count; i++)
+        record->arg[i] = get_le32(in + 7 + 4 * i);
+    return in + LOG_RECORD_SIZE(record->arg_count);
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include "compass.h"
+#include "fixed_trig.h"
+
+#define Z_GAIN_RATIO Q16((double)COMPASS_XY_LSB_PER_GAUSS / COMPASS_Z_LSB_PER_GAUSS)
+
+static void set_default_correction(compass_calibration_t *cal)
+{
+    for (int i = 0; i < 3; i++) {
+        cal->offset[i] = 0;
+        cal->scale[i] = Q16_ONE;
+    }
+    cal->scale[2] = Z_GAIN_RATIO;
+}
+
+void compass_cal_default(compass_calibration_t *cal)
+{
+    for (int i = 0; i < 3; i++) {
+        cal->min[i] = 0;
+        cal->max[i] = 0;
+    }
+    set_default_correction(cal);
+}
+
+void compass_cal_begin(compass_calibration_t *cal)
+{
+    for (int i = 0; i < 3; i++) {
+        cal->min[i] = INT16_MAX;
+        cal->max[i] = INT16_MIN;
+    }
+}
+
+void compass_cal_add(compass_calibration_t *cal, const int16_t mag[3])
+{
+    for (int i = 0; i < 3; i++) {
+        if (mag[i] < cal->min[i])
+            cal->min[i] = mag[i];
+        if (mag[i] > cal->max[i])
+            cal->max[i] = mag[i];
+    }
+}
+
+bool compass_cal_finish(compass_calibration_t *cal)
+{
+    int32_t radius[3];
+    for (int i = 0; i < 3; i++)
+        radius[i] = cal->max[i] > cal->min[i] ? (cal->max[i] - cal->min[i]) / 2 : 0;
+
+    if (radius[0] < COMPASS_CAL_MIN_RADIUS || radius[1] < COMPASS_CAL_MIN_RADIUS) {
+        set_default_correction(cal);
+        return false;
+    }
+
+    // Z is only seen end to end if the car was tilted during the spin
+    bool fit_z = 2 * radius[2] >= (radius[0] + radius[1]) / 2;
+    int axes = fit_z ? 3 : 2;
+
+    int32_t mean = 0;
+    for (int i = 0; i < axes; i++)
+        mean += radius[i];
+    mean /= axes;
+
+    for (int i = 0; i < axes; i++) {
+        cal->offset[i] = (int16_t)((cal->min[i] + cal->max[i]) / 2);
+        cal->scale[i] = (q16_t)(((int64_t)mean << Q16_SHIFT) / radius[i]);
+    }
+    if (!fit_z) {
+        cal->offset[2] = 0;
+        cal->scale[2] = q16_mul(Z_GAIN_RATIO, (cal->scale[0] + cal->scale[1]) / 2);
+    }
+    return true;
+}
+
+void compass_correct(const compass_calibration_t *cal, const int16_t mag[3], int32_t out[3])
+{
+    for (int i = 0; i < 3; i++)
+        out[i] = (int32_t)(((int64_t)(mag[i] - cal->offset[i]) * cal->scale[i]) >> Q16_SHIFT);
+}
+
+q16_t compass_heading(const compass_calibration_t *cal, const int16_t accel[3], const int16_t mag[3])
+{
+    int32_t m[3];
+    compass_correct(cal, mag, m);
+
+    int64_t gravity_sq = 0;
+    if (accel) {
+        for (int i = 0; i < 3; i++)
+            gravity_sq += (int64_t)accel[i] * accel[i];
+    }
+    if (gravity_sq < (int64_t)COMPASS_MIN_GRAVITY * COMPASS_MIN_GRAVITY)
+        return q16_wrap_360(q16_atan2_deg(m[1], m[0]));
+
+    // Tilt compensation without any angles: with down = -accel,
+    // east = down x field and north = east x down span the horizontal plane,
+    // and the heading is the angle of the sensor X axis in that plane.
+    // north is |down| times longer than east, so east is scaled to match
+    int64_t d[3] = {-accel[0], -accel[1], -accel[2]};
+    int64_t east[3] = {
+        d[1] * m[2] - d[2] * m[1],
+        d[2] * m[0] - d[0] * m[2],
+        d[0] * m[1] - d[1] * m[0],
+    };
+    int64_t north_x = east[1] * d[2] - east[2] * d[1];
+    int64_t east_x = east[0] * isqrt64((uint64_t)gravity_sq);
+
+    return q16_wrap_360(q16_atan2_deg(east_x, north_x));
+}
@@ -0,0 +1,49 @@
+#ifndef COMPASS_H
+#define COMPASS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed.h"
+
+// Heading from the LSM303DLHC: hard/soft-iron corrected magnetometer, tilt
+// compensated with the accelerometer, all in integer maths
+
+// Magnetometer gain at +/- 1.3 gauss: Z reads lower than X/Y
+#define COMPASS_XY_LSB_PER_GAUSS 1100
+#define COMPASS_Z_LSB_PER_GAUSS 980
+
+// An X/Y axis whose (max - min) / 2 is below this never saw the field turn
+#define COMPASS_CAL_MIN_RADIUS 100
+
+// Below this accelerometer magnitude (raw counts, 1 g ~ 16000) the car is not
+// at rest enough to trust gravity; the heading is taken as if level
+#define COMPASS_MIN_GRAVITY 4000
+
+typedef struct {
+    int16_t min[3];
+    int16_t max[3];
+    int16_t offset[3];      // hard iron: centre of the field sphere
+    q16_t scale[3];         // soft iron: stretch each axis to the mean radius
+} compass_calibration_t;
+
+// Zero offsets, scale only for the Z gain difference
+void compass_cal_default(compass_calibration_t *cal);
+
+// Calibration spin: reset min/max, feed every new magnetometer sample while
+// turning in place at least once, then fit offsets and scales.
+// compass_cal_finish() returns false (keeping the defaults) if the spin did
+// not cover enough of the circle. Spinning level does not expose Z, so Z is
+// only fitted if its range is comparable to X/Y
+void compass_cal_begin(compass_calibration_t *cal);
+void compass_cal_add(compass_calibration_t *cal, const int16_t mag[3]);
+bool compass_cal_finish(compass_calibration_t *cal);
+
+// Calibrated field in the sensor frame (scaled counts)
+void compass_correct(const compass_calibration_t *cal, const int16_t mag[3], int32_t out[3]);
+
+// Heading of the sensor X axis in Q16.16 degrees clockwise from magnetic
+// north, 0..360. accel is the raw accelerometer sample used for tilt
+// compensation; NULL (or no usable gravity) assumes the car is level
+q16_t compass_heading(const compass_calibration_t *cal, const int16_t accel[3], const int16_t mag[3]);
+
+#endif
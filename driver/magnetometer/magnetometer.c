@@ -1,147 +1,323 @@
-#include <stdio.h>
-#include <stdlib.h>
+#include "magnetometer.h"
 #include "pico/stdlib.h"
-#include "hardware/i2c.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 
-int main() {
-    stdio_init_all();
+// Accelerometer registers. Setting bit 7 of the sub-address makes the part
+// auto-increment through a multi-byte read
+#define ACCEL_CTRL_REG1 0x20
+#define ACCEL_CTRL_REG4 0x23
+#define ACCEL_STATUS_REG 0x27
+#define ACCEL_OUT_X_L 0x28
+#define ACCEL_AUTO_INCREMENT 0x80
 
-    // Initialize I2C
-    i2c_init(i2c0, 400000); // 400 kHz
-    gpio_set_function(17, GPIO_FUNC_I2C);
-    gpio_set_function(16, GPIO_FUNC_I2C);
-    gpio_pull_up(17);
-    gpio_pull_up(16);
+#define ACCEL_XYZ_ENABLE 0x07
+#define ACCEL_STATUS_ZYXDA 0x08     // new X/Y/Z sample
+#define ACCEL_STATUS_ZYXOR 0x80     // a sample was overwritten unread
 
-    // LSM303DLHC ACCELERO I2C address is 0x32 (50) for writing, 0x33 (51) for reading
-    uint8_t accelero_addr = 0x19;
+// Magnetometer registers (these auto-increment on their own)
+#define MAG_CRA_REG 0x00
+#define MAG_CRB_REG 0x01
+#define MAG_MR_REG 0x02
+#define MAG_OUT_X_H 0x03
+#define MAG_SR_REG 0x09
 
-    // LSM303DLHC MAGNETO I2C address is 0x3C (60) for writing, 0x3D (61) for reading
-    uint8_t magneto_addr = 0x1E;
+#define MAG_SR_DRDY 0x01
 
-    // Select control register1 (0x20)
-    // X, Y, and Z-axis enable, power on mode, output data rate 10 Hz (0x27)
-    uint8_t config[2] = {0x20, 0x27};
+static bool write_reg(uint8_t addr, uint8_t reg, uint8_t value)
+{
+    uint8_t buf[2] = {reg, value};
+    return i2c_write_blocking(IMU_I2C_PORT, addr, buf, 2, false) == 2;
+}
+
+static bool read_regs(uint8_t addr, uint8_t reg, uint8_t *data, size_t len)
+{
+    if (i2c_write_blocking(IMU_I2C_PORT, addr, &reg, 1, true) != 1)
+        return false;
+    return i2c_read_blocking(IMU_I2C_PORT, addr, data, len, false) == (int)len;
+}
+
+// Output data rates of the enum values above
+static const uint16_t accel_odr_hz[] = {0, 1, 10, 25, 50, 100, 200, 400};
+static const uint32_t mag_odr_mhz[] = {750, 1500, 3000, 7500, 15000, 30000, 75000, 220000};
+
+static lsm303_config_t config;
+
+bool lsm303_init(const lsm303_config_t *cfg)
+{
+    const lsm303_config_t defaults = LSM303_DEFAULT_CONFIG;
+    config = cfg ? *cfg : defaults;
+
+    i2c_init(IMU_I2C_PORT, LSM303_I2C_BAUD);
+    gpio_set_function(IMU_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(IMU_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(IMU_SDA_PIN);
+    gpio_pull_up(IMU_SCL_PIN);
 
-    // Select control register4 (0x23)
+    bool ok = true;
+
+    // X, Y, and Z-axis enable, normal power mode, configured output data rate
+    ok &= write_reg(LSM303_ACCEL_ADDR, ACCEL_CTRL_REG1, (config.accel_odr << 4) | ACCEL_XYZ_ENABLE);
     // Full scale +/- 2g, continuous update (0x00)
-    uint8_t config_accel[2] = {0x23, 0x00};
+    ok &= write_reg(LSM303_ACCEL_ADDR, ACCEL_CTRL_REG4, 0x00);
 
-    // Select MR register (0x02) for magnetometer
+    // Configured data output rate
+    ok &= write_reg(LSM303_MAG_ADDR, MAG_CRA_REG, config.mag_odr << 2);
+    // Set gain = +/- 1.3 gauss (0x20)
+    ok &= write_reg(LSM303_MAG_ADDR, MAG_CRB_REG, 0x20);
     // Continuous conversion (0x00)
-    uint8_t config_magneto[2] = {0x02, 0x00};
-
-    // Select CRA register (0x00)
-    // Data output rate = 15Hz (0x10)
-    uint8_t config_cra[2] = {0x00, 0x10};
-
-    // Select CRB register (0x01)
-    // Set gain = +/- 1.3g (0x20)
-    uint8_t config_crb[2] = {0x01, 0x20};
-
-    while (1) {
-        // Initialize error flags
-        bool accel_error = false;
-        bool magneto_error = false;
-
-        // Write accelerometer configuration
-        if (i2c_write_blocking(i2c0, accelero_addr, config, 2, false) != PICO_ERROR_GENERIC) {
-            if (i2c_write_blocking(i2c0, accelero_addr, config_accel, 2, false) == PICO_ERROR_GENERIC) {
-                printf("Error: Failed to write accelerometer configuration\n");
-                accel_error = true;
-            }
-        } else {
-            printf("Error: Failed to communicate with accelerometer\n");
-            accel_error = true;
-        }
-        sleep_ms(10); // Wait for accelerometer data
-
-        // Read accelerometer data
-        uint8_t reg_accel = 0x28; // X-axis lsb data register
-        if (i2c_write_blocking(i2c0, accelero_addr, &reg_accel, 1, true) != PICO_ERROR_GENERIC) {
-            uint8_t accel_data[6] = {0};
-            if (i2c_read_blocking(i2c0, accelero_addr, accel_data, 6, false) != PICO_ERROR_GENERIC) {
-                int16_t xAccl = (accel_data[1] << 8) | accel_data[0];
-                if (xAccl > 32767) {
-                    xAccl -= 65536;
-                }
-
-                int16_t yAccl = (accel_data[3] << 8) | accel_data[2];
-                if (yAccl > 32767) {
-                    yAccl -= 65536;
-                }
-
-                int16_t zAccl = (accel_data[5] << 8) | accel_data[4];
-                if (zAccl > 32767) {
-                    zAccl -= 65536;
-                }
-
-                // Output accelerometer data
-                printf("Acceleration in X-Axis: %d\n", xAccl);
-                printf("Acceleration in Y-Axis: %d\n", yAccl);
-                printf("Acceleration in Z-Axis: %d\n", zAccl);
-            } else {
-                printf("Error: Failed to read accelerometer data\n");
-                accel_error = true;
-            }
-        } else {
-            printf("Error: Failed to communicate with accelerometer\n");
-            accel_error = true;
+    ok &= write_reg(LSM303_MAG_ADDR, MAG_MR_REG, 0x00);
+
+    return ok;
+}
+
+bool lsm303_read_accel(int16_t accel[3])
+{
+    uint8_t data[6];
+    if (!read_regs(LSM303_ACCEL_ADDR, ACCEL_OUT_X_L | ACCEL_AUTO_INCREMENT, data, 6))
+        return false;
+
+    // Little endian X, Y, Z
+    for (int i = 0; i < 3; i++)
+        accel[i] = (int16_t)((data[2 * i + 1] << 8) | data[2 * i]);
+    return true;
+}
+
+bool lsm303_read_mag(int16_t mag[3])
+{
+    uint8_t data[6];
+    if (!read_regs(LSM303_MAG_ADDR, MAG_OUT_X_H, data, 6))
+        return false;
+
+    // Big endian, and the part orders the axes X, Z, Y
+    mag[0] = (int16_t)((data[0] << 8) | data[1]);
+    mag[2] = (int16_t)((data[2] << 8) | data[3]);
+    mag[1] = (int16_t)((data[4] << 8) | data[5]);
+    return true;
+}
+
+// Background pipeline. A repeating timer starts a poll round; each step is
+// one DMA-driven I2C read whose completion IRQ parses it and starts the next:
+//
+//   ACCEL      STATUS_REG_A and the six output bytes in one auto-increment burst
+//   MAG_STATUS SR_REG_M, every mag_every rounds
+//   MAG_DATA   the six output bytes, only if SR_REG_M flagged a new sample
+typedef enum {
+    PIPE_IDLE,
+    PIPE_ACCEL,
+    PIPE_MAG_STATUS,
+    PIPE_MAG_DATA,
+} pipe_state_t;
+
+static volatile pipe_state_t state = PIPE_IDLE;
+static uint32_t rounds;
+static uint32_t mag_every;
+static struct repeating_timer poll_timer;
+
+// The pool lsm303_start() creates off core 0 only holds the poll timer
+#define LSM303_POLL_TIMERS 1
+
+static uint tx_chan;
+static uint rx_chan;
+static uint32_t commands[8];        // IC_DATA_CMD words: sub-address, then reads
+static uint8_t rx_data[7];
+
+// Seqlock: odd while an IRQ is writing the sample. The writers (the poll
+// timer, the DMA completion and the I2C abort handlers) all run on the core
+// that called lsm303_start() and cannot preempt each other mid-write, so
+// there is only ever one writer and no lock is needed. Readers may run on
+// either core
+static volatile uint32_t sample_seq = 0;
+static lsm303_sample_t sample;
+
+// Queue sub-address + repeated-start read of len bytes. The RX channel is
+// armed first so it is ready for the first byte the TX commands produce
+static void start_read(uint8_t addr, uint8_t reg, uint len)
+{
+    i2c_hw_t *hw = i2c_get_hw(IMU_I2C_PORT);
+
+    // The target address can only change while the block is disabled
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+
+    commands[0] = reg;
+    for (uint i = 1; i <= len; i++)
+        commands[i] = I2C_IC_DATA_CMD_CMD_BITS;
+    commands[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    commands[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    dma_channel_transfer_to_buffer_now(rx_chan, rx_data, len);
+    dma_channel_transfer_from_buffer_now(tx_chan, commands, len + 1);
+}
+
+static void begin_write(void)
+{
+    sample_seq++;
+    __dmb();
+}
+
+static void end_write(void)
+{
+    __dmb();
+    sample_seq++;
+}
+
+static void finish_step(void)
+{
+    switch (state) {
+    case PIPE_ACCEL: {
+        uint8_t status = rx_data[0];
+        begin_write();
+        if (status & ACCEL_STATUS_ZYXOR)
+            sample.accel_overruns++;
+        if (status & ACCEL_STATUS_ZYXDA) {
+            for (int i = 0; i < 3; i++)
+                sample.accel[i] = (int16_t)((rx_data[2 * i + 2] << 8) | rx_data[2 * i + 1]);
+            sample.accel_timestamp_us = time_us_32();
+            sample.accel_sequence++;
         }
+        end_write();
 
-        // Write magnetometer configuration
-        if (i2c_write_blocking(i2c0, magneto_addr, config_magneto, 2, false) != PICO_ERROR_GENERIC) {
-            if (i2c_write_blocking(i2c0, magneto_addr, config_cra, 2, false) == PICO_ERROR_GENERIC) {
-                printf("Error: Failed to write magnetometer configuration\n");
-                magneto_error = true;
-            }
+        if (rounds % mag_every == 0) {
+            state = PIPE_MAG_STATUS;
+            start_read(LSM303_MAG_ADDR, MAG_SR_REG, 1);
         } else {
-            printf("Error: Failed to communicate with magnetometer\n");
-            magneto_error = true;
+            state = PIPE_IDLE;
         }
-        sleep_ms(10); // Wait for magnetometer data
-        
-
-        // Read magnetometer data
-        uint8_t reg_magneto = 0x03; // X-axis msb data register
-        if (i2c_write_blocking(i2c0, magneto_addr, &reg_magneto, 1, true) != PICO_ERROR_GENERIC) {
-            uint8_t magneto_data[6] = {0};
-            if (i2c_read_blocking(i2c0, magneto_addr, magneto_data, 6, false) != PICO_ERROR_GENERIC) {
-                int16_t xMag = (magneto_data[0] << 8) | magneto_data[1];
-                if (xMag > 32767) {
-                    xMag -= 65536;
-                }
-
-                int16_t yMag = (magneto_data[2] << 8) | magneto_data[3];
-                if (yMag > 32767) {
-                    yMag -= 65536;
-                }
-
-                int16_t zMag = (magneto_data[4] << 8) | magneto_data[5];
-                if (zMag > 32767) {
-                    zMag -= 65536;
-                }
-
-                // Output magnetometer data
-                printf("Magnetic field in X-Axis: %d\n", xMag);
-                printf("Magnetic field in Y-Axis: %d\n", yMag);
-                printf("Magnetic field in Z-Axis: %d\n", zMag);
-            } else {
-                printf("Error: Failed to read magnetometer data\n");
-                magneto_error = true;
-            }
+        break;
+    }
+    case PIPE_MAG_STATUS:
+        if (rx_data[0] & MAG_SR_DRDY) {
+            state = PIPE_MAG_DATA;
+            start_read(LSM303_MAG_ADDR, MAG_OUT_X_H, 6);
         } else {
-            printf("Error: Failed to communicate with magnetometer\n");
-            magneto_error = true;
+            state = PIPE_IDLE;
         }
+        break;
+    case PIPE_MAG_DATA:
+        begin_write();
+        // Big endian, and the part orders the axes X, Z, Y
+        sample.mag[0] = (int16_t)((rx_data[0] << 8) | rx_data[1]);
+        sample.mag[2] = (int16_t)((rx_data[2] << 8) | rx_data[3]);
+        sample.mag[1] = (int16_t)((rx_data[4] << 8) | rx_data[5]);
+        sample.mag_timestamp_us = time_us_32();
+        sample.mag_sequence++;
+        end_write();
+        state = PIPE_IDLE;
+        break;
+    default:
+        break;
+    }
+}
 
-        // Check for potential errors
-        if (accel_error || magneto_error) {
-            printf("Potential errors detected.\n");
-        }
+static void lsm303_dma_handler(void)
+{
+    if (!dma_channel_get_irq1_status(rx_chan))
+        return;
+    dma_channel_acknowledge_irq1(rx_chan);
+    finish_step();
+}
+
+// A NACK or lost arbitration flushes the TX FIFO, so the RX channel would
+// never complete: stop both channels and give up on this round
+static void lsm303_i2c_handler(void)
+{
+    i2c_hw_t *hw = i2c_get_hw(IMU_I2C_PORT);
+    if (!(hw->intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS))
+        return;
+
+    // Aborting can raise a spurious completion IRQ, so mask it meanwhile
+    dma_channel_set_irq1_enabled(rx_chan, false);
+    dma_channel_abort(tx_chan);
+    dma_channel_abort(rx_chan);
+    dma_channel_acknowledge_irq1(rx_chan);
+    dma_channel_set_irq1_enabled(rx_chan, true);
+
+    (void)hw->clr_tx_abrt;
+    while (hw->rxflr)
+        (void)hw->data_cmd;
 
-        sleep_ms(1000); // Wait for the next reading
+    begin_write();
+    sample.errors++;
+    end_write();
+    state = PIPE_IDLE;
+}
+
+static bool lsm303_poll(__unused struct repeating_timer *t)
+{
+    if (state != PIPE_IDLE) {
+        begin_write();
+        sample.busy_polls++;
+        end_write();
+        return true;
     }
 
-    return 0;
+    rounds++;
+    state = PIPE_ACCEL;
+    start_read(LSM303_ACCEL_ADDR, ACCEL_STATUS_REG | ACCEL_AUTO_INCREMENT, 7);
+    return true;
+}
+
+void lsm303_start(void)
+{
+    i2c_hw_t *hw = i2c_get_hw(IMU_I2C_PORT);
+
+    // Poll at twice the accelerometer rate so no sample is missed, and the
+    // magnetometer at twice its own (much lower) rate
+    uint32_t accel_hz = accel_odr_hz[config.accel_odr] ? accel_odr_hz[config.accel_odr] : 1;
+    uint32_t poll_us = 1000000 / (2 * accel_hz);
+    if (poll_us < LSM303_MIN_POLL_US)
+        poll_us = LSM303_MIN_POLL_US;
+    mag_every = (uint32_t)(500000000ull / ((uint64_t)mag_odr_mhz[config.mag_odr] * poll_us));
+    if (mag_every == 0)
+        mag_every = 1;
+    rounds = 0;
+
+    tx_chan = dma_claim_unused_channel(true);
+    rx_chan = dma_claim_unused_channel(true);
+
+    // Commands are 32-bit writes to IC_DATA_CMD; received bytes are read back from it
+    dma_channel_config c = dma_channel_get_default_config(tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(IMU_I2C_PORT, true));
+    dma_channel_configure(tx_chan, &c, &hw->data_cmd, commands, 0, false);
+
+    c = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, i2c_get_dreq(IMU_I2C_PORT, false));
+    dma_channel_configure(rx_chan, &c, rx_data, &hw->data_cmd, 0, false);
+    dma_channel_set_irq1_enabled(rx_chan, true);
+
+    irq_add_shared_handler(DMA_IRQ_1, lsm303_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    uint i2c_irq = I2C0_IRQ + i2c_hw_index(IMU_I2C_PORT);
+    irq_set_exclusive_handler(i2c_irq, lsm303_i2c_handler);
+    irq_set_enabled(i2c_irq, true);
+
+    // The poll timer writes the sample too, so it must fire on this core like
+    // the IRQs above. The default alarm pool's alarms fire on core 0
+    alarm_pool_t *pool = alarm_pool_get_default();
+    if (alarm_pool_core_num(pool) != get_core_num())
+        pool = alarm_pool_create_with_unused_hardware_alarm(LSM303_POLL_TIMERS);
+    alarm_pool_add_repeating_timer_us(pool, -(int64_t)poll_us, lsm303_poll, NULL, &poll_timer);
+}
+
+void lsm303_get_sample(lsm303_sample_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = sample_seq;
+        __dmb();
+        *out = sample;
+        __dmb();
+    } while ((seq & 1) || seq != sample_seq);
 }
@@ -0,0 +1,85 @@
+#ifndef MAGNETOMETER_H
+#define MAGNETOMETER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hardware/i2c.h"
+#include "board_pins.h"
+
+#define LSM303_I2C_BAUD 400000 // 400 kHz
+
+// LSM303DLHC ACCELERO I2C address is 0x32 (50) for writing, 0x33 (51) for reading
+#define LSM303_ACCEL_ADDR 0x19
+
+// LSM303DLHC MAGNETO I2C address is 0x3C (60) for writing, 0x3D (61) for reading
+#define LSM303_MAG_ADDR 0x1E
+
+// Shortest poll period: one accelerometer and one magnetometer burst at 400 kHz
+#define LSM303_MIN_POLL_US 500
+
+// Accelerometer output data rate (CTRL_REG1_A ODR field, normal power mode).
+// The part also does 1344 Hz, but polling at twice that would need a round
+// every 372 us, shorter than LSM303_MIN_POLL_US
+typedef enum {
+    LSM303_ACCEL_ODR_1HZ = 1,
+    LSM303_ACCEL_ODR_10HZ,
+    LSM303_ACCEL_ODR_25HZ,
+    LSM303_ACCEL_ODR_50HZ,
+    LSM303_ACCEL_ODR_100HZ,
+    LSM303_ACCEL_ODR_200HZ,
+    LSM303_ACCEL_ODR_400HZ,
+} lsm303_accel_odr_t;
+
+// Magnetometer output data rate (CRA_REG_M DO field)
+typedef enum {
+    LSM303_MAG_ODR_0_75HZ = 0,
+    LSM303_MAG_ODR_1_5HZ,
+    LSM303_MAG_ODR_3HZ,
+    LSM303_MAG_ODR_7_5HZ,
+    LSM303_MAG_ODR_15HZ,
+    LSM303_MAG_ODR_30HZ,
+    LSM303_MAG_ODR_75HZ,
+    LSM303_MAG_ODR_220HZ,
+} lsm303_mag_odr_t;
+
+typedef struct {
+    lsm303_accel_odr_t accel_odr;
+    lsm303_mag_odr_t mag_odr;
+} lsm303_config_t;
+
+#define LSM303_DEFAULT_CONFIG { LSM303_ACCEL_ODR_100HZ, LSM303_MAG_ODR_75HZ }
+
+// Latest samples from the background pipeline. Each part has its own
+// sequence number, bumped whenever that part delivers a new sample
+typedef struct {
+    int16_t accel[3];           // raw X/Y/Z counts
+    int16_t mag[3];
+    uint32_t accel_timestamp_us;
+    uint32_t mag_timestamp_us;
+    uint32_t accel_sequence;
+    uint32_t mag_sequence;
+    uint32_t accel_overruns;    // samples the part overwrote before we read them
+    uint32_t busy_polls;        // polls skipped because the last one was still on the bus
+    uint32_t errors;            // aborted I2C transfers (NACK, arbitration lost)
+} lsm303_sample_t;
+
+// Set up I2C and write the accelerometer and magnetometer configuration once.
+// NULL selects LSM303_DEFAULT_CONFIG. Returns false if either part does not answer
+bool lsm303_init(const lsm303_config_t *config);
+
+// Raw X/Y/Z counts, read with blocking I2C. Return false on an I2C error.
+// Only for use before lsm303_start()
+bool lsm303_read_accel(int16_t accel[3]);
+bool lsm303_read_mag(int16_t mag[3]);
+
+// Poll both parts' data-ready status from a timer and burst-read new samples
+// with DMA, so no CPU time is spent waiting on the bus. The poll rate follows
+// the configured data rates (twice the fastest, at most every LSM303_MIN_POLL_US).
+// The timer and the interrupts all run on the calling core; on core 1 that
+// takes a hardware alarm for a second alarm pool
+void lsm303_start(void);
+
+// Copy out the latest samples. Safe from thread context while the pipeline runs
+void lsm303_get_sample(lsm303_sample_t *out);
+
+#endif
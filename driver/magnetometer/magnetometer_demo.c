@@ -0,0 +1,118 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "compass.h"
+#include "fixed_trig.h"
+#include "magnetometer.h"
+
+// Turn the board through a full circle by hand within this time at startup
+#define CALIBRATION_MS 15000
+
+#define BENCH_ITERATIONS 10000
+
+// Time atan2f against the CORDIC atan2 over the same inputs and report the
+// worst disagreement
+static void benchmark_atan2(void) {
+    volatile float float_sink = 0;
+    volatile q16_t fixed_sink = 0;
+    float max_error = 0;
+
+    uint32_t start = time_us_32();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        float_sink += atan2f((float)(i % 1000 - 500), (float)(i % 777 - 388));
+    }
+    uint32_t float_us = time_us_32() - start;
+
+    start = time_us_32();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        fixed_sink += q16_atan2_deg(i % 1000 - 500, i % 777 - 388);
+    }
+    uint32_t fixed_us = time_us_32() - start;
+
+    for (int i = 0; i < 1000; i++) {
+        float expected = atan2f((float)(i % 1000 - 500), (float)(i % 777 - 388)) * (180.0f / (float)M_PI);
+        float error = fabsf(q16_atan2_deg(i % 1000 - 500, i % 777 - 388) / 65536.0f - expected);
+        if (error > 180.0f) {
+            error = 360.0f - error;
+        }
+        if (error > max_error) {
+            max_error = error;
+        }
+    }
+
+    printf("atan2f: %.3f us/call, CORDIC: %.3f us/call, max error %.4f deg\n",
+           (float)float_us / BENCH_ITERATIONS, (float)fixed_us / BENCH_ITERATIONS, max_error);
+}
+
+int main() {
+    stdio_init_all();
+
+    // Initialize I2C and configure both parts once
+    lsm303_config_t config = LSM303_DEFAULT_CONFIG;
+    if (!lsm303_init(&config)) {
+        printf("Error: Failed to configure LSM303DLHC\n");
+    }
+
+    benchmark_atan2();
+
+    // From here on samples arrive in the background
+    lsm303_start();
+
+    uint32_t last_accel = 0;
+    uint32_t last_mag = 0;
+
+    // Hard/soft-iron calibration while the board is turned by hand
+    printf("Compass calibration: turn the board through a full circle\n");
+    compass_calibration_t cal;
+    compass_cal_begin(&cal);
+    absolute_time_t cal_end = make_timeout_time_ms(CALIBRATION_MS);
+    while (!time_reached(cal_end)) {
+        lsm303_sample_t sample;
+        lsm303_get_sample(&sample);
+        if (sample.mag_sequence != last_mag) {
+            last_mag = sample.mag_sequence;
+            compass_cal_add(&cal, sample.mag);
+        }
+    }
+    if (!compass_cal_finish(&cal)) {
+        printf("Compass calibration failed: not turned far enough, using defaults\n");
+    }
+    printf("Compass offsets %d %d %d\n", cal.offset[0], cal.offset[1], cal.offset[2]);
+
+    while (1) {
+        lsm303_sample_t sample;
+        lsm303_get_sample(&sample);
+
+        if (sample.accel_sequence != last_accel) {
+            // Output accelerometer data
+            printf("Acceleration in X-Axis: %d\n", sample.accel[0]);
+            printf("Acceleration in Y-Axis: %d\n", sample.accel[1]);
+            printf("Acceleration in Z-Axis: %d\n", sample.accel[2]);
+            printf("Accelerometer samples: %lu\n", (unsigned long)(sample.accel_sequence - last_accel));
+            last_accel = sample.accel_sequence;
+        }
+
+        if (sample.mag_sequence != last_mag) {
+            // Output magnetometer data
+            printf("Magnetic field in X-Axis: %d\n", sample.mag[0]);
+            printf("Magnetic field in Y-Axis: %d\n", sample.mag[1]);
+            printf("Magnetic field in Z-Axis: %d\n", sample.mag[2]);
+            printf("Magnetometer samples: %lu\n", (unsigned long)(sample.mag_sequence - last_mag));
+            last_mag = sample.mag_sequence;
+
+            // Tilt-compensated heading
+            q16_t heading = compass_heading(&cal, sample.accel, sample.mag);
+            printf("Heading: %.1f deg\n", heading / 65536.0f);
+        }
+
+        if (sample.errors || sample.accel_overruns) {
+            printf("I2C errors: %lu, accelerometer overruns: %lu\n",
+                   (unsigned long)sample.errors, (unsigned long)sample.accel_overruns);
+        }
+
+        sleep_ms(1000); // Wait for the next report
+    }
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "motor.h"
+
+void motor_init(void)
+{
+    // Direction pins: outputs, all low (motors coasting)
+    gpio_init_mask(MOTOR_DIR_MASK);
+    gpio_set_dir_out_masked(MOTOR_DIR_MASK);
+    gpio_clr_mask(MOTOR_DIR_MASK);
+
+    gpio_set_function(MOTOR_PWM_RIGHT_PIN, GPIO_FUNC_PWM);
+    gpio_set_function(MOTOR_PWM_LEFT_PIN, GPIO_FUNC_PWM);
+
+    // Here I am creating 2 PWM, that way we can control both wheels at
+    // different speed. Example for turning.
+    uint slice_right = pwm_gpio_to_slice_num(MOTOR_PWM_RIGHT_PIN);
+    uint slice_left = pwm_gpio_to_slice_num(MOTOR_PWM_LEFT_PIN);
+
+    pwm_set_clkdiv(slice_right, MOTOR_PWM_CLKDIV);
+    pwm_set_wrap(slice_right, MOTOR_PWM_WRAP);
+    pwm_set_clkdiv(slice_left, MOTOR_PWM_CLKDIV);
+    pwm_set_wrap(slice_left, MOTOR_PWM_WRAP);
+
+    motor_stop();
+
+    pwm_set_enabled(slice_right, true);
+    pwm_set_enabled(slice_left, true);
+}
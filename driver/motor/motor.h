@@ -0,0 +1,54 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+#include "board_pins.h"
+#include "fixed.h"
+
+// PWM clock divider and wrap value (full duty cycle)
+#define MOTOR_PWM_CLKDIV 100
+#define MOTOR_PWM_WRAP 12500
+
+#define MOTOR_DIR_MASK ((1u << MOTOR_DIR_R01_PIN) | (1u << MOTOR_DIR_R02_PIN) | \
+                        (1u << MOTOR_DIR_L01_PIN) | (1u << MOTOR_DIR_L02_PIN))
+
+// Pins are compile-time constants, so the slice and channel lookups below
+// fold away. When both PWM pins share a slice one register write sets both
+#define MOTOR_PWM_SHARED_SLICE ((MOTOR_PWM_RIGHT_PIN >> 1) == (MOTOR_PWM_LEFT_PIN >> 1))
+
+// Set up the direction pins and PWM slices, motors stopped
+void motor_init(void);
+
+// Set both wheels at once from signed duty cycles (-1..1 in Q16.16). The
+// sign drives the direction pins, the magnitude the PWM level. Inline so
+// control loops get a couple of register writes and no call
+static inline void motor_set_duty(q16_t left_duty, q16_t right_duty)
+{
+    uint16_t right_level = (uint16_t)q16_to_int(q16_abs(right_duty) * MOTOR_PWM_WRAP);
+    uint16_t left_level = (uint16_t)q16_to_int(q16_abs(left_duty) * MOTOR_PWM_WRAP);
+
+#if MOTOR_PWM_SHARED_SLICE && (MOTOR_PWM_RIGHT_PIN & 1) == 0
+    pwm_set_both_levels(pwm_gpio_to_slice_num(MOTOR_PWM_RIGHT_PIN), right_level, left_level);
+#elif MOTOR_PWM_SHARED_SLICE
+    pwm_set_both_levels(pwm_gpio_to_slice_num(MOTOR_PWM_LEFT_PIN), left_level, right_level);
+#else
+    pwm_set_gpio_level(MOTOR_PWM_RIGHT_PIN, right_level);
+    pwm_set_gpio_level(MOTOR_PWM_LEFT_PIN, left_level);
+#endif
+
+    // All four direction pins in one SIO write
+    uint32_t dir = 0;
+    if (right_duty > 0) dir |= 1u << MOTOR_DIR_R01_PIN;
+    if (right_duty < 0) dir |= 1u << MOTOR_DIR_R02_PIN;
+    if (left_duty > 0) dir |= 1u << MOTOR_DIR_L01_PIN;
+    if (left_duty < 0) dir |= 1u << MOTOR_DIR_L02_PIN;
+    gpio_put_masked(MOTOR_DIR_MASK, dir);
+}
+
+static inline void motor_stop(void)
+{
+    motor_set_duty(0, 0);
+}
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Include necessary libraries and header files
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "motor.h"
+
+int main() {
+    // Initialize standard I/O
+    stdio_init_all();
+
+    // Direction pins, PWM slices, motors stopped
+    motor_init();
+
+    // Main control loop
+    while(1) {
+        // Forward motion at full duty
+        motor_set_duty(Q16_ONE, Q16_ONE);
+
+        // Wait for a specified duration (4000 milliseconds)
+        sleep_ms(4000);
+
+        // Backward motion at half duty
+        motor_set_duty(-Q16_ONE / 2, -Q16_ONE / 2);
+
+        // Wait for a specified duration (4000 milliseconds)
+        sleep_ms(4000);
+
+        // Right motor backward, left motor stopped (turn left)
+        motor_set_duty(0, -Q16_ONE / 2);
+
+        // Wait for a specified duration (4000 milliseconds)
+        sleep_ms(4000);
+
+        // Left motor forward, right motor stopped (turn right)
+        motor_set_duty(Q16_ONE / 2, 0);
+
+        // Wait for a specified duration (2000 milliseconds)
+        sleep_ms(2000); 
+    }
+}
@@ -1,74 +1,147 @@
+#include "ultrasonic.h"
 #include "pico/stdlib.h"
-#include <stdio.h>
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "hardware/timer.h"
 
-int timeout = 30000; // Increase the timeout to handle longer distances
+// Speed of sound in air = 343 m/s, halved for the round trip
+#define CM_PER_US 0.01715f
 
-void setupUltrasonicPins(uint trigPin, uint echoPin)
+typedef enum {
+    STATE_IDLE = 0,
+    STATE_WAIT_RISE,    // trigger sent, waiting for the echo to start
+    STATE_WAIT_FALL,    // echo high, waiting for it to end
+} ping_state_t;
+
+static uint trigger_pin;
+static uint echo_pin;
+
+static volatile ping_state_t state = STATE_IDLE;
+static volatile uint32_t trigger_time;
+static volatile uint32_t rise_time;
+static volatile uint32_t finish_time;
+
+// Result ring written from the IRQ (and from poll() with interrupts off),
+// read by poll(). Indices only ever increase; count must be a power of two
+static ultrasonic_result_t results[ULTRASONIC_RESULT_COUNT];
+static volatile uint32_t result_head = 0;
+static volatile uint32_t result_tail = 0;
+static volatile uint32_t dropped = 0;
+
+// Must be called with the echo IRQ unable to preempt (inside the IRQ or with
+// interrupts disabled)
+static void push_result(ultrasonic_status_t status, uint32_t now, uint32_t pulse_us)
 {
-    gpio_init(trigPin);
-    gpio_init(echoPin);
-    gpio_set_dir(trigPin, GPIO_OUT);
-    gpio_set_dir(echoPin, GPIO_IN);
+    uint32_t head = result_head;
+    if (head - result_tail == ULTRASONIC_RESULT_COUNT) {
+        // Keep the newest reading, the control loop cares about now
+        result_tail++;
+        dropped++;
+    }
+
+    ultrasonic_result_t *r = &results[head % ULTRASONIC_RESULT_COUNT];
+    r->status = status;
+    r->timestamp_us = now;
+    r->pulse_us = pulse_us;
+    r->distance_cm = 0;
+    result_head = head + 1;
+    finish_time = now;
+    state = STATE_IDLE;
 }
 
-uint64_t getPulse(uint trigPin, uint echoPin)
+static void echo_irq_handler(void)
 {
-    gpio_put(trigPin, 1);
-    sleep_us(10);
-    gpio_put(trigPin, 0);
-
-    uint64_t width = 0;
-
-    while (gpio_get(echoPin) == 0) tight_loop_contents();
-    absolute_time_t startTime = get_absolute_time();
-    while (gpio_get(echoPin) == 1)
-    {
-        width++;
-        sleep_us(1);
-        if (width > timeout)
-            return 0;
+    uint32_t events = gpio_get_irq_event_mask(echo_pin);
+    if (!(events & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)))
+        return;
+    gpio_acknowledge_irq(echo_pin, events);
+
+    uint32_t now = time_us_32();
+
+    // Both edges may be latched if the echo was very short, handle rise first
+    if ((events & GPIO_IRQ_EDGE_RISE) && state == STATE_WAIT_RISE) {
+        rise_time = now;
+        state = STATE_WAIT_FALL;
     }
-    absolute_time_t endTime = get_absolute_time();
+    if ((events & GPIO_IRQ_EDGE_FALL) && state == STATE_WAIT_FALL) {
+        // poll() may not have run in time to expire an over-long echo
+        uint32_t pulse_us = now - rise_time;
+        if (pulse_us > ULTRASONIC_ECHO_TIMEOUT_US)
+            push_result(ULTRASONIC_ERR_TIMEOUT, now, 0);
+        else
+            push_result(ULTRASONIC_OK, now, pulse_us);
+    }
+}
 
-    return absolute_time_diff_us(startTime, endTime);
+void ultrasonic_init(uint trig_pin, uint echo)
+{
+    trigger_pin = trig_pin;
+    echo_pin = echo;
+
+    gpio_init(trigger_pin);
+    gpio_init(echo_pin);
+    gpio_set_dir(trigger_pin, GPIO_OUT);
+    gpio_set_dir(echo_pin, GPIO_IN);
+    gpio_put(trigger_pin, 0);
+
+    // Raw handler so the echo pin does not fight other drivers over the
+    // single gpio_set_irq_enabled_with_callback() callback
+    gpio_add_raw_irq_handler(echo_pin, echo_irq_handler);
+    gpio_set_irq_enabled(echo_pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
 }
 
-float getCm(uint trigPin, uint echoPin)
+bool ultrasonic_start(void)
 {
-    uint64_t pulseLength = getPulse(trigPin, echoPin);
-    if (pulseLength == 0)
-        return -1.0; // Error condition
+    if (state != STATE_IDLE)
+        return false;
+    if (time_us_32() - finish_time < ULTRASONIC_PING_INTERVAL_US)
+        return false;
 
-    // Calculate the distance in centimeters
-    float distance_cm = (float)pulseLength * 0.01715; // Speed of sound in air = 343 m/s
+    // Arm before triggering so the rising edge can never be missed
+    trigger_time = time_us_32();
+    state = STATE_WAIT_RISE;
 
-    return distance_cm;
+    // 10 us trigger pulse; short enough to busy-wait
+    gpio_put(trigger_pin, 1);
+    busy_wait_us_32(10);
+    gpio_put(trigger_pin, 0);
+    return true;
 }
 
-int main()
+bool ultrasonic_busy(void)
 {
-    const uint trigPin = 12; 
-    const uint echoPin = 13; 
+    return state != STATE_IDLE;
+}
 
-    stdio_init_all();
+bool ultrasonic_poll(ultrasonic_result_t *result)
+{
+    // Expire a ping that has been in flight for too long. Interrupts are off
+    // so the echo IRQ cannot complete the same ping underneath us
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t now = time_us_32();
+    if (state == STATE_WAIT_RISE && now - trigger_time > ULTRASONIC_RISE_TIMEOUT_US) {
+        push_result(ULTRASONIC_ERR_NO_ECHO, now, 0);
+    } else if (state == STATE_WAIT_FALL && now - rise_time > ULTRASONIC_ECHO_TIMEOUT_US) {
+        push_result(ULTRASONIC_ERR_TIMEOUT, now, 0);
+    }
 
-    setupUltrasonicPins(trigPin, echoPin);
+    bool have_result = result_tail != result_head;
+    if (have_result) {
+        *result = results[result_tail % ULTRASONIC_RESULT_COUNT];
+        result_tail++;
+    }
+    restore_interrupts(irq_state);
 
-    while (1)
-    {
-        float distance_cm = getCm(trigPin, echoPin);
-        if (distance_cm >= 0)
-        {
-            printf("Distance: %.2f cm\n", distance_cm);
-        }
-        else
-        {
-            printf("Error reading distance\n");
-        }
-        sleep_ms(1000); // Update the distance every second
+    if (have_result && result->status == ULTRASONIC_OK) {
+        // Float math stays out of the IRQ
+        result->distance_cm = (float)result->pulse_us * CM_PER_US;
     }
+    return have_result;
+}
 
-    return 0;
+uint32_t ultrasonic_dropped(void)
+{
+    return dropped;
 }
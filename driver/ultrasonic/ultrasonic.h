@@ -0,0 +1,53 @@
+#ifndef ULTRASONIC_H
+#define ULTRASONIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+
+// Echo must start within this long after the trigger, otherwise the sensor
+// never answered (unplugged, broken wire, ...)
+#define ULTRASONIC_RISE_TIMEOUT_US 5000
+
+// Longest echo we accept (~5 m). The HC-SR04 holds echo high for ~38 ms when
+// nothing is in range, so anything longer is reported as out of range
+#define ULTRASONIC_ECHO_TIMEOUT_US 30000
+
+// Minimum gap between the end of one ping and the next trigger, so a late
+// echo from the previous ping is not mistaken for the new one
+#define ULTRASONIC_PING_INTERVAL_US 60000
+
+// Number of finished readings buffered between the IRQ and the control loop
+#define ULTRASONIC_RESULT_COUNT 4
+
+typedef enum {
+    ULTRASONIC_OK = 0,
+    ULTRASONIC_ERR_NO_ECHO,     // echo never went high after the trigger
+    ULTRASONIC_ERR_TIMEOUT,     // echo went high but did not fall in time
+} ultrasonic_status_t;
+
+typedef struct {
+    ultrasonic_status_t status;
+    uint32_t timestamp_us;      // time_us_32() when the reading finished
+    uint32_t pulse_us;          // echo high time, 0 on error
+    float distance_cm;          // only valid when status == ULTRASONIC_OK
+} ultrasonic_result_t;
+
+// Configure the trigger/echo pins and hook the echo edges into the GPIO IRQ
+void ultrasonic_init(uint trig_pin, uint echo_pin);
+
+// Fire a ping. Returns false (and does nothing) if a ping is still in flight
+// or the previous one finished less than ULTRASONIC_PING_INTERVAL_US ago
+bool ultrasonic_start(void);
+
+// True while a ping has been fired and its result is not yet in the buffer
+bool ultrasonic_busy(void);
+
+// Expire timed-out pings and pop the oldest finished reading, if any.
+// Never blocks; returns false when there is nothing new
+bool ultrasonic_poll(ultrasonic_result_t *result);
+
+// Number of readings lost because the control loop did not poll in time
+uint32_t ultrasonic_dropped(void);
+
+#endif
@@ -0,0 +1,37 @@
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include "board_pins.h"
+#include "ultrasonic.h"
+
+int main()
+{
+    stdio_init_all();
+
+    ultrasonic_init(ULTRASONIC_TRIGGER_PIN, ULTRASONIC_ECHO_PIN);
+
+    while (1)
+    {
+        // Fire a ping whenever the previous one has finished
+        ultrasonic_start();
+
+        ultrasonic_result_t result;
+        if (ultrasonic_poll(&result))
+        {
+            if (result.status == ULTRASONIC_OK)
+            {
+                printf("Distance: %.2f cm\n", result.distance_cm);
+            }
+            else if (result.status == ULTRASONIC_ERR_TIMEOUT)
+            {
+                printf("Out of range\n");
+            }
+            else
+            {
+                printf("Error reading distance\n");
+            }
+            sleep_ms(1000); // Update the distance every second
+        }
+    }
+
+    return 0;
+}
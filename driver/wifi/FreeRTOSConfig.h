@@ -75,16 +75,25 @@
 #define configTOTAL_HEAP_SIZE                   (128*1024)
 #define configAPPLICATION_ALLOCATED_HEAP        0
 
-/* Hook function related definitions. */
-#define configCHECK_FOR_STACK_OVERFLOW          0
+/* Hook function related definitions. runtime_stats.c has the overflow hook */
+#define configCHECK_FOR_STACK_OVERFLOW          2
 #define configUSE_MALLOC_FAILED_HOOK            0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
-/* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+/* Run time and task stats gathering related definitions. Run time is
+counted in microseconds by the RP2040 timer, which is always running, and
+read by runtime_stats.c; the kernel's text formatting is left out */
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+extern uint64_t time_us_64(void);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        ( ( uint32_t ) time_us_64() )
+
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
 #define configMAX_CO_ROUTINE_PRIORITIES         1
@@ -103,11 +112,13 @@
 */
 
 #if FREE_RTOS_KERNEL_SMP // set by the RP2040 SMP port of FreeRTOS
-/* SMP port only */
+/* SMP port only. The ROBOT_SMP build option sets configNUM_CORES to 2 */
+#ifndef configNUM_CORES
 #define configNUM_CORES                         1
+#endif
 #define configTICK_CORE                         0
 #define configRUN_MULTIPLE_PRIORITIES           1
-#define configUSE_CORE_AFFINITY                 0
+#define configUSE_CORE_AFFINITY                 ( configNUM_CORES > 1 )
 #endif
 
 /* RP2040 specific */
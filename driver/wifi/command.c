@@ -0,0 +1,145 @@
+#include <string.h>
+#include "command.h"
+#include "pico/cyw43_arch.h"
+#include "pico/time.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+
+static struct udp_pcb *udp;
+static struct tcp_pcb *listener;
+
+// The one TCP client, and the part of a frame its stream has delivered so far
+static struct tcp_pcb *client;
+static uint8_t partial[COMMAND_FRAME_SIZE];
+static uint partial_length;
+
+static void udp_received(__unused void *arg, struct udp_pcb *pcb, struct pbuf *p,
+                         const ip_addr_t *addr, u16_t port)
+{
+    uint32_t received_us = time_us_32();
+    uint8_t frame[COMMAND_FRAME_SIZE];
+
+    // A datagram of any other size is only counted
+    u16_t length = p->tot_len;
+    if (length == COMMAND_FRAME_SIZE)
+        pbuf_copy_partial(p, frame, COMMAND_FRAME_SIZE, 0);
+    pbuf_free(p);
+
+    if (!command_handle(frame, length, received_us))
+        return;
+
+    struct pbuf *ack = pbuf_alloc(PBUF_TRANSPORT, COMMAND_FRAME_SIZE, PBUF_RAM);
+    if (!ack) {
+        command_count_ack_error();
+        return;
+    }
+    memcpy(ack->payload, frame, COMMAND_FRAME_SIZE);
+    if (udp_sendto(pcb, ack, addr, port) != ERR_OK)
+        command_count_ack_error();
+    pbuf_free(ack);
+}
+
+static void tcp_drop_client(void)
+{
+    if (client) {
+        tcp_arg(client, NULL);
+        tcp_recv(client, NULL);
+        tcp_err(client, NULL);
+        if (tcp_close(client) != ERR_OK)
+            tcp_abort(client);
+        client = NULL;
+    }
+}
+
+static err_t tcp_received(__unused void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+    if (!p) {
+        // Closed by the client
+        tcp_drop_client();
+        return ERR_OK;
+    }
+
+    uint32_t received_us = time_us_32();
+    bool acked = false;
+    for (struct pbuf *q = p; q; q = q->next) {
+        const uint8_t *data = q->payload;
+        for (u16_t i = 0; i < q->len; i++) {
+            partial[partial_length++] = data[i];
+            if (partial_length < COMMAND_FRAME_SIZE)
+                continue;
+            partial_length = 0;
+
+            if (command_handle(partial, COMMAND_FRAME_SIZE, received_us)) {
+                if (tcp_write(pcb, partial, COMMAND_FRAME_SIZE, TCP_WRITE_FLAG_COPY) == ERR_OK)
+                    acked = true;
+                else
+                    command_count_ack_error();
+            } else if (partial[0] != COMMAND_MAGIC) {
+                // Lost frame alignment: the stream cannot be trusted any more
+                tcp_recved(pcb, p->tot_len);
+                pbuf_free(p);
+                tcp_abort(pcb);
+                client = NULL;
+                return ERR_ABRT;
+            }
+        }
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    if (acked)
+        tcp_output(pcb);
+    return ERR_OK;
+}
+
+static void tcp_failed(__unused void *arg, __unused err_t err)
+{
+    // The pcb is already gone
+    client = NULL;
+}
+
+static err_t tcp_accepted(__unused void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    if (err != ERR_OK || !pcb)
+        return ERR_VAL;
+
+    // The newest client wins: a stale connection must not lock the car out
+    tcp_drop_client();
+    client = pcb;
+    partial_length = 0;
+
+    // Acks are tiny and latency is the point
+    tcp_nagle_disable(pcb);
+    tcp_recv(pcb, tcp_received);
+    tcp_err(pcb, tcp_failed);
+    return ERR_OK;
+}
+
+bool command_server_start(uint16_t port, uint8_t opcode_count)
+{
+    command_queue_init(opcode_count);
+    bool ok = false;
+
+    cyw43_arch_lwip_begin();
+    udp = udp_new();
+    struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_ANY);
+    if (udp && pcb && udp_bind(udp, IP_ANY_TYPE, port) == ERR_OK &&
+        tcp_bind(pcb, IP_ANY_TYPE, port) == ERR_OK) {
+        udp_recv(udp, udp_received, NULL);
+        listener = tcp_listen_with_backlog(pcb, 1);
+        if (listener) {
+            tcp_accept(listener, tcp_accepted);
+            ok = true;
+        }
+    }
+    if (!ok) {
+        if (udp)
+            udp_remove(udp);
+        if (pcb && !listener)
+            tcp_close(pcb);
+        udp = NULL;
+    }
+    cyw43_arch_lwip_end();
+    return ok;
+}
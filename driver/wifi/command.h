@@ -0,0 +1,52 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "command_codec.h"
+
+// Remote command server on UDP and TCP (one client at a time), both on the
+// same port. Frames are checked and acknowledged in lwIP's thread as they
+// arrive; pings are answered there, everything else goes into a lock-free
+// queue for the task that owns the motion layer. The checks and the queue
+// (command_queue.c) leave lwIP to command.c, so they build on the host too.
+
+#define COMMAND_QUEUE_SIZE 16       // power of two
+
+typedef struct {
+    uint8_t opcode;
+    uint32_t sequence;
+    int32_t arg[2];
+    uint32_t received_us;   // time_us_32() when the frame arrived
+} command_t;
+
+typedef struct {
+    uint32_t received;      // well-formed command frames
+    uint32_t malformed;     // wrong size, magic or an ack
+    uint32_t unknown;       // opcode not below opcode_count
+    uint32_t busy;          // queue full
+    uint32_t ack_errors;    // ack could not be sent
+} command_stats_t;
+
+// Listen on port for opcodes below opcode_count (COMMAND_OPCODE_COUNT for
+// all of them). wifi_connect() must have succeeded
+bool command_server_start(uint16_t port, uint8_t opcode_count);
+
+// Next queued command, oldest first. Single consumer
+bool command_receive(command_t *command);
+
+void command_get_stats(command_stats_t *stats);
+
+// Transport side. command_server_start() calls command_queue_init(), which
+// empties the queue and the stats
+void command_queue_init(uint8_t opcode_count);
+
+// Check one received frame of length bytes, queue it and turn it into its
+// ack in place. False if it is not a command (wrong size or magic, or an
+// ack), which gets no ack. Single producer
+bool command_handle(uint8_t frame[COMMAND_FRAME_SIZE], size_t length, uint32_t received_us);
+
+void command_count_ack_error(void);
+
+#endif
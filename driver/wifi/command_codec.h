@@ -0,0 +1,82 @@
+#ifndef COMMAND_CODEC_H
+#define COMMAND_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "byte_order.h"
+
+// Remote command frames, shared by the firmware and the host client
+// (tools/command_client.c), so it only uses the C standard library.
+//
+// Every frame, command or acknowledgement, is COMMAND_FRAME_SIZE bytes, one
+// per UDP datagram or back to back on a TCP stream. Little endian:
+//   0  u8  magic           COMMAND_MAGIC
+//   1  u8  opcode
+//   2  u8  flags           COMMAND_FLAG_ACK on replies
+//   3  u8  status          command_status_t, replies only
+//   4  u32 sequence        chosen by the client, echoed in the ack
+//   8  u32 client_time_us  chosen by the client, echoed: round-trip time
+//   12 i32 arg[0]          in an ack: robot time from receipt to the ack, us
+//   16 i32 arg[1]
+
+#define COMMAND_PORT 5006
+#define COMMAND_MAGIC 0xA5
+#define COMMAND_FRAME_SIZE 20
+#define COMMAND_FLAG_ACK 0x01
+
+// Arguments are Q16.16 in the units of the motion layer
+typedef enum {
+    COMMAND_PING = 0,       // ack only
+    COMMAND_STOP,           // abort any maneuver and hold, manual mode
+    COMMAND_DRIVE,          // arg[0]: cm, negative backwards
+    COMMAND_TURN_BY,        // arg[0]: degrees, positive clockwise
+    COMMAND_TURN_TO,        // arg[0]: compass heading, degrees
+    COMMAND_SET_SPEED,      // arg[0], arg[1]: left, right wheel cm/s
+    COMMAND_MANUAL,         // arg[0]: 1 remote control only, 0 back to the behaviours
+    COMMAND_STATS,          // full run-time statistics on the console and in the log
+    COMMAND_OPCODE_COUNT,
+} command_opcode_t;
+
+typedef enum {
+    COMMAND_OK = 0,         // queued (or answered, for a ping)
+    COMMAND_UNKNOWN,        // opcode not handled
+    COMMAND_BUSY,           // command queue full, not queued
+} command_status_t;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;
+    uint8_t status;
+    uint32_t sequence;
+    uint32_t client_time_us;
+    int32_t arg[2];
+} command_frame_t;
+
+static inline void command_put(uint8_t out[COMMAND_FRAME_SIZE], const command_frame_t *frame)
+{
+    out[0] = COMMAND_MAGIC;
+    out[1] = frame->opcode;
+    out[2] = frame->flags;
+    out[3] = frame->status;
+    put_le32(out + 4, frame->sequence);
+    put_le32(out + 8, frame->client_time_us);
+    put_le32(out + 12, (uint32_t)frame->arg[0]);
+    put_le32(out + 16, (uint32_t)frame->arg[1]);
+}
+
+// False if the magic byte is wrong
+static inline bool command_get(const uint8_t in[COMMAND_FRAME_SIZE], command_frame_t *frame)
+{
+    if (in[0] != COMMAND_MAGIC)
+        return false;
+    frame->opcode = in[1];
+    frame->flags = in[2];
+    frame->status = in[3];
+    frame->sequence = get_le32(in + 4);
+    frame->client_time_us = get_le32(in + 8);
+    frame->arg[0] = (int32_t)get_le32(in + 12);
+    frame->arg[1] = (int32_t)get_le32(in + 16);
+    return true;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <string.h>
+#include "command.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+// The half of the command server that does not touch lwIP: checking frames,
+// building acks and the queue to the consumer
+
+#define QUEUE_MASK (COMMAND_QUEUE_SIZE - 1)
+
+static uint8_t opcodes;
+
+// Producer: lwIP's thread. Consumer: command_receive()
+static command_t queue[COMMAND_QUEUE_SIZE];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+
+static command_stats_t stats;
+
+void command_queue_init(uint8_t opcode_count)
+{
+    opcodes = opcode_count;
+    head = 0;
+    tail = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+static command_status_t enqueue(const command_frame_t *frame, uint32_t received_us)
+{
+    if (frame->opcode >= opcodes) {
+        stats.unknown++;
+        return COMMAND_UNKNOWN;
+    }
+    if (frame->opcode == COMMAND_PING)
+        return COMMAND_OK;
+
+    uint32_t h = head;
+    if (h - tail > QUEUE_MASK) {
+        stats.busy++;
+        return COMMAND_BUSY;
+    }
+    command_t *command = &queue[h & QUEUE_MASK];
+    command->opcode = frame->opcode;
+    command->sequence = frame->sequence;
+    command->arg[0] = frame->arg[0];
+    command->arg[1] = frame->arg[1];
+    command->received_us = received_us;
+    __dmb();
+    head = h + 1;
+    return COMMAND_OK;
+}
+
+bool command_handle(uint8_t frame_bytes[COMMAND_FRAME_SIZE], size_t length, uint32_t received_us)
+{
+    command_frame_t frame;
+    if (length != COMMAND_FRAME_SIZE || !command_get(frame_bytes, &frame) || (frame.flags & COMMAND_FLAG_ACK)) {
+        stats.malformed++;
+        return false;
+    }
+    stats.received++;
+
+    frame.flags = COMMAND_FLAG_ACK;
+    frame.status = enqueue(&frame, received_us);
+    frame.arg[0] = (int32_t)(time_us_32() - received_us);
+    frame.arg[1] = 0;
+    command_put(frame_bytes, &frame);
+    return true;
+}
+
+void command_count_ack_error(void)
+{
+    stats.ack_errors++;
+}
+
+bool command_receive(command_t *command)
+{
+    uint32_t t = tail;
+    if (t == head)
+        return false;
+    __dmb();
+    *command = queue[t & QUEUE_MASK];
+    __dmb();
+    tail = t + 1;
+    return true;
+}
+
+void command_get_stats(command_stats_t *out)
+{
+    *out = stats;
+}
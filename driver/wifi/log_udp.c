@@ -0,0 +1,80 @@
+#include "log_udp.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos_cores.h"
+
+#define LOG_UDP_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#define LOG_UDP_TASK_STACK 512
+
+static struct udp_pcb *pcb;
+static ip_addr_t destination;
+static uint16_t destination_port;
+static uint32_t period;
+static uint32_t send_errors;
+
+// Frames are drained straight into pool pbufs, like the telemetry
+static bool send_frame(void)
+{
+    cyw43_arch_lwip_begin();
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, LOG_FRAME_MAX, PBUF_POOL);
+    cyw43_arch_lwip_end();
+    if (!p || p->next) {
+        cyw43_arch_lwip_begin();
+        if (p)
+            pbuf_free(p);
+        cyw43_arch_lwip_end();
+        send_errors++;
+        return false;
+    }
+
+    size_t length = log_drain(p->payload, LOG_FRAME_MAX);
+    err_t err = ERR_OK;
+    cyw43_arch_lwip_begin();
+    if (length > 0) {
+        pbuf_realloc(p, length);
+        err = udp_sendto(pcb, p, &destination, destination_port);
+    }
+    pbuf_free(p);
+    cyw43_arch_lwip_end();
+
+    if (err != ERR_OK)
+        send_errors++;
+    return length > 0 && err == ERR_OK;
+}
+
+static void log_udp_task(__unused void *params)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(period));
+        while (send_frame())
+            ;
+    }
+}
+
+bool log_udp_start(const char *host, uint16_t port, uint32_t period_ms)
+{
+    if (period_ms == 0 || !ipaddr_aton(host, &destination))
+        return false;
+    destination_port = port;
+    period = period_ms;
+
+    cyw43_arch_lwip_begin();
+    pcb = udp_new();
+    cyw43_arch_lwip_end();
+    if (!pcb)
+        return false;
+
+    TaskHandle_t task;
+    xTaskCreate(log_udp_task, "Log", LOG_UDP_TASK_STACK, NULL, LOG_UDP_TASK_PRIORITY, &task);
+    rtos_pin_task(task, RTOS_NETWORK_CORE);
+    return true;
+}
+
+uint32_t log_udp_send_errors(void)
+{
+    return send_errors;
+}
@@ -0,0 +1,19 @@
+#ifndef LOG_UDP_H
+#define LOG_UDP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "log.h"
+
+// Drain the binary log (log.h) over UDP instead of the console: a task on
+// the network core sends one datagram per frame every period_ms
+
+#define LOG_UDP_PORT 5007
+
+// wifi_connect() must have succeeded. False on a bad host or no PCB
+bool log_udp_start(const char *host, uint16_t port, uint32_t period_ms);
+
+// Datagrams lwIP would not take
+uint32_t log_udp_send_errors(void);
+
+#endif
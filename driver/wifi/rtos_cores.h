@@ -0,0 +1,30 @@
+#ifndef RTOS_CORES_H
+#define RTOS_CORES_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+// Core assignment when the scheduler runs on both cores (ROBOT_SMP build):
+// time-critical control and sensor tasks on one core, the cyw43 driver,
+// lwIP and everything that talks to the network on the other. Built for a
+// single core, pinning does nothing
+#define RTOS_CONTROL_CORE 0
+#define RTOS_NETWORK_CORE 1
+
+#if defined(configNUM_CORES) && configNUM_CORES > 1 && configUSE_CORE_AFFINITY
+#define RTOS_SMP 1
+#else
+#define RTOS_SMP 0
+#endif
+
+static inline void rtos_pin_task(TaskHandle_t task, UBaseType_t core)
+{
+#if RTOS_SMP
+    vTaskCoreAffinitySet(task, 1u << core);
+#else
+    (void)task;
+    (void)core;
+#endif
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <string.h>
+#include "runtime_stats.h"
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef VTABLE_FIRST_IRQ
+#define VTABLE_FIRST_IRQ 16
+#endif
+
+#ifdef configNUM_CORES
+#define CORES configNUM_CORES
+#else
+#define CORES 1
+#endif
+
+// Kernel state per task and the run-time counters at the previous sample
+static TaskStatus_t status[RUNTIME_STATS_MAX_TASKS];
+static struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} previous[RUNTIME_STATS_MAX_TASKS];
+static uint previous_count;
+static uint32_t previous_total;
+
+// Timed IRQs: the handler each one had, and its histogram by IRQ slot
+static irq_handler_t original[NUM_IRQS];
+static int8_t slot_of[NUM_IRQS];
+static isr_stats_t isr_stats[RUNTIME_STATS_MAX_IRQS];
+static uint isr_count;
+
+uint runtime_stats_sample(task_stats_t *tasks, uint max)
+{
+    uint32_t total;
+    uint count = uxTaskGetSystemState(status, RUNTIME_STATS_MAX_TASKS, &total);
+
+    // Every core accrues run time, so the tasks add up to cores x elapsed
+    uint64_t elapsed = (uint64_t)(total - previous_total) * CORES;
+    previous_total = total;
+
+    for (uint i = 0; i < count; i++) {
+        uint32_t runtime = status[i].ulRunTimeCounter;
+        uint32_t before = 0;
+        for (uint j = 0; j < previous_count; j++) {
+            if (previous[j].number == status[i].xTaskNumber) {
+                before = previous[j].runtime;
+                break;
+            }
+        }
+
+        if (i < max) {
+            tasks[i].name = status[i].pcTaskName;
+            tasks[i].priority = status[i].uxCurrentPriority;
+            tasks[i].cpu_permille = elapsed ? (uint32_t)((uint64_t)(runtime - before) * 1000 / elapsed) : 0;
+            tasks[i].stack_free_words = status[i].usStackHighWaterMark;
+        }
+    }
+
+    for (uint i = 0; i < count; i++) {
+        previous[i].number = status[i].xTaskNumber;
+        previous[i].runtime = status[i].ulRunTimeCounter;
+    }
+    previous_count = count;
+    return count;
+}
+
+// Stands in for every timed IRQ's vector; which IRQ is running comes
+// from the exception number
+static void __not_in_flash_func(timed_irq_handler)(void)
+{
+    uint irq = __get_current_exception() - VTABLE_FIRST_IRQ;
+    uint32_t start = time_us_32();
+    original[irq]();
+    histogram_add(&isr_stats[slot_of[irq]].time_us, (int32_t)(time_us_32() - start));
+}
+
+bool runtime_stats_time_irq(uint irq)
+{
+    if (irq >= NUM_IRQS || isr_count >= RUNTIME_STATS_MAX_IRQS)
+        return false;
+    irq_handler_t handler = irq_get_vtable_handler(irq);
+    if (handler == timed_irq_handler)
+        return true;
+
+    uint slot = isr_count++;
+    isr_stats[slot].irq = irq;
+    histogram_init(&isr_stats[slot].time_us, 0, RUNTIME_STATS_ISR_SHIFT);
+    slot_of[irq] = (int8_t)slot;
+    original[irq] = handler;
+
+    // Both cores share the vector table: the wrapper's state must be in
+    // place before the vector points at it
+    __dmb();
+    uint32_t irq_state = save_and_disable_interrupts();
+    ((irq_handler_t *)(uintptr_t)scb_hw->vtor)[VTABLE_FIRST_IRQ + irq] = timed_irq_handler;
+    restore_interrupts(irq_state);
+    return true;
+}
+
+uint runtime_stats_isr(isr_stats_t *isrs, uint max)
+{
+    uint count = isr_count < max ? isr_count : max;
+    memcpy(isrs, isr_stats, count * sizeof(*isrs));
+    return isr_count;
+}
+
+// configCHECK_FOR_STACK_OVERFLOW: the kernel found a task past its stack
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name)
+{
+    panic("Stack overflow in task %s", name);
+}
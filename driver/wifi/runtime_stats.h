@@ -0,0 +1,45 @@
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "histogram.h"
+
+// Where CPU time and stack go, from the FreeRTOS run-time counters (the
+// 1 MHz timer, see FreeRTOSConfig.h), and how long interrupt handlers run.
+// Cheap enough to leave on: the kernel reads the timer once per context
+// switch and a timed IRQ costs two more timer reads and a histogram bucket.
+
+#define RUNTIME_STATS_MAX_TASKS 16
+#define RUNTIME_STATS_MAX_IRQS 8
+
+// ISR time histograms: 2 us buckets from 0, 30 us and up in the last
+#define RUNTIME_STATS_ISR_SHIFT 1
+
+typedef struct {
+    const char *name;
+    uint8_t priority;
+    uint32_t cpu_permille;      // of all cores, since the previous sample
+    uint32_t stack_free_words;  // least free stack so far
+} task_stats_t;
+
+typedef struct {
+    uint irq;
+    histogram_t time_us;
+} isr_stats_t;
+
+// Fill tasks (up to max) with each task's share of the time since the
+// previous call, and its stack high-water mark. Returns how many tasks
+// there are, 0 if more than RUNTIME_STATS_MAX_TASKS. Suspends the
+// scheduler briefly: call from one low priority task only
+uint runtime_stats_sample(task_stats_t *tasks, uint max);
+
+// Time every call to the handler(s) now installed for irq. Call once all
+// handlers for irq are in place: adding one later would fail
+bool runtime_stats_time_irq(uint irq);
+
+// Copy of the histogram of each timed IRQ. Returns how many there are
+uint runtime_stats_isr(isr_stats_t *isrs, uint max);
+
+#endif
@@ -0,0 +1,151 @@
+#include "telemetry.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtos_cores.h"
+
+#define TELEMETRY_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
+#define TELEMETRY_TASK_STACK 512
+
+#define RING_MASK (TELEMETRY_RING_RECORDS - 1)
+
+static telemetry_config_t config;
+static struct udp_pcb *pcb;
+static ip_addr_t destination;
+static TaskHandle_t task;
+static volatile bool started;
+
+// Record ring: head written by the producer only, tail by the task only
+static telemetry_record_t ring[TELEMETRY_RING_RECORDS];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+
+static telemetry_stats_t stats;
+static uint32_t reported_drops;
+static uint32_t sequence;
+
+void telemetry_record(const telemetry_record_t *record)
+{
+    if (!started)
+        return;
+
+    uint32_t h = head;
+    uint32_t queued = h - tail;
+    if (queued > RING_MASK) {
+        stats.dropped++;
+        return;
+    }
+    ring[h & RING_MASK] = *record;
+    __dmb();
+    head = h + 1;
+    stats.records++;
+
+    if (queued + 1 == TELEMETRY_BATCH_RECORDS)
+        xTaskNotifyGive(task);
+}
+
+// Pack as many waiting records as fit into one pool pbuf and send it.
+// Records are encoded from the ring straight into the payload
+static bool send_frame(void)
+{
+    cyw43_arch_lwip_begin();
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, TELEMETRY_FRAME_MAX, PBUF_POOL);
+    cyw43_arch_lwip_end();
+    if (!p) {
+        stats.send_errors++;
+        return false;
+    }
+    if (p->next) {
+        // A frame must fit one pool buffer to be written in place
+        cyw43_arch_lwip_begin();
+        pbuf_free(p);
+        cyw43_arch_lwip_end();
+        stats.send_errors++;
+        return false;
+    }
+
+    uint8_t *start = p->payload;
+    uint8_t *out = start + TELEMETRY_HEADER_SIZE;
+    uint8_t *end = start + TELEMETRY_FRAME_MAX;
+    static const telemetry_record_t zero;
+    const telemetry_record_t *prev = &zero;
+    uint16_t count = 0;
+
+    uint32_t t = tail;
+    uint32_t h = head;
+    __dmb();
+    while (t != h && end - out >= TELEMETRY_RECORD_MAX_SIZE(config.field_count)) {
+        const telemetry_record_t *record = &ring[t & RING_MASK];
+        out = telemetry_put_record(out, record, prev, config.field_count);
+        prev = record;
+        t++;
+        count++;
+    }
+
+    // The last record encoded is still read as prev until here
+    __dmb();
+    tail = t;
+
+    uint32_t dropped = stats.dropped;
+    telemetry_header_t header = {
+        .field_count = config.field_count,
+        .sequence = sequence++,
+        .record_count = count,
+        .dropped = dropped - reported_drops > UINT16_MAX ? UINT16_MAX : dropped - reported_drops,
+    };
+    reported_drops = dropped;
+    telemetry_put_header(start, &header);
+
+    uint16_t length = out - start;
+    cyw43_arch_lwip_begin();
+    pbuf_realloc(p, length);
+    err_t err = udp_sendto(pcb, p, &destination, config.port);
+    pbuf_free(p);
+    cyw43_arch_lwip_end();
+
+    if (err != ERR_OK) {
+        stats.send_errors++;
+        return false;
+    }
+    stats.frames++;
+    stats.bytes += length;
+    return true;
+}
+
+static void telemetry_task(__unused void *params)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(config.period_ms));
+        while (head != tail) {
+            if (!send_frame())
+                break;
+        }
+    }
+}
+
+bool telemetry_start(const telemetry_config_t *cfg)
+{
+    if (cfg->field_count > TELEMETRY_MAX_FIELDS || cfg->period_ms == 0 ||
+        !ipaddr_aton(cfg->host, &destination))
+        return false;
+    config = *cfg;
+
+    cyw43_arch_lwip_begin();
+    pcb = udp_new();
+    cyw43_arch_lwip_end();
+    if (!pcb)
+        return false;
+
+    xTaskCreate(telemetry_task, "Telemetry", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, &task);
+    rtos_pin_task(task, RTOS_NETWORK_CORE);
+    started = true;
+    return true;
+}
+
+void telemetry_get_stats(telemetry_stats_t *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,44 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "telemetry_codec.h"
+
+// Binary telemetry over UDP. Producers queue fixed-size records into a
+// lock-free ring; a telemetry task packs them into delta-coded frames
+// (telemetry_codec.h) written straight into a pbuf from the lwIP pool, and
+// sends one datagram per frame. A frame goes out when a batch of records
+// is waiting or when the period runs out, whichever comes first.
+
+#define TELEMETRY_PORT 5005
+#define TELEMETRY_FRAME_MAX 512         // bytes of UDP payload, header included
+#define TELEMETRY_RING_RECORDS 64       // power of two
+#define TELEMETRY_BATCH_RECORDS 16      // wake the task early at this many
+
+typedef struct {
+    const char *host;       // receiver's IPv4 address
+    uint16_t port;
+    uint32_t period_ms;     // longest a record waits before it is sent
+    uint8_t field_count;    // fields used per record, <= TELEMETRY_MAX_FIELDS
+} telemetry_config_t;
+
+typedef struct {
+    uint32_t records;       // queued by the producer
+    uint32_t dropped;       // ring full
+    uint32_t frames;        // datagrams sent
+    uint32_t bytes;         // UDP payload sent
+    uint32_t send_errors;   // no pool pbuf, or udp_sendto() failed
+} telemetry_stats_t;
+
+// Start the telemetry task on the network core. wifi_connect() must have
+// succeeded. Returns false on a bad config or if lwIP is out of PCBs
+bool telemetry_start(const telemetry_config_t *config);
+
+// Queue one record. Never blocks: the record is dropped if the ring is
+// full. Single producer; does nothing before telemetry_start()
+void telemetry_record(const telemetry_record_t *record);
+
+void telemetry_get_stats(telemetry_stats_t *stats);
+
+#endif
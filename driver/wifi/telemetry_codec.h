@@ -0,0 +1,135 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Telemetry frame format, shared by the firmware and the host receiver
+// (tools/telemetry_receiver.c), so it only uses the C standard library.
+//
+// One UDP datagram is one frame: a fixed header, then record_count records.
+// A record is a timestamp and field_count signed fields. Every value is
+// stored as a varint of its difference to the same value in the previous
+// record of the frame (signed ones zigzag coded), the first record against
+// zero, so slowly changing fields take a byte or two and every frame
+// decodes on its own even if the one before was lost.
+//
+// Header, little endian:
+//   0  u16 magic       TELEMETRY_MAGIC
+//   2  u8  version     TELEMETRY_VERSION
+//   3  u8  field_count
+//   4  u32 sequence    frame number, for loss detection
+//   8  u16 record_count
+//   10 u16 dropped     records the sender had to drop since the last frame
+
+#define TELEMETRY_MAGIC 0x4D54      // "TM"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER_SIZE 12
+#define TELEMETRY_MAX_FIELDS 12
+
+// Worst case: a 5-byte varint for the timestamp and for every field
+#define TELEMETRY_RECORD_MAX_SIZE(fields) (5 * (1 + (fields)))
+
+typedef struct {
+    uint32_t timestamp_us;
+    int32_t field[TELEMETRY_MAX_FIELDS];
+} telemetry_record_t;
+
+typedef struct {
+    uint8_t field_count;
+    uint32_t sequence;
+    uint16_t record_count;
+    uint16_t dropped;
+} telemetry_header_t;
+
+static inline uint32_t telemetry_zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t telemetry_unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static inline uint8_t *telemetry_put_varint(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+// NULL if the varint runs past end or is longer than 5 bytes
+static inline const uint8_t *telemetry_get_varint(const uint8_t *in, const uint8_t *end, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        result |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
+
+static inline void telemetry_put_header(uint8_t *out, const telemetry_header_t *header)
+{
+    out[0] = TELEMETRY_MAGIC & 0xff;
+    out[1] = TELEMETRY_MAGIC >> 8;
+    out[2] = TELEMETRY_VERSION;
+    out[3] = header->field_count;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t)(header->sequence >> (8 * i));
+    out[8] = (uint8_t)header->record_count;
+    out[9] = (uint8_t)(header->record_count >> 8);
+    out[10] = (uint8_t)header->dropped;
+    out[11] = (uint8_t)(header->dropped >> 8);
+}
+
+static inline bool telemetry_get_header(const uint8_t *in, size_t length, telemetry_header_t *header)
+{
+    if (length < TELEMETRY_HEADER_SIZE || in[0] != (TELEMETRY_MAGIC & 0xff) ||
+        in[1] != (TELEMETRY_MAGIC >> 8) || in[2] != TELEMETRY_VERSION || in[3] > TELEMETRY_MAX_FIELDS)
+        return false;
+
+    header->field_count = in[3];
+    header->sequence = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+    header->record_count = (uint16_t)(in[8] | in[9] << 8);
+    header->dropped = (uint16_t)(in[10] | in[11] << 8);
+    return true;
+}
+
+// Append record, delta coded against prev (all zero for the first record)
+static inline uint8_t *telemetry_put_record(uint8_t *out, const telemetry_record_t *record,
+                                            const telemetry_record_t *prev, unsigned fields)
+{
+    out = telemetry_put_varint(out, record->timestamp_us - prev->timestamp_us);
+    for (unsigned i = 0; i < fields; i++)
+        out = telemetry_put_varint(out, telemetry_zigzag((int32_t)((uint32_t)record->field[i] - (uint32_t)prev->field[i])));
+    return out;
+}
+
+// Read one record into record, which holds the previous one on entry.
+// NULL if the frame is truncated
+static inline const uint8_t *telemetry_get_record(const uint8_t *in, const uint8_t *end,
+                                                  telemetry_record_t *record, unsigned fields)
+{
+    uint32_t value;
+    if (!(in = telemetry_get_varint(in, end, &value)))
+        return NULL;
+    record->timestamp_us += value;
+    for (unsigned i = 0; i < fields; i++) {
+        if (!(in = telemetry_get_varint(in, end, &value)))
+            return NULL;
+        record->field[i] = (int32_t)((uint32_t)record->field[i] + (uint32_t)telemetry_unzigzag(value));
+    }
+    return in;
+}
+
+#endif
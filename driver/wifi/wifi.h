@@ -0,0 +1,12 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bring up the cyw43 chip in station mode and join WIFI_SSID (set at build
+// time). Must be called from a FreeRTOS task; on two cores that task and the
+// network tasks are pinned to RTOS_NETWORK_CORE. Returns false on failure
+bool wifi_connect(uint32_t timeout_ms);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2022 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/netif.h"
+#include "lwip/apps/lwiperf.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "message_buffer.h"
+#include "command.h"
+#include "rtos_cores.h"
+#include "runtime_stats.h"
+#include "wifi.h"
+
+#ifndef PING_ADDR
+#define PING_ADDR "142.251.35.196"
+#endif
+#ifndef RUN_FREERTOS_ON_CORE
+#define RUN_FREERTOS_ON_CORE 0
+#endif
+
+#define TEST_TASK_PRIORITY  (tskIDLE_PRIORITY + 1UL)
+
+// Jitter benchmark: a stand-in for the robot's 1 ms control task, at the same
+// priority and on the same core, measured while iperf loads the network
+#define JITTER_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define JITTER_PERIOD_US 1000
+#define JITTER_LATE_US 50       // wake-ups further off than this are counted
+#define JITTER_REPORT_MS 1000
+
+typedef struct {
+    uint32_t periods;
+    int32_t min_us;
+    int32_t max_us;
+    uint32_t late;
+} jitter_stats_t;
+
+static MessageBufferHandle_t xControlMessageBuffer;
+
+// Written by the jitter task, read and reset by the main task
+static jitter_stats_t jitter;
+
+static void jitter_reset(void) {
+    jitter.periods = 0;
+    jitter.min_us = INT32_MAX;
+    jitter.max_us = INT32_MIN;
+    jitter.late = 0;
+}
+
+void jitter_task(__unused void *params) {
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t last = time_us_32();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(JITTER_PERIOD_US / 1000));
+        uint32_t now = time_us_32();
+        int32_t error = (int32_t)(now - last) - JITTER_PERIOD_US;
+        last = now;
+
+        taskENTER_CRITICAL();
+        jitter.periods++;
+        if (error < jitter.min_us)
+            jitter.min_us = error;
+        if (error > jitter.max_us)
+            jitter.max_us = error;
+        if (error > JITTER_LATE_US || error < -JITTER_LATE_US)
+            jitter.late++;
+        taskEXIT_CRITICAL();
+    }
+}
+
+void main_task(__unused void *params) {
+    if (!wifi_connect(30000)) {
+        exit(1);
+    }
+
+    // iperf server as the network load for the jitter benchmark
+    cyw43_arch_lwip_begin();
+    lwiperf_start_tcp_server_default(NULL, NULL);
+    cyw43_arch_lwip_end();
+    printf("Jitter benchmark on %s: load it with 'iperf -c %s'\n",
+           RTOS_SMP ? "two cores" : "one core", ip4addr_ntoa(netif_ip4_addr(netif_list)));
+
+    // Answer command pings only, for round-trip latency with tools/command_client
+    if (!command_server_start(COMMAND_PORT, COMMAND_PING + 1)) {
+        printf("Command server failed to start\n");
+    }
+
+    while (true) {
+        // Your main code for WiFi communication goes here
+
+        // Example: Sending a message
+        char message_to_send[] = "Hello, Pico!"; // Message to send
+
+        xMessageBufferSend(
+            xControlMessageBuffer,        // The message buffer to write to
+            message_to_send,              // The source of the data to send
+            sizeof(message_to_send),      // The length of the data to send
+            0                            // Do not block if the buffer is full
+        );
+
+        vTaskDelay(pdMS_TO_TICKS(JITTER_REPORT_MS));
+
+        jitter_stats_t stats;
+        taskENTER_CRITICAL();
+        stats = jitter;
+        jitter_reset();
+        taskEXIT_CRITICAL();
+        if (stats.periods > 0) {
+            printf("Jitter: %lu periods, %ld..%ld us, %lu beyond +-%d us\n",
+                   (unsigned long)stats.periods, (long)stats.min_us, (long)stats.max_us,
+                   (unsigned long)stats.late, JITTER_LATE_US);
+        }
+
+        // CPU share and stack headroom of every task, for sizing the stacks
+        task_stats_t tasks[RUNTIME_STATS_MAX_TASKS];
+        uint count = runtime_stats_sample(tasks, RUNTIME_STATS_MAX_TASKS);
+        for (uint i = 0; i < count; i++) {
+            printf("  %-16s cpu %3lu.%lu%%, stack free %lu words\n", tasks[i].name,
+                   (unsigned long)tasks[i].cpu_permille / 10, (unsigned long)tasks[i].cpu_permille % 10,
+                   (unsigned long)tasks[i].stack_free_words);
+        }
+    }
+
+    cyw43_arch_deinit();
+}
+
+/* A Task that waits for data from the PC/Laptop via message buffer. */
+void pc_task(__unused void *params) {
+    char received_message[64]; // Buffer to store received messages
+
+    while (true) {
+        size_t received_bytes;
+        received_bytes = xMessageBufferReceive(
+            xControlMessageBuffer,       // The message buffer to receive from
+            received_message,            // Location to store received data
+            sizeof(received_message) - 1, // Maximum number of bytes to receive, leaving room for the terminator
+            portMAX_DELAY                // Wait indefinitely
+        );
+
+        if (received_bytes > 0) {
+            received_message[received_bytes] = '\0'; // Null-terminate the received message
+            printf("Received message: %s\n", received_message);
+
+            // Process the received message here
+            if (strcmp(received_message, "Hello, Pico!") == 0) {
+                printf("Received a greeting message!\n");
+                // Perform an action in response to the received message
+            } else if (strcmp(received_message, "AnotherCommand") == 0) {
+                printf("Received another command!\n");
+                // Handle this specific command
+            } else {
+                printf("Unknown message received: %s\n", received_message);
+                // Handle unknown messages or provide an appropriate response
+            }
+        }
+    }
+}
+
+
+void vLaunch(void) {
+    jitter_reset();
+    TaskHandle_t jittertask;
+    xTaskCreate(jitter_task, "JitterTask", configMINIMAL_STACK_SIZE, NULL, JITTER_TASK_PRIORITY, &jittertask);
+    rtos_pin_task(jittertask, RTOS_CONTROL_CORE);
+
+    TaskHandle_t task;
+    xTaskCreate(main_task, "TestMainThread", configMINIMAL_STACK_SIZE, NULL, TEST_TASK_PRIORITY, &task);
+    TaskHandle_t pctask;
+    xTaskCreate(pc_task, "TestPCTask", configMINIMAL_STACK_SIZE, NULL, 5, &pctask);
+
+    xControlMessageBuffer = xMessageBufferCreate(64); // Adjust the size according to your needs
+
+    /* Start the tasks and timer running. */
+    vTaskStartScheduler();
+}
+
+int main(void) {
+    stdio_init_all();
+
+    /* Configure the hardware ready to run the demo. */
+    const char *rtos_name;
+#if (portSUPPORT_SMP == 1)
+    rtos_name = "FreeRTOS SMP";
+#else
+    rtos_name = "FreeRTOS";
+#endif
+
+#if (portSUPPORT_SMP == 1) && (configNUM_CORES == 2)
+    printf("Starting %s on both cores:\n", rtos_name);
+    vLaunch();
+#elif (RUN_FREERTOS_ON_CORE == 1)
+    printf("Starting %s on core 1:\n", rtos_name);
+    multicore_launch_core1(vLaunch);
+    while (true);
+#else
+    printf("Starting %s on core 0:\n", rtos_name);
+    vLaunch();
+#endif
+    return 0;
+}
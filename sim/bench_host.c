@@ -0,0 +1,265 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench.h"
+#include "grid.h"
+#include "hal.h"
+#include "planner.h"
+#include "world.h"
+
+// Host wall-clock time of the firmware code and the mock HAL under it,
+// for catching algorithmic regressions. The simulated clock moves as in
+// robot_sim, so the sensors answer, but has no bearing on the numbers
+
+// Larger than any last-level cache
+#define CACHE_FLUSH_BYTES (64u << 20)
+#define CACHE_LINE_BYTES 64
+
+const char *const bench_platform = "host";
+const char *const bench_timer = "clock_monotonic";
+
+static struct timespec start;
+static volatile uint8_t *flush_buffer;
+static int saved_stdout = -1;
+
+uint32_t bench_cpu_hz(void)
+{
+    return 0;
+}
+
+void bench_start(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+uint32_t bench_stop(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t ns = (int64_t)(now.tv_sec - start.tv_sec) * 1000000000 + (now.tv_nsec - start.tv_nsec);
+    return ns < UINT32_MAX ? (uint32_t)ns : UINT32_MAX;
+}
+
+// User code cannot flush the instruction cache, but streaming through a
+// buffer bigger than the caches evicts the code from every shared level
+void bench_flush_cache(void)
+{
+    if (!flush_buffer && !(flush_buffer = calloc(1, CACHE_FLUSH_BYTES)))
+        return;
+    for (size_t i = 0; i < CACHE_FLUSH_BYTES; i += CACHE_LINE_BYTES)
+        flush_buffer[i]++;
+}
+
+// A null console: the printing still runs, its bytes go nowhere. stdout
+// keeps its buffer, only the descriptor under it changes
+void bench_console_off(void)
+{
+    int null = open("/dev/null", O_WRONLY);
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    if (null < 0 || saved_stdout < 0 || dup2(null, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "bench: cannot send stdout to /dev/null\n");
+        exit(1);
+    }
+    close(null);
+}
+
+void bench_console_on(void)
+{
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    saved_stdout = -1;
+}
+
+// Planner on generated mazes, too big for the car's grid: robot_bench's
+// firmware is built with a 128 x 128 grid (sim/CMakeLists.txt).
+// Every maze cell is MAZE_PITCH grid cells, a wall and a corridor wide
+// enough for one lane of clearance. The goal is maze cell (0, 0); a full
+// rebuild of the field is timed against the incremental update after one
+// new wall in the middle of the maze
+#define MAZE_PITCH (2 * PLANNER_CLEARANCE_CELLS + 2)
+#define MAZE_MAX 32
+
+static grid_t maze_grid;
+static grid_t maze_built;
+static planner_t maze_planner;
+static planner_t maze_solved;
+static uint maze_size;
+
+static void maze_set(grid_t *grid, int x, int y, bool occupied)
+{
+    uint index = (uint)y * GRID_WIDTH + (uint)x;
+    uint8_t bit = 1u << (index & 7);
+    grid->known[index >> 3] |= bit;
+    if (occupied)
+        grid->occupied[index >> 3] |= bit;
+    else
+        grid->occupied[index >> 3] &= ~bit;
+}
+
+// Depth-first maze with every wall drawn, then the passages knocked out
+static void maze_generate(grid_t *grid, uint size)
+{
+    static const int dx[4] = {0, 1, 0, -1};
+    static const int dy[4] = {1, 0, -1, 0};
+    static bool visited[MAZE_MAX * MAZE_MAX];
+    static uint stack[MAZE_MAX * MAZE_MAX];
+    uint32_t random = 12345;
+
+    grid_init(grid);
+    int side = (int)(size * MAZE_PITCH);
+    for (int y = 0; y <= side; y++) {
+        for (int x = 0; x <= side; x++)
+            maze_set(grid, x, y, x % MAZE_PITCH == 0 || y % MAZE_PITCH == 0);
+    }
+
+    memset(visited, 0, sizeof(visited));
+    uint depth = 0;
+    stack[depth++] = 0;
+    visited[0] = true;
+    while (depth > 0) {
+        uint cell = stack[depth - 1];
+        int cx = (int)(cell % size);
+        int cy = (int)(cell / size);
+
+        int options[4];
+        int count = 0;
+        for (int dir = 0; dir < 4; dir++) {
+            int nx = cx + dx[dir];
+            int ny = cy + dy[dir];
+            if (nx >= 0 && nx < (int)size && ny >= 0 && ny < (int)size && !visited[ny * size + nx])
+                options[count++] = dir;
+        }
+        if (count == 0) {
+            depth--;
+            continue;
+        }
+
+        random = random * 1103515245u + 12345u;
+        int dir = options[(random >> 16) % count];
+        int nx = cx + dx[dir];
+        int ny = cy + dy[dir];
+
+        // The wall between the two cells, corners excepted
+        for (int i = 1; i < MAZE_PITCH; i++) {
+            int x = dx[dir] ? (dx[dir] > 0 ? nx : cx) * MAZE_PITCH : cx * MAZE_PITCH + i;
+            int y = dy[dir] ? (dy[dir] > 0 ? ny : cy) * MAZE_PITCH : cy * MAZE_PITCH + i;
+            maze_set(grid, x, y, false);
+        }
+        visited[ny * size + nx] = true;
+        stack[depth++] = ny * size + nx;
+    }
+    grid->change_count = 0;
+    grid->changes_lost = false;
+}
+
+static int maze_center(uint cell)
+{
+    return (int)cell * MAZE_PITCH + MAZE_PITCH / 2;
+}
+
+static void maze_solve(void)
+{
+    planner_set_goal(&maze_planner, maze_center(0), maze_center(0), true);
+    while (!planner_step(&maze_planner, UINT_MAX))
+        ;
+}
+
+static void maze_begin(uint size)
+{
+    maze_size = size;
+    maze_generate(&maze_built, size);
+    maze_grid = maze_built;
+    planner_init(&maze_planner, &maze_grid);
+    maze_solve();
+
+    int far = maze_center(size - 1);
+    if (planner_distance(&maze_planner, far, far) == PLANNER_UNREACHABLE) {
+        fprintf(stderr, "bench: %ux%u maze has no route\n", size, size);
+        exit(1);
+    }
+    maze_solved = maze_planner;
+}
+
+static void maze_add_wall(void)
+{
+    int middle = maze_center(maze_size / 2);
+    maze_set(&maze_grid, middle, middle, true);
+    maze_grid.changes[maze_grid.change_count++] = (uint16_t)(middle * GRID_WIDTH + middle);
+}
+
+static void maze_run(void)
+{
+    while (!planner_step(&maze_planner, UINT_MAX))
+        ;
+}
+
+static void maze_prepare_rebuild(void)
+{
+    planner_set_goal(&maze_planner, maze_center(0), maze_center(0), true);
+}
+
+// The incremental update must land where a rebuild does
+static void maze_begin_update(uint size)
+{
+    maze_begin(size);
+    maze_add_wall();
+    maze_run();
+    static uint16_t updated[GRID_CELLS];
+    memcpy(updated, maze_planner.distance, sizeof(updated));
+    maze_solve();
+    if (memcmp(updated, maze_planner.distance, sizeof(updated)) != 0) {
+        fprintf(stderr, "bench: %ux%u maze update differs from a rebuild\n", size, size);
+        exit(1);
+    }
+}
+
+static void maze_prepare_update(void)
+{
+    maze_grid = maze_built;
+    maze_planner = maze_solved;
+    maze_add_wall();
+}
+
+static void maze_begin_16(void)
+{
+    maze_begin(16);
+}
+
+static void maze_begin_21(void)
+{
+    maze_begin(21);
+}
+
+static void maze_begin_update_16(void)
+{
+    maze_begin_update(16);
+}
+
+static void maze_begin_update_21(void)
+{
+    maze_begin_update(21);
+}
+
+static const benchmark_t host_benchmarks[] = {
+    {"planner_rebuild_16x16", maze_begin_16, maze_prepare_rebuild, maze_run, NULL, 0},
+    {"planner_update_16x16", maze_begin_update_16, maze_prepare_update, maze_run, NULL, 0},
+    {"planner_rebuild_21x21", maze_begin_21, maze_prepare_rebuild, maze_run, NULL, 0},
+    {"planner_update_21x21", maze_begin_update_21, maze_prepare_update, maze_run, NULL, 0},
+};
+
+int main(void)
+{
+    // The car sits still in the simulated world, motors off
+    world_config_t config = {0};
+    sim_init();
+    world_init(&config);
+
+    bench_main(host_benchmarks, count_of(host_benchmarks));
+    return 0;
+}
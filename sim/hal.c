@@ -0,0 +1,510 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/irq.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+
+#define EVENT_QUEUE_SIZE 256
+#define MAX_SHARED_HANDLERS 4
+#define ALARM_COUNT 16
+
+// The alarm pool's hardware alarm, as in the SDK
+#define ALARM_IRQ (TIMER_IRQ_0 + PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM)
+
+// Clock and event queue: a binary heap on (time, order scheduled)
+typedef struct {
+    uint64_t at_ns;
+    uint64_t order;
+    sim_event_fn_t fn;
+    void *context;
+} event_t;
+
+static uint64_t now_ns;
+static event_t events[EVENT_QUEUE_SIZE];
+static uint event_count;
+static uint64_t events_scheduled;
+static void (*thread_hook)(void);
+static bool stopped;
+
+// NVIC and the vector table the handlers are called through
+static irq_handler_t vtable[VTABLE_FIRST_IRQ + NUM_IRQS];
+static armv6m_scb_hw_t scb = {.vtor = (uintptr_t)vtable};
+armv6m_scb_hw_t *const scb_hw = &scb;
+
+static uint32_t irq_enabled;
+static uint32_t irq_pending;
+static bool primask;
+static uint current_exception;
+static irq_handler_t shared[NUM_IRQS][MAX_SHARED_HANDLERS];
+static uint shared_count[NUM_IRQS];
+
+static spin_lock_t spin_locks[NUM_SPIN_LOCKS];
+static uint next_spin_lock;
+
+// Alarm pool. An alarm's event pends the timer IRQ, whose handler runs
+// the callbacks that are due
+typedef struct {
+    alarm_id_t id;
+    uint64_t at_us;
+    alarm_callback_t callback;
+    void *user_data;
+    uint32_t generation;
+    bool due;
+} alarm_t;
+
+static alarm_t alarms[ALARM_COUNT];
+static alarm_id_t next_alarm_id;
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+static bool event_before(const event_t *a, const event_t *b)
+{
+    return a->at_ns < b->at_ns || (a->at_ns == b->at_ns && a->order < b->order);
+}
+
+void sim_schedule(uint64_t at_ns, sim_event_fn_t fn, void *context)
+{
+    if (event_count == EVENT_QUEUE_SIZE)
+        panic("sim: event queue full");
+    if (at_ns < now_ns)
+        at_ns = now_ns;
+
+    uint i = event_count++;
+    events[i] = (event_t){at_ns, events_scheduled++, fn, context};
+    while (i > 0 && event_before(&events[i], &events[(i - 1) / 2])) {
+        event_t parent = events[(i - 1) / 2];
+        events[(i - 1) / 2] = events[i];
+        events[i] = parent;
+        i = (i - 1) / 2;
+    }
+}
+
+static event_t pop_event(void)
+{
+    event_t first = events[0];
+    events[0] = events[--event_count];
+    uint i = 0;
+    while (true) {
+        uint smallest = i;
+        uint left = 2 * i + 1;
+        uint right = left + 1;
+        if (left < event_count && event_before(&events[left], &events[smallest]))
+            smallest = left;
+        if (right < event_count && event_before(&events[right], &events[smallest]))
+            smallest = right;
+        if (smallest == i)
+            break;
+        event_t swap = events[i];
+        events[i] = events[smallest];
+        events[smallest] = swap;
+        i = smallest;
+    }
+    return first;
+}
+
+uint64_t sim_now_ns(void)
+{
+    return now_ns;
+}
+
+void sim_advance_to(uint64_t at_ns)
+{
+    while (event_count > 0 && events[0].at_ns <= at_ns) {
+        event_t event = pop_event();
+        now_ns = event.at_ns;
+        event.fn(event.context);
+        sim_deliver_irqs();
+    }
+    if (at_ns > now_ns)
+        now_ns = at_ns;
+    sim_deliver_irqs();
+}
+
+void sim_spend_ns(uint64_t ns)
+{
+    sim_advance_to(now_ns + ns);
+    if (thread_hook && !current_exception && !primask)
+        thread_hook();
+}
+
+void sim_set_thread_hook(void (*hook)(void))
+{
+    thread_hook = hook;
+}
+
+void sim_stop(void)
+{
+    stopped = true;
+}
+
+bool sim_stopped(void)
+{
+    return stopped;
+}
+
+// Interrupts
+
+void sim_irq_pend(uint irq)
+{
+    irq_pending |= 1u << irq;
+}
+
+void sim_deliver_irqs(void)
+{
+    uint32_t ready;
+    while (!primask && !current_exception && (ready = irq_pending & irq_enabled)) {
+        uint irq = (uint)__builtin_ctz(ready);
+        irq_pending &= ~(1u << irq);
+
+        irq_handler_t handler = vtable[VTABLE_FIRST_IRQ + irq];
+        if (!handler)
+            panic("sim: IRQ %u enabled without a handler", irq);
+        current_exception = VTABLE_FIRST_IRQ + irq;
+        handler();
+        current_exception = 0;
+
+        // The IO bank interrupt is a level: still set if events are left
+        if (irq == IO_IRQ_BANK0)
+            sim_gpio_update_irq();
+    }
+}
+
+static void shared_irq_handler(void)
+{
+    uint irq = current_exception - VTABLE_FIRST_IRQ;
+    for (uint i = 0; i < shared_count[irq]; i++)
+        shared[irq][i]();
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+    if (enabled)
+        irq_enabled |= 1u << num;
+    else
+        irq_enabled &= ~(1u << num);
+    sim_deliver_irqs();
+}
+
+bool irq_is_enabled(uint num)
+{
+    return (irq_enabled >> num) & 1u;
+}
+
+void irq_set_pending(uint num)
+{
+    sim_irq_pend(num);
+    sim_deliver_irqs();
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    if (shared_count[num] > 0)
+        panic("sim: IRQ %u already has shared handlers", num);
+    vtable[VTABLE_FIRST_IRQ + num] = handler;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority)
+{
+    (void)order_priority;
+    irq_handler_t current = vtable[VTABLE_FIRST_IRQ + num];
+    if (current && current != shared_irq_handler)
+        panic("sim: IRQ %u already has an exclusive handler", num);
+    if (shared_count[num] == MAX_SHARED_HANDLERS)
+        panic("sim: too many shared handlers on IRQ %u", num);
+    shared[num][shared_count[num]++] = handler;
+    vtable[VTABLE_FIRST_IRQ + num] = shared_irq_handler;
+}
+
+irq_handler_t irq_get_vtable_handler(uint num)
+{
+    return ((irq_handler_t *)scb_hw->vtor)[VTABLE_FIRST_IRQ + num];
+}
+
+uint __get_current_exception(void)
+{
+    return current_exception;
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+    uint32_t status = primask;
+    primask = true;
+    return status;
+}
+
+void restore_interrupts(uint32_t status)
+{
+    primask = status != 0;
+    sim_deliver_irqs();
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num)
+{
+    return &spin_locks[lock_num];
+}
+
+int spin_lock_claim_unused(bool required)
+{
+    if (next_spin_lock < PICO_SPINLOCK_ID_STRIPED_FIRST)
+        next_spin_lock = PICO_SPINLOCK_ID_STRIPED_FIRST;
+    if (next_spin_lock == NUM_SPIN_LOCKS) {
+        if (required)
+            panic("sim: no spin locks left");
+        return -1;
+    }
+    return (int)next_spin_lock++;
+}
+
+// Timer
+
+uint64_t time_us_64(void)
+{
+    if (!current_exception)
+        sim_spend_ns(SIM_CLOCK_READ_NS);
+    return now_ns / 1000;
+}
+
+void busy_wait_us(uint64_t us)
+{
+    sim_spend_ns(us * 1000);
+}
+
+void sleep_us(uint64_t us)
+{
+    sim_spend_ns(us * 1000);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sim_spend_ns(ms * 1000000ull);
+}
+
+// An alarm's event carries its slot and the generation it was armed with,
+// so a slot cancelled or rearmed since then ignores it
+static void alarm_event(void *context)
+{
+    uintptr_t tag = (uintptr_t)context;
+    alarm_t *alarm = &alarms[tag % ALARM_COUNT];
+    if (alarm->callback && alarm->generation == (uint32_t)(tag / ALARM_COUNT)) {
+        alarm->due = true;
+        sim_irq_pend(ALARM_IRQ);
+    }
+}
+
+static void arm_alarm(alarm_t *alarm)
+{
+    alarm->due = false;
+    alarm->generation++;
+    uintptr_t tag = (uintptr_t)(alarm - alarms) + (uintptr_t)alarm->generation * ALARM_COUNT;
+    sim_schedule(alarm->at_us * 1000, alarm_event, (void *)tag);
+}
+
+static void alarm_irq_handler(void)
+{
+    for (uint i = 0; i < ALARM_COUNT; i++) {
+        alarm_t *alarm = &alarms[i];
+        if (!alarm->due)
+            continue;
+        alarm->due = false;
+
+        alarm_callback_t callback = alarm->callback;
+        int64_t again = callback(alarm->id, alarm->user_data);
+        if (alarm->callback != callback)
+            continue;       // cancelled from its own callback
+        if (again == 0) {
+            alarm->callback = NULL;
+            continue;
+        }
+        // Negative: from when it was due; positive: from now
+        alarm->at_us = again < 0 ? alarm->at_us - again : now_ns / 1000 + again;
+        arm_alarm(alarm);
+    }
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+    (void)fire_if_past;
+    for (uint i = 0; i < ALARM_COUNT; i++) {
+        alarm_t *alarm = &alarms[i];
+        if (alarm->callback)
+            continue;
+        alarm->id = ++next_alarm_id;
+        alarm->at_us = now_ns / 1000 + us;
+        alarm->callback = callback;
+        alarm->user_data = user_data;
+        arm_alarm(alarm);
+        return alarm->id;
+    }
+    return -1;
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+    for (uint i = 0; i < ALARM_COUNT; i++) {
+        if (alarms[i].callback && alarms[i].id == alarm_id) {
+            alarms[i].callback = NULL;
+            alarms[i].due = false;
+            alarms[i].generation++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int64_t repeating_timer_callback(alarm_id_t id, void *user_data)
+{
+    struct repeating_timer *rt = user_data;
+    if (rt->callback(rt))
+        return rt->delay_us;
+    rt->alarm_id = 0;
+    return 0;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            struct repeating_timer *out)
+{
+    if (delay_us == 0)
+        delay_us = 1;
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = add_alarm_in_us(delay_us < 0 ? -delay_us : delay_us, repeating_timer_callback, out, true);
+    return out->alarm_id > 0;
+}
+
+bool cancel_repeating_timer(struct repeating_timer *timer)
+{
+    bool cancelled = timer->alarm_id && cancel_alarm(timer->alarm_id);
+    timer->alarm_id = 0;
+    return cancelled;
+}
+
+struct alarm_pool {
+    uint core;
+};
+
+static alarm_pool_t default_pool;
+
+alarm_pool_t *alarm_pool_get_default(void)
+{
+    return &default_pool;
+}
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers)
+{
+    (void)max_timers;
+    return &default_pool;
+}
+
+uint alarm_pool_core_num(alarm_pool_t *pool)
+{
+    return pool->core;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback,
+                                       void *user_data, struct repeating_timer *out)
+{
+    (void)pool;
+    return add_repeating_timer_us(delay_us, callback, user_data, out);
+}
+
+// Flash: reads go straight to sim_flash through XIP_BASE
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES)
+        panic("sim: bad flash erase %#x + %zu", flash_offs, count);
+    memset(sim_flash + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES)
+        panic("sim: bad flash program %#x + %zu", flash_offs, count);
+    // Programming can only clear bits
+    for (size_t i = 0; i < count; i++)
+        sim_flash[flash_offs + i] &= data[i];
+}
+
+bool sim_flash_load(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return false;
+    size_t n = fread(sim_flash, 1, sizeof(sim_flash), file);
+    fclose(file);
+    return n == sizeof(sim_flash);
+}
+
+bool sim_flash_save(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+    size_t n = fwrite(sim_flash, 1, sizeof(sim_flash), file);
+    return fclose(file) == 0 && n == sizeof(sim_flash);
+}
+
+// stdio
+
+bool stdio_init_all(void)
+{
+    return true;
+}
+
+void stdio_flush(void)
+{
+    fflush(stdout);
+}
+
+int putchar_raw(int c)
+{
+    return putchar(c);
+}
+
+void panic(const char *format, ...)
+{
+    fflush(stdout);
+    fprintf(stderr, "*** PANIC at %.6f s ***\n", now_ns / 1e9);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(2);
+}
+
+void sim_init(void)
+{
+    now_ns = 0;
+    event_count = 0;
+    events_scheduled = 0;
+    thread_hook = NULL;
+    stopped = false;
+
+    memset(vtable, 0, sizeof(vtable));
+    memset(shared_count, 0, sizeof(shared_count));
+    irq_enabled = 0;
+    irq_pending = 0;
+    primask = false;
+    current_exception = 0;
+    next_spin_lock = 0;
+
+    memset(alarms, 0, sizeof(alarms));
+    next_alarm_id = 0;
+    irq_set_exclusive_handler(ALARM_IRQ, alarm_irq_handler);
+    irq_set_enabled(ALARM_IRQ, true);
+
+    memset(sim_flash, 0xFF, sizeof(sim_flash));
+
+    sim_gpio_init();
+    sim_pwm_init();
+    sim_adc_init();
+    sim_dma_init();
+    sim_i2c_init();
+}
@@ -0,0 +1,95 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/types.h"
+#include "hardware/i2c.h"
+
+// Host stand-in for the Pico SDK (sim/include), seen from the simulated
+// world's side. There is one thread and one clock, in nanoseconds, which
+// only moves when the firmware waits or reads it and when the scheduler
+// idles. The world puts events on the clock's queue; an event changes
+// what the peripherals see (a pin level, an ADC input) and may raise an
+// IRQ, which runs as soon as interrupts are unmasked. Nothing depends on
+// the host's speed, so the same inputs give the same run every time.
+//
+// Firmware code itself takes no simulated time, except that every clock
+// read from thread mode lets SIM_CLOCK_READ_NS pass. That is enough for
+// busy-wait loops to make progress, and for a higher priority task that
+// became ready meanwhile to preempt the one spinning.
+
+#define SIM_CLOCK_READ_NS 1000
+
+typedef void (*sim_event_fn_t)(void *context);
+
+// Reset every peripheral, erase the flash, clock to 0
+void sim_init(void);
+
+uint64_t sim_now_ns(void);
+
+// Run fn(context) when the clock reaches at_ns (now if earlier). Events at
+// the same time run in the order they were scheduled
+void sim_schedule(uint64_t at_ns, sim_event_fn_t fn, void *context);
+
+// Run the events and IRQs due up to at_ns and leave the clock there
+void sim_advance_to(uint64_t at_ns);
+
+// Thread code busy for ns: the clock moves on, then the thread hook may
+// switch tasks
+void sim_spend_ns(uint64_t ns);
+
+// Called after thread code let time pass with interrupts enabled (the
+// scheduler's preemption point)
+void sim_set_thread_hook(void (*hook)(void));
+
+// End of the run: the scheduler returns from vTaskStartScheduler() at its
+// next chance
+void sim_stop(void);
+bool sim_stopped(void);
+
+// A pin driven by the world. Edges latch GPIO events as on the chip
+void sim_gpio_drive(uint gpio, bool level);
+
+// Called whenever the firmware changes an output pin's level
+typedef void (*sim_gpio_output_fn_t)(uint gpio, bool level);
+void sim_set_gpio_output_callback(sim_gpio_output_fn_t callback);
+
+// Duty cycle 0..1 of a pin set to GPIO_FUNC_PWM, 0 while its slice is off
+float sim_pwm_duty(uint gpio);
+
+// 12-bit value of ADC input 0..4 at the current time
+typedef uint16_t (*sim_adc_source_fn_t)(uint input);
+void sim_set_adc_source(sim_adc_source_fn_t source);
+
+// A target on an I2C bus. A write transfer hands over all its bytes at
+// once (register pointer first); reads take one byte at a time
+typedef struct {
+    void (*write)(void *context, const uint8_t *data, size_t length);
+    uint8_t (*read)(void *context);
+    void *context;
+} sim_i2c_target_t;
+
+void sim_i2c_attach(i2c_inst_t *i2c, uint8_t addr, const sim_i2c_target_t *target);
+
+// Keep the flash image in a file between runs. Loading a missing file
+// leaves the flash erased
+bool sim_flash_load(const char *path);
+bool sim_flash_save(const char *path);
+
+// Run the IRQs that are pending and enabled, if interrupts are unmasked
+void sim_deliver_irqs(void);
+
+// For the other HAL files: pend an IRQ, and the IO bank and DMA hooks
+void sim_irq_pend(uint irq);
+void sim_gpio_init(void);
+void sim_gpio_update_irq(void);
+void sim_pwm_init(void);
+void sim_adc_init(void);
+void sim_dma_init(void);
+void sim_i2c_init(void);
+bool sim_dma_push(uint dreq, uint32_t value);
+bool sim_dma_pull(uint dreq, uint32_t *value);
+void sim_i2c_dma_started(uint index);
+
+#endif
@@ -0,0 +1,760 @@
+#include <string.h>
+#include "hal.h"
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+
+#define EDGE_EVENTS (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL)
+
+// ADC clock and conversion time in ADC clock cycles
+#define ADC_CLOCK_HZ 48000000
+#define ADC_CONVERSION_CYCLES 96
+#define ADC_FIFO_DEPTH 4
+
+#define I2C_TARGETS 4
+
+// GPIO
+
+static uint32_t gpio_dir;
+static uint32_t gpio_out;
+static uint32_t gpio_in;
+static uint32_t gpio_in_invert;     // input overrides
+static uint32_t gpio_in_low;
+static uint32_t gpio_in_high;
+static uint8_t gpio_function[NUM_BANK0_GPIOS];
+static uint8_t gpio_irq_enabled[NUM_BANK0_GPIOS];
+static uint8_t gpio_edges[NUM_BANK0_GPIOS];       // latched, until acknowledged
+static gpio_irq_callback_t gpio_callback;
+static sim_gpio_output_fn_t output_callback;
+
+void sim_gpio_init(void)
+{
+    gpio_dir = 0;
+    gpio_out = 0;
+    gpio_in = 0;
+    gpio_in_invert = 0;
+    gpio_in_low = 0;
+    gpio_in_high = 0;
+    memset(gpio_function, GPIO_FUNC_NULL, sizeof(gpio_function));
+    memset(gpio_irq_enabled, 0, sizeof(gpio_irq_enabled));
+    memset(gpio_edges, 0, sizeof(gpio_edges));
+    gpio_callback = NULL;
+    output_callback = NULL;
+}
+
+static uint32_t gpio_events(uint gpio)
+{
+    bool level = (gpio_get_all() >> gpio) & 1u;
+    uint32_t events = gpio_edges[gpio] | (level ? GPIO_IRQ_LEVEL_HIGH : GPIO_IRQ_LEVEL_LOW);
+    return events & gpio_irq_enabled[gpio];
+}
+
+void sim_gpio_update_irq(void)
+{
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (gpio_events(gpio)) {
+            sim_irq_pend(IO_IRQ_BANK0);
+            return;
+        }
+    }
+}
+
+// Input edges and output edges alike, as the pad sees them
+static void gpio_level_changed(uint32_t before)
+{
+    uint32_t changed = before ^ gpio_get_all();
+    if (!changed)
+        return;
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (changed & (1u << gpio))
+            gpio_edges[gpio] |= (before >> gpio) & 1u ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE;
+    }
+    sim_gpio_update_irq();
+}
+
+void sim_gpio_drive(uint gpio, bool level)
+{
+    uint32_t before = gpio_get_all();
+    gpio_in = (gpio_in & ~(1u << gpio)) | ((uint32_t)level << gpio);
+    gpio_level_changed(before);
+}
+
+void sim_set_gpio_output_callback(sim_gpio_output_fn_t callback)
+{
+    output_callback = callback;
+}
+
+void gpio_init(uint gpio)
+{
+    gpio_init_mask(1u << gpio);
+}
+
+void gpio_init_mask(uint32_t mask)
+{
+    gpio_dir &= ~mask;
+    gpio_out &= ~mask;
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (mask & (1u << gpio))
+            gpio_function[gpio] = GPIO_FUNC_SIO;
+    }
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    gpio_function[gpio] = (uint8_t)fn;
+}
+
+enum gpio_function gpio_get_function(uint gpio)
+{
+    return (enum gpio_function)gpio_function[gpio];
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down)
+{
+    (void)gpio;
+    (void)up;
+    (void)down;
+}
+
+void gpio_set_inover(uint gpio, uint value)
+{
+    uint32_t before = gpio_get_all();
+    uint32_t bit = 1u << gpio;
+    gpio_in_invert = value == GPIO_OVERRIDE_INVERT ? gpio_in_invert | bit : gpio_in_invert & ~bit;
+    gpio_in_low = value == GPIO_OVERRIDE_LOW ? gpio_in_low | bit : gpio_in_low & ~bit;
+    gpio_in_high = value == GPIO_OVERRIDE_HIGH ? gpio_in_high | bit : gpio_in_high & ~bit;
+    gpio_level_changed(before);
+    sim_deliver_irqs();
+}
+
+void gpio_set_dir_masked(uint32_t mask, uint32_t value)
+{
+    uint32_t before = gpio_get_all();
+    gpio_dir = (gpio_dir & ~mask) | (value & mask);
+    gpio_level_changed(before);
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value)
+{
+    uint32_t before = gpio_get_all();
+    gpio_out = (gpio_out & ~mask) | (value & mask);
+    uint32_t changed = (before ^ gpio_get_all()) & gpio_dir;
+    gpio_level_changed(before);
+
+    for (uint gpio = 0; changed && output_callback && gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (changed & (1u << gpio))
+            output_callback(gpio, (gpio_out >> gpio) & 1u);
+    }
+}
+
+uint32_t gpio_get_all(void)
+{
+    uint32_t in = ((gpio_in ^ gpio_in_invert) & ~gpio_in_low) | gpio_in_high;
+    return (gpio_out & gpio_dir) | (in & ~gpio_dir);
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+    // Enabling an edge clears any stale one, as the SDK does
+    gpio_edges[gpio] &= ~(event_mask & EDGE_EVENTS);
+    if (enabled)
+        gpio_irq_enabled[gpio] |= (uint8_t)event_mask;
+    else
+        gpio_irq_enabled[gpio] &= (uint8_t)~event_mask;
+    sim_gpio_update_irq();
+}
+
+static void gpio_default_irq_handler(void)
+{
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        uint32_t events = gpio_events(gpio);
+        if (events) {
+            gpio_acknowledge_irq(gpio, events);
+            gpio_callback(gpio, events);
+        }
+    }
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback)
+{
+    if (!gpio_callback)
+        irq_add_shared_handler(IO_IRQ_BANK0, gpio_default_irq_handler, PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY);
+    gpio_callback = callback;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio)
+{
+    return gpio_events(gpio);
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask)
+{
+    gpio_edges[gpio] &= (uint8_t)~event_mask;
+}
+
+// PWM
+
+static struct {
+    uint16_t wrap;
+    uint16_t level[2];
+    bool enabled;
+} pwm_slices[NUM_PWM_SLICES];
+
+void sim_pwm_init(void)
+{
+    for (uint i = 0; i < NUM_PWM_SLICES; i++) {
+        pwm_slices[i].wrap = 0xFFFF;
+        pwm_slices[i].level[0] = 0;
+        pwm_slices[i].level[1] = 0;
+        pwm_slices[i].enabled = false;
+    }
+}
+
+float sim_pwm_duty(uint gpio)
+{
+    if (gpio_function[gpio] != GPIO_FUNC_PWM)
+        return 0.0f;
+    uint slice = pwm_gpio_to_slice_num(gpio);
+    if (!pwm_slices[slice].enabled)
+        return 0.0f;
+    float duty = (float)pwm_slices[slice].level[pwm_gpio_to_channel(gpio)] / ((float)pwm_slices[slice].wrap + 1.0f);
+    return duty > 1.0f ? 1.0f : duty;
+}
+
+void pwm_set_clkdiv(uint slice_num, float divider)
+{
+    // The counter is not modelled, only the duty cycle
+    (void)slice_num;
+    (void)divider;
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap)
+{
+    pwm_slices[slice_num].wrap = wrap;
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled)
+{
+    pwm_slices[slice_num].enabled = enabled;
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level)
+{
+    pwm_slices[slice_num].level[chan] = level;
+}
+
+// ADC
+
+static adc_hw_t adc_regs;
+adc_hw_t *const adc_hw = &adc_regs;
+
+static struct {
+    sim_adc_source_fn_t source;
+    uint input;
+    uint round_robin;
+    bool fifo_enabled;
+    bool dreq_enabled;
+    float clkdiv;
+    bool running;
+    uint32_t generation;        // bumped on stop, so a queued conversion is dropped
+    uint16_t fifo[ADC_FIFO_DEPTH];
+    uint fifo_count;
+} adc;
+
+void sim_adc_init(void)
+{
+    // The source is the world's and the generation must keep counting
+    sim_adc_source_fn_t source = adc.source;
+    uint32_t generation = adc.generation;
+    memset(&adc, 0, sizeof(adc));
+    adc.source = source;
+    adc.generation = generation;
+}
+
+void sim_set_adc_source(sim_adc_source_fn_t source)
+{
+    adc.source = source;
+}
+
+static uint16_t adc_convert(void)
+{
+    uint16_t value = adc.source ? adc.source(adc.input) & 0xFFF : 0;
+    if (adc.round_robin) {
+        // Next input in the mask after the current one
+        for (uint i = 1; i <= NUM_ADC_CHANNELS; i++) {
+            uint next = (adc.input + i) % NUM_ADC_CHANNELS;
+            if (adc.round_robin & (1u << next)) {
+                adc.input = next;
+                break;
+            }
+        }
+    }
+    return value;
+}
+
+static uint64_t adc_period_ns(void)
+{
+    float cycles = adc.clkdiv < ADC_CONVERSION_CYCLES ? ADC_CONVERSION_CYCLES : adc.clkdiv + 1.0f;
+    return (uint64_t)(cycles * (1e9f / ADC_CLOCK_HZ));
+}
+
+static void adc_conversion_event(void *context)
+{
+    if (!adc.running || (uintptr_t)context != adc.generation)
+        return;
+
+    uint16_t value = adc_convert();
+    if (adc.fifo_enabled && !(adc.dreq_enabled && sim_dma_push(DREQ_ADC, value)) &&
+        adc.fifo_count < ADC_FIFO_DEPTH)
+        adc.fifo[adc.fifo_count++] = value;
+    sim_schedule(sim_now_ns() + adc_period_ns(), adc_conversion_event, context);
+}
+
+void adc_init(void)
+{
+    adc_run(false);
+    sim_adc_init();
+}
+
+void adc_gpio_init(uint gpio)
+{
+    gpio_set_function(gpio, GPIO_FUNC_NULL);
+    gpio_set_dir(gpio, GPIO_IN);
+}
+
+void adc_select_input(uint input)
+{
+    adc.input = input;
+}
+
+uint adc_get_selected_input(void)
+{
+    return adc.input;
+}
+
+void adc_set_round_robin(uint input_mask)
+{
+    adc.round_robin = input_mask;
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift)
+{
+    (void)dreq_thresh;
+    (void)err_in_fifo;
+    (void)byte_shift;
+    adc.fifo_enabled = en;
+    adc.dreq_enabled = dreq_en;
+}
+
+void adc_set_clkdiv(float clkdiv)
+{
+    adc.clkdiv = clkdiv;
+}
+
+void adc_run(bool run)
+{
+    if (run == adc.running)
+        return;
+    adc.running = run;
+    adc.generation++;
+    if (run)
+        sim_schedule(sim_now_ns() + adc_period_ns(), adc_conversion_event, (void *)(uintptr_t)adc.generation);
+}
+
+void adc_fifo_drain(void)
+{
+    adc.fifo_count = 0;
+}
+
+bool adc_fifo_is_empty(void)
+{
+    return adc.fifo_count == 0;
+}
+
+uint16_t adc_fifo_get(void)
+{
+    if (adc.fifo_count == 0)
+        return 0;
+    uint16_t value = adc.fifo[0];
+    memmove(adc.fifo, adc.fifo + 1, --adc.fifo_count * sizeof(adc.fifo[0]));
+    return value;
+}
+
+uint16_t adc_read(void)
+{
+    sim_spend_ns(adc_period_ns() > 2000 ? 2000 : adc_period_ns());
+    return adc_convert();
+}
+
+// DMA
+
+typedef struct {
+    bool claimed;
+    dma_channel_config config;
+    volatile uint8_t *read_addr;
+    volatile uint8_t *write_addr;
+    uint32_t trans_count;       // reloaded on every trigger
+    uint32_t remaining;
+    bool busy;
+    bool irq_raised;
+    bool irq0_enabled;
+    bool irq1_enabled;
+} dma_channel_t;
+
+static dma_channel_t dma[NUM_DMA_CHANNELS];
+
+static void dma_trigger(uint channel);
+
+void sim_dma_init(void)
+{
+    memset(dma, 0, sizeof(dma));
+}
+
+static void dma_complete(uint channel)
+{
+    dma_channel_t *ch = &dma[channel];
+    ch->busy = false;
+    ch->irq_raised = true;
+    if (ch->irq0_enabled)
+        sim_irq_pend(DMA_IRQ_0);
+    if (ch->irq1_enabled)
+        sim_irq_pend(DMA_IRQ_1);
+    if (ch->config.chain_to != channel)
+        dma_trigger(ch->config.chain_to);
+}
+
+static uint32_t dma_read_element(dma_channel_t *ch)
+{
+    uint32_t value = 0;
+    memcpy(&value, (const void *)ch->read_addr, 1u << ch->config.size);
+    if (ch->config.read_increment)
+        ch->read_addr += 1u << ch->config.size;
+    return value;
+}
+
+static void dma_write_element(dma_channel_t *ch, uint32_t value)
+{
+    memcpy((void *)ch->write_addr, &value, 1u << ch->config.size);
+    if (ch->config.write_increment)
+        ch->write_addr += 1u << ch->config.size;
+}
+
+static void dma_trigger(uint channel)
+{
+    dma_channel_t *ch = &dma[channel];
+    ch->remaining = ch->trans_count;
+    ch->busy = true;
+
+    uint dreq = ch->config.dreq;
+    if (dreq == DREQ_FORCE) {
+        // Unpaced: memory to memory, done at once
+        while (ch->remaining > 0) {
+            dma_write_element(ch, dma_read_element(ch));
+            ch->remaining--;
+        }
+        dma_complete(channel);
+    } else if (dreq == DREQ_I2C0_TX || dreq == DREQ_I2C1_TX) {
+        sim_i2c_dma_started((dreq - DREQ_I2C0_TX) / 2);
+    } else if (ch->remaining == 0) {
+        dma_complete(channel);
+    }
+}
+
+bool sim_dma_push(uint dreq, uint32_t value)
+{
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        dma_channel_t *ch = &dma[channel];
+        if (!ch->busy || ch->config.dreq != dreq)
+            continue;
+        dma_write_element(ch, value);
+        if (--ch->remaining == 0)
+            dma_complete(channel);
+        return true;
+    }
+    return false;
+}
+
+bool sim_dma_pull(uint dreq, uint32_t *value)
+{
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        dma_channel_t *ch = &dma[channel];
+        if (!ch->busy || ch->config.dreq != dreq)
+            continue;
+        *value = dma_read_element(ch);
+        if (--ch->remaining == 0)
+            dma_complete(channel);
+        return true;
+    }
+    return false;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (!dma[channel].claimed) {
+            dma[channel].claimed = true;
+            return (int)channel;
+        }
+    }
+    if (required)
+        panic("sim: no DMA channels left");
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+    dma[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    return (dma_channel_config){
+        .size = DMA_SIZE_32,
+        .read_increment = true,
+        .write_increment = false,
+        .dreq = DREQ_FORCE,
+        .chain_to = (uint8_t)channel,
+        .enable = true,
+    };
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma[channel].config = *config;
+    dma[channel].write_addr = write_addr;
+    dma[channel].read_addr = (volatile uint8_t *)read_addr;
+    dma[channel].trans_count = transfer_count;
+    if (trigger)
+        dma_trigger(channel);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void *read_addr, bool trigger)
+{
+    dma[channel].read_addr = (volatile uint8_t *)read_addr;
+    if (trigger)
+        dma_trigger(channel);
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void *write_addr, bool trigger)
+{
+    dma[channel].write_addr = write_addr;
+    if (trigger)
+        dma_trigger(channel);
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger)
+{
+    dma[channel].trans_count = trans_count;
+    if (trigger)
+        dma_trigger(channel);
+}
+
+void dma_channel_start(uint channel)
+{
+    dma_trigger(channel);
+}
+
+void dma_channel_abort(uint channel)
+{
+    dma[channel].busy = false;
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+    return dma[channel].busy;
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+    dma[channel].irq0_enabled = enabled;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled)
+{
+    dma[channel].irq1_enabled = enabled;
+}
+
+bool dma_channel_get_irq0_status(uint channel)
+{
+    return dma[channel].irq_raised && dma[channel].irq0_enabled;
+}
+
+bool dma_channel_get_irq1_status(uint channel)
+{
+    return dma[channel].irq_raised && dma[channel].irq1_enabled;
+}
+
+void dma_channel_acknowledge_irq0(uint channel)
+{
+    dma[channel].irq_raised = false;
+}
+
+void dma_channel_acknowledge_irq1(uint channel)
+{
+    dma[channel].irq_raised = false;
+}
+
+// I2C
+
+typedef struct {
+    uint8_t addr;
+    sim_i2c_target_t target;
+} i2c_target_slot_t;
+
+typedef struct {
+    i2c_target_slot_t targets[I2C_TARGETS];
+    uint target_count;
+    const sim_i2c_target_t *active;     // addressed target, NULL after a NACK
+    uint8_t written[64];                // write transfer being collected
+    size_t written_count;
+} i2c_bus_t;
+
+static i2c_hw_t i2c_regs[2];
+static i2c_bus_t i2c_buses[2];
+i2c_inst_t i2c0_inst = {&i2c_regs[0], 0};
+i2c_inst_t i2c1_inst = {&i2c_regs[1], 0};
+
+static i2c_inst_t *const i2c_instances[2] = {&i2c0_inst, &i2c1_inst};
+
+void sim_i2c_init(void)
+{
+    memset(i2c_regs, 0, sizeof(i2c_regs));
+    memset(i2c_buses, 0, sizeof(i2c_buses));
+}
+
+void sim_i2c_attach(i2c_inst_t *i2c, uint8_t addr, const sim_i2c_target_t *target)
+{
+    i2c_bus_t *bus = &i2c_buses[i2c_hw_index(i2c)];
+    if (bus->target_count == I2C_TARGETS)
+        panic("sim: too many I2C targets");
+    bus->targets[bus->target_count++] = (i2c_target_slot_t){addr, *target};
+}
+
+// Time on the wire for bytes plus the address byte, 9 clocks each
+static uint64_t i2c_bytes_ns(i2c_inst_t *i2c, size_t bytes)
+{
+    uint baudrate = i2c->baudrate ? i2c->baudrate : 100000;
+    return (uint64_t)(bytes + 1) * 9 * 1000000000ull / baudrate;
+}
+
+// Hand a collected write transfer to the target
+static void i2c_flush_write(i2c_bus_t *bus)
+{
+    if (bus->active && bus->written_count > 0)
+        bus->active->write(bus->active->context, bus->written, bus->written_count);
+    bus->written_count = 0;
+}
+
+static bool i2c_start(i2c_bus_t *bus, uint8_t addr)
+{
+    i2c_flush_write(bus);
+    bus->active = NULL;
+    for (uint i = 0; i < bus->target_count; i++) {
+        if (bus->targets[i].addr == addr)
+            bus->active = &bus->targets[i].target;
+    }
+    return bus->active != NULL;
+}
+
+static void i2c_write_byte(i2c_bus_t *bus, uint8_t byte)
+{
+    if (bus->written_count < sizeof(bus->written))
+        bus->written[bus->written_count++] = byte;
+}
+
+static uint8_t i2c_read_byte(i2c_bus_t *bus)
+{
+    i2c_flush_write(bus);
+    return bus->active ? bus->active->read(bus->active->context) : 0xFF;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+    i2c->baudrate = baudrate;
+    i2c->hw->enable = 1;
+    return baudrate;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    i2c_bus_t *bus = &i2c_buses[i2c_hw_index(i2c)];
+    bool acked = i2c_start(bus, addr);
+    sim_spend_ns(i2c_bytes_ns(i2c, acked ? len : 0));
+    if (!acked)
+        return PICO_ERROR_GENERIC;
+    for (size_t i = 0; i < len; i++)
+        i2c_write_byte(bus, src[i]);
+    if (!nostop)
+        i2c_flush_write(bus);
+    return (int)len;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    (void)nostop;
+    // A register pointer written with nostop reaches the target first
+    i2c_bus_t *bus = &i2c_buses[i2c_hw_index(i2c)];
+    if (!i2c_start(bus, addr)) {
+        sim_spend_ns(i2c_bytes_ns(i2c, 0));
+        return PICO_ERROR_GENERIC;
+    }
+    sim_spend_ns(i2c_bytes_ns(i2c, len));
+    for (size_t i = 0; i < len; i++)
+        dst[i] = i2c_read_byte(bus);
+    return (int)len;
+}
+
+// DMA-driven transfer: the TX channel holds IC_DATA_CMD words. The bus
+// time of the whole sequence passes, then the words are played out: data
+// bytes are written, read commands fetch a byte for the RX channel
+static void i2c_dma_event(void *context)
+{
+    uint index = (uint)(uintptr_t)context;
+    i2c_hw_t *hw = &i2c_regs[index];
+    i2c_bus_t *bus = &i2c_buses[index];
+    uint tx_dreq = DREQ_I2C0_TX + 2 * index;
+
+    if (!i2c_start(bus, (uint8_t)hw->tar)) {
+        // NACK: the block flushes its TX FIFO and raises TX_ABRT
+        hw->intr_stat |= I2C_IC_INTR_STAT_R_TX_ABRT_BITS;
+        if (hw->intr_mask & I2C_IC_INTR_MASK_M_TX_ABRT_BITS)
+            sim_irq_pend(I2C0_IRQ + index);
+        return;
+    }
+
+    uint32_t word;
+    while (sim_dma_pull(tx_dreq, &word)) {
+        if (word & I2C_IC_DATA_CMD_RESTART_BITS)
+            i2c_flush_write(bus);
+        if (word & I2C_IC_DATA_CMD_CMD_BITS) {
+            uint8_t byte = i2c_read_byte(bus);
+            if (!sim_dma_push(tx_dreq + 1, byte))
+                hw->rxflr++;
+        } else {
+            i2c_write_byte(bus, (uint8_t)word);
+        }
+        if (word & I2C_IC_DATA_CMD_STOP_BITS)
+            i2c_flush_write(bus);
+    }
+}
+
+void sim_i2c_dma_started(uint index)
+{
+    uint tx_dreq = DREQ_I2C0_TX + 2 * index;
+    uint32_t words = 0;
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (dma[channel].busy && dma[channel].config.dreq == tx_dreq)
+            words += dma[channel].remaining;
+    }
+
+    // Each restart sends the address again; one covers the usual
+    // sub-address then read
+    i2c_regs[index].intr_stat = 0;
+    uint64_t ns = i2c_bytes_ns(i2c_instances[index], words + 1);
+    sim_schedule(sim_now_ns() + ns, i2c_dma_event, (void *)(uintptr_t)index);
+}
@@ -0,0 +1,39 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The part of the FreeRTOS API the firmware uses, on a deterministic
+// scheduler with host contexts as task stacks (sim/rtos.c). Priority
+// preemptive like the real kernel, on one core, with the simulated clock
+// as the run-time counter. Settings match driver/wifi/FreeRTOSConfig.h
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 32
+#define configMINIMAL_STACK_SIZE 256
+#define configMAX_TASK_NAME_LEN 16
+#define configGENERATE_RUN_TIME_STATS 1
+
+#define tskIDLE_PRIORITY 0
+#define portMAX_DELAY ((TickType_t)0xffffffffu)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+
+// Masks interrupts like the single-core port
+void vTaskEnterCritical(void);
+void vTaskExitCritical(void);
+
+#define taskENTER_CRITICAL() vTaskEnterCritical()
+#define taskEXIT_CRITICAL() vTaskExitCritical()
+
+#endif
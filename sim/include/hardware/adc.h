@@ -0,0 +1,34 @@
+#ifndef SIM_HARDWARE_ADC_H
+#define SIM_HARDWARE_ADC_H
+
+#include "pico/types.h"
+
+// 12-bit ADC with round robin, a FIFO with DREQ and the free-running clock
+// divider. Each conversion asks the simulated world for the input's value
+// (sim_set_adc_source()) at the time it is converted
+
+#define NUM_ADC_CHANNELS 5
+#define DREQ_ADC 36
+
+typedef struct {
+    volatile uint32_t fifo;     // address for DMA configuration only
+} adc_hw_t;
+
+extern adc_hw_t *const adc_hw;
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+uint adc_get_selected_input(void);
+void adc_set_round_robin(uint input_mask);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+void adc_fifo_drain(void);
+bool adc_fifo_is_empty(void);
+uint16_t adc_fifo_get(void);
+
+// One blocking conversion of the selected input
+uint16_t adc_read(void);
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+
+#include "pico/types.h"
+#include "hardware/irq.h"
+
+// Bank 0 pins. Inputs follow what the simulated world drives onto them
+// (sim_gpio_drive()); edges latch into the per-pin event bits and raise
+// IO_IRQ_BANK0 like the real interrupt controller
+
+#define NUM_BANK0_GPIOS 30
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function {
+    GPIO_FUNC_XIP = 0,
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_GPCK = 8,
+    GPIO_FUNC_USB = 9,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+enum gpio_irq_level {
+    GPIO_IRQ_LEVEL_LOW = 0x1u,
+    GPIO_IRQ_LEVEL_HIGH = 0x2u,
+    GPIO_IRQ_EDGE_FALL = 0x4u,
+    GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+enum gpio_override {
+    GPIO_OVERRIDE_NORMAL = 0,
+    GPIO_OVERRIDE_INVERT = 1,
+    GPIO_OVERRIDE_LOW = 2,
+    GPIO_OVERRIDE_HIGH = 3,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_init_mask(uint32_t mask);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+enum gpio_function gpio_get_function(uint gpio);
+void gpio_set_pulls(uint gpio, bool up, bool down);
+
+// Force what the pin's input reads, over what the world drives. An edge
+// interrupts at once, as on the chip
+void gpio_set_inover(uint gpio, uint value);
+
+static inline void gpio_pull_up(uint gpio)
+{
+    gpio_set_pulls(gpio, true, false);
+}
+
+static inline void gpio_pull_down(uint gpio)
+{
+    gpio_set_pulls(gpio, false, true);
+}
+
+static inline void gpio_disable_pulls(uint gpio)
+{
+    gpio_set_pulls(gpio, false, false);
+}
+
+void gpio_set_dir_masked(uint32_t mask, uint32_t value);
+
+static inline void gpio_set_dir(uint gpio, bool out)
+{
+    gpio_set_dir_masked(1u << gpio, (uint32_t)out << gpio);
+}
+
+static inline void gpio_set_dir_out_masked(uint32_t mask)
+{
+    gpio_set_dir_masked(mask, mask);
+}
+
+static inline void gpio_set_dir_in_masked(uint32_t mask)
+{
+    gpio_set_dir_masked(mask, 0);
+}
+
+// Output register, SIO style
+void gpio_put_masked(uint32_t mask, uint32_t value);
+
+static inline void gpio_put(uint gpio, bool value)
+{
+    gpio_put_masked(1u << gpio, (uint32_t)value << gpio);
+}
+
+static inline void gpio_set_mask(uint32_t mask)
+{
+    gpio_put_masked(mask, mask);
+}
+
+static inline void gpio_clr_mask(uint32_t mask)
+{
+    gpio_put_masked(mask, 0);
+}
+
+// Pin levels: outputs read back what they drive, inputs what the world drives
+uint32_t gpio_get_all(void);
+
+static inline bool gpio_get(uint gpio)
+{
+    return (gpio_get_all() >> gpio) & 1u;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+
+static inline void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled,
+                                                      gpio_irq_callback_t callback)
+{
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    gpio_set_irq_callback(callback);
+    if (enabled)
+        irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio);
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask);
+
+// Shared IO_IRQ_BANK0 handler for one pin's events
+static inline void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler)
+{
+    (void)gpio;
+    irq_add_shared_handler(IO_IRQ_BANK0, handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SIM_HARDWARE_I2C_H
+#define SIM_HARDWARE_I2C_H
+
+#include "pico/types.h"
+#include "hardware/dma.h"
+
+// I2C controllers with simulated targets on the bus (sim_i2c_attach()).
+// The blocking calls let the bus time pass; DMA transfers work on the
+// IC_DATA_CMD command words like the DW_apb_i2c block does
+
+typedef struct {
+    volatile uint32_t enable;
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t intr_stat;
+    volatile uint32_t intr_mask;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t rxflr;
+    volatile uint32_t dma_cr;
+} i2c_hw_t;
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+    uint baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_INTR_STAT_R_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040u
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x00000002u
+#define I2C_IC_DMA_CR_RDMAE_BITS 0x00000001u
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c)
+{
+    return i2c->hw;
+}
+
+static inline uint i2c_hw_index(i2c_inst_t *i2c)
+{
+    return i2c == i2c1;
+}
+
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx)
+{
+    return DREQ_I2C0_TX + 2 * i2c_hw_index(i2c) + !is_tx;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+#endif
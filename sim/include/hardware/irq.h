@@ -0,0 +1,49 @@
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include "pico/types.h"
+
+// NVIC: one pending bit per IRQ, taken lowest number first whenever the
+// clock moves and interrupts are not masked. Handlers are called through a
+// vector table (scb_hw->vtor), so code that patches it works as on the chip
+
+#define TIMER_IRQ_0 0
+#define TIMER_IRQ_1 1
+#define TIMER_IRQ_2 2
+#define TIMER_IRQ_3 3
+#define PWM_IRQ_WRAP 4
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define IO_IRQ_BANK0 13
+#define SIO_IRQ_PROC0 15
+#define SIO_IRQ_PROC1 16
+#define ADC_IRQ_FIFO 22
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+#define NUM_IRQS 32
+
+#define VTABLE_FIRST_IRQ 16
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#define PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY 0xff
+#define PICO_SHARED_IRQ_HANDLER_LOWEST_ORDER_PRIORITY 0x00
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_enabled(uint num, bool enabled);
+bool irq_is_enabled(uint num);
+void irq_set_pending(uint num);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+irq_handler_t irq_get_vtable_handler(uint num);
+
+static inline void irq_set_priority(uint num, uint8_t hardware_priority)
+{
+    (void)num;
+    (void)hardware_priority;
+}
+
+// Exception number being handled, 0 in thread mode
+uint __get_current_exception(void);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SIM_HARDWARE_PWM_H
+#define SIM_HARDWARE_PWM_H
+
+#include "pico/types.h"
+
+// Eight slices of two channels; the simulated world reads each pin's duty
+// cycle (sim_pwm_duty()), the counter itself is not modelled
+
+#define NUM_PWM_SLICES 8
+
+enum pwm_chan {
+    PWM_CHAN_A = 0,
+    PWM_CHAN_B = 1,
+};
+
+static inline uint pwm_gpio_to_slice_num(uint gpio)
+{
+    return (gpio >> 1) & 7u;
+}
+
+static inline uint pwm_gpio_to_channel(uint gpio)
+{
+    return gpio & 1u;
+}
+
+void pwm_set_clkdiv(uint slice_num, float divider);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+
+static inline void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b)
+{
+    pwm_set_chan_level(slice_num, PWM_CHAN_A, level_a);
+    pwm_set_chan_level(slice_num, PWM_CHAN_B, level_b);
+}
+
+static inline void pwm_set_gpio_level(uint gpio, uint16_t level)
+{
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SIM_HARDWARE_STRUCTS_SCB_H
+#define SIM_HARDWARE_STRUCTS_SCB_H
+
+#include "pico/types.h"
+
+// Only the vector table offset: it holds the simulator's vector table
+typedef struct {
+    uintptr_t vtor;
+} armv6m_scb_hw_t;
+
+extern armv6m_scb_hw_t *const scb_hw;
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include "pico/types.h"
+
+// PRIMASK: with interrupts disabled pending IRQs wait until they are
+// restored. Spin locks only mask interrupts, there is no other core
+
+#define PICO_SPINLOCK_ID_STRIPED_FIRST 16
+#define NUM_SPIN_LOCKS 32
+
+typedef volatile uint32_t spin_lock_t;
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+int spin_lock_claim_unused(bool required);
+
+static inline spin_lock_t *spin_lock_init(uint lock_num)
+{
+    return spin_lock_instance(lock_num);
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock)
+{
+    (void)lock;
+    return save_and_disable_interrupts();
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq)
+{
+    (void)lock;
+    restore_interrupts(saved_irq);
+}
+
+static inline void __sev(void)
+{
+}
+
+static inline void __wfe(void)
+{
+}
+
+static inline void __wfi(void)
+{
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include "pico/types.h"
+
+// The simulated 1 MHz timer. Reading it from task code lets
+// SIM_CLOCK_READ_US pass, so busy-wait loops make progress (sim/hal.h)
+
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void)
+{
+    return (uint32_t)time_us_64();
+}
+
+void busy_wait_us(uint64_t us);
+
+static inline void busy_wait_us_32(uint32_t us)
+{
+    busy_wait_us(us);
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef SIM_MESSAGE_BUFFER_H
+#define SIM_MESSAGE_BUFFER_H
+
+#include "FreeRTOS.h"
+
+// Each message costs its length plus a size_t header, as in the kernel
+
+typedef struct sim_message_buffer *MessageBufferHandle_t;
+
+MessageBufferHandle_t xMessageBufferCreate(size_t size);
+size_t xMessageBufferSend(MessageBufferHandle_t buffer, const void *data, size_t length, TickType_t ticks_to_wait);
+size_t xMessageBufferReceive(MessageBufferHandle_t buffer, void *data, size_t max_length, TickType_t ticks_to_wait);
+
+#endif
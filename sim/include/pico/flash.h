@@ -0,0 +1,24 @@
+#ifndef SIM_PICO_FLASH_H
+#define SIM_PICO_FLASH_H
+
+#include "pico/types.h"
+#include "hardware/sync.h"
+
+// One core and nothing runs from flash: the operation just runs with
+// interrupts off, as it would on the calling core
+
+static inline int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms)
+{
+    (void)enter_exit_timeout_ms;
+    uint32_t irq_state = save_and_disable_interrupts();
+    func(param);
+    restore_interrupts(irq_state);
+    return PICO_OK;
+}
+
+static inline bool flash_safe_execute_core_init(void)
+{
+    return true;
+}
+
+#endif
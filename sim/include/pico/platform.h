@@ -0,0 +1,14 @@
+#ifndef SIM_PICO_PLATFORM_H
+#define SIM_PICO_PLATFORM_H
+
+#include "pico/types.h"
+
+// Everything runs as core 0; the second core's state exists but stays idle
+#define NUM_CORES 2
+
+static inline uint get_core_num(void)
+{
+    return 0;
+}
+
+#endif
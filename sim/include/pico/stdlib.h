@@ -0,0 +1,17 @@
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdio.h>
+#include "pico/types.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+// stdio goes to the host's stdout; putchar_raw() bytes too, so binary log
+// frames can be piped into tools/log_decoder
+
+bool stdio_init_all(void);
+void stdio_flush(void);
+int putchar_raw(int c);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include "pico/types.h"
+#include "hardware/timer.h"
+
+// Sleeps and timeouts on the simulated clock. Repeating timers and alarms
+// fire from the timer IRQ of the default alarm pool, as on the chip
+
+#define PICO_TIME_DEFAULT_ALARM_POOL_HARDWARE_ALARM_NUM 3
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *rt);
+
+struct repeating_timer {
+    int64_t delay_us;
+    alarm_id_t alarm_id;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline absolute_time_t get_absolute_time(void)
+{
+    return time_us_64();
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+    return t;
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return time_us_64() + us;
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return make_timeout_time_us(1000ull * ms);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return (int64_t)(to - from);
+}
+
+static inline bool time_reached(absolute_time_t t)
+{
+    return time_us_64() >= t;
+}
+
+// Negative delay: period from one callback start to the next; positive:
+// from the end of one to the start of the next (the same thing here)
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            struct repeating_timer *out);
+bool cancel_repeating_timer(struct repeating_timer *timer);
+
+// One core, so one pool: every pool is the default one
+typedef struct alarm_pool alarm_pool_t;
+
+alarm_pool_t *alarm_pool_get_default(void);
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(uint max_timers);
+uint alarm_pool_core_num(alarm_pool_t *pool);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us, repeating_timer_callback_t callback,
+                                       void *user_data, struct repeating_timer *out);
+
+static inline alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data,
+                                         bool fire_if_past)
+{
+    return add_alarm_in_us(1000ull * ms, callback, user_data, fire_if_past);
+}
+
+static inline bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback,
+                                          void *user_data, struct repeating_timer *out)
+{
+    return add_repeating_timer_us(1000ll * delay_ms, callback, user_data, out);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SIM_PICO_TYPES_H
+#define SIM_PICO_TYPES_H
+
+// Host build of the Pico SDK basics the drivers use (see sim/hal.h)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+// Microseconds since boot, on the simulated clock
+typedef uint64_t absolute_time_t;
+
+#define __unused __attribute__((unused))
+#define __not_in_flash_func(func) func
+#define __time_critical_func(func) func
+#define __no_inline_not_in_flash_func(func) __attribute__((noinline)) func
+#define __force_inline inline __attribute__((always_inline))
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC (-1)
+#define PICO_ERROR_TIMEOUT (-2)
+
+void panic(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+#define hard_assert(x) ((x) ? (void)0 : panic("hard_assert failed: %s (%s:%d)", #x, __FILE__, __LINE__))
+
+#define __compiler_memory_barrier() __asm__ volatile("" ::: "memory")
+
+// The firmware runs on one host thread, but the ring test puts producer
+// and consumer on two, so this is a real fence as on the chip
+static inline void __dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void tight_loop_contents(void)
+{
+}
+
+#endif
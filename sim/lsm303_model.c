@@ -0,0 +1,195 @@
+#include <math.h>
+#include <string.h>
+#include "world.h"
+#include "hal.h"
+#include "board_pins.h"
+#include "magnetometer.h"
+
+#define PI 3.14159265358979323846
+
+// Registers the driver uses (magnetometer.c)
+#define ACCEL_CTRL_REG1 0x20
+#define ACCEL_CTRL_REG4 0x23
+#define ACCEL_STATUS_REG 0x27
+#define ACCEL_OUT_X_L 0x28
+#define ACCEL_OUT_Z_H 0x2D
+#define ACCEL_AUTO_INCREMENT 0x80
+#define ACCEL_STATUS_ZYXDA 0x08
+#define ACCEL_STATUS_ZYXOR 0x80
+
+#define MAG_CRA_REG 0x00
+#define MAG_CRB_REG 0x01
+#define MAG_MR_REG 0x02
+#define MAG_OUT_X_H 0x03
+#define MAG_OUT_Y_L 0x08
+#define MAG_SR_REG 0x09
+#define MAG_SR_DRDY 0x01
+
+// 1 g at +/-2 g full scale, left-justified 12-bit
+#define ACCEL_ONE_G 16000.0
+#define ACCEL_NOISE 40.0
+
+// Earth's field, gauss: horizontal towards north, vertical pointing down
+#define FIELD_HORIZONTAL 0.25
+#define FIELD_VERTICAL 0.4
+#define MAG_XY_LSB_PER_GAUSS 1100.0    // +/-1.3 gauss range
+#define MAG_Z_LSB_PER_GAUSS 980.0
+#define MAG_NOISE 3.0
+
+// What the car's own motors and chassis add, for the calibration to remove
+static const double hard_iron[3] = {60.0, -40.0, 25.0};
+static const double soft_iron[3] = {1.0, 1.1, 1.0};
+
+static const double accel_odr_hz[16] = {0, 1, 10, 25, 50, 100, 200, 400, 1620, 1344};
+static const double mag_odr_hz[8] = {0.75, 1.5, 3, 7.5, 15, 30, 75, 220};
+
+typedef struct {
+    uint8_t reg[0x40];
+    uint8_t pointer;
+    bool auto_increment;
+    uint64_t read_index;        // last sample whose output was read out
+} device_t;
+
+static device_t accel;
+static device_t mag;
+
+// Samples converted so far at the configured data rate; 0 while off
+static uint64_t sample_index(double odr_hz)
+{
+    return odr_hz > 0 ? (uint64_t)(sim_now_ns() * 1e-9 * odr_hz) : 0;
+}
+
+static uint64_t accel_index(void)
+{
+    if (!(accel.reg[ACCEL_CTRL_REG1] & 0x07))
+        return 0;
+    return sample_index(accel_odr_hz[accel.reg[ACCEL_CTRL_REG1] >> 4]);
+}
+
+static uint64_t mag_index(void)
+{
+    if ((mag.reg[MAG_MR_REG] & 0x03) != 0)
+        return 0;       // not in continuous conversion
+    return sample_index(mag_odr_hz[(mag.reg[MAG_CRA_REG] >> 2) & 0x07]);
+}
+
+static void put_le(uint8_t *out, double value)
+{
+    int16_t v = (int16_t)fmax(-32768.0, fmin(32767.0, value));
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)((uint16_t)v >> 8);
+}
+
+static void put_be(uint8_t *out, double value)
+{
+    int16_t v = (int16_t)fmax(-2048.0, fmin(2047.0, value));
+    out[0] = (uint8_t)((uint16_t)v >> 8);
+    out[1] = (uint8_t)v;
+}
+
+// A fresh sample into the output registers. The car stays level, so the
+// accelerometer only sees gravity
+static void accel_convert(void)
+{
+    put_le(&accel.reg[ACCEL_OUT_X_L], world_noise(ACCEL_NOISE));
+    put_le(&accel.reg[ACCEL_OUT_X_L + 2], world_noise(ACCEL_NOISE));
+    put_le(&accel.reg[ACCEL_OUT_X_L + 4], ACCEL_ONE_G + world_noise(ACCEL_NOISE));
+}
+
+// Body frame X forward, Y left, Z up: facing north the field is along +X
+static void mag_convert(void)
+{
+    double psi = world_heading() * (PI / 180.0);
+    double field[3] = {
+        FIELD_HORIZONTAL * cos(psi) * MAG_XY_LSB_PER_GAUSS,
+        FIELD_HORIZONTAL * sin(psi) * MAG_XY_LSB_PER_GAUSS,
+        -FIELD_VERTICAL * MAG_Z_LSB_PER_GAUSS,
+    };
+    double m[3];
+    for (int i = 0; i < 3; i++)
+        m[i] = field[i] * soft_iron[i] + hard_iron[i] + world_noise(MAG_NOISE);
+
+    // X, Z, Y order, big-endian
+    put_be(&mag.reg[MAG_OUT_X_H], m[0]);
+    put_be(&mag.reg[MAG_OUT_X_H + 2], m[2]);
+    put_be(&mag.reg[MAG_OUT_X_H + 4], m[1]);
+}
+
+static void accel_write(void *context, const uint8_t *data, size_t length)
+{
+    accel.pointer = data[0] & 0x7F;
+    accel.auto_increment = data[0] & ACCEL_AUTO_INCREMENT;
+    for (size_t i = 1; i < length; i++) {
+        if (accel.pointer == ACCEL_CTRL_REG1 || accel.pointer == ACCEL_CTRL_REG4)
+            accel.reg[accel.pointer] = data[i];
+        if (accel.auto_increment)
+            accel.pointer = (accel.pointer + 1) & 0x3F;
+    }
+}
+
+static uint8_t accel_read(void *context)
+{
+    uint8_t reg = accel.pointer;
+    uint64_t index = accel_index();
+
+    if (reg == ACCEL_STATUS_REG) {
+        uint8_t status = 0;
+        if (index > accel.read_index)
+            status |= ACCEL_STATUS_ZYXDA;
+        if (index > accel.read_index + 1)
+            status |= ACCEL_STATUS_ZYXOR;
+        accel.reg[reg] = status;
+    }
+    // The output latches when its first byte is read and counts as read
+    // with its last
+    if (reg == ACCEL_OUT_X_L)
+        accel_convert();
+    if (reg == ACCEL_OUT_Z_H)
+        accel.read_index = index;
+
+    uint8_t value = accel.reg[reg];
+    if (accel.auto_increment)
+        accel.pointer = (accel.pointer + 1) & 0x3F;
+    return value;
+}
+
+static void mag_write(void *context, const uint8_t *data, size_t length)
+{
+    mag.pointer = data[0];
+    for (size_t i = 1; i < length; i++) {
+        if (mag.pointer <= MAG_MR_REG)
+            mag.reg[mag.pointer] = data[i];
+        mag.pointer = (mag.pointer + 1) & 0x3F;
+    }
+}
+
+static uint8_t mag_read(void *context)
+{
+    uint8_t reg = mag.pointer;
+    uint64_t index = mag_index();
+
+    if (reg == MAG_SR_REG)
+        mag.reg[reg] = index > mag.read_index ? MAG_SR_DRDY : 0;
+    if (reg == MAG_OUT_X_H)
+        mag_convert();
+    if (reg == MAG_OUT_Y_L)
+        mag.read_index = index;
+
+    uint8_t value = mag.reg[reg];
+    mag.pointer = (mag.pointer + 1) & 0x3F;
+    return value;
+}
+
+void lsm303_model_init(void)
+{
+    memset(&accel, 0, sizeof(accel));
+    memset(&mag, 0, sizeof(mag));
+    mag.reg[MAG_CRA_REG] = 0x10;        // 15 Hz
+    mag.reg[MAG_CRB_REG] = 0x20;
+    mag.reg[MAG_MR_REG] = 0x03;         // sleep
+
+    static const sim_i2c_target_t accel_target = {accel_write, accel_read, NULL};
+    static const sim_i2c_target_t mag_target = {mag_write, mag_read, NULL};
+    sim_i2c_attach(IMU_I2C_PORT, LSM303_ACCEL_ADDR, &accel_target);
+    sim_i2c_attach(IMU_I2C_PORT, LSM303_MAG_ADDR, &mag_target);
+}
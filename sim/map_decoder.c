@@ -0,0 +1,141 @@
+// Rebuilds the maze map the car streams through its binary log
+// (LOG_MAP_CHUNK, Partial_Integration.c) and draws it. Reads
+// tools/log_decoder's output, so it works on the USB console, UDP and the
+// simulator alike:
+//
+//   build-sim/robot_sim -n 3 | build-sim/log_decoder | build-sim/map_decoder
+//   log_decoder /dev/ttyACM0 | build-sim/map_decoder -a
+//
+//   map_decoder [-a] [file]
+//       Draw the last complete map at the end of the input, or every map as
+//       it completes with -a: '#' occupied, '.' free, blank unknown, 'o' the
+//       cell the car started in. Records with a bad CRC are counted and skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "byte_order.h"
+#include "grid.h"
+
+#define CHUNK_WORDS 5
+#define CHUNK_BYTES (4 * CHUNK_WORDS)
+#define CHUNKS ((GRID_RECORD_SIZE + CHUNK_BYTES - 1) / CHUNK_BYTES)
+
+static uint8_t record[CHUNKS * CHUNK_BYTES];
+static bool received[CHUNKS];
+static unsigned received_count;
+
+static grid_t map;
+static bool have_map;
+static unsigned maps;
+static unsigned bad_records;
+
+static void draw(const grid_t *grid)
+{
+    int min_x = GRID_WIDTH, max_x = -1, min_y = GRID_HEIGHT, max_y = -1;
+    unsigned known = 0, occupied = 0;
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        for (int x = 0; x < GRID_WIDTH; x++) {
+            grid_cell_t cell = grid_get(grid, x, y);
+            if (cell == GRID_UNKNOWN)
+                continue;
+            known++;
+            occupied += cell == GRID_OCCUPIED;
+            min_x = x < min_x ? x : min_x;
+            max_x = x > max_x ? x : max_x;
+            min_y = y < min_y ? y : min_y;
+            max_y = y > max_y ? y : max_y;
+        }
+    }
+
+    printf("Map %u: %d x %d cells of %d cm, %u known, %u occupied\n", maps, GRID_WIDTH, GRID_HEIGHT,
+           GRID_CELL_CM, known, occupied);
+    if (known == 0)
+        return;
+
+    // North up
+    for (int y = max_y; y >= min_y; y--) {
+        for (int x = min_x; x <= max_x; x++) {
+            grid_cell_t cell = grid_get(grid, x, y);
+            if (x == GRID_ORIGIN_X && y == GRID_ORIGIN_Y)
+                putchar('o');
+            else
+                putchar(cell == GRID_OCCUPIED ? '#' : cell == GRID_FREE ? '.' : ' ');
+        }
+        putchar('\n');
+    }
+}
+
+static void add_chunk(unsigned offset, const uint32_t words[CHUNK_WORDS], bool print_all)
+{
+    if (offset % CHUNK_BYTES || offset / CHUNK_BYTES >= CHUNKS)
+        return;
+
+    // Every copy of the map starts at offset 0
+    if (offset == 0) {
+        memset(received, 0, sizeof(received));
+        received_count = 0;
+    }
+    unsigned chunk = offset / CHUNK_BYTES;
+    for (int i = 0; i < CHUNK_WORDS; i++)
+        put_le32(record + offset + 4 * i, words[i]);
+    if (!received[chunk]) {
+        received[chunk] = true;
+        received_count++;
+    }
+    if (received_count < CHUNKS)
+        return;
+
+    received_count = 0;
+    memset(received, 0, sizeof(received));
+    if (!grid_decode(record, &map)) {
+        bad_records++;
+        return;
+    }
+    have_map = true;
+    maps++;
+    if (print_all) {
+        draw(&map);
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool print_all = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a")) != -1) {
+        switch (opt) {
+        case 'a':
+            print_all = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-a] [file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    FILE *in = optind < argc ? fopen(argv[optind], "r") : stdin;
+    if (!in) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), in)) {
+        const char *p = strstr(line, "Map: record at ");
+        unsigned offset;
+        uint32_t words[CHUNK_WORDS];
+        if (p && sscanf(p, "Map: record at %u: %x %x %x %x %x", &offset, &words[0], &words[1], &words[2],
+                        &words[3], &words[4]) == 1 + CHUNK_WORDS)
+            add_chunk(offset, words, print_all);
+    }
+
+    if (have_map && !print_all)
+        draw(&map);
+    fprintf(stderr, "%u maps, %u bad records\n", maps, bad_records);
+    return have_map ? 0 : 1;
+}
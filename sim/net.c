@@ -0,0 +1,63 @@
+#include "net.h"
+#include "command.h"
+#include "log_udp.h"
+#include "telemetry.h"
+#include "wifi.h"
+
+static FILE *trace;
+static telemetry_stats_t stats;
+
+void sim_net_set_trace(FILE *file)
+{
+    trace = file;
+}
+
+bool wifi_connect(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    return false;
+}
+
+bool telemetry_start(const telemetry_config_t *config)
+{
+    (void)config;
+    return false;
+}
+
+// One CSV row per record, every field raw as on the wire
+void telemetry_record(const telemetry_record_t *record)
+{
+    if (!trace)
+        return;
+    stats.records++;
+    fprintf(trace, "%lu", (unsigned long)record->timestamp_us);
+    for (int i = 0; i < TELEMETRY_MAX_FIELDS; i++)
+        fprintf(trace, ",%ld", (long)record->field[i]);
+    fputc('\n', trace);
+}
+
+void telemetry_get_stats(telemetry_stats_t *out)
+{
+    *out = stats;
+}
+
+bool log_udp_start(const char *host, uint16_t port, uint32_t period_ms)
+{
+    (void)host;
+    (void)port;
+    (void)period_ms;
+    return false;
+}
+
+uint32_t log_udp_send_errors(void)
+{
+    return 0;
+}
+
+bool command_server_start(uint16_t port, uint8_t opcode_count)
+{
+    (void)port;
+    (void)opcode_count;
+    return false;
+}
+
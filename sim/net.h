@@ -0,0 +1,11 @@
+#ifndef SIM_NET_H
+#define SIM_NET_H
+
+#include <stdio.h>
+
+// There is no network in the simulator: Wi-Fi never connects, so the
+// firmware runs as it does without TELEMETRY_HOST. Telemetry records still
+// reach telemetry_record(), and go to this CSV file if one is set
+void sim_net_set_trace(FILE *file);
+
+#endif
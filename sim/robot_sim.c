@@ -0,0 +1,142 @@
+// Runs the integrated firmware (Partial_Integration) on the host against
+// the mock HAL and the simulated car. See sim/CMakeLists.txt to build.
+//
+//   robot_sim [-n laps] [-t seconds] [-s seed] [-o x,y,size] [-f flash.bin] [-r trace.csv]
+//       Drive until the car has done the laps (default 3) or the simulated
+//       time runs out (default 120 s). -s picks the noise and motor
+//       mismatch; the same seed gives the same run. -o puts a box of that
+//       size in the world. -f keeps the flash in a file, so a second run
+//       skips the IR calibration. -r writes every telemetry record as CSV.
+//
+// The firmware's console, status text and binary log frames, goes to
+// stdout (pipe it through tools/log_decoder). The run summary goes to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "net.h"
+#include "world.h"
+
+#define MONITOR_PERIOD_NS 10000000ull  // 10 ms
+
+// Partial_Integration.c's main(), renamed by the build
+int robot_main(void);
+
+static uint32_t lap_target = 3;
+static uint64_t time_limit_ns = 120000000000ull;
+
+static void monitor(void *context)
+{
+    world_status_t status;
+    world_get_status(&status);
+    if (status.laps >= lap_target || sim_now_ns() >= time_limit_ns) {
+        sim_stop();
+        return;
+    }
+    sim_schedule(sim_now_ns() + MONITOR_PERIOD_NS, monitor, NULL);
+}
+
+static double host_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_summary(double host_elapsed)
+{
+    world_status_t status;
+    world_get_status(&status);
+    double seconds = sim_now_ns() * 1e-9;
+
+    fprintf(stderr, "time %.3f s simulated, %.3f s host (%.0fx)\n",
+            seconds, host_elapsed, host_elapsed > 0 ? seconds / host_elapsed : 0.0);
+    fprintf(stderr, "laps %u, progress %.1f cm of %.1f cm per lap\n",
+            status.laps, status.progress_cm, world_track_length());
+    uint64_t previous_us = 0;
+    for (uint32_t i = 0; i < status.laps && i < WORLD_MAX_LAPS; i++) {
+        fprintf(stderr, "lap %u %.3f s\n", i + 1, (status.lap_end_us[i] - previous_us) * 1e-6);
+        previous_us = status.lap_end_us[i];
+    }
+    fprintf(stderr, "driven %.1f cm, distance from the line mean %.2f cm max %.2f cm\n",
+            status.odometer_cm, status.line_samples ? status.line_distance_sum / status.line_samples : 0.0,
+            status.line_distance_max);
+    fprintf(stderr, "pose x %.1f cm y %.1f cm heading %.1f deg, %u pings, %u steps against a wall\n",
+            status.pose.x, status.pose.y, status.pose.heading, status.pings, status.collisions);
+}
+
+int main(int argc, char **argv)
+{
+    world_config_t config = {0};
+    const char *flash_path = NULL;
+    const char *trace_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:s:o:f:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            lap_target = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            time_limit_ns = (uint64_t)(strtod(optarg, NULL) * 1e9);
+            break;
+        case 's':
+            config.seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            if (sscanf(optarg, "%lf,%lf,%lf", &config.obstacle_x, &config.obstacle_y,
+                       &config.obstacle_size) != 3)
+                goto usage;
+            config.obstacle = true;
+            break;
+        case 'f':
+            flash_path = optarg;
+            break;
+        case 'r':
+            trace_path = optarg;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc)
+        goto usage;
+
+    sim_init();
+    if (flash_path)
+        sim_flash_load(flash_path);
+    world_init(&config);
+
+    FILE *trace = NULL;
+    if (trace_path) {
+        trace = fopen(trace_path, "w");
+        if (!trace) {
+            perror(trace_path);
+            return 1;
+        }
+        sim_net_set_trace(trace);
+    }
+
+    sim_schedule(MONITOR_PERIOD_NS, monitor, NULL);
+
+    double host_start = host_seconds();
+    robot_main();
+    fflush(stdout);
+    print_summary(host_seconds() - host_start);
+
+    if (trace)
+        fclose(trace);
+    if (flash_path && !sim_flash_save(flash_path)) {
+        perror(flash_path);
+        return 1;
+    }
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-n laps] [-t seconds] [-s seed] [-o x,y,size] [-f flash.bin] [-r trace.csv]\n",
+            argv[0]);
+    return 2;
+}
@@ -0,0 +1,375 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "hal.h"
+#include "FreeRTOS.h"
+#include "message_buffer.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "task.h"
+
+// FreeRTOS on the simulated clock. Every task runs on its own host stack
+// (ucontext) and the scheduler loop on the main one, so exactly one task
+// runs at a time and switches happen only where the real kernel could
+// switch: when a task blocks, when it wakes a higher priority task, and
+// when time passes in thread code (sim_spend_ns()) while a higher priority
+// task's delay or timeout ran out. Ties go round robin. With nothing ready
+// the clock jumps to the next wake-up, and that time is the IDLE task's.
+
+#define MAX_TASKS 16
+
+// Host code needs far more stack than the firmware's words
+#define HOST_STACK_BYTES (256 * 1024)
+
+#define FOREVER UINT64_MAX
+
+typedef enum {
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DELETED,
+} task_state_t;
+
+struct sim_task {
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t number;
+    UBaseType_t priority;
+    uint32_t stack_depth;
+    TaskFunction_t code;
+    void *params;
+    ucontext_t context;
+    void *stack;
+
+    task_state_t state;
+    const void *waiting_on;     // object that wakes it, NULL for a delay
+    uint64_t wake_us;           // timeout, FOREVER for none
+    bool timed_out;
+    uint32_t notify;
+
+    uint64_t last_ran;          // round robin among equal priorities
+    uint64_t run_time_us;
+};
+
+struct sim_message_buffer {
+    uint8_t *data;
+    size_t size;
+    size_t head;                // next byte written
+    size_t used;
+};
+
+static struct sim_task tasks[MAX_TASKS];
+static uint task_count;
+static struct sim_task *current;
+static ucontext_t scheduler_context;
+static uint64_t switches;
+static uint64_t idle_time_us;
+static uint32_t critical_nesting;
+static uint32_t critical_saved;
+
+static uint64_t now_us(void)
+{
+    return sim_now_ns() / 1000;
+}
+
+static uint64_t deadline_us(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+        return FOREVER;
+    return now_us() + (uint64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+// Blocked tasks whose timeout ran out are ready again
+static void wake_expired(void)
+{
+    uint64_t now = now_us();
+    for (uint i = 0; i < task_count; i++) {
+        if (tasks[i].state == TASK_BLOCKED && tasks[i].wake_us <= now) {
+            tasks[i].state = TASK_READY;
+            tasks[i].timed_out = true;
+        }
+    }
+}
+
+static struct sim_task *highest_ready(void)
+{
+    struct sim_task *best = NULL;
+    for (uint i = 0; i < task_count; i++) {
+        struct sim_task *task = &tasks[i];
+        if (task->state != TASK_READY)
+            continue;
+        if (!best || task->priority > best->priority ||
+            (task->priority == best->priority && task->last_ran < best->last_ran))
+            best = task;
+    }
+    return best;
+}
+
+static void yield_to_scheduler(void)
+{
+    swapcontext(&current->context, &scheduler_context);
+}
+
+// Switch away if the run is over or someone more urgent is ready
+static void preempt_check(void)
+{
+    if (!current)
+        return;
+    wake_expired();
+    struct sim_task *next = highest_ready();
+    if (sim_stopped() || (next && next->priority > current->priority))
+        yield_to_scheduler();
+}
+
+// Block the current task until wake_waiters(object) or the deadline.
+// Returns false on timeout
+static bool block_on(const void *object, uint64_t wake_us)
+{
+    if (!current)
+        panic("sim: blocking call outside a task");
+    if (wake_us <= now_us())
+        return false;
+    current->state = TASK_BLOCKED;
+    current->waiting_on = object;
+    current->wake_us = wake_us;
+    current->timed_out = false;
+    yield_to_scheduler();
+    return !current->timed_out;
+}
+
+static void wake_waiters(const void *object)
+{
+    for (uint i = 0; i < task_count; i++) {
+        if (tasks[i].state == TASK_BLOCKED && tasks[i].waiting_on == object && object) {
+            tasks[i].state = TASK_READY;
+            tasks[i].timed_out = false;
+        }
+    }
+}
+
+static void task_entry(void)
+{
+    current->code(current->params);
+    // Returning from a task function is a bug on the real kernel
+    panic("sim: task %s returned", current->name);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack_depth, void *params,
+                       UBaseType_t priority, TaskHandle_t *created)
+{
+    if (task_count == MAX_TASKS || priority >= configMAX_PRIORITIES)
+        return pdFAIL;
+
+    struct sim_task *task = &tasks[task_count];
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->number = ++task_count;
+    task->priority = priority;
+    task->stack_depth = stack_depth;
+    task->code = code;
+    task->params = params;
+    task->state = TASK_READY;
+    task->wake_us = FOREVER;
+    task->stack = malloc(HOST_STACK_BYTES);
+    if (!task->stack)
+        panic("sim: no memory for task %s", name);
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = HOST_STACK_BYTES;
+    task->context.uc_link = NULL;
+    makecontext(&task->context, task_entry, 0);
+
+    if (created)
+        *created = task;
+    return pdPASS;
+}
+
+static void thread_hook(void)
+{
+    preempt_check();
+}
+
+void vTaskStartScheduler(void)
+{
+    sim_set_thread_hook(thread_hook);
+
+    while (!sim_stopped()) {
+        wake_expired();
+        struct sim_task *task = highest_ready();
+        if (!task) {
+            // Idle until the next timeout; with none, a tick at a time
+            uint64_t wake = now_us() + 1000000 / configTICK_RATE_HZ;
+            for (uint i = 0; i < task_count; i++) {
+                if (tasks[i].state == TASK_BLOCKED && tasks[i].wake_us < wake)
+                    wake = tasks[i].wake_us;
+            }
+            idle_time_us += wake - now_us();
+            sim_advance_to(wake * 1000);
+            continue;
+        }
+
+        current = task;
+        task->last_ran = ++switches;
+        uint64_t start = now_us();
+        swapcontext(&scheduler_context, &task->context);
+        task->run_time_us += now_us() - start;
+        current = NULL;
+    }
+
+    sim_set_thread_hook(NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+        preempt_check();
+    else
+        block_on(NULL, deadline_us(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+{
+    // Late already: carry on without blocking, like the kernel
+    *previous_wake += period;
+    uint64_t wake_us = (uint64_t)*previous_wake * (1000000 / configTICK_RATE_HZ);
+    block_on(NULL, wake_us);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notify++;
+    wake_waiters(task);
+    preempt_check();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    uint64_t wake_us = deadline_us(ticks_to_wait);
+    while (current->notify == 0) {
+        if (!block_on(current, wake_us))
+            return 0;
+    }
+    uint32_t value = current->notify;
+    current->notify = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t max, uint32_t *total_run_time)
+{
+    // The tasks plus IDLE. Stack use on the host says nothing about the
+    // target, so every task reports its whole stack free
+    UBaseType_t count = task_count + 1;
+    if (count > max)
+        return 0;
+
+    for (uint i = 0; i < task_count; i++) {
+        status[i] = (TaskStatus_t){
+            .xHandle = &tasks[i],
+            .pcTaskName = tasks[i].name,
+            .xTaskNumber = tasks[i].number,
+            .eCurrentState = &tasks[i] == current ? eRunning :
+                             tasks[i].state == TASK_READY ? eReady : eBlocked,
+            .uxCurrentPriority = tasks[i].priority,
+            .uxBasePriority = tasks[i].priority,
+            .ulRunTimeCounter = (uint32_t)tasks[i].run_time_us,
+            .usStackHighWaterMark = (uint16_t)tasks[i].stack_depth,
+        };
+    }
+    status[task_count] = (TaskStatus_t){
+        .pcTaskName = "IDLE",
+        .xTaskNumber = task_count + 1,
+        .eCurrentState = eReady,
+        .ulRunTimeCounter = (uint32_t)idle_time_us,
+        .usStackHighWaterMark = configMINIMAL_STACK_SIZE,
+    };
+    if (total_run_time)
+        *total_run_time = (uint32_t)now_us();
+    return count;
+}
+
+void vTaskEnterCritical(void)
+{
+    uint32_t saved = save_and_disable_interrupts();
+    if (critical_nesting++ == 0)
+        critical_saved = saved;
+}
+
+void vTaskExitCritical(void)
+{
+    if (--critical_nesting == 0)
+        restore_interrupts(critical_saved);
+}
+
+MessageBufferHandle_t xMessageBufferCreate(size_t size)
+{
+    struct sim_message_buffer *buffer = calloc(1, sizeof(*buffer));
+    if (!buffer || !(buffer->data = malloc(size)))
+        panic("sim: no memory for a message buffer");
+    buffer->size = size;
+    return buffer;
+}
+
+static void ring_copy_in(struct sim_message_buffer *buffer, const void *data, size_t length)
+{
+    const uint8_t *in = data;
+    for (size_t i = 0; i < length; i++) {
+        buffer->data[buffer->head] = in[i];
+        buffer->head = (buffer->head + 1) % buffer->size;
+    }
+    buffer->used += length;
+}
+
+static void ring_copy_out(const struct sim_message_buffer *buffer, size_t offset, void *data, size_t length)
+{
+    uint8_t *out = data;
+    size_t tail = (buffer->head + buffer->size - buffer->used) % buffer->size;
+    for (size_t i = 0; i < length; i++)
+        out[i] = buffer->data[(tail + offset + i) % buffer->size];
+}
+
+size_t xMessageBufferSend(MessageBufferHandle_t buffer, const void *data, size_t length, TickType_t ticks_to_wait)
+{
+    size_t needed = length + sizeof(size_t);
+    if (needed > buffer->size)
+        return 0;
+
+    uint64_t wake_us = deadline_us(ticks_to_wait);
+    while (buffer->size - buffer->used < needed) {
+        if (!block_on(buffer, wake_us))
+            return 0;
+    }
+    ring_copy_in(buffer, &length, sizeof(length));
+    ring_copy_in(buffer, data, length);
+    wake_waiters(buffer);
+    preempt_check();
+    return length;
+}
+
+size_t xMessageBufferReceive(MessageBufferHandle_t buffer, void *data, size_t max_length, TickType_t ticks_to_wait)
+{
+    uint64_t wake_us = deadline_us(ticks_to_wait);
+    while (buffer->used == 0) {
+        if (!block_on(buffer, wake_us))
+            return 0;
+    }
+
+    size_t length;
+    ring_copy_out(buffer, 0, &length, sizeof(length));
+    if (length > max_length)
+        return 0;       // left in the buffer, as the kernel does
+    ring_copy_out(buffer, sizeof(length), data, length);
+    buffer->used -= sizeof(length) + length;
+    wake_waiters(buffer);
+    preempt_check();
+    return length;
+}
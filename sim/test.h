@@ -0,0 +1,19 @@
+#ifndef SIM_TEST_H
+#define SIM_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Host tests (sim/test_*.c) are plain executables that ctest runs. The
+// first check that fails prints where and why, and the test exits with 1
+#define CHECK(condition, ...)                                   \
+    do {                                                        \
+        if (!(condition)) {                                     \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);     \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fputc('\n', stderr);                                \
+            exit(1);                                            \
+        }                                                       \
+    } while (0)
+
+#endif
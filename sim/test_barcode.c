@@ -0,0 +1,201 @@
+// The Code 39 decoder on synthetic bars, fed as distance-tagged edges the
+// way the bottom IR sensor reports them: every character in both scan
+// directions, bar widths drifting along the scan, noise spikes, positions
+// wrapping past BARCODE_POSITION_MASK, a second barcode after a quiet
+// zone, and rejection of a corrupted character, a missing delimiter and
+// too little contrast between wide and narrow.
+
+#include <string.h>
+#include "test.h"
+#include "barcode.h"
+
+#define NARROW_CM 0.3
+#define WIDE_RATIO 2.5
+#define QUIET_CM 3.0
+
+// Same table as barcode.c: first element in the most significant bit, 1 = wide
+static const char chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%*";
+static const uint16_t patterns[] = {
+    0x034, 0x121, 0x061, 0x160, 0x031, 0x130, 0x070, 0x025, 0x124, 0x064,
+    0x109, 0x049, 0x148, 0x019, 0x118, 0x058, 0x00D, 0x10C, 0x04C, 0x01C,
+    0x103, 0x043, 0x142, 0x013, 0x112, 0x052, 0x007, 0x106, 0x046, 0x016,
+    0x181, 0x0C1, 0x1C0, 0x091, 0x190, 0x0D0, 0x085, 0x184, 0x0C4, 0x0A8,
+    0x0A2, 0x08A, 0x02A, 0x094,
+};
+
+typedef struct {
+    double widths[BARCODE_MAX_ELEMENTS];
+    uint count;
+} bars_t;
+
+// Bars and spaces of "*text*", narrow gaps between characters
+static void encode(const char *text, double wide_ratio, bars_t *bars)
+{
+    char framed[16];
+    snprintf(framed, sizeof(framed), "*%s*", text);
+    bars->count = 0;
+    for (const char *c = framed; *c; c++) {
+        const char *found = strchr(chars, *c);
+        CHECK(found, "no Code 39 for '%c'", *c);
+        uint16_t pattern = patterns[found - chars];
+        if (c != framed)
+            bars->widths[bars->count++] = NARROW_CM;
+        for (int i = 0; i < 9; i++)
+            bars->widths[bars->count++] = pattern & (0x100 >> i) ? NARROW_CM * wide_ratio : NARROW_CM;
+    }
+}
+
+static void reverse(bars_t *bars)
+{
+    for (uint i = 0; i < bars->count / 2; i++) {
+        double swap = bars->widths[i];
+        bars->widths[i] = bars->widths[bars->count - 1 - i];
+        bars->widths[bars->count - 1 - i] = swap;
+    }
+}
+
+static uint32_t position(double cm)
+{
+    return (uint32_t)(int64_t)(cm * Q16_ONE) & BARCODE_POSITION_MASK;
+}
+
+// Drive over the bars from start_cm, widths scaled by 1 + drift * (how far
+// along the barcode), then a quiet zone. Returns whether it decoded
+static bool scan(barcode_decoder_t *decoder, const bars_t *bars, double start_cm, double drift, char *text,
+                 size_t text_len)
+{
+    double total = 0;
+    for (uint i = 0; i < bars->count; i++)
+        total += bars->widths[i];
+
+    double cm = start_cm;
+    double along = 0;
+    bool decoded = barcode_feed(decoder, position(cm), true, text, text_len);
+    for (uint i = 0; i < bars->count; i++) {
+        along += bars->widths[i];
+        cm += bars->widths[i] * (1.0 + drift * along / total);
+        // Edges alternate: a bar ends on white, a space on black
+        decoded |= barcode_feed(decoder, position(cm), i % 2 != 0, text, text_len);
+    }
+    for (double quiet = 0.5; quiet <= QUIET_CM; quiet += 0.5)
+        decoded |= barcode_idle(decoder, position(cm + quiet), text, text_len);
+    return decoded;
+}
+
+static void check_scan(const char *text, bool reversed, double start_cm, double drift)
+{
+    bars_t bars;
+    encode(text, WIDE_RATIO, &bars);
+    if (reversed)
+        reverse(&bars);
+
+    barcode_decoder_t decoder;
+    barcode_init(&decoder);
+    char out[16] = "";
+    CHECK(scan(&decoder, &bars, start_cm, drift, out, sizeof(out)), "\"%s\"%s not decoded", text,
+          reversed ? " reversed" : "");
+    CHECK(strcmp(out, text) == 0, "\"%s\"%s decoded as \"%s\"", text, reversed ? " reversed" : "", out);
+}
+
+static void check_rejected(const bars_t *bars, const char *why)
+{
+    barcode_decoder_t decoder;
+    barcode_init(&decoder);
+    char out[16] = "";
+    CHECK(!scan(&decoder, bars, 10.0, 0.0, out, sizeof(out)), "%s: decoded as \"%s\"", why, out);
+}
+
+static void test_all_characters(void)
+{
+    // Every character but '*', ten at a time
+    const char *texts[] = {"0123456789", "ABCDEFGHIJ", "KLMNOPQRST", "UVWXYZ-. $", "/+%"};
+    for (uint i = 0; i < count_of(texts); i++) {
+        check_scan(texts[i], false, 10.0, 0.0);
+        check_scan(texts[i], true, 10.0, 0.0);
+    }
+}
+
+static void test_conditions(void)
+{
+    // Wheel slip or speed change: widths grow 30% or shrink 25% along the scan
+    check_scan("ROBOT", false, 10.0, 0.3);
+    check_scan("ROBOT", true, 10.0, -0.25);
+
+    // Positions wrap from BARCODE_POSITION_MASK to 0 in the middle
+    double wrap_cm = (BARCODE_POSITION_MASK + 1.0) / Q16_ONE;
+    check_scan("WRAP", false, wrap_cm - 4.0, 0.0);
+    check_scan("WRAP", true, wrap_cm - 4.0, 0.0);
+
+    // A speck of dirt inside a wide space, shorter than BARCODE_MIN_ELEMENT
+    bars_t bars;
+    encode("A1", WIDE_RATIO, &bars);
+    bars_t noisy = {.count = 0};
+    for (uint i = 0; i < bars.count; i++) {
+        if (i == 15 && bars.widths[i] > NARROW_CM) {
+            noisy.widths[noisy.count++] = bars.widths[i] / 2 - 0.02;
+            noisy.widths[noisy.count++] = 0.04;
+            noisy.widths[noisy.count++] = bars.widths[i] / 2 - 0.02;
+            continue;
+        }
+        noisy.widths[noisy.count++] = bars.widths[i];
+    }
+    CHECK(noisy.count == bars.count + 2, "element 15 of \"A1\" is not a wide space");
+    barcode_decoder_t decoder;
+    barcode_init(&decoder);
+    char out[16] = "";
+    CHECK(scan(&decoder, &noisy, 10.0, 0.0, out, sizeof(out)) && strcmp(out, "A1") == 0,
+          "noisy \"A1\" decoded as \"%s\"", out);
+
+    // Two barcodes in a row: the second bar after the quiet zone finishes
+    // the first barcode and starts the next scan
+    barcode_init(&decoder);
+    encode("12", WIDE_RATIO, &bars);
+    bars_t second;
+    encode("34", WIDE_RATIO, &second);
+    double cm = 10.0;
+    bool decoded = barcode_feed(&decoder, position(cm), true, out, sizeof(out));
+    for (uint i = 0; i < bars.count; i++) {
+        cm += bars.widths[i];
+        decoded |= barcode_feed(&decoder, position(cm), i % 2 != 0, out, sizeof(out));
+    }
+    CHECK(!decoded, "decoded before the quiet zone");
+    cm += QUIET_CM;
+    CHECK(barcode_feed(&decoder, position(cm), true, out, sizeof(out)) && strcmp(out, "12") == 0,
+          "first of two decoded as \"%s\"", out);
+    decoded = false;
+    for (uint i = 0; i < second.count; i++) {
+        cm += second.widths[i];
+        decoded |= barcode_feed(&decoder, position(cm), i % 2 != 0, out, sizeof(out));
+    }
+    CHECK(!decoded && barcode_idle(&decoder, position(cm + QUIET_CM), out, sizeof(out)) &&
+          strcmp(out, "34") == 0, "second of two decoded as \"%s\"", out);
+}
+
+static void test_rejected(void)
+{
+    bars_t bars;
+
+    // 'K' with its second wide element moved: 0x103 becomes 0x105, no character
+    encode("K", WIDE_RATIO, &bars);
+    double swap = bars.widths[10 + 7];
+    bars.widths[10 + 7] = bars.widths[10 + 6];
+    bars.widths[10 + 6] = swap;
+    check_rejected(&bars, "corrupted character");
+
+    // Stop character cut off
+    encode("OK", WIDE_RATIO, &bars);
+    bars.count -= 10;
+    check_rejected(&bars, "missing stop");
+
+    // Wide only 1.2 times narrow
+    encode("OK", 1.2, &bars);
+    check_rejected(&bars, "wide too narrow");
+}
+
+int main(void)
+{
+    test_all_characters();
+    test_conditions();
+    test_rejected();
+    return 0;
+}
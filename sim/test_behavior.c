@@ -0,0 +1,188 @@
+// The behaviour state machine on synthetic snapshots, without a planner or
+// a compass. Each transition in the table: a line seen and lost, an
+// obstacle, a cross line, maneuvers finishing and stalling, and the STOP
+// hold. Also what must not cause one: a stale distance, an obstacle in a
+// state without that row, a snapshot older than the maneuver the last
+// tick started, and a second event in the same tick. The maneuvers the
+// entry actions start, event priority, and the transition count and
+// latency in the stats.
+
+#include "hal.h"
+#include "test.h"
+#include "hardware/timer.h"
+#include "encoder.h"
+#include "board_pins.h"
+#include "behavior.h"
+#include "motion.h"
+#include "motor.h"
+#include "speed_control.h"
+
+#define MS 1000000ull
+
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+static line_follower_t follower;
+static behavior_t behavior;
+static uint32_t ir_sequence;
+static uint32_t transitions;
+
+// Nothing in sight, no line, the latest maneuver reported as motion
+static behavior_snapshot_t snapshot(motion_state_t motion)
+{
+    uint32_t now = time_us_32();
+    return (behavior_snapshot_t){
+        .now_us = now,
+        .ir_sequence = ++ir_sequence,
+        .ir_timestamp_us = now,
+        .distance_cm = 100.0f,
+        .distance_timestamp_us = now,
+        .motion = motion,
+        .maneuver = motion_get_maneuver(),
+    };
+}
+
+static void wait_ms(uint32_t ms)
+{
+    sim_advance_to(sim_now_ns() + ms * MS);
+}
+
+static void expect(const behavior_snapshot_t *s, behavior_state_t state, const char *what)
+{
+    behavior_state_t before = behavior.state;
+    behavior_tick(&behavior, s);
+    CHECK(behavior.state == state, "%s: %s to %s, expected %s", what, behavior_state_name(before),
+          behavior_state_name(behavior.state), behavior_state_name(state));
+    if (state != before)
+        transitions++;
+}
+
+static void test_line(void)
+{
+    behavior_snapshot_t s = snapshot(MOTION_IDLE);
+    expect(&s, BEHAVIOR_CRUISE, "nothing seen");
+
+    s = snapshot(MOTION_IDLE);
+    s.line.confidence = LINE_MIN_CONFIDENCE - 1;
+    expect(&s, BEHAVIOR_CRUISE, "too faint a line");
+    s.line.confidence = LINE_MIN_CONFIDENCE;
+    expect(&s, BEHAVIOR_LINE_FOLLOW, "line seen");
+
+    // Lost: held for BEHAVIOR_LINE_LOST_MS, then back to cruising
+    wait_ms(BEHAVIOR_LINE_LOST_MS - 10);
+    s = snapshot(MOTION_IDLE);
+    expect(&s, BEHAVIOR_LINE_FOLLOW, "line just lost");
+    wait_ms(20);
+    s = snapshot(MOTION_IDLE);
+    expect(&s, BEHAVIOR_CRUISE, "line lost for long");
+}
+
+static void test_obstacle(void)
+{
+    // A close reading the ultrasonic stopped updating is not an obstacle
+    behavior_snapshot_t s = snapshot(MOTION_IDLE);
+    s.distance_cm = BEHAVIOR_OBSTACLE_CM / 2;
+    s.distance_timestamp_us = s.now_us - (BEHAVIOR_DISTANCE_MAX_AGE_MS + 1) * 1000;
+    expect(&s, BEHAVIOR_CRUISE, "stale obstacle");
+
+    // A recent one wins over the line in the same snapshot, and backs away
+    uint32_t maneuver = motion_get_maneuver();
+    s = snapshot(MOTION_IDLE);
+    s.distance_cm = BEHAVIOR_OBSTACLE_CM - 1;
+    s.distance_timestamp_us = s.now_us - 50000;
+    s.line.confidence = Q16_ONE;
+    expect(&s, BEHAVIOR_AVOID, "obstacle");
+    CHECK(motion_get_maneuver() == maneuver + 1 && motion_get_direction() == -1,
+          "AVOID started maneuver %u direction %d", motion_get_maneuver() - maneuver, motion_get_direction());
+    CHECK(behavior.stats.latency_us_max >= 50000 && behavior.stats.latency_us_max < 60000,
+          "obstacle latency %u us for a reading 50 ms old", behavior.stats.latency_us_max);
+
+    // A snapshot from before the reverse started says nothing about it
+    s = snapshot(MOTION_DONE);
+    s.maneuver = maneuver;
+    expect(&s, BEHAVIOR_AVOID, "snapshot older than the reverse");
+    s = snapshot(MOTION_RUNNING);
+    expect(&s, BEHAVIOR_AVOID, "reversing");
+
+    // Done, with the obstacle still there: only AVOID's row counts this tick
+    s = snapshot(MOTION_DONE);
+    s.distance_cm = BEHAVIOR_OBSTACLE_CM - 1;
+    expect(&s, BEHAVIOR_RECOVER, "reversed");
+    CHECK(motion_get_maneuver() == maneuver + 2 && motion_get_direction() == 1,
+          "RECOVER started maneuver %u direction %d", motion_get_maneuver() - maneuver, motion_get_direction());
+
+    // Still there on the next tick: back away again
+    expect(&s, BEHAVIOR_AVOID, "obstacle while turning");
+    s = snapshot(MOTION_DONE);
+    expect(&s, BEHAVIOR_RECOVER, "reversed again");
+    s = snapshot(MOTION_DONE);
+    expect(&s, BEHAVIOR_CRUISE, "turned");
+}
+
+static void test_cross_line(void)
+{
+    behavior_snapshot_t s = snapshot(MOTION_IDLE);
+    s.left_on_line = true;
+    expect(&s, BEHAVIOR_CRUISE, "one sensor on black");
+    s.right_on_line = true;
+    expect(&s, BEHAVIOR_AVOID, "cross line while cruising");
+
+    s = snapshot(MOTION_DONE);
+    expect(&s, BEHAVIOR_RECOVER, "reversed off the cross line");
+    s = snapshot(MOTION_DONE);
+    expect(&s, BEHAVIOR_CRUISE, "turned off the cross line");
+
+    s = snapshot(MOTION_IDLE);
+    s.line.confidence = Q16_ONE;
+    expect(&s, BEHAVIOR_LINE_FOLLOW, "line seen");
+    s = snapshot(MOTION_IDLE);
+    s.line.confidence = Q16_ONE;
+    s.left_on_line = s.right_on_line = true;
+    expect(&s, BEHAVIOR_AVOID, "cross line while following");
+}
+
+static void test_stall(void)
+{
+    behavior_snapshot_t s = snapshot(MOTION_STALLED);
+    expect(&s, BEHAVIOR_STOP, "stalled reversing");
+    CHECK(motion_get_state() == MOTION_IDLE, "STOP left motion in state %d", motion_get_state());
+
+    // STOP has no row for an obstacle, and holds for BEHAVIOR_STOP_HOLD_MS
+    wait_ms(BEHAVIOR_STOP_HOLD_MS - 10);
+    s = snapshot(MOTION_IDLE);
+    s.distance_cm = 1.0f;
+    expect(&s, BEHAVIOR_STOP, "obstacle while stopped");
+    wait_ms(20);
+    s = snapshot(MOTION_IDLE);
+    expect(&s, BEHAVIOR_CRUISE, "stop held");
+
+    // A stalled turn stops too
+    s = snapshot(MOTION_IDLE);
+    s.distance_cm = 1.0f;
+    expect(&s, BEHAVIOR_AVOID, "obstacle");
+    s = snapshot(MOTION_DONE);
+    expect(&s, BEHAVIOR_RECOVER, "reversed");
+    s = snapshot(MOTION_STALLED);
+    expect(&s, BEHAVIOR_STOP, "stalled turning");
+}
+
+int main(void)
+{
+    sim_init();
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    motion_init(&encoder_left, &encoder_right);
+    behavior_init(&behavior, &follower, NULL);
+    CHECK(behavior.state == BEHAVIOR_CRUISE, "starts in %s", behavior_state_name(behavior.state));
+
+    test_line();
+    test_obstacle();
+    test_cross_line();
+    test_stall();
+
+    CHECK(behavior.stats.transitions == transitions && behavior.stats.ticks > transitions,
+          "stats: %u transitions in %u ticks, expected %u", behavior.stats.transitions, behavior.stats.ticks,
+          transitions);
+    return 0;
+}
@@ -0,0 +1,142 @@
+// The remote command frames and the server's queue, without the sockets.
+// command_put()/command_get(): every field round trips through the
+// documented little-endian layout, a wrong magic is refused. Then frames
+// through command_handle() as the transport hands them over: a command is
+// queued and acked in place with its sequence, client time and the time it
+// took; an ack sent back at the car, a short frame and a wrong magic get no
+// ack; an unknown opcode is acked UNKNOWN and never queued; a ping is acked
+// but not queued; a full queue answers BUSY; the queue drains oldest first
+// and the stats count each case.
+
+#include <string.h>
+#include "hal.h"
+#include "test.h"
+#include "hardware/timer.h"
+#include "command.h"
+#include "fixed.h"
+
+#define MS 1000000ull
+
+static void test_codec(void)
+{
+    const command_frame_t frame = {
+        .opcode = COMMAND_SET_SPEED,
+        .flags = COMMAND_FLAG_ACK,
+        .status = COMMAND_BUSY,
+        .sequence = 0x89ABCDEF,
+        .client_time_us = 0x01020304,
+        .arg = {Q16(-12.5), INT32_MIN},
+    };
+    uint8_t bytes[COMMAND_FRAME_SIZE];
+    command_put(bytes, &frame);
+    static const uint8_t header[12] = {COMMAND_MAGIC, COMMAND_SET_SPEED, COMMAND_FLAG_ACK, COMMAND_BUSY,
+                                       0xEF, 0xCD, 0xAB, 0x89, 0x04, 0x03, 0x02, 0x01};
+    CHECK(memcmp(bytes, header, sizeof(header)) == 0, "header bytes differ from the documented layout");
+    CHECK(bytes[19] == 0x80 && bytes[16] == 0, "arg[1] not little endian");
+
+    command_frame_t decoded;
+    CHECK(command_get(bytes, &decoded), "own frame refused");
+    CHECK(decoded.opcode == frame.opcode && decoded.flags == frame.flags && decoded.status == frame.status &&
+          decoded.sequence == frame.sequence && decoded.client_time_us == frame.client_time_us &&
+          decoded.arg[0] == frame.arg[0] && decoded.arg[1] == frame.arg[1], "round trip changed a field");
+
+    bytes[0] ^= 0xFF;
+    CHECK(!command_get(bytes, &decoded), "wrong magic accepted");
+}
+
+// Frame bytes of a command from the client
+static void request(uint8_t bytes[COMMAND_FRAME_SIZE], uint8_t opcode, uint32_t sequence, int32_t arg)
+{
+    command_frame_t frame = {
+        .opcode = opcode,
+        .sequence = sequence,
+        .client_time_us = sequence * 3,
+        .arg = {arg, -arg},
+    };
+    command_put(bytes, &frame);
+}
+
+// Handle a request received 250 us ago and return its ack
+static command_frame_t handle(uint8_t opcode, uint32_t sequence, int32_t arg)
+{
+    uint8_t bytes[COMMAND_FRAME_SIZE];
+    request(bytes, opcode, sequence, arg);
+    CHECK(command_handle(bytes, sizeof(bytes), time_us_32() - 250), "opcode %u got no ack", opcode);
+
+    command_frame_t ack;
+    CHECK(command_get(bytes, &ack), "ack for opcode %u has no magic", opcode);
+    CHECK(ack.flags == COMMAND_FLAG_ACK && ack.opcode == opcode && ack.sequence == sequence &&
+          ack.client_time_us == sequence * 3, "ack for opcode %u does not echo the request", opcode);
+    // Reading the simulated clock takes a little time too
+    CHECK(ack.arg[0] >= 250 && ack.arg[0] < 260 && ack.arg[1] == 0, "ack took %d us, arg[1] %d", ack.arg[0],
+          ack.arg[1]);
+    return ack;
+}
+
+static void test_server(void)
+{
+    command_queue_init(COMMAND_OPCODE_COUNT);
+    command_t command;
+    command_stats_t stats;
+
+    // A drive is queued with everything the handler needs
+    command_frame_t ack = handle(COMMAND_DRIVE, 7, Q16(30.0));
+    CHECK(ack.status == COMMAND_OK, "drive acked with status %u", ack.status);
+    CHECK(command_receive(&command), "drive not queued");
+    CHECK(command.opcode == COMMAND_DRIVE && command.sequence == 7 && command.arg[0] == Q16(30.0) &&
+          command.arg[1] == -Q16(30.0), "queued drive differs");
+    uint32_t age_us = time_us_32() - command.received_us;
+    CHECK(age_us >= 250 && age_us < 270, "drive received %u us ago", age_us);
+    CHECK(!command_receive(&command), "one frame queued twice");
+
+    // Not commands: no ack, the bytes left as they were
+    uint8_t bytes[COMMAND_FRAME_SIZE], sent[COMMAND_FRAME_SIZE];
+    request(bytes, COMMAND_STOP, 8, 0);
+    bytes[2] = COMMAND_FLAG_ACK;
+    memcpy(sent, bytes, sizeof(bytes));
+    CHECK(!command_handle(bytes, sizeof(bytes), time_us_32()), "an ack was taken for a command");
+    CHECK(memcmp(bytes, sent, sizeof(bytes)) == 0, "a refused ack was rewritten");
+    request(bytes, COMMAND_STOP, 9, 0);
+    CHECK(!command_handle(bytes, sizeof(bytes) - 1, time_us_32()), "short frame accepted");
+    bytes[0] = 0;
+    CHECK(!command_handle(bytes, sizeof(bytes), time_us_32()), "wrong magic accepted");
+    CHECK(!command_receive(&command), "opcode %u queued from a refused frame", command.opcode);
+
+    // Unknown: acked as such, never reaches the handlers
+    ack = handle(COMMAND_OPCODE_COUNT, 10, 0);
+    CHECK(ack.status == COMMAND_UNKNOWN, "opcode past the table acked with status %u", ack.status);
+    ack = handle(0xFF, 11, 0);
+    CHECK(ack.status == COMMAND_UNKNOWN, "opcode 255 acked with status %u", ack.status);
+    ack = handle(COMMAND_PING, 12, 0);
+    CHECK(ack.status == COMMAND_OK, "ping acked with status %u", ack.status);
+    CHECK(!command_receive(&command), "opcode %u queued", command.opcode);
+
+    // Full: BUSY and dropped, then drained oldest first
+    for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        CHECK(handle(COMMAND_TURN_BY, 100 + i, (int32_t)i).status == COMMAND_OK, "command %u not queued", i);
+    CHECK(handle(COMMAND_TURN_BY, 200, 0).status == COMMAND_BUSY, "a full queue took another command");
+    for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+        CHECK(command_receive(&command) && command.sequence == 100 + i && command.arg[0] == (int32_t)i,
+              "command %u out of order", i);
+    CHECK(!command_receive(&command), "the busy command was queued");
+
+    command_get_stats(&stats);
+    CHECK(stats.received == 5 + COMMAND_QUEUE_SIZE && stats.malformed == 3 && stats.unknown == 2 &&
+          stats.busy == 1 && stats.ack_errors == 0, "stats: %u received, %u malformed, %u unknown, %u busy",
+          stats.received, stats.malformed, stats.unknown, stats.busy);
+
+    // A server started for fewer opcodes refuses the rest
+    command_queue_init(COMMAND_TURN_TO);
+    CHECK(handle(COMMAND_TURN_TO, 300, 0).status == COMMAND_UNKNOWN, "opcode past the limit accepted");
+    CHECK(handle(COMMAND_TURN_BY, 301, 0).status == COMMAND_OK, "opcode below the limit refused");
+}
+
+int main(void)
+{
+    sim_init();
+    sim_advance_to(10 * MS);
+
+    test_codec();
+    test_server();
+    return 0;
+}
@@ -0,0 +1,301 @@
+// The occupancy grid. Single readings from known poses: floor division
+// into cells, the cells along the beam freed and the one it ended in
+// occupied, nothing else touched, an out-of-range reading only clearing,
+// a shorter reading moving the wall and a longer one clearing it again,
+// a diagonal beam staying on its line, a beam leaving the grid without
+// wrapping, and the change log filling up. The record: round trip,
+// layout, every single-bit error rejected. Then a map built by spinning
+// the simulated car next to a box, on its own ultrasonic readings and
+// odometry, compared with the walls and the box that are really there.
+
+#include <math.h>
+#include <string.h>
+#include "hal.h"
+#include "test.h"
+#include "world.h"
+#include "board_pins.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "encoder.h"
+#include "grid.h"
+#include "motor.h"
+#include "odometry.h"
+#include "speed_control.h"
+#include "ultrasonic.h"
+
+#define MS 1000000ull
+
+// What update_distance() reports for an echo that never ends
+#define OUT_OF_RANGE_CM 500.0f
+
+// The box next to the start, and how far a mapped cell may be from the truth
+#define BOX_X 35.0
+#define BOX_Y -40.0
+#define BOX_SIZE 20.0
+#define SURFACE_ERROR_CM GRID_CELL_CM
+
+static grid_t grid;
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+
+// In the middle of the cell, so a beam along an axis does not run down a
+// cell boundary
+static pose_t pose_at(double x, double y, double theta)
+{
+    const double mid = GRID_CELL_CM / 2.0;
+    return (pose_t){.x = Q16(x + mid), .y = Q16(y + mid), .theta = Q16(theta)};
+}
+
+static uint count_cells(grid_cell_t state)
+{
+    uint count = 0;
+    for (int cy = 0; cy < GRID_HEIGHT; cy++) {
+        for (int cx = 0; cx < GRID_WIDTH; cx++)
+            count += grid_get(&grid, cx, cy) == state;
+    }
+    return count;
+}
+
+static void test_cells(void)
+{
+    int cx, cy;
+    CHECK(grid_cell_at(0, 0, &cx, &cy) && cx == GRID_ORIGIN_X && cy == GRID_ORIGIN_Y, "origin in %d, %d", cx, cy);
+    CHECK(grid_cell_at(-1, -1, &cx, &cy) && cx == GRID_ORIGIN_X - 1 && cy == GRID_ORIGIN_Y - 1,
+          "just below the origin in %d, %d", cx, cy);
+    CHECK(grid_cell_at(Q16(GRID_CELL_CM) - 1, Q16(GRID_CELL_CM), &cx, &cy) && cx == GRID_ORIGIN_X &&
+          cy == GRID_ORIGIN_Y + 1, "cell boundary in %d, %d", cx, cy);
+    CHECK(!grid_cell_at(Q16(-GRID_ORIGIN_X * GRID_CELL_CM) - 1, 0, &cx, &cy), "west of the grid accepted");
+
+    q16_t x, y;
+    grid_cell_center(GRID_ORIGIN_X - 3, GRID_ORIGIN_Y + 2, &x, &y);
+    CHECK(x == Q16(-2.5 * GRID_CELL_CM) && y == Q16(2.5 * GRID_CELL_CM), "centre %d, %d", x, y);
+}
+
+static void test_readings(void)
+{
+    grid_init(&grid);
+    CHECK(count_cells(GRID_UNKNOWN) == GRID_CELLS, "a new grid is not all unknown");
+
+    // North from the origin: the beam starts at the sensor, one cell ahead,
+    // and ends 50 cm further on
+    const int wall = GRID_ORIGIN_Y + (GRID_SENSOR_OFFSET_CM + 50) / GRID_CELL_CM;
+    pose_t north = pose_at(0, 0, 0);
+    grid_add_reading(&grid, &north, 50.0f);
+    for (int cy = GRID_ORIGIN_Y + 1; cy < wall; cy++)
+        CHECK(grid_get(&grid, GRID_ORIGIN_X, cy) == GRID_FREE, "row %d on the beam not free", cy);
+    CHECK(grid_get(&grid, GRID_ORIGIN_X, wall) == GRID_OCCUPIED, "no wall at row %d", wall);
+    CHECK(grid_get(&grid, GRID_ORIGIN_X, GRID_ORIGIN_Y) == GRID_UNKNOWN, "the cell under the car was marked");
+    CHECK(count_cells(GRID_FREE) == (uint)(wall - GRID_ORIGIN_Y - 1) && count_cells(GRID_OCCUPIED) == 1,
+          "%u free, %u occupied cells off the beam", count_cells(GRID_FREE), count_cells(GRID_OCCUPIED));
+    CHECK(grid.change_count == (uint)(wall - GRID_ORIGIN_Y), "%u changes logged", grid.change_count);
+
+    // The same again changes nothing
+    grid.change_count = 0;
+    grid_add_reading(&grid, &north, 50.0f);
+    CHECK(grid.change_count == 0, "%u changes for a repeated reading", grid.change_count);
+
+    // Something 20 cm closer, then gone again
+    const int nearer = wall - 20 / GRID_CELL_CM;
+    grid_add_reading(&grid, &north, 30.0f);
+    CHECK(grid_get(&grid, GRID_ORIGIN_X, nearer) == GRID_OCCUPIED && grid.change_count == 1,
+          "closer reading: row %d is %d, %u changes", nearer, grid_get(&grid, GRID_ORIGIN_X, nearer),
+          grid.change_count);
+    CHECK(grid_get(&grid, GRID_ORIGIN_X, wall) == GRID_OCCUPIED, "the far wall was cleared unseen");
+    grid_add_reading(&grid, &north, 50.0f);
+    CHECK(grid_get(&grid, GRID_ORIGIN_X, nearer) == GRID_FREE && grid.change_count == 2,
+          "row %d not cleared again", nearer);
+
+    // Past GRID_MAX_RANGE_CM east, and an echo that never came back: free
+    // as far as GRID_MAX_RANGE_CM, no wall
+    grid_init(&grid);
+    pose_t east = pose_at(-100, 0, 90);
+    const int reach = GRID_ORIGIN_X + (-100 + GRID_SENSOR_OFFSET_CM + GRID_MAX_RANGE_CM) / GRID_CELL_CM;
+    const float readings[] = {GRID_MAX_RANGE_CM + 10, OUT_OF_RANGE_CM};
+    for (uint i = 0; i < count_of(readings); i++) {
+        grid_add_reading(&grid, &east, readings[i]);
+        CHECK(count_cells(GRID_OCCUPIED) == 0, "%.0f cm made a wall", readings[i]);
+        CHECK(grid_get(&grid, reach, GRID_ORIGIN_Y) == GRID_FREE &&
+              grid_get(&grid, reach + 1, GRID_ORIGIN_Y) == GRID_UNKNOWN, "%.0f cm cleared to the wrong cell",
+              readings[i]);
+    }
+
+    // Diagonal: every freed cell next to the line, the wall at the end
+    grid_init(&grid);
+    pose_t diagonal = pose_at(0, 0, 45);
+    grid_add_reading(&grid, &diagonal, 60.0f);
+    double end = (GRID_CELL_CM / 2.0 + (GRID_SENSOR_OFFSET_CM + 60) * sqrt(0.5)) / GRID_CELL_CM;
+    CHECK(grid_get(&grid, GRID_ORIGIN_X + (int)end, GRID_ORIGIN_Y + (int)end) == GRID_OCCUPIED,
+          "no wall at the end of the diagonal");
+    for (int cy = 0; cy < GRID_HEIGHT; cy++) {
+        for (int cx = 0; cx < GRID_WIDTH; cx++) {
+            if (grid_get(&grid, cx, cy) == GRID_FREE)
+                CHECK(abs(cx - cy) <= 1 && cx > GRID_ORIGIN_X - 1 && cx < GRID_ORIGIN_X + (int)end,
+                      "cell %d, %d freed off the diagonal", cx, cy);
+        }
+    }
+
+    // From column 3 west out of the grid: the sensor is over column 2, so
+    // columns 2 to 0 are freed and nothing else
+    grid_init(&grid);
+    pose_t west = pose_at(-(GRID_ORIGIN_X - 3) * GRID_CELL_CM, 0, 270);
+    grid_add_reading(&grid, &west, 100.0f);
+    CHECK(count_cells(GRID_OCCUPIED) == 0 && count_cells(GRID_FREE) == 3,
+          "beam off the edge: %u free, %u occupied", count_cells(GRID_FREE), count_cells(GRID_OCCUPIED));
+    CHECK(grid_get(&grid, 0, GRID_ORIGIN_Y) == GRID_FREE && grid_get(&grid, GRID_WIDTH - 1, GRID_ORIGIN_Y - 1) ==
+          GRID_UNKNOWN, "beam off the edge wrapped round");
+
+    // More changes than the log holds
+    grid_init(&grid);
+    for (int angle = 0; angle < 360 && !grid.changes_lost; angle += 10) {
+        pose_t spin = pose_at(0, 0, angle);
+        grid_add_reading(&grid, &spin, 40.0f);
+    }
+    CHECK(grid.changes_lost && grid.change_count == GRID_CHANGE_LOG, "change log: %u, lost %d",
+          grid.change_count, grid.changes_lost);
+}
+
+static void test_record(void)
+{
+    grid_init(&grid);
+    for (int angle = 0; angle < 360; angle += 7) {
+        pose_t pose = pose_at(12, -7, angle);
+        grid_add_reading(&grid, &pose, 20.0f + angle % 90);
+    }
+
+    static uint8_t record[GRID_RECORD_SIZE];
+    static grid_t decoded;
+    grid_encode(&grid, record);
+    CHECK(grid_decode(record, &decoded), "own record rejected");
+    CHECK(memcmp(decoded.known, grid.known, GRID_PLANE_BYTES) == 0 &&
+          memcmp(decoded.occupied, grid.occupied, GRID_PLANE_BYTES) == 0, "decoded planes differ");
+    CHECK(decoded.change_count == 0 && decoded.changes_lost, "a decoded map does not report everything changed");
+
+    // Header, then cell (x, y) at bit (y * width + x) of each plane
+    CHECK(memcmp(record, "GRID", 4) == 0, "magic %.4s", record);
+    CHECK(get_le16(record + 4) == GRID_VERSION && get_le16(record + 6) == GRID_PAYLOAD_SIZE &&
+          get_le16(record + 8) == GRID_WIDTH && get_le16(record + 10) == GRID_HEIGHT &&
+          record[12] == GRID_CELL_CM && record[13] == GRID_ORIGIN_X && record[14] == GRID_ORIGIN_Y,
+          "header fields");
+    for (int cy = 0; cy < GRID_HEIGHT; cy++) {
+        for (int cx = 0; cx < GRID_WIDTH; cx++) {
+            uint index = (uint)(cy * GRID_WIDTH + cx);
+            bool known = record[GRID_HEADER_SIZE + index / 8] >> (index % 8) & 1;
+            bool occupied = record[GRID_HEADER_SIZE + GRID_PLANE_BYTES + index / 8] >> (index % 8) & 1;
+            grid_cell_t expected = !known ? GRID_UNKNOWN : occupied ? GRID_OCCUPIED : GRID_FREE;
+            CHECK(grid_get(&grid, cx, cy) == expected, "cell %d, %d in the record", cx, cy);
+        }
+    }
+    CHECK(get_le32(record + GRID_RECORD_SIZE - GRID_CRC_SIZE) ==
+          crc32(record, GRID_RECORD_SIZE - GRID_CRC_SIZE), "CRC not over the header and planes");
+
+    for (uint bit = 0; bit < GRID_RECORD_SIZE * 8; bit++) {
+        record[bit / 8] ^= (uint8_t)(1u << bit % 8);
+        CHECK(!grid_decode(record, &decoded), "bit %u flipped and accepted", bit);
+        record[bit / 8] ^= (uint8_t)(1u << bit % 8);
+    }
+}
+
+// Distance from a floor point (world frame) to the nearest wall or box face
+static double surface_distance(double x, double y)
+{
+    double half_x = WORLD_STRAIGHT_CM / 2.0 + WORLD_TURN_RADIUS_CM + WORLD_WALL_MARGIN_CM;
+    double half_y = WORLD_TURN_RADIUS_CM + WORLD_WALL_MARGIN_CM;
+    double wall = fmin(half_x - fabs(x), half_y - fabs(y));
+
+    double bx = fabs(x - BOX_X) - BOX_SIZE / 2.0;
+    double by = fabs(y - BOX_Y) - BOX_SIZE / 2.0;
+    double box = bx > 0 || by > 0 ? hypot(fmax(bx, 0), fmax(by, 0)) : fmax(bx, by);
+    return fmin(fabs(wall), fabs(box));
+}
+
+// Inside the box or beyond the walls, by more than half a cell
+static bool solid(double x, double y)
+{
+    double half_x = WORLD_STRAIGHT_CM / 2.0 + WORLD_TURN_RADIUS_CM + WORLD_WALL_MARGIN_CM;
+    double half_y = WORLD_TURN_RADIUS_CM + WORLD_WALL_MARGIN_CM;
+    double margin = GRID_CELL_CM / 2.0;
+    if (fabs(x) > half_x + margin || fabs(y) > half_y + margin)
+        return true;
+    return fabs(x - BOX_X) < BOX_SIZE / 2.0 - margin && fabs(y - BOX_Y) < BOX_SIZE / 2.0 - margin;
+}
+
+static void test_world_map(void)
+{
+    sim_init();
+    world_init(&(world_config_t){.seed = 1, .obstacle = true, .obstacle_x = BOX_X, .obstacle_y = BOX_Y,
+                                 .obstacle_size = BOX_SIZE});
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    odometry_init(&encoder_left, &encoder_right, NULL);
+    speed_control_start_timer();
+    ultrasonic_init(ULTRASONIC_TRIGGER_PIN, ULTRASONIC_ECHO_PIN);
+
+    // The odometry frame starts at the car, facing where it faces
+    world_status_t truth;
+    world_get_status(&truth);
+    double start_x = truth.pose.x, start_y = truth.pose.y;
+    odometry_reset(0, 0, (q16_t)(truth.pose.heading * Q16_ONE));
+
+    // Two slow turns on the spot, every reading into the map
+    grid_init(&grid);
+    uint readings = 0;
+    speed_control_set_target(Q16(6.0), Q16(-6.0));
+    while (sim_now_ns() < 12000 * MS) {
+        sim_advance_to(sim_now_ns() + MS);
+        ultrasonic_result_t result;
+        while (ultrasonic_poll(&result)) {
+            pose_t pose;
+            odometry_get_pose(&pose);
+            if (result.status == ULTRASONIC_OK)
+                grid_add_reading(&grid, &pose, result.distance_cm);
+            else if (result.status == ULTRASONIC_ERR_TIMEOUT)
+                grid_add_reading(&grid, &pose, OUT_OF_RANGE_CM);
+            readings++;
+        }
+        ultrasonic_start();
+    }
+    speed_control_set_target(0, 0);
+    world_get_status(&truth);
+    CHECK(truth.collisions == 0 && hypot(truth.pose.x - start_x, truth.pose.y - start_y) < 2.0,
+          "the car moved off the spot");
+
+    // Every wall cell near something solid, no free cell inside it
+    uint walls = 0, box = 0, worst_x = 0, worst_y = 0;
+    double worst = 0;
+    for (int cy = 0; cy < GRID_HEIGHT; cy++) {
+        for (int cx = 0; cx < GRID_WIDTH; cx++) {
+            q16_t qx, qy;
+            grid_cell_center(cx, cy, &qx, &qy);
+            double x = start_x + qx / (double)Q16_ONE;
+            double y = start_y + qy / (double)Q16_ONE;
+            grid_cell_t cell = grid_get(&grid, cx, cy);
+            if (cell == GRID_OCCUPIED) {
+                double off = surface_distance(x, y);
+                if (off > worst) {
+                    worst = off;
+                    worst_x = cx;
+                    worst_y = cy;
+                }
+                walls++;
+                box += fabs(x - BOX_X) < BOX_SIZE && fabs(y - BOX_Y) < BOX_SIZE;
+            }
+            CHECK(cell != GRID_FREE || !solid(x, y), "cell %d, %d at %.1f, %.1f free inside a wall", cx, cy, x, y);
+        }
+    }
+    printf("%u readings: %u wall cells, %u on the box, worst %.2f cm off (cell %u, %u), %u free\n", readings,
+           walls, box, worst, worst_x, worst_y, count_cells(GRID_FREE));
+    CHECK(worst <= SURFACE_ERROR_CM, "wall cell %u, %u is %.2f cm from anything", worst_x, worst_y, worst);
+    CHECK(box >= BOX_SIZE / GRID_CELL_CM, "only %u cells of the box mapped", box);
+    CHECK(walls - box >= 20, "only %u cells of the walls mapped", walls - box);
+}
+
+int main(void)
+{
+    test_cells();
+    test_readings();
+    test_record();
+    test_world_map();
+    return 0;
+}
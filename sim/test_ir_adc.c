@@ -0,0 +1,158 @@
+// IR acquisition: ir_adc_accumulate() against a plain de-interleaving
+// loop (whole frames, a trailing partial frame, sums carried in), then the
+// free-running ADC and DMA on the mock HAL: a snapshot every block with
+// each channel's exact average, per-channel decimation, and edge times on
+// the watched channel within a sample of the real crossing.
+
+#include <string.h>
+#include "hal.h"
+#include "test.h"
+#include "irsensor.h"
+
+#define MS 1000000ull
+#define BLOCK_US (IR_ADC_BLOCK_SAMPLES * 1000000ull / IR_ADC_SAMPLE_RATE_HZ)
+#define CHANNEL_PERIOD_US (IR_ADC_CHANNELS * 1000000 / IR_ADC_SAMPLE_RATE_HZ)
+
+// What each ADC input reads now
+static uint16_t level[IR_ADC_CHANNELS];
+
+static uint16_t adc_source(uint input)
+{
+    return input < IR_ADC_CHANNELS ? level[input] : 0x300;
+}
+
+static uint32_t edges;
+static uint32_t edge_time_us;
+static bool edge_black;
+
+static void edge_seen(uint32_t timestamp_us, bool black)
+{
+    edges++;
+    edge_time_us = timestamp_us;
+    edge_black = black;
+}
+
+static void test_accumulate(void)
+{
+    static uint16_t samples[IR_ADC_BLOCK_SAMPLES * 4 + 2];
+    uint32_t seed = 1;
+    for (uint i = 0; i < count_of(samples); i++) {
+        seed = seed * 1103515245u + 12345u;
+        samples[i] = (seed >> 16) & 0xFFF;
+    }
+    samples[0] = 4095;
+
+    const uint counts[] = {0, 1, 2, 3, 4, 5, IR_ADC_BLOCK_SAMPLES, count_of(samples)};
+    for (uint c = 0; c < count_of(counts); c++) {
+        uint32_t sums[IR_ADC_CHANNELS] = {7, 8, 9};
+        uint32_t expected[IR_ADC_CHANNELS] = {7, 8, 9};
+        for (uint i = 0; i < counts[c]; i++)
+            expected[i % IR_ADC_CHANNELS] += samples[i];
+        ir_adc_accumulate(samples, counts[c], sums);
+        for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++)
+            CHECK(sums[ch] == expected[ch], "%u samples: channel %u sums to %u, expected %u", counts[c], ch,
+                  sums[ch], expected[ch]);
+    }
+}
+
+static void wait_snapshot(ir_adc_snapshot_t *snapshot)
+{
+    uint32_t sequence = snapshot->sequence;
+    uint64_t deadline = sim_now_ns() + 2 * BLOCK_US * 1000;
+    while (snapshot->sequence == sequence) {
+        CHECK(sim_now_ns() < deadline, "no snapshot within two blocks");
+        sim_advance_to(sim_now_ns() + 100000);
+        ir_adc_get_snapshot(snapshot);
+    }
+}
+
+static void test_acquisition(void)
+{
+    // Left every block, right every second, bottom every fourth
+    const uint8_t decimation[IR_ADC_CHANNELS] = {1, 2, 4};
+    level[IR_ADC_LEFT] = 1000;
+    level[IR_ADC_RIGHT] = 2000;
+    level[IR_ADC_BOTTOM] = 3000;
+    ir_adc_start(decimation);
+
+    ir_adc_snapshot_t snapshot = {0};
+    sim_advance_to(sim_now_ns() + 5 * BLOCK_US * 1000);
+    ir_adc_get_snapshot(&snapshot);
+    CHECK(snapshot.value[IR_ADC_LEFT] == 1000 && snapshot.value[IR_ADC_RIGHT] == 2000 &&
+          snapshot.value[IR_ADC_BOTTOM] == 3000, "averages %u %u %u", snapshot.value[0], snapshot.value[1],
+          snapshot.value[2]);
+
+    // Published once per block, each a block after the last
+    uint32_t first = snapshot.sequence;
+    uint32_t first_us = snapshot.timestamp_us;
+    sim_advance_to(sim_now_ns() + 100 * MS);
+    ir_adc_get_snapshot(&snapshot);
+    uint32_t blocks = snapshot.sequence - first;
+    uint32_t expected = (uint32_t)((snapshot.timestamp_us - first_us) / BLOCK_US);
+    CHECK(blocks == expected, "%u snapshots in %u us, expected %u", blocks, snapshot.timestamp_us - first_us,
+          expected);
+    CHECK(blocks >= 100000 / BLOCK_US - 1, "%u snapshots in 100 ms", blocks);
+
+    // A step on every channel shows up on each at its own rate
+    level[IR_ADC_LEFT] = 1100;
+    level[IR_ADC_RIGHT] = 2200;
+    level[IR_ADC_BOTTOM] = 3300;
+    uint32_t settled[IR_ADC_CHANNELS] = {0};
+    for (uint32_t n = 1; n <= 10; n++) {
+        wait_snapshot(&snapshot);
+        for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+            uint16_t target = (uint16_t)(1100 * (ch + 1));
+            if (!settled[ch] && snapshot.value[ch] == target)
+                settled[ch] = n;
+        }
+    }
+    // The averaging window the step fell in, then a whole one
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++)
+        CHECK(settled[ch] && settled[ch] <= 2u * decimation[ch], "channel %u settled after %u snapshots", ch,
+              settled[ch]);
+}
+
+static void step_bottom(void *context)
+{
+    level[IR_ADC_BOTTOM] = (uint16_t)(uintptr_t)context;
+}
+
+static void test_edges(void)
+{
+    ir_adc_set_edge_callback(IR_ADC_BOTTOM, 1500, 2500, edge_seen);
+    level[IR_ADC_BOTTOM] = 200;
+    sim_advance_to(sim_now_ns() + 3 * BLOCK_US * 1000);
+    CHECK(edges == 0, "%u edges over white", edges);
+
+    // Crossings at odd times within a block, and a wobble inside the band
+    const uint32_t at_us[] = {12345, 30017, 51234};
+    const uint16_t to[] = {3500, 2000, 200};
+    uint64_t start = sim_now_ns();
+    for (uint i = 0; i < count_of(at_us); i++)
+        sim_schedule(start + at_us[i] * 1000ull, step_bottom, (void *)(uintptr_t)to[i]);
+
+    uint32_t start_us = (uint32_t)(start / 1000);
+    sim_advance_to(start + (at_us[0] + 2 * BLOCK_US) * 1000);
+    CHECK(edges == 1 && edge_black, "%u edges after going black", edges);
+    uint32_t late_us = edge_time_us - (start_us + at_us[0]);
+    CHECK(late_us <= CHANNEL_PERIOD_US, "black edge %d us after the crossing", (int32_t)late_us);
+
+    sim_advance_to(start + (at_us[1] + 2 * BLOCK_US) * 1000);
+    CHECK(edges == 1, "edge inside the hysteresis band");
+
+    sim_advance_to(start + (at_us[2] + 2 * BLOCK_US) * 1000);
+    CHECK(edges == 2 && !edge_black, "%u edges after going white", edges);
+    late_us = edge_time_us - (start_us + at_us[2]);
+    CHECK(late_us <= CHANNEL_PERIOD_US, "white edge %d us after the crossing", (int32_t)late_us);
+}
+
+int main(void)
+{
+    test_accumulate();
+
+    sim_init();
+    sim_set_adc_source(adc_source);
+    test_acquisition();
+    test_edges();
+    return 0;
+}
@@ -0,0 +1,123 @@
+// IR calibration records: a sweep that saw the line on two channels and
+// not on the third, an encode/decode round trip and the record layout,
+// rejection of every single-bit corruption, of another version and of a
+// record whose CRC is right but whose values are not, and save/load
+// through the mock flash.
+
+#include <string.h>
+#include "hal.h"
+#include "test.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "irsensor.h"
+
+static void sweep(ir_calibration_t *cal)
+{
+    // Left and right see white and black, the bottom sensor only floor
+    ir_cal_begin(cal);
+    for (uint i = 0; i < 100; i++) {
+        ir_adc_snapshot_t snapshot = {
+            .value = {(uint16_t)(300 + i * 30), (uint16_t)(3200 - i * 28), (uint16_t)(500 + i % 3)},
+        };
+        ir_cal_add(cal, &snapshot);
+    }
+}
+
+static void test_sweep(void)
+{
+    ir_calibration_t cal;
+    sweep(&cal);
+    CHECK(!ir_cal_finish(&cal), "a channel without contrast passed");
+    CHECK(cal.min[IR_ADC_LEFT] == 300 && cal.max[IR_ADC_LEFT] == 3270, "left %u..%u", cal.min[IR_ADC_LEFT],
+          cal.max[IR_ADC_LEFT]);
+    CHECK(cal.min[IR_ADC_RIGHT] == 428 && cal.max[IR_ADC_RIGHT] == 3200, "right %u..%u", cal.min[IR_ADC_RIGHT],
+          cal.max[IR_ADC_RIGHT]);
+    CHECK(cal.min[IR_ADC_BOTTOM] == IR_CAL_DEFAULT_MIN && cal.max[IR_ADC_BOTTOM] == IR_CAL_DEFAULT_MAX,
+          "bottom not back to the defaults: %u..%u", cal.min[IR_ADC_BOTTOM], cal.max[IR_ADC_BOTTOM]);
+    for (uint ch = 0; ch < IR_ADC_CHANNELS; ch++) {
+        uint16_t band = (cal.max[ch] - cal.min[ch]) / IR_CAL_HYSTERESIS_DIV;
+        uint16_t mid = (cal.min[ch] + cal.max[ch]) / 2;
+        CHECK(cal.threshold_low[ch] == mid - band && cal.threshold_high[ch] == mid + band,
+              "channel %u thresholds %u, %u", ch, cal.threshold_low[ch], cal.threshold_high[ch]);
+    }
+
+    // Hysteresis: between the thresholds the previous answer stands
+    uint16_t between = (cal.threshold_low[IR_ADC_LEFT] + cal.threshold_high[IR_ADC_LEFT]) / 2;
+    CHECK(ir_cal_on_line(&cal, IR_ADC_LEFT, between, true), "left the line inside the band");
+    CHECK(!ir_cal_on_line(&cal, IR_ADC_LEFT, between, false), "entered the line inside the band");
+}
+
+static void test_round_trip(void)
+{
+    ir_calibration_t cal, decoded;
+    sweep(&cal);
+    ir_cal_finish(&cal);
+
+    uint8_t record[IR_CAL_RECORD_SIZE];
+    ir_cal_encode(&cal, record);
+    memset(&decoded, 0, sizeof(decoded));
+    CHECK(ir_cal_decode(record, &decoded), "own record rejected");
+    CHECK(memcmp(&cal, &decoded, sizeof(cal)) == 0, "decoded record differs");
+
+    // Layout: "IRCL", version, payload length, CRC over the rest at the end
+    CHECK(memcmp(record, "IRCL", 4) == 0, "magic %02x%02x%02x%02x", record[0], record[1], record[2], record[3]);
+    CHECK(get_le16(record + 4) == IR_CAL_VERSION, "version %u", get_le16(record + 4));
+    CHECK(get_le16(record + 6) == IR_CAL_PAYLOAD_SIZE, "payload length %u", get_le16(record + 6));
+    CHECK(get_le16(record + IR_CAL_HEADER_SIZE) == cal.min[0], "first payload field %u",
+          get_le16(record + IR_CAL_HEADER_SIZE));
+    CHECK(get_le32(record + IR_CAL_RECORD_SIZE - IR_CAL_CRC_SIZE) ==
+          crc32(record, IR_CAL_RECORD_SIZE - IR_CAL_CRC_SIZE), "CRC not over the header and payload");
+
+    // Every single-bit error is caught, and the output is left alone
+    for (uint bit = 0; bit < IR_CAL_RECORD_SIZE * 8; bit++) {
+        record[bit / 8] ^= (uint8_t)(1u << bit % 8);
+        ir_calibration_t untouched = decoded;
+        CHECK(!ir_cal_decode(record, &untouched), "bit %u flipped and accepted", bit);
+        CHECK(memcmp(&untouched, &decoded, sizeof(decoded)) == 0, "bit %u: rejected but written", bit);
+        record[bit / 8] ^= (uint8_t)(1u << bit % 8);
+    }
+
+    // Another version with a good CRC
+    put_le16(record + 4, IR_CAL_VERSION + 1);
+    put_le32(record + IR_CAL_RECORD_SIZE - IR_CAL_CRC_SIZE, crc32(record, IR_CAL_RECORD_SIZE - IR_CAL_CRC_SIZE));
+    CHECK(!ir_cal_decode(record, &decoded), "version %u accepted", IR_CAL_VERSION + 1);
+
+    // A good CRC over values that make no sense
+    ir_calibration_t bad = cal;
+    bad.min[IR_ADC_RIGHT] = bad.max[IR_ADC_RIGHT];
+    ir_cal_encode(&bad, record);
+    CHECK(!ir_cal_decode(record, &decoded), "min == max accepted");
+    bad = cal;
+    bad.threshold_low[IR_ADC_LEFT] = bad.threshold_high[IR_ADC_LEFT] + 1;
+    ir_cal_encode(&bad, record);
+    CHECK(!ir_cal_decode(record, &decoded), "thresholds the wrong way round accepted");
+}
+
+static void test_flash(void)
+{
+    ir_calibration_t cal, loaded;
+    sim_init();
+    ir_cal_default(&loaded);
+    ir_calibration_t defaults = loaded;
+    CHECK(!ir_cal_load(&loaded), "loaded from erased flash");
+    CHECK(memcmp(&loaded, &defaults, sizeof(loaded)) == 0, "failed load changed the calibration");
+
+    sweep(&cal);
+    ir_cal_finish(&cal);
+    CHECK(ir_cal_save(&cal), "save failed");
+    CHECK(ir_cal_load(&loaded), "saved record not loaded");
+    CHECK(memcmp(&cal, &loaded, sizeof(cal)) == 0, "loaded calibration differs");
+
+    // A second save replaces the first
+    ir_cal_default(&cal);
+    CHECK(ir_cal_save(&cal), "second save failed");
+    CHECK(ir_cal_load(&loaded) && memcmp(&cal, &loaded, sizeof(cal)) == 0, "second save not loaded");
+}
+
+int main(void)
+{
+    test_sweep();
+    test_round_trip();
+    test_flash();
+    return 0;
+}
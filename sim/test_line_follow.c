@@ -0,0 +1,147 @@
+// The analog line follower. line_estimate() on fixed readings: sign,
+// range, clamping and a calibration with no contrast. A scripted replay
+// through line_follower_update(): speeding up on a steady line, steering
+// towards the line, holding the last error while it is lost, slowing
+// down when it wobbles. Then the follower alone in closed loop on the
+// simulated track for a full lap, staying close to the line.
+
+#include <math.h>
+#include "hal.h"
+#include "test.h"
+#include "world.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "line_follow.h"
+#include "motor.h"
+#include "speed_control.h"
+
+#define LAP_LIMIT_S 30
+#define LINE_DISTANCE_MAX_CM 1.5
+
+static ir_calibration_t cal;
+static line_follower_t follower;
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+
+static line_estimate_t estimate(uint16_t left, uint16_t right)
+{
+    line_estimate_t e;
+    line_estimate(left, right, &cal, &e);
+    return e;
+}
+
+static void test_estimate(void)
+{
+    uint16_t white = IR_CAL_DEFAULT_MIN;
+    uint16_t black = IR_CAL_DEFAULT_MAX;
+    uint16_t grey = (white + black) / 2;
+
+    line_estimate_t e = estimate(white, white);
+    CHECK(e.error == 0 && e.confidence == 0, "white: error %d confidence %d", e.error, e.confidence);
+    e = estimate(black, black);
+    CHECK(e.error == 0 && e.confidence == Q16_ONE, "black: error %d confidence %d", e.error, e.confidence);
+    e = estimate(white, black);
+    CHECK(e.error == Q16_ONE && e.confidence == Q16_ONE, "under the right: error %d", e.error);
+    e = estimate(black, white);
+    CHECK(e.error == -Q16_ONE, "under the left: error %d", e.error);
+
+    // Halfway is half, and readings past the calibration clamp
+    e = estimate(white, grey);
+    CHECK(abs(e.error - Q16(0.5)) < 16 && e.confidence == e.error, "half right: error %d", e.error);
+    e = estimate(0, 4095);
+    CHECK(e.error == Q16_ONE, "past the calibration: error %d", e.error);
+
+    // A channel that never saw contrast reads as white
+    ir_calibration_t flat = cal;
+    flat.max[IR_ADC_RIGHT] = flat.min[IR_ADC_RIGHT];
+    line_estimate(white, black, &flat, &e);
+    CHECK(e.error == 0 && e.confidence == 0, "flat calibration: error %d", e.error);
+}
+
+// Feed one reading, return the wheel targets
+static void replay(uint16_t left, uint16_t right, q16_t *left_speed, q16_t *right_speed)
+{
+    line_estimate_t e = estimate(left, right);
+    line_follower_update(&follower, &e, left_speed, right_speed);
+}
+
+static void test_replay(void)
+{
+    uint16_t white = IR_CAL_DEFAULT_MIN;
+    uint16_t edge = IR_CAL_DEFAULT_MIN + (IR_CAL_DEFAULT_MAX - IR_CAL_DEFAULT_MIN) / 2;
+    q16_t left, right;
+    line_follower_init(&follower);
+
+    // Line between the sensors, both half covered: slow until the window
+    // fills, then up by LINE_SPEED_STEP per update to fast
+    uint32_t ramp = (LINE_FAST_SPEED - LINE_SLOW_SPEED) / LINE_SPEED_STEP;
+    for (uint32_t n = 1; n <= LINE_WINDOW + ramp; n++) {
+        replay(edge, edge, &left, &right);
+        CHECK(left == right, "update %u: steering %d on a centred line", n, right - left);
+        q16_t expected = n < LINE_WINDOW ? LINE_SLOW_SPEED : LINE_SLOW_SPEED + (n - LINE_WINDOW + 1) * LINE_SPEED_STEP;
+        if (expected > LINE_FAST_SPEED)
+            expected = LINE_FAST_SPEED;
+        CHECK(left == expected, "update %u: speed %d, expected %d", n, left, expected);
+    }
+    CHECK(left == LINE_FAST_SPEED, "not at full speed after the ramp: %d", left);
+
+    // Line drifting under the right sensor: right wheel faster, by KP
+    replay(white, edge, &left, &right);
+    q16_t steer = q16_mul(LINE_STEER_KP, estimate(white, edge).error);
+    CHECK(right - left == 2 * steer && steer > 0, "steering %d towards the right, expected %d", right - left,
+          2 * steer);
+
+    // Lost off the right: keeps turning the same way
+    replay(white, white, &left, &right);
+    CHECK(right - left == 2 * steer, "steering %d with the line lost, expected %d", right - left, 2 * steer);
+
+    // Swinging hard from side to side: back down to slow
+    uint16_t black = IR_CAL_DEFAULT_MAX;
+    for (uint32_t n = 0; n < LINE_WINDOW + ramp; n++)
+        replay(n & 1 ? black : white, n & 1 ? white : black, &left, &right);
+    CHECK((left + right) / 2 == LINE_SLOW_SPEED, "speed %d while wobbling", (left + right) / 2);
+}
+
+static void test_track(void)
+{
+    sim_init();
+    world_init(&(world_config_t){.seed = 1});
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    speed_control_start_timer();
+    ir_adc_start(NULL);
+    line_follower_init(&follower);
+
+    // One steering update per IR snapshot, as the sensor task does
+    uint32_t sequence = 0;
+    world_status_t status;
+    do {
+        sim_advance_to(sim_now_ns() + 1000000);
+        ir_adc_snapshot_t ir;
+        ir_adc_get_snapshot(&ir);
+        if (ir.sequence != sequence) {
+            sequence = ir.sequence;
+            q16_t left, right;
+            replay(ir.value[IR_ADC_LEFT], ir.value[IR_ADC_RIGHT], &left, &right);
+            speed_control_set_target(left, right);
+        }
+        world_get_status(&status);
+    } while (status.laps == 0 && sim_now_ns() < LAP_LIMIT_S * 1000000000ull);
+
+    printf("lap in %.2f s, from the line mean %.2f cm, max %.2f cm\n", sim_now_ns() * 1e-9,
+           status.line_distance_sum / status.line_samples, status.line_distance_max);
+    CHECK(status.laps == 1, "no lap in %d s, %.1f cm along", LAP_LIMIT_S, status.progress_cm);
+    CHECK(status.progress_cm > 0, "lap driven clockwise");
+    CHECK(status.line_distance_max < LINE_DISTANCE_MAX_CM, "%.2f cm from the line", status.line_distance_max);
+}
+
+int main(void)
+{
+    ir_cal_default(&cal);
+    test_estimate();
+    test_replay();
+    test_track();
+    return 0;
+}
@@ -0,0 +1,260 @@
+// The binary log from LOG() to tools/log_decoder. Records of no to six
+// arguments come out of log_drain() in a frame log_get_header() accepts,
+// and log_get_record() gives back each ID, timestamp and argument in
+// order; a record with too many arguments is dropped. A full ring drops
+// and counts what does not fit, and the next frame reports it. Frames cut
+// short, with a wrong length field or with any single bit flipped are
+// refused, and so are records running past their frame. Then a console
+// stream of text, frames and damaged frames goes through the decoder (its
+// path is the first argument): the good frames are decoded, the rest comes
+// out as the bytes it was, and the damaged frame between them is counted
+// as lost.
+
+#define _GNU_SOURCE          // memmem
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal.h"
+#include "test.h"
+#include "hardware/timer.h"
+#include "log.h"
+#include "log_messages.h"
+
+#define MS 1000000ull
+
+typedef struct {
+    uint16_t id;
+    uint8_t arg_count;
+    uint32_t arg[LOG_MAX_ARGS];
+} expected_t;
+
+// Every record of a frame against the expected ones; returns the header
+static log_header_t check_frame(const uint8_t *frame, size_t length, const expected_t *expected, uint count,
+                                uint32_t since_us)
+{
+    log_header_t header;
+    CHECK(length > 0 && log_get_header(frame, length, &header) == length, "frame of %zu bytes refused", length);
+
+    const uint8_t *in = frame + LOG_HEADER_SIZE;
+    const uint8_t *end = frame + length - LOG_CRC_SIZE;
+    uint32_t last_us = since_us;
+    for (uint i = 0; i < count; i++) {
+        log_record_t record;
+        CHECK((in = log_get_record(in, end, &record)) != NULL, "record %u missing", i);
+        CHECK(record.id == expected[i].id && record.arg_count == expected[i].arg_count,
+              "record %u: id %u with %u args, expected %u with %u", i, record.id, record.arg_count,
+              expected[i].id, expected[i].arg_count);
+        for (uint a = 0; a < record.arg_count; a++)
+            CHECK(record.arg[a] == expected[i].arg[a], "record %u arg %u: %08x", i, a, record.arg[a]);
+        CHECK(record.timestamp_us - last_us <= time_us_32() - last_us, "record %u stamped %u, out of order", i,
+              record.timestamp_us);
+        last_us = record.timestamp_us;
+    }
+    CHECK(in == end, "%zu bytes after the last record", (size_t)(end - in));
+    return header;
+}
+
+static void test_round_trip(void)
+{
+    static const expected_t expected[] = {
+        {LOG_ULTRASONIC_NO_ECHO, 0, {0}},
+        {LOG_CONTROL_OVERRUN, 2, {(uint32_t)-12, 345}},
+        {LOG_COMMAND, 5, {1, 2, (uint32_t)-3, 4, 5}},
+        {LOG_MAP_CHUNK, 6, {0, 0xFFFFFFFF, 0x80000000, 3, 4, 5}},
+        {LOG_SNAPSHOT_DROPPED, 1, {99}},
+    };
+    uint32_t start = time_us_32();
+    for (uint i = 0; i < count_of(expected); i++) {
+        uint32_t words[1 + LOG_MAX_ARGS] = {expected[i].id};
+        memcpy(words + 1, expected[i].arg, sizeof(expected[i].arg));
+        log_write(words, 1 + expected[i].arg_count);
+        sim_advance_to(sim_now_ns() + MS);
+
+        // One argument too many: dropped, the records around it kept
+        if (i == 2) {
+            const uint32_t too_many[] = {LOG_MAP_CHUNK, 1, 2, 3, 4, 5, 6, 7};
+            log_write(too_many, count_of(too_many));
+        }
+    }
+
+    uint8_t frame[LOG_FRAME_MAX];
+    size_t length = log_drain(frame, sizeof(frame));
+    log_header_t header = check_frame(frame, length, expected, count_of(expected), start);
+    CHECK(header.sequence == 0 && header.dropped == 1 && header.core == 0, "header: sequence %u, %u dropped, core %u",
+          header.sequence, header.dropped, header.core);
+    CHECK(log_drain(frame, sizeof(frame)) == 0, "a second frame from an empty ring");
+
+    log_stats_t stats;
+    log_get_stats(&stats);
+    CHECK(stats.records == count_of(expected) && stats.dropped == 1 && stats.frames == 1 && stats.bytes == length,
+          "stats: %u records, %u dropped, %u frames, %u bytes", stats.records, stats.dropped, stats.frames,
+          stats.bytes);
+}
+
+static void test_full_ring(void)
+{
+    // Two arguments take four words
+    const uint fit = LOG_RING_WORDS / 4;
+    const uint extra = 20;
+    log_stats_t before, after;
+    log_get_stats(&before);
+    uint32_t start = time_us_32();
+    for (uint i = 0; i < fit + extra; i++)
+        LOG(LOG_CONTROL_OVERRUN, i, 2 * i);
+    log_get_stats(&after);
+    CHECK(after.records - before.records == fit && after.dropped - before.dropped == extra,
+          "full ring: %u written, %u dropped", after.records - before.records, after.dropped - before.dropped);
+
+    // Drained over several frames, in order, the drops on the first
+    uint8_t frame[LOG_FRAME_MAX];
+    size_t length;
+    uint next = 0, frames = 0;
+    while ((length = log_drain(frame, sizeof(frame))) > 0) {
+        expected_t expected[LOG_FRAME_MAX / LOG_RECORD_SIZE(2)];
+        uint count = (length - LOG_HEADER_SIZE - LOG_CRC_SIZE) / LOG_RECORD_SIZE(2);
+        for (uint i = 0; i < count; i++)
+            expected[i] = (expected_t){LOG_CONTROL_OVERRUN, 2, {next + i, 2 * (next + i)}};
+        log_header_t header = check_frame(frame, length, expected, count, start);
+        CHECK(header.sequence == 1 + frames, "frame %u has sequence %u", frames, header.sequence);
+        CHECK(header.dropped == (frames == 0 ? extra : 0), "frame %u reports %u dropped", frames, header.dropped);
+        next += count;
+        frames++;
+    }
+    CHECK(next == fit && frames > 1, "%u records in %u frames", next, frames);
+
+    // Room again, and the drops reported only once
+    LOG(LOG_ULTRASONIC_NO_ECHO);
+    length = log_drain(frame, sizeof(frame));
+    static const expected_t one[] = {{LOG_ULTRASONIC_NO_ECHO, 0, {0}}};
+    log_header_t header = check_frame(frame, length, one, 1, start);
+    CHECK(header.dropped == 0, "drops reported twice");
+}
+
+static void test_damage(void)
+{
+    LOG(LOG_COMMAND, 3, 17, 1, 2, 40);
+    LOG(LOG_ULTRASONIC_NO_ECHO);
+    uint8_t frame[LOG_FRAME_MAX], copy[LOG_FRAME_MAX] = {0};
+    size_t length = log_drain(frame, sizeof(frame));
+    log_header_t header;
+    CHECK(length > 0 && log_get_header(frame, length, &header) == length, "frame refused");
+
+    // Cut short: not (yet) a frame
+    for (size_t cut = 0; cut < length; cut++)
+        CHECK(log_get_header(frame, cut, &header) == 0, "frame accepted from %zu of %zu bytes", cut, length);
+
+    // The length field: one short lands the CRC check on the wrong bytes
+    const uint16_t lengths[] = {length - 1, length + 1, LOG_HEADER_SIZE + LOG_CRC_SIZE - 1, LOG_FRAME_MAX + 1};
+    for (uint i = 0; i < count_of(lengths); i++) {
+        memcpy(copy, frame, length);
+        put_le16(copy + 2, lengths[i]);
+        CHECK(log_get_header(copy, sizeof(copy), &header) == 0, "length field %u accepted", lengths[i]);
+    }
+
+    // Every single-bit error
+    for (size_t bit = 0; bit < 8 * length; bit++) {
+        memcpy(copy, frame, length);
+        copy[bit / 8] ^= 1u << (bit % 8);
+        CHECK(log_get_header(copy, length, &header) == 0, "bit %zu flipped accepted", bit);
+    }
+
+    // Records that run past the frame, or claim too many arguments
+    const uint8_t *records = frame + LOG_HEADER_SIZE;
+    log_record_t record;
+    CHECK(!log_get_record(records, records + LOG_RECORD_SIZE(5) - 1, &record), "cut record decoded");
+    CHECK(!log_get_record(records, records + LOG_RECORD_SIZE(0) - 1, &record), "cut record header decoded");
+    memcpy(copy, records, LOG_RECORD_SIZE(5));
+    copy[2] = LOG_MAX_ARGS + 1;
+    CHECK(!log_get_record(copy, copy + sizeof(copy), &record), "record with %u args decoded", copy[2]);
+}
+
+// One record in a frame of its own
+static size_t single(uint8_t *frame, uint32_t sequence)
+{
+    LOG(LOG_COMMAND, 7, sequence, (uint32_t)-3, 4, 5);
+    return log_drain(frame, LOG_FRAME_MAX);
+}
+
+static void append(uint8_t *stream, size_t *used, const void *data, size_t length)
+{
+    memcpy(stream + *used, data, length);
+    *used += length;
+}
+
+static bool contains(const char *haystack, size_t length, const void *needle, size_t needle_length)
+{
+    return memmem(haystack, length, needle, needle_length) != NULL;
+}
+
+static void test_decoder(const char *decoder)
+{
+    // Text, a frame, text that starts with the magic, a frame with a byte
+    // damaged, a good frame, text, and a frame the stream ends inside
+    static const char text1[] = "Status: cruising\n";
+    static const char text2[] = "LG is also the magic\n";
+    static const char text3[] = "Done\n";
+    uint8_t a[LOG_FRAME_MAX], b[LOG_FRAME_MAX], c[LOG_FRAME_MAX], d[LOG_FRAME_MAX];
+    size_t a_length = single(a, 1), b_length = single(b, 2), c_length = single(c, 3), d_length = single(d, 4);
+    b[LOG_HEADER_SIZE + 4] ^= 0x10;
+
+    static uint8_t stream[4 * LOG_FRAME_MAX];
+    size_t used = 0;
+    append(stream, &used, text1, strlen(text1));
+    append(stream, &used, a, a_length);
+    append(stream, &used, text2, strlen(text2));
+    append(stream, &used, b, b_length);
+    append(stream, &used, c, c_length);
+    append(stream, &used, text3, strlen(text3));
+    append(stream, &used, d, d_length / 2);
+
+    char path[] = "/tmp/test_log_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0 && write(fd, stream, used) == (ssize_t)used && close(fd) == 0, "cannot write %s", path);
+    char command[512];
+    snprintf(command, sizeof(command), "%s %s 2>&1", decoder, path);
+    FILE *pipe = popen(command, "r");
+    CHECK(pipe, "cannot run %s", command);
+    static char output[16 * LOG_FRAME_MAX];
+    size_t length = fread(output, 1, sizeof(output) - 1, pipe);
+    int status = pclose(pipe);
+    unlink(path);
+    output[length] = '\0';
+    CHECK(status == 0, "%s exited with %d", decoder, status);
+
+    // Text and damaged frames pass through byte for byte
+    CHECK(contains(output, length, text1, strlen(text1)) && contains(output, length, text2, strlen(text2)) &&
+          contains(output, length, text3, strlen(text3)), "text lost:\n%s", output);
+    CHECK(contains(output, length, b, b_length), "the damaged frame did not pass through");
+    CHECK(contains(output, length, d, d_length / 2), "the cut frame did not pass through");
+
+    // The good frames decoded, the damaged one neither decoded nor missed
+    const char *lines[] = {
+        "Command: opcode 7 sequence 1 args -3 4, 5 us after receipt\n",
+        "Command: opcode 7 sequence 3 args -3 4, 5 us after receipt\n",
+    };
+    for (uint i = 0; i < count_of(lines); i++)
+        CHECK(contains(output, length, lines[i], strlen(lines[i])), "no \"%.*s\" in:\n%s",
+              (int)strlen(lines[i]) - 1, lines[i], output);
+    CHECK(!contains(output, length, "sequence 2 args", 15) && !contains(output, length, "sequence 4 args", 15),
+          "a damaged frame decoded");
+
+    char summary[160];
+    snprintf(summary, sizeof(summary), "2 frames, 2 records, 1 frames lost, 0 records dropped, 0 malformed, %zu text "
+             "bytes\n", strlen(text1) + strlen(text2) + b_length + strlen(text3) + d_length / 2);
+    CHECK(contains(output, length, summary, strlen(summary)), "expected \"%s\" in:\n%s", summary, output);
+    printf("%s", summary);
+}
+
+int main(int argc, char **argv)
+{
+    CHECK(argc == 2, "usage: %s log_decoder", argv[0]);
+    sim_init();
+    sim_advance_to(10 * MS);
+
+    test_round_trip();
+    test_full_ring();
+    test_damage();
+    test_decoder(argv[1]);
+    return 0;
+}
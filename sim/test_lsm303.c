@@ -0,0 +1,233 @@
+// The LSM303 driver against two scripted I2C targets that log every
+// transfer: the configuration registers lsm303_init() writes for a given
+// data rate, a missing part failing init, blocking reads decoding the
+// accelerometer (little-endian, auto-increment only with bit 7 of the
+// sub-address) and the magnetometer (big-endian, X/Z/Y). Then the DMA
+// pipeline: one burst per poll at the configured period, the magnetometer
+// status every third poll, its data only when DRDY is set, overruns
+// counted, no register rewritten after init, and polls skipped while a
+// slow bus is still busy.
+
+#include <string.h>
+#include "hal.h"
+#include "test.h"
+#include "hardware/timer.h"
+#include "board_pins.h"
+#include "magnetometer.h"
+
+#define MS 1000000ull
+
+#define ACCEL_STATUS_REG 0x27
+#define ACCEL_OUT_X_L 0x28
+#define ACCEL_STATUS_ZYXDA 0x08
+#define ACCEL_STATUS_ZYXOR 0x80
+#define MAG_OUT_X_H 0x03
+#define MAG_SR_REG 0x09
+#define MAG_SR_DRDY 0x01
+
+// 50 Hz polls every 10 ms; the 15 Hz magnetometer wants one every 33 ms
+#define POLL_MS 10
+#define MAG_EVERY 3
+
+typedef struct {
+    uint8_t reg[0x40];
+    uint8_t pointer;
+    bool increment;             // this transfer auto-increments
+    bool needs_increment_bit;   // the accelerometer only does with bit 7 set
+    uint8_t status_reg;
+    uint32_t transfers;         // register pointer writes
+    uint32_t status_reads;
+    uint8_t written[8][2];      // register, value
+    uint32_t write_count;
+} part_t;
+
+static part_t accel = {.needs_increment_bit = true, .status_reg = ACCEL_STATUS_REG};
+static part_t mag = {.status_reg = MAG_SR_REG};
+
+static void part_write(void *context, const uint8_t *data, size_t length)
+{
+    part_t *part = context;
+    part->transfers++;
+    part->pointer = data[0] & 0x3F;
+    part->increment = !part->needs_increment_bit || (data[0] & 0x80);
+    for (size_t i = 1; i < length; i++) {
+        if (part->write_count < count_of(part->written)) {
+            part->written[part->write_count][0] = part->pointer;
+            part->written[part->write_count][1] = data[i];
+        }
+        part->write_count++;
+        part->reg[part->pointer] = data[i];
+        if (part->increment)
+            part->pointer = (part->pointer + 1) & 0x3F;
+    }
+}
+
+static uint8_t part_read(void *context)
+{
+    part_t *part = context;
+    if (part->pointer == part->status_reg)
+        part->status_reads++;
+    uint8_t value = part->reg[part->pointer];
+    if (part->increment)
+        part->pointer = (part->pointer + 1) & 0x3F;
+    return value;
+}
+
+static void attach(part_t *part, uint8_t addr)
+{
+    sim_i2c_attach(IMU_I2C_PORT, addr, &(sim_i2c_target_t){part_write, part_read, part});
+}
+
+static void check_written(const part_t *part, const char *name, const uint8_t (*expected)[2], uint32_t count)
+{
+    CHECK(part->write_count == count, "%s: %u register writes, expected %u", name, part->write_count, count);
+    for (uint32_t i = 0; i < count; i++)
+        CHECK(part->written[i][0] == expected[i][0] && part->written[i][1] == expected[i][1],
+              "%s write %u: 0x%02x = 0x%02x, expected 0x%02x = 0x%02x", name, i, part->written[i][0],
+              part->written[i][1], expected[i][0], expected[i][1]);
+}
+
+static void set_accel(const int16_t xyz[3])
+{
+    for (int i = 0; i < 3; i++) {
+        accel.reg[ACCEL_OUT_X_L + 2 * i] = (uint8_t)xyz[i];
+        accel.reg[ACCEL_OUT_X_L + 2 * i + 1] = (uint8_t)((uint16_t)xyz[i] >> 8);
+    }
+}
+
+static void set_mag(const int16_t xyz[3])
+{
+    const int order[3] = {0, 2, 1};
+    for (int i = 0; i < 3; i++) {
+        mag.reg[MAG_OUT_X_H + 2 * i] = (uint8_t)((uint16_t)xyz[order[i]] >> 8);
+        mag.reg[MAG_OUT_X_H + 2 * i + 1] = (uint8_t)xyz[order[i]];
+    }
+}
+
+static bool same(const int16_t a[3], const int16_t b[3])
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+static void test_missing_part(void)
+{
+    sim_init();
+    attach(&accel, LSM303_ACCEL_ADDR);
+    CHECK(!lsm303_init(NULL), "init passed without the magnetometer");
+    memset(&accel, 0, sizeof(accel));
+    accel.needs_increment_bit = true;
+    accel.status_reg = ACCEL_STATUS_REG;
+}
+
+static void test_init(void)
+{
+    sim_init();
+    attach(&accel, LSM303_ACCEL_ADDR);
+    attach(&mag, LSM303_MAG_ADDR);
+    lsm303_config_t config = {LSM303_ACCEL_ODR_50HZ, LSM303_MAG_ODR_15HZ};
+    CHECK(lsm303_init(&config), "init failed");
+
+    // CTRL_REG1_A: 50 Hz, X/Y/Z on; CTRL_REG4_A: +/-2 g
+    static const uint8_t accel_writes[][2] = {{0x20, 0x47}, {0x23, 0x00}};
+    check_written(&accel, "accel", accel_writes, count_of(accel_writes));
+    // CRA_REG_M: 15 Hz; CRB_REG_M: +/-1.3 gauss; MR_REG_M: continuous
+    static const uint8_t mag_writes[][2] = {{0x00, 0x10}, {0x01, 0x20}, {0x02, 0x00}};
+    check_written(&mag, "mag", mag_writes, count_of(mag_writes));
+}
+
+static void test_blocking_reads(void)
+{
+    const int16_t a[3] = {1234, -2, -32768};
+    const int16_t m[3] = {-500, 321, 7};
+    set_accel(a);
+    set_mag(m);
+
+    int16_t out[3];
+    CHECK(lsm303_read_accel(out) && same(out, a), "accel read %d %d %d", out[0], out[1], out[2]);
+    CHECK(lsm303_read_mag(out) && same(out, m), "mag read %d %d %d", out[0], out[1], out[2]);
+}
+
+// Run for ms and return the polls and magnetometer status reads seen
+static void run(uint32_t ms, uint32_t *polls, uint32_t *mag_polls)
+{
+    uint32_t accel_before = accel.status_reads;
+    uint32_t mag_before = mag.status_reads;
+    sim_advance_to(sim_now_ns() + ms * MS);
+    *polls = accel.status_reads - accel_before;
+    *mag_polls = mag.status_reads - mag_before;
+}
+
+static void test_pipeline(void)
+{
+    const int16_t a[3] = {-16000, 40, 16001};
+    const int16_t m[3] = {275, -110, -392};
+    set_accel(a);
+    set_mag(m);
+    accel.reg[ACCEL_STATUS_REG] = ACCEL_STATUS_ZYXDA;
+    mag.reg[MAG_SR_REG] = 0;
+    accel.transfers = mag.transfers = 0;
+    accel.write_count = mag.write_count = 0;
+    lsm303_start();
+
+    // Accelerometer every poll in a single burst, magnetometer status only
+    uint32_t polls, mag_polls;
+    run(1000, &polls, &mag_polls);
+    lsm303_sample_t s;
+    lsm303_get_sample(&s);
+    // The last poll's burst may still be on the bus
+    CHECK(polls >= 1000 / POLL_MS - 1 && polls <= 1000 / POLL_MS, "%u polls in 1 s", polls);
+    CHECK(accel.transfers == polls, "%u accel transfers for %u polls", accel.transfers, polls);
+    CHECK(mag_polls == polls / MAG_EVERY && mag.transfers == mag_polls, "%u mag status reads, %u transfers",
+          mag_polls, mag.transfers);
+    CHECK(s.accel_sequence == polls && same(s.accel, a), "accel %u samples, %d %d %d", s.accel_sequence,
+          s.accel[0], s.accel[1], s.accel[2]);
+    CHECK(s.mag_sequence == 0, "%u mag samples without DRDY", s.mag_sequence);
+    uint32_t age_us = time_us_32() - s.accel_timestamp_us;
+    CHECK(age_us <= POLL_MS * 1000, "accel sample %u us old", age_us);
+
+    // DRDY set: each status read is followed by the data
+    mag.reg[MAG_SR_REG] = MAG_SR_DRDY;
+    uint32_t mag_transfers = mag.transfers;
+    run(1000, &polls, &mag_polls);
+    lsm303_get_sample(&s);
+    CHECK(s.mag_sequence == mag_polls && same(s.mag, m), "mag %u samples for %u polls, %d %d %d",
+          s.mag_sequence, mag_polls, s.mag[0], s.mag[1], s.mag[2]);
+    CHECK(mag.transfers - mag_transfers == 2 * mag_polls, "%u mag transfers for %u polls",
+          mag.transfers - mag_transfers, mag_polls);
+
+    // Overwritten samples are counted, and nothing new is not a sample
+    accel.reg[ACCEL_STATUS_REG] = ACCEL_STATUS_ZYXDA | ACCEL_STATUS_ZYXOR;
+    run(100, &polls, &mag_polls);
+    lsm303_get_sample(&s);
+    CHECK(s.accel_overruns == polls, "%u overruns in %u polls", s.accel_overruns, polls);
+    accel.reg[ACCEL_STATUS_REG] = 0;
+    uint32_t accel_sequence = s.accel_sequence;
+    run(100, &polls, &mag_polls);
+    lsm303_get_sample(&s);
+    CHECK(polls > 0 && s.accel_sequence == accel_sequence, "%u accel samples without ZYXDA",
+          s.accel_sequence - accel_sequence);
+
+    // Configured once: the pipeline only moves register pointers
+    CHECK(accel.write_count == 0 && mag.write_count == 0, "%u and %u register writes after init",
+          accel.write_count, mag.write_count);
+    CHECK(s.busy_polls == 0 && s.errors == 0, "%u busy polls, %u errors on a fast bus", s.busy_polls, s.errors);
+
+    // At 5 kHz a round takes longer than a poll period
+    accel.reg[ACCEL_STATUS_REG] = ACCEL_STATUS_ZYXDA;
+    accel_sequence = s.accel_sequence;
+    i2c_init(IMU_I2C_PORT, 5000);
+    run(1000, &polls, &mag_polls);
+    lsm303_get_sample(&s);
+    CHECK(s.busy_polls > 0 && s.accel_sequence - accel_sequence == polls && s.errors == 0,
+          "slow bus: %u busy polls, %u samples in %u polls, %u errors", s.busy_polls,
+          s.accel_sequence - accel_sequence, polls, s.errors);
+}
+
+int main(void)
+{
+    test_missing_part();
+    test_init();
+    test_blocking_reads();
+    test_pipeline();
+    return 0;
+}
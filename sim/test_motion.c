@@ -0,0 +1,193 @@
+// Maneuvers on the simulated car, measured against its true pose: encoder
+// drives forwards and backwards covering their distance, encoder arcs
+// turning their angle either way (clockwise positive), compass turns (by an angle, and onto a heading the
+// short way across north) with 1.5 degrees of compass noise, and a straight
+// drive that steers onto a heading off the one it started on. Then the
+// failures: heading maneuvers refused without a compass, a turn timing out
+// on a stuck compass, and a drive stalling with the wheels jammed.
+
+#include <math.h>
+#include "hal.h"
+#include "test.h"
+#include "world.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "motion.h"
+#include "motor.h"
+#include "speed_control.h"
+
+#define MS 1000000ull
+
+#define COMPASS_NOISE_DEG 1.5
+#define STOP_MS 300             // for the car to come to rest afterwards
+#define DISTANCE_ERROR_CM 1.0
+#define ARC_ERROR_DEG 4.0
+#define TURN_ERROR_DEG 3.0
+#define TURN_90_MS 1500
+
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+
+static q16_t noisy_compass(void)
+{
+    double heading = fmod(world_heading() + world_noise(COMPASS_NOISE_DEG) + 360.0, 360.0);
+    return (q16_t)(heading * Q16_ONE);
+}
+
+static q16_t stuck_compass(void)
+{
+    return Q16(45.0);
+}
+
+static world_status_t status(void)
+{
+    world_status_t s;
+    world_get_status(&s);
+    return s;
+}
+
+// Clockwise from a to b, -180..180
+static double turned(double a, double b)
+{
+    return fmod(b - a + 540.0, 360.0) - 180.0;
+}
+
+// Furthest clockwise the car went from where the last run() started
+static double clockwise_max;
+
+// Run the maneuver just started until it ends, then let the car stop.
+// Returns how it ended; *ms is how long it ran
+static motion_state_t run(uint32_t limit_ms, uint32_t *ms)
+{
+    uint64_t start = sim_now_ns();
+    double from = world_heading();
+    uint32_t elapsed = 0;
+    clockwise_max = 0;
+    while (motion_get_state() == MOTION_RUNNING && elapsed < limit_ms) {
+        sim_advance_to(start + ++elapsed * MS);
+        clockwise_max = fmax(clockwise_max, turned(from, world_heading()));
+    }
+    if (ms)
+        *ms = elapsed;
+    motion_state_t state = motion_get_state();
+    sim_advance_to(sim_now_ns() + STOP_MS * MS);
+    return state;
+}
+
+static void test_drive(void)
+{
+    const double distances[] = {50.0, -30.0};
+    for (uint i = 0; i < count_of(distances); i++) {
+        double before = status().odometer_cm;
+        uint32_t number = motion_get_maneuver();
+        motion_drive(Q16(distances[i]));
+        CHECK(motion_get_direction() == (distances[i] < 0 ? -1 : 1), "direction %d for %.0f cm",
+              motion_get_direction(), distances[i]);
+        uint32_t ms;
+        motion_state_t state = run(5000, &ms);
+        double driven = status().odometer_cm - before;
+        uint32_t seen;
+        printf("drive %+.0f cm: %.2f cm in %u ms\n", distances[i], driven, ms);
+        CHECK(state == MOTION_DONE, "drive %.0f cm ended in state %d", distances[i], state);
+        CHECK(motion_get_status(&seen) == MOTION_DONE && seen == number + 1, "maneuver %u, expected %u", seen,
+              number + 1);
+        CHECK(fabs(driven - fabs(distances[i])) <= DISTANCE_ERROR_CM, "drove %.2f cm for %.0f", driven,
+              distances[i]);
+    }
+}
+
+static void test_arc(void)
+{
+    // Clockwise like the compass turns, then anticlockwise twice to end a
+    // quarter turn left of the start
+    const double angles[] = {90.0, -90.0, -90.0};
+    for (uint i = 0; i < count_of(angles); i++) {
+        double before = world_heading();
+        motion_arc(Q16(angles[i]));
+        motion_state_t state = run(5000, NULL);
+        double arc = turned(before, world_heading());
+        printf("arc %+.0f: turned %+.2f degrees\n", angles[i], arc);
+        CHECK(state == MOTION_DONE, "arc %.0f ended in state %d", angles[i], state);
+        CHECK(fabs(arc - angles[i]) <= ARC_ERROR_DEG, "arc %.0f turned %+.2f degrees", angles[i], arc);
+    }
+}
+
+static void check_turn(double from, double to, const char *what, uint32_t limit_ms)
+{
+    uint32_t ms;
+    motion_state_t state = run(MOTION_TURN_TIMEOUT_MS + 100, &ms);
+    double error = turned(to, world_heading());
+    printf("%s: from %.1f to %.1f, %+.2f degrees off, %u ms\n", what, from, world_heading(), error, ms);
+    CHECK(state == MOTION_DONE, "%s ended in state %d", what, state);
+    CHECK(fabs(error) <= TURN_ERROR_DEG, "%s: %+.2f degrees off", what, error);
+    CHECK(ms <= limit_ms, "%s took %u ms", what, ms);
+}
+
+static void test_turns(void)
+{
+    CHECK(!motion_turn_by(Q16(90.0)) && !motion_drive_straight(Q16(10.0), 0), "started without a compass");
+    CHECK(motion_get_state() == MOTION_DONE, "a refused maneuver changed the state");
+
+    motion_set_heading_source(noisy_compass);
+    sim_advance_to(sim_now_ns() + 100 * MS);
+
+    double from = world_heading();
+    CHECK(motion_turn_by(Q16(90.0)), "turn refused with a compass");
+    check_turn(from, fmod(from + 90.0, 360.0), "turn by 90", TURN_90_MS);
+
+    // From about 90 onto 340: anticlockwise through north, not the long way
+    from = world_heading();
+    CHECK(motion_turn_to_heading(Q16(340.0)), "turn to heading refused");
+    check_turn(from, 340.0, "turn to 340", 2 * TURN_90_MS);
+    CHECK(clockwise_max < TURN_ERROR_DEG, "turned %.1f degrees clockwise towards 340", clockwise_max);
+
+    // Straight on 350 from 340: steers on, covers the distance
+    double before = status().odometer_cm;
+    CHECK(motion_drive_straight(Q16(60.0), Q16(350.0)), "drive straight refused");
+    motion_state_t state = run(6000, NULL);
+    double driven = status().odometer_cm - before;
+    double error = turned(350.0, world_heading());
+    printf("straight 60 cm on 350: %.2f cm, %+.2f degrees off\n", driven, error);
+    CHECK(state == MOTION_DONE, "straight drive ended in state %d", state);
+    CHECK(fabs(driven - 60.0) <= DISTANCE_ERROR_CM, "drove %.2f cm straight for 60", driven);
+    CHECK(fabs(error) <= TURN_ERROR_DEG, "straight drive %+.2f degrees off", error);
+}
+
+static void test_failures(void)
+{
+    // A compass stuck 90 degrees off the target: spins until the timeout
+    motion_set_heading_source(stuck_compass);
+    sim_advance_to(sim_now_ns() + 100 * MS);
+    uint32_t ms;
+    motion_turn_to_heading(Q16(135.0));
+    motion_state_t state = run(MOTION_TURN_TIMEOUT_MS * 2, &ms);
+    CHECK(state == MOTION_TIMEOUT, "stuck compass ended in state %d", state);
+    CHECK(ms >= MOTION_TURN_TIMEOUT_MS && ms <= MOTION_TURN_TIMEOUT_MS + 10, "timed out after %u ms", ms);
+
+    // Jammed wheels: no encoder progress
+    world_block_wheels(true);
+    motion_drive(Q16(20.0));
+    state = run(MOTION_STALL_TIMEOUT_MS * 2, &ms);
+    world_block_wheels(false);
+    CHECK(state == MOTION_STALLED, "jammed drive ended in state %d", state);
+    CHECK(ms >= MOTION_STALL_TIMEOUT_MS && ms <= MOTION_STALL_TIMEOUT_MS + 10, "stalled after %u ms", ms);
+    CHECK(motion_get_direction() == 0, "direction %d after stalling", motion_get_direction());
+}
+
+int main(void)
+{
+    sim_init();
+    world_init(&(world_config_t){.seed = 1});
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    motion_init(&encoder_left, &encoder_right);
+    speed_control_start_timer();
+
+    test_drive();
+    test_arc();
+    test_turns();
+    test_failures();
+    return 0;
+}
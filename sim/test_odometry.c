@@ -0,0 +1,145 @@
+// Odometry against the simulated car's true pose. Driven along a path of
+// straights, arcs both ways, a spin and a reverse, with a compass of 1.5
+// degrees noise fused in, the pose must stay within a small share of the
+// distance driven and the heading within a few degrees (the encoders only
+// count, and a wheel still rolls the old way for a moment after its
+// commanded direction flips). A fresh pose is published every control
+// tick. Then, standing still with the heading put 20 degrees off, the
+// compass must pull it back at the documented time constant.
+
+#include <math.h>
+#include "hal.h"
+#include "test.h"
+#include "hardware/timer.h"
+#include "world.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "motor.h"
+#include "odometry.h"
+#include "speed_control.h"
+
+#define MS 1000000ull
+
+#define COMPASS_NOISE_DEG 1.5
+#define POSITION_ERROR 0.02         // of the distance driven
+#define POSITION_ERROR_CM 1.0       // on top of that
+#define HEADING_ERROR_DEG 3.0
+#define OFFSET_DEG 20.0
+
+// 2^ODOMETRY_COMPASS_SHIFT ticks of SPEED_CONTROL_PERIOD_US
+#define TIME_CONSTANT_MS ((1 << ODOMETRY_COMPASS_SHIFT) * SPEED_CONTROL_PERIOD_US / 1000)
+
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+
+static q16_t noisy_compass(void)
+{
+    double heading = fmod(world_heading() + world_noise(COMPASS_NOISE_DEG) + 360.0, 360.0);
+    return (q16_t)(heading * Q16_ONE);
+}
+
+static double heading_error(const pose_t *pose, double truth)
+{
+    return fmod(pose->theta / (double)Q16_ONE - truth + 540.0, 360.0) - 180.0;
+}
+
+typedef struct {
+    double left;                // cm/s
+    double right;
+    uint32_t ms;
+} segment_t;
+
+static void test_path(void)
+{
+    world_status_t truth;
+    world_get_status(&truth);
+    odometry_reset((q16_t)(truth.pose.x * Q16_ONE), (q16_t)(truth.pose.y * Q16_ONE),
+                   (q16_t)(truth.pose.heading * Q16_ONE));
+
+    const segment_t path[] = {
+        {20, 20, 2000},         // straight east
+        {25, 10, 3000},         // arc clockwise
+        {15, -15, 1000},        // spin on the spot
+        {-15, -15, 1500},       // back up
+        {10, 25, 3000},         // arc anticlockwise
+        {20, 20, 2000},
+        {0, 0, 500},
+    };
+
+    double position_max = 0, heading_max = 0;
+    double position_allowed = 0;
+    pose_t start;
+    odometry_get_pose(&start);
+    uint32_t sequence = start.sequence;
+    for (uint i = 0; i < count_of(path); i++) {
+        speed_control_set_target(Q16(path[i].left), Q16(path[i].right));
+        for (uint32_t ms = 10; ms <= path[i].ms; ms += 10) {
+            sim_advance_to(sim_now_ns() + 10 * MS);
+            pose_t pose;
+            odometry_get_pose(&pose);
+            world_get_status(&truth);
+
+            // A fresh pose every tick
+            CHECK(pose.sequence - sequence >= 9 && pose.sequence - sequence <= 11, "%u poses in 10 ms",
+                  pose.sequence - sequence);
+            CHECK(time_us_32() - pose.timestamp_us <= SPEED_CONTROL_PERIOD_US, "pose %u us old",
+                  time_us_32() - pose.timestamp_us);
+            sequence = pose.sequence;
+
+            double position = hypot(pose.x / (double)Q16_ONE - truth.pose.x, pose.y / (double)Q16_ONE - truth.pose.y);
+            double allowed = POSITION_ERROR * truth.odometer_cm + POSITION_ERROR_CM;
+            if (position > position_max) {
+                position_max = position;
+                position_allowed = allowed;
+            }
+            CHECK(position <= allowed, "segment %u: %.2f cm off after %.1f cm", i, position, truth.odometer_cm);
+            double heading = fabs(heading_error(&pose, truth.pose.heading));
+            heading_max = fmax(heading_max, heading);
+            CHECK(heading <= HEADING_ERROR_DEG, "segment %u: heading %.2f degrees off", i, heading);
+        }
+    }
+    printf("%.1f cm driven: position at most %.2f cm off (%.2f allowed), heading %.2f degrees\n",
+           truth.odometer_cm, position_max, position_allowed, heading_max);
+    CHECK(truth.collisions == 0, "the path hit a wall");
+}
+
+static void test_compass_pull(void)
+{
+    pose_t pose;
+    odometry_get_pose(&pose);
+    q16_t x = pose.x, y = pose.y;
+    odometry_reset(x, y, pose.theta + Q16(OFFSET_DEG));
+
+    // One time constant: e^-1 of the offset left, then practically none
+    sim_advance_to(sim_now_ns() + TIME_CONSTANT_MS * MS);
+    odometry_get_pose(&pose);
+    double after_one = heading_error(&pose, world_heading());
+    sim_advance_to(sim_now_ns() + 4 * TIME_CONSTANT_MS * MS);
+    odometry_get_pose(&pose);
+    double after_five = heading_error(&pose, world_heading());
+    printf("%.0f degrees off: %.2f after %u ms, %.2f after %u ms\n", OFFSET_DEG, after_one, TIME_CONSTANT_MS,
+           after_five, 5 * TIME_CONSTANT_MS);
+    CHECK(after_one > 0.25 * OFFSET_DEG && after_one < 0.5 * OFFSET_DEG, "%.2f degrees off after %u ms",
+          after_one, TIME_CONSTANT_MS);
+    CHECK(fabs(after_five) < 0.05 * OFFSET_DEG, "%.2f degrees off after %u ms", after_five, 5 * TIME_CONSTANT_MS);
+    CHECK(pose.x == x && pose.y == y, "moved standing still");
+    CHECK(odometry_get_heading() == pose.theta, "odometry_get_heading() %d, pose %d", odometry_get_heading(),
+          pose.theta);
+}
+
+int main(void)
+{
+    sim_init();
+    world_init(&(world_config_t){.seed = 1});
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    odometry_init(&encoder_left, &encoder_right, noisy_compass);
+    speed_control_start_timer();
+    sim_advance_to(10 * MS);
+
+    test_path();
+    test_compass_pull();
+    return 0;
+}
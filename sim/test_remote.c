@@ -0,0 +1,208 @@
+// Remote commands through the whole firmware on the simulated car. A
+// script task stands in for lwIP's thread: it hands frames to
+// command_handle() and the planning task runs them from the dispatch table.
+// STOP holds the car through the boot calibrations with the behaviours off;
+// DRIVE covers its distance both ways; TURN_BY turns clockwise for a
+// positive angle, by compass or, with no LSM303 on the bus ("no-compass"),
+// by encoder arc; TURN_TO reaches its heading, or is refused without a
+// compass; SET_SPEED holds both wheel speeds; STATS adds the task table to
+// the next status report; MANUAL 0 hands the car back to the behaviours.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal.h"
+#include "test.h"
+#include "world.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "hardware/timer.h"
+#include "command.h"
+#include "fixed.h"
+
+// Partial_Integration.c's main(), renamed by the build
+int robot_main(void);
+
+#define CALIBRATION_MS 9000     // IR sweeps and the compass spin, with margin
+#define STEP_MS 3000            // for a maneuver to finish and the car to stop
+#define STILL_CM 0.1
+#define DISTANCE_ERROR_CM 1.5
+#define TURN_ERROR_DEG 4.0      // compass noise and its tolerance
+#define ARC_ERROR_DEG 5.0
+#define SPEED_ERROR 1.5         // cm/s
+
+static bool compass;
+static uint32_t sequence;
+
+static world_status_t status(void)
+{
+    world_status_t s;
+    world_get_status(&s);
+    return s;
+}
+
+// Clockwise from a to b, -180..180
+static double turned(double a, double b)
+{
+    return fmod(b - a + 540.0, 360.0) - 180.0;
+}
+
+// Along the heading the car had at from
+static double forward(const world_status_t *from, const world_status_t *to)
+{
+    double psi = from->pose.heading * (M_PI / 180.0);
+    return (to->pose.x - from->pose.x) * sin(psi) + (to->pose.y - from->pose.y) * cos(psi);
+}
+
+static void send(uint8_t opcode, int32_t arg0, int32_t arg1)
+{
+    command_frame_t frame = {.opcode = opcode, .sequence = ++sequence, .arg = {arg0, arg1}};
+    uint8_t bytes[COMMAND_FRAME_SIZE];
+    command_put(bytes, &frame);
+    CHECK(command_handle(bytes, sizeof(bytes), time_us_32()), "opcode %u got no ack", opcode);
+    CHECK(command_get(bytes, &frame) && frame.status == COMMAND_OK, "opcode %u acked with status %u", opcode,
+          frame.status);
+}
+
+// Send one command and let it play out; returns where the car was before
+static world_status_t step(uint8_t opcode, double arg0, double arg1, uint32_t ms)
+{
+    world_status_t before = status();
+    send(opcode, Q16(arg0), Q16(arg1));
+    vTaskDelay(pdMS_TO_TICKS(ms));
+    return before;
+}
+
+static void check_still(const char *what)
+{
+    world_status_t before = status();
+    vTaskDelay(pdMS_TO_TICKS(500));
+    world_status_t after = status();
+    CHECK(after.odometer_cm - before.odometer_cm < STILL_CM, "%s: still moving, %.2f cm in 500 ms", what,
+          after.odometer_cm - before.odometer_cm);
+}
+
+static void check_drive(double cm)
+{
+    world_status_t before = step(COMMAND_DRIVE, cm, 0, STEP_MS);
+    world_status_t after = status();
+    double driven = forward(&before, &after);
+    double turn = turned(before.pose.heading, after.pose.heading);
+    fprintf(stderr, "drive %+.0f: %+.2f cm, %+.2f degrees\n", cm, driven, turn);
+    CHECK(fabs(driven - cm) <= DISTANCE_ERROR_CM, "drive %.0f cm went %+.2f cm", cm, driven);
+    CHECK(fabs(turn) <= TURN_ERROR_DEG, "drive %.0f cm turned %+.2f degrees", cm, turn);
+    check_still("drive");
+}
+
+static void check_turn_by(double deg)
+{
+    world_status_t before = step(COMMAND_TURN_BY, deg, 0, STEP_MS);
+    double turn = turned(before.pose.heading, status().pose.heading);
+    fprintf(stderr, "turn by %+.0f: %+.2f degrees (%s)\n", deg, turn, compass ? "compass" : "arc");
+    CHECK(fabs(turn - deg) <= (compass ? TURN_ERROR_DEG : ARC_ERROR_DEG), "turn by %+.0f turned %+.2f degrees",
+          deg, turn);
+    check_still("turn by");
+}
+
+static void check_turn_to(double heading)
+{
+    world_status_t before = step(COMMAND_TURN_TO, heading, 0, STEP_MS);
+    world_status_t after = status();
+    fprintf(stderr, "turn to %.0f: from %.1f to %.1f\n", heading, before.pose.heading, after.pose.heading);
+    if (compass)
+        CHECK(fabs(turned(heading, after.pose.heading)) <= TURN_ERROR_DEG, "turn to %.0f ended on %.1f", heading,
+              after.pose.heading);
+    else
+        CHECK(after.odometer_cm - before.odometer_cm < STILL_CM, "turn to %.0f moved the car without a compass",
+              heading);
+}
+
+static void check_set_speed(void)
+{
+    step(COMMAND_SET_SPEED, 10.0, -10.0, 1000);
+    world_status_t after = status();
+    fprintf(stderr, "set speed 10 -10: %.2f %.2f cm/s\n", after.pose.speed_left, after.pose.speed_right);
+    CHECK(fabs(after.pose.speed_left - 10.0) <= SPEED_ERROR && fabs(after.pose.speed_right + 10.0) <= SPEED_ERROR,
+          "set speed 10 -10 runs at %.2f %.2f cm/s", after.pose.speed_left, after.pose.speed_right);
+
+    step(COMMAND_STOP, 0, 0, 500);
+    check_still("stop");
+}
+
+// Bytes of console output so far
+static off_t console_length(void)
+{
+    fflush(stdout);
+    return lseek(STDOUT_FILENO, 0, SEEK_CUR);
+}
+
+// How often text appears in the console output from offset on
+static uint count_text(off_t offset, const char *text)
+{
+    static char buffer[1 << 22];
+    off_t end = console_length();
+    size_t length = end - offset < (off_t)sizeof(buffer) ? (size_t)(end - offset) : sizeof(buffer);
+    ssize_t got = pread(STDOUT_FILENO, buffer, length, offset);
+    length = got > 0 ? (size_t)got : 0;
+
+    uint count = 0;
+    for (size_t i = 0; i + strlen(text) <= length; i++)
+        count += memcmp(buffer + i, text, strlen(text)) == 0;
+    return count;
+}
+
+static void check_stats(void)
+{
+    // Only on request: none of the reports so far had the task table
+    CHECK(count_text(0, "Task ") == 0, "task table printed without STATS");
+    off_t offset = console_length();
+    step(COMMAND_STATS, 0, 0, 1000);
+    uint tasks = count_text(offset, "Task ");
+    fprintf(stderr, "stats: %u task lines\n", tasks);
+    CHECK(tasks >= 5, "%u task lines after STATS", tasks);
+}
+
+static void script(__unused void *params)
+{
+    // Queued until the planning task starts, after the calibrations
+    send(COMMAND_STOP, 0, 0);
+    vTaskDelay(pdMS_TO_TICKS(CALIBRATION_MS));
+    check_still("held after the calibrations");
+
+    check_drive(30.0);
+    check_drive(-20.0);
+    check_turn_by(90.0);
+    check_turn_by(-45.0);
+    check_turn_to(180.0);
+    check_set_speed();
+    check_stats();
+
+    // Manual off: the behaviours drive again
+    world_status_t before = step(COMMAND_MANUAL, 0, 0, 1000);
+    double driven = status().odometer_cm - before.odometer_cm;
+    fprintf(stderr, "manual off: %.2f cm in 1 s\n", driven);
+    CHECK(driven > 5.0, "behaviours drove %.2f cm after MANUAL 0", driven);
+
+    CHECK(status().collisions == 0, "the car hit a wall");
+    sim_stop();
+    vTaskDelay(portMAX_DELAY);
+}
+
+int main(int argc, char **argv)
+{
+    compass = !(argc > 1 && strcmp(argv[1], "no-compass") == 0);
+
+    // The console goes to a file and is read back for STATS
+    FILE *console = tmpfile();
+    CHECK(console && dup2(fileno(console), STDOUT_FILENO) >= 0, "no file for the console");
+
+    sim_init();
+    world_init(&(world_config_t){.seed = 1, .no_compass = !compass});
+    command_queue_init(COMMAND_OPCODE_COUNT);
+    CHECK(xTaskCreate(script, "Script", 1024, NULL, tskIDLE_PRIORITY + 1, NULL) == pdPASS, "no script task");
+
+    robot_main();
+    CHECK(sim_stopped(), "the firmware stopped before the script");
+    return 0;
+}
@@ -0,0 +1,141 @@
+// The per-wheel speed loops on the simulated motors (a first-order lag
+// with static friction and a few percent of gain mismatch per wheel):
+// step responses while spinning on the spot, so one wheel runs backwards,
+// then both wheels reversing, then a stop. For each step the true wheel
+// speed must reach 90% of the target in time, not overshoot by much and
+// settle close to it. The seed for the motor mismatch is the argument.
+//
+// Before that, the PID alone on a motor model far off the feedforward's
+// 60 cm/s at full duty: the integral must make up the difference both
+// ways, so a motor that is too strong settles at the target too. The
+// feedforward's overshoot on such a motor is not held against the PID.
+
+#include <math.h>
+#include <stdlib.h>
+#include "hal.h"
+#include "test.h"
+#include "world.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "motor.h"
+#include "speed_control.h"
+
+#define MS 1000000ull
+
+#define STEP_MS 1500
+#define SETTLE_MS 500           // the end of a step that must be settled
+#define RISE_MS 250             // to 90% of the target
+#define OVERSHOOT 0.15
+#define SETTLED_ERROR 0.04      // mean over SETTLE_MS, of the target
+#define STOPPED_CM_S 0.5
+
+// The PID's own step: 1 kHz ticks on a first-order motor of this many
+// cm/s at full duty
+#define MODEL_TAU_MS 60.0
+#define MODEL_TARGET_CM_S 30.0
+
+static encoder_t encoder_left;
+static encoder_t encoder_right;
+
+typedef struct {
+    double target;
+    double rise_ms;             // -1 if never reached
+    double peak;                // furthest past zero in the target's direction
+    double settled;             // mean speed at the end
+} response_t;
+
+static void record(response_t *r, double speed, uint32_t ms)
+{
+    double along = r->target < 0 ? -speed : speed;
+    if (r->rise_ms < 0 && along >= 0.9 * fabs(r->target))
+        r->rise_ms = ms;
+    if (along > r->peak)
+        r->peak = along;
+    if (ms >= STEP_MS - SETTLE_MS)
+        r->settled += speed / SETTLE_MS;
+}
+
+// Set new targets and follow the true wheel speeds for STEP_MS
+static void step(double left, double right, response_t *out)
+{
+    out[0] = (response_t){left, -1, 0, 0};
+    out[1] = (response_t){right, -1, 0, 0};
+    speed_control_set_target(Q16(left), Q16(right));
+
+    uint64_t start = sim_now_ns();
+    for (uint32_t ms = 1; ms <= STEP_MS; ms++) {
+        sim_advance_to(start + ms * MS);
+        world_status_t status;
+        world_get_status(&status);
+        record(&out[0], status.pose.speed_left, ms);
+        record(&out[1], status.pose.speed_right, ms);
+    }
+}
+
+static void check_response(const response_t *r, uint32_t seed, const char *wheel)
+{
+    double target = fabs(r->target);
+    printf("seed %u %s %+.0f cm/s: rise %.0f ms, peak %.1f, settled %+.2f\n", seed, wheel, r->target,
+           r->rise_ms, r->peak, r->settled);
+    CHECK(r->rise_ms >= 0 && r->rise_ms <= RISE_MS, "seed %u %s: rise %.0f ms", seed, wheel, r->rise_ms);
+    CHECK(r->peak <= target * (1 + OVERSHOOT), "seed %u %s: peak %.1f cm/s for %.1f", seed, wheel,
+          r->peak, target);
+    CHECK(fabs(r->settled - r->target) <= target * SETTLED_ERROR, "seed %u %s: settled at %.2f cm/s for %.1f",
+          seed, wheel, r->settled, r->target);
+}
+
+// Same loop as speed_control.c's, with a perfect speed measurement
+static void test_pid_model(double full_speed)
+{
+    pid_controller_t pid;
+    pid_init(&pid, SPEED_KP, SPEED_KI, SPEED_KD, 0, Q16_ONE);
+    response_t r = {MODEL_TARGET_CM_S, -1, 0, 0};
+    q16_t target = Q16(MODEL_TARGET_CM_S);
+    double speed = 0;
+    for (uint32_t ms = 1; ms <= STEP_MS * 2; ms++) {
+        q16_t measured = (q16_t)(speed * Q16_ONE);
+        q16_t duty = pid_update(&pid, target - measured, q16_mul(SPEED_KF, target));
+        speed += (duty / (double)Q16_ONE * full_speed - speed) / (MODEL_TAU_MS + 1.0);
+        // Overshoot here is the feedforward's, so only the second half counts
+        if (ms > STEP_MS)
+            record(&r, speed, ms - STEP_MS);
+    }
+    printf("motor of %.0f cm/s: settled %.2f, integral %+.3f\n", full_speed, r.settled,
+           pid.integral / (double)Q16_ONE);
+    CHECK(fabs(r.settled - MODEL_TARGET_CM_S) <= MODEL_TARGET_CM_S * SETTLED_ERROR,
+          "motor of %.0f cm/s: settled at %.2f cm/s", full_speed, r.settled);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+    test_pid_model(45.0);
+    test_pid_model(90.0);
+
+    sim_init();
+    world_init(&(world_config_t){.seed = seed});
+    motor_init();
+    encoder_init(&encoder_left, ENCODER_LEFT_PIN);
+    encoder_init(&encoder_right, ENCODER_RIGHT_PIN);
+    speed_control_init(&encoder_left, &encoder_right);
+    speed_control_start_timer();
+
+    // Spin clockwise, then reverse both wheels at once
+    response_t r[2];
+    step(25.0, -25.0, r);
+    check_response(&r[0], seed, "left");
+    check_response(&r[1], seed, "right");
+    CHECK(speed_control_get_right_direction() == -1, "right wheel direction %d",
+          speed_control_get_right_direction());
+
+    step(-15.0, 15.0, r);
+    check_response(&r[0], seed, "left");
+    check_response(&r[1], seed, "right");
+    CHECK(speed_control_get_left_direction() == -1, "left wheel direction %d",
+          speed_control_get_left_direction());
+
+    step(0.0, 0.0, r);
+    CHECK(fabs(r[0].settled) < STOPPED_CM_S && fabs(r[1].settled) < STOPPED_CM_S,
+          "seed %u: still moving at %.2f, %.2f cm/s", seed, r[0].settled, r[1].settled);
+    return 0;
+}
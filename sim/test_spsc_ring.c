@@ -0,0 +1,86 @@
+// The SPSC ring with its producer and consumer on two host threads, as
+// the encoder ISR and the control task use it: every value arrives once
+// and in order, pushes that found the ring full are exactly the counted
+// overflows, and the free-running indices wrap past UINT32_MAX.
+
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+#include "spsc_ring.h"
+
+#define RING_SIZE 64                // as ENCODER_RING_SIZE
+#define STRESS_VALUES 500000u
+
+static uint32_t storage[RING_SIZE];
+static spsc_ring_t ring;
+static uint32_t rejected;
+
+// Pushes 0..STRESS_VALUES-1, retrying each one the ring refuses
+static void *producer(void *arg)
+{
+    (void)arg;
+    for (uint32_t value = 0; value < STRESS_VALUES; value++) {
+        while (!spsc_ring_push(&ring, value)) {
+            rejected++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_two_threads(void)
+{
+    spsc_ring_init(&ring, storage, RING_SIZE);
+    rejected = 0;
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, producer, NULL) == 0, "no producer thread");
+    uint32_t expected = 0;
+    uint32_t empty = 0;
+    while (expected < STRESS_VALUES) {
+        uint32_t value;
+        if (!spsc_ring_pop(&ring, &value)) {
+            empty++;
+            sched_yield();
+            continue;
+        }
+        CHECK(value == expected, "popped %u, expected %u", value, expected);
+        CHECK(spsc_ring_count(&ring) <= RING_SIZE, "count %u", spsc_ring_count(&ring));
+        expected++;
+    }
+    pthread_join(thread, NULL);
+
+    uint32_t value;
+    CHECK(!spsc_ring_pop(&ring, &value), "popped %u after the last value", value);
+    CHECK(ring.overflows == rejected, "%u overflows counted, %u pushes rejected", ring.overflows, rejected);
+    printf("%u values, %u full, %u empty\n", STRESS_VALUES, rejected, empty);
+}
+
+static void test_wrap(void)
+{
+    // Start the indices just short of wrapping, fill, overflow once, drain
+    spsc_ring_init(&ring, storage, RING_SIZE);
+    ring.head = UINT32_MAX - 10;
+    ring.tail = UINT32_MAX - 10;
+
+    for (uint32_t i = 0; i < RING_SIZE; i++)
+        CHECK(spsc_ring_push(&ring, i), "push %u refused", i);
+    CHECK(spsc_ring_count(&ring) == RING_SIZE, "count %u when full", spsc_ring_count(&ring));
+    CHECK(!spsc_ring_push(&ring, RING_SIZE), "push accepted when full");
+    CHECK(ring.overflows == 1, "%u overflows", ring.overflows);
+
+    uint32_t value;
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        CHECK(spsc_ring_pop(&ring, &value), "pop %u failed", i);
+        CHECK(value == i, "popped %u, expected %u", value, i);
+    }
+    CHECK(!spsc_ring_pop(&ring, &value), "popped from an empty ring");
+    CHECK(spsc_ring_count(&ring) == 0, "count %u when empty", spsc_ring_count(&ring));
+}
+
+int main(void)
+{
+    test_wrap();
+    test_two_threads();
+    return 0;
+}
@@ -0,0 +1,183 @@
+// The ultrasonic driver against echoes timed on the simulated clock: a
+// good echo's width and distance, the gap enforced between pings, the
+// no-echo and stuck-echo timeouts, an over-long echo that ends before the
+// driver polls, and the result ring keeping the newest readings.
+
+#include <math.h>
+#include "hal.h"
+#include "test.h"
+#include "board_pins.h"
+#include "pico/stdlib.h"
+#include "ultrasonic.h"
+
+#define US 1000ull
+#define NO_FALL UINT32_MAX
+
+// The echo the next trigger gets: high after rise_us, for pulse_us
+// (none at all if rise_us is 0)
+static uint32_t echo_rise_us;
+static uint32_t echo_pulse_us;
+static uint64_t trigger_rise_ns;
+static uint64_t trigger_fall_ns;
+
+static void echo_high(void *context)
+{
+    (void)context;
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, true);
+}
+
+static void echo_low(void *context)
+{
+    (void)context;
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, false);
+}
+
+static void trigger_changed(uint gpio, bool level)
+{
+    if (gpio != ULTRASONIC_TRIGGER_PIN)
+        return;
+    if (level) {
+        trigger_rise_ns = sim_now_ns();
+        return;
+    }
+    trigger_fall_ns = sim_now_ns();
+    if (!echo_rise_us)
+        return;
+    uint64_t rise_ns = trigger_fall_ns + echo_rise_us * US;
+    sim_schedule(rise_ns, echo_high, NULL);
+    if (echo_pulse_us != NO_FALL)
+        sim_schedule(rise_ns + echo_pulse_us * US, echo_low, NULL);
+}
+
+static void advance_us(uint64_t us)
+{
+    sim_advance_to(sim_now_ns() + us * US);
+}
+
+// Wait out the gap after the last reading and fire a ping with this echo
+static void ping(uint32_t rise_us, uint32_t pulse_us)
+{
+    advance_us(ULTRASONIC_PING_INTERVAL_US + 1000);
+    echo_rise_us = rise_us;
+    echo_pulse_us = pulse_us;
+    CHECK(ultrasonic_start(), "ping refused after the interval");
+    CHECK(trigger_fall_ns - trigger_rise_ns >= 10 * US, "trigger pulse %llu ns",
+          (unsigned long long)(trigger_fall_ns - trigger_rise_ns));
+}
+
+// Poll every 100 us until a reading arrives; fails after limit_us
+static void wait_result(uint32_t limit_us, ultrasonic_result_t *result)
+{
+    uint64_t deadline = sim_now_ns() + limit_us * US;
+    while (!ultrasonic_poll(result)) {
+        CHECK(sim_now_ns() < deadline, "no reading within %u us", limit_us);
+        advance_us(100);
+    }
+}
+
+static uint32_t since_trigger_us(void)
+{
+    return (uint32_t)((sim_now_ns() - trigger_fall_ns) / US);
+}
+
+static void test_echo(void)
+{
+    ultrasonic_result_t result;
+    ping(500, 1000);
+    wait_result(10000, &result);
+    CHECK(result.status == ULTRASONIC_OK, "status %d", result.status);
+    CHECK(result.pulse_us >= 1000 && result.pulse_us <= 1002, "pulse %u us", result.pulse_us);
+    CHECK(fabsf(result.distance_cm - 17.15f) < 0.05f, "distance %.2f cm", result.distance_cm);
+    uint32_t finished_us = result.timestamp_us - (uint32_t)(trigger_fall_ns / US);
+    CHECK(finished_us >= 1500 && finished_us <= 1502, "finished %u us after the trigger", finished_us);
+    CHECK(!ultrasonic_busy(), "busy after the reading");
+}
+
+static void test_interval(void)
+{
+    // Right after a reading, and just short of the interval, a ping is refused
+    ultrasonic_result_t result;
+    ping(300, 200);
+    wait_result(10000, &result);
+    uint64_t finished_ns = sim_now_ns();
+    CHECK(!ultrasonic_start(), "ping accepted straight after a reading");
+    sim_advance_to(finished_ns + (ULTRASONIC_PING_INTERVAL_US - 1000) * US);
+    CHECK(!ultrasonic_start(), "ping accepted before the interval");
+}
+
+static void test_no_echo(void)
+{
+    ultrasonic_result_t result;
+    ping(0, 0);
+    advance_us(ULTRASONIC_RISE_TIMEOUT_US - 100);
+    CHECK(!ultrasonic_poll(&result), "reading before the rise timeout");
+    CHECK(ultrasonic_busy(), "idle before the rise timeout");
+    CHECK(!ultrasonic_start(), "second ping while one is in flight");
+    advance_us(200);
+    CHECK(ultrasonic_poll(&result), "no reading after the rise timeout");
+    CHECK(result.status == ULTRASONIC_ERR_NO_ECHO, "status %d", result.status);
+    CHECK(since_trigger_us() <= ULTRASONIC_RISE_TIMEOUT_US + 110, "expired %u us after the trigger",
+          since_trigger_us());
+}
+
+static void test_stuck_echo(void)
+{
+    // Echo goes high and stays there past the timeout; its late fall must
+    // not turn into a reading
+    ultrasonic_result_t result;
+    ping(200, NO_FALL);
+    advance_us(200 + ULTRASONIC_ECHO_TIMEOUT_US - 100);
+    CHECK(!ultrasonic_poll(&result), "reading before the echo timeout");
+    advance_us(200);
+    CHECK(ultrasonic_poll(&result), "no reading after the echo timeout");
+    CHECK(result.status == ULTRASONIC_ERR_TIMEOUT, "status %d", result.status);
+    CHECK(result.pulse_us == 0, "pulse %u us on a timeout", result.pulse_us);
+
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, false);
+    advance_us(1000);
+    CHECK(!ultrasonic_poll(&result), "reading from the late fall");
+}
+
+static void test_long_echo(void)
+{
+    // Over-long echo that has ended by the time anyone polls
+    ultrasonic_result_t result;
+    ping(200, ULTRASONIC_ECHO_TIMEOUT_US + 5000);
+    advance_us(200 + ULTRASONIC_ECHO_TIMEOUT_US + 6000);
+    CHECK(ultrasonic_poll(&result), "no reading after the long echo");
+    CHECK(result.status == ULTRASONIC_ERR_TIMEOUT, "status %d", result.status);
+}
+
+static void test_overflow(void)
+{
+    // One more reading than the ring holds, none polled: the oldest goes
+    ultrasonic_result_t result;
+    uint32_t dropped = ultrasonic_dropped();
+    for (uint32_t i = 0; i <= ULTRASONIC_RESULT_COUNT; i++) {
+        ping(100, 100 * (i + 1));
+        advance_us(200 + 100 * (i + 1));
+        CHECK(!ultrasonic_busy(), "ping %u still in flight", i);
+    }
+    CHECK(ultrasonic_dropped() == dropped + 1, "dropped %u", ultrasonic_dropped() - dropped);
+    for (uint32_t i = 1; i <= ULTRASONIC_RESULT_COUNT; i++) {
+        CHECK(ultrasonic_poll(&result), "reading %u missing", i);
+        CHECK(result.pulse_us >= 100 * (i + 1) && result.pulse_us <= 100 * (i + 1) + 2,
+              "reading %u has pulse %u us", i, result.pulse_us);
+    }
+    CHECK(!ultrasonic_poll(&result), "more readings than were kept");
+}
+
+int main(void)
+{
+    sim_init();
+    sim_set_gpio_output_callback(trigger_changed);
+    ultrasonic_init(ULTRASONIC_TRIGGER_PIN, ULTRASONIC_ECHO_PIN);
+
+    test_echo();
+    test_interval();
+    test_no_echo();
+    test_stuck_echo();
+    test_long_echo();
+    test_overflow();
+    return 0;
+}
@@ -0,0 +1,408 @@
+#include <math.h>
+#include <string.h>
+#include "world.h"
+#include "hal.h"
+#include "board_pins.h"
+#include "encoder.h"
+#include "hardware/gpio.h"
+
+#define PI 3.14159265358979323846
+
+#define STEP_NS 100000ull               // physics step, 100 us
+
+// IR sensors: raw ADC counts over white and black, and the patch of floor
+// each one sees
+#define IR_WHITE 200.0
+#define IR_BLACK 3500.0
+#define IR_NOISE 15.0
+#define IR_SPOT_RADIUS_CM 0.6
+
+// HC-SR04: echo starts this long after the trigger falls, its width is the
+// round trip at CM_PER_US per us (ultrasonic.c), and it stays high for
+// ECHO_NONE_US when nothing is within ULTRASONIC_RANGE_CM
+#define ECHO_DELAY_US 500
+#define ECHO_NONE_US 38000
+#define CM_PER_US 0.01715
+#define ULTRASONIC_MIN_CM 2.0
+#define ULTRASONIC_RANGE_CM 400.0
+#define ULTRASONIC_NOISE_CM 0.3
+
+// The car is a circle this size around the axle for collisions
+#define CAR_RADIUS_CM 7.0
+
+// Encoder disc: the level changes every half pulse
+#define ENCODER_HALF_PULSE_CM (WHEEL_CIRCUMFERENCE / PPR / 2.0)
+
+typedef struct {
+    uint pwm_pin;
+    uint forward_pin;
+    uint reverse_pin;
+    uint encoder_pin;
+    double gain;                // this motor's speed for a given duty
+    double speed;               // cm/s
+    double position;            // cm rolled, signed
+} wheel_t;
+
+static world_config_t config;
+static uint64_t rng_state;
+static wheel_t wheels[2];       // left, right
+static world_status_t status;
+static double last_progress_s;  // arc length at the last step
+static bool echo_busy;
+static bool wheels_blocked;
+
+static double wall_min_x, wall_max_x, wall_min_y, wall_max_y;
+
+// xorshift64*, seeded through splitmix64 so small seeds are fine
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+static double rng_uniform(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double world_noise(double sigma)
+{
+    // Box-Muller, one value per call
+    double u = rng_uniform();
+    double v = rng_uniform();
+    return sigma * sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * PI * v);
+}
+
+double world_track_length(void)
+{
+    return 2.0 * WORLD_STRAIGHT_CM + 2.0 * PI * WORLD_TURN_RADIUS_CM;
+}
+
+double world_heading(void)
+{
+    return status.pose.heading;
+}
+
+void world_block_wheels(bool blocked)
+{
+    wheels_blocked = blocked;
+}
+
+// Distance from (x, y) to the middle of the line, and how far along the
+// line its nearest point is, anticlockwise from the bottom left corner
+static double track_distance(double x, double y, double *along)
+{
+    double half = WORLD_STRAIGHT_CM / 2.0;
+    double r = WORLD_TURN_RADIUS_CM;
+    double turn = PI * r;
+
+    if (x >= -half && x <= half) {
+        if (along)
+            *along = y < 0 ? x + half : WORLD_STRAIGHT_CM + turn + (half - x);
+        return fabs(fabs(y) - r);
+    }
+
+    double cx = x > 0 ? half : -half;
+    double angle = atan2(y, x - cx);    // -pi..pi, 0 pointing east
+    if (along) {
+        if (x > 0)
+            *along = WORLD_STRAIGHT_CM + (angle + PI / 2.0) * r;
+        else
+            *along = 2.0 * WORLD_STRAIGHT_CM + turn + ((angle < 0 ? angle + 2.0 * PI : angle) - PI / 2.0) * r;
+    }
+    return fabs(hypot(x - cx, y) - r);
+}
+
+// Share of a disc of radius 1 below the chord at a (-1..1 from the centre)
+static double disc_below(double a)
+{
+    if (a <= -1.0)
+        return 0.0;
+    if (a >= 1.0)
+        return 1.0;
+    return (PI - acos(a) + a * sqrt(1.0 - a * a)) / PI;
+}
+
+// How much of a sensor's spot at distance d from the line's middle is black.
+// The line is straight at this scale
+static double line_coverage(double d)
+{
+    double w = WORLD_LINE_WIDTH_CM / 2.0;
+    return disc_below((w - d) / IR_SPOT_RADIUS_CM) - disc_below((-w - d) / IR_SPOT_RADIUS_CM);
+}
+
+// A point on the car, forward and to the left of the axle middle
+static void car_point(double forward, double left, double *x, double *y)
+{
+    double psi = status.pose.heading * (PI / 180.0);
+    *x = status.pose.x + forward * sin(psi) - left * cos(psi);
+    *y = status.pose.y + forward * cos(psi) + left * sin(psi);
+}
+
+static uint16_t ir_source(uint input)
+{
+    double forward = WORLD_IR_FORWARD_CM;
+    double left = 0.0;
+    // ADC0 (IR_SENSOR_LEFT_PIN) sits on the car's right and ADC1 on its
+    // left: the firmware turns left when ADC1 sees the line, as the original
+    // bang-bang code did, which only steers towards the line this way round
+    switch (input) {
+    case 0:
+        left = -WORLD_IR_LATERAL_CM;
+        break;
+    case 1:
+        left = WORLD_IR_LATERAL_CM;
+        break;
+    case 2:
+        forward = WORLD_IR_BOTTOM_FORWARD_CM;
+        break;
+    default:
+        return 0x300;   // temperature sensor, about 25 C
+    }
+
+    double x, y;
+    car_point(forward, left, &x, &y);
+    double value = IR_WHITE + (IR_BLACK - IR_WHITE) * line_coverage(track_distance(x, y, NULL)) +
+                   world_noise(IR_NOISE);
+    return value < 0 ? 0 : value > 4095 ? 4095 : (uint16_t)value;
+}
+
+// Distance along a ray to the walls or the box
+static double ray_cast(double x, double y, double heading)
+{
+    double psi = heading * (PI / 180.0);
+    double dx = sin(psi), dy = cos(psi);
+
+    // Inside the walls: the nearest exit
+    double range = INFINITY;
+    if (dx > 1e-9)
+        range = fmin(range, (wall_max_x - x) / dx);
+    if (dx < -1e-9)
+        range = fmin(range, (wall_min_x - x) / dx);
+    if (dy > 1e-9)
+        range = fmin(range, (wall_max_y - y) / dy);
+    if (dy < -1e-9)
+        range = fmin(range, (wall_min_y - y) / dy);
+
+    // Outside the box: the slab entry, if the ray hits it at all
+    if (config.obstacle) {
+        double half = config.obstacle_size / 2.0;
+        double t_near = -INFINITY, t_far = INFINITY;
+        double origin[2] = {x - config.obstacle_x, y - config.obstacle_y};
+        double dir[2] = {dx, dy};
+        for (int axis = 0; axis < 2; axis++) {
+            if (fabs(dir[axis]) < 1e-9) {
+                if (fabs(origin[axis]) > half)
+                    t_far = -INFINITY;
+                continue;
+            }
+            double t1 = (-half - origin[axis]) / dir[axis];
+            double t2 = (half - origin[axis]) / dir[axis];
+            t_near = fmax(t_near, fmin(t1, t2));
+            t_far = fmin(t_far, fmax(t1, t2));
+        }
+        if (t_near <= t_far && t_near >= 0)
+            range = fmin(range, t_near);
+    }
+    return range;
+}
+
+static void echo_fall(void *context)
+{
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, false);
+    echo_busy = false;
+}
+
+static void echo_rise(void *context)
+{
+    double x, y;
+    car_point(WORLD_ULTRASONIC_FORWARD_CM, 0.0, &x, &y);
+    double distance = ray_cast(x, y, status.pose.heading) + world_noise(ULTRASONIC_NOISE_CM);
+
+    double width_us = ECHO_NONE_US;
+    if (distance <= ULTRASONIC_RANGE_CM)
+        width_us = fmax(distance, ULTRASONIC_MIN_CM) / CM_PER_US;
+
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, true);
+    sim_schedule(sim_now_ns() + (uint64_t)(width_us * 1000.0), echo_fall, NULL);
+}
+
+// A trigger pulse ends: the sensor pings unless it is still listening
+static void gpio_output(uint gpio, bool level)
+{
+    if (gpio != ULTRASONIC_TRIGGER_PIN || level || echo_busy)
+        return;
+    echo_busy = true;
+    status.pings++;
+    sim_schedule(sim_now_ns() + ECHO_DELAY_US * 1000ull, echo_rise, NULL);
+}
+
+static void encoder_edge(void *context)
+{
+    uintptr_t edge = (uintptr_t)context;
+    sim_gpio_drive(edge >> 1, edge & 1u);
+}
+
+static double wheel_duty(const wheel_t *wheel)
+{
+    uint32_t pins = gpio_get_all();
+    bool forward = (pins >> wheel->forward_pin) & 1u;
+    bool reverse = (pins >> wheel->reverse_pin) & 1u;
+    double duty = sim_pwm_duty(wheel->pwm_pin);
+    if (forward == reverse || duty < WORLD_DEADBAND_DUTY)
+        return 0.0;
+    return forward ? duty : -duty;
+}
+
+// Move one wheel through a step, with an encoder edge at the moment the
+// disc passes each slot boundary
+static double wheel_step(wheel_t *wheel, uint64_t now_ns)
+{
+    double dt = STEP_NS * 1e-9;
+    if (wheels_blocked) {
+        wheel->speed = 0.0;
+        return 0.0;
+    }
+    double target = wheel_duty(wheel) * WORLD_FULL_SPEED_CM_S * wheel->gain;
+    wheel->speed += (target - wheel->speed) * (dt / (WORLD_WHEEL_TAU_S + dt));
+
+    double from = wheel->position;
+    double to = from + wheel->speed * dt;
+    wheel->position = to;
+
+    long slot_from = (long)floor(from / ENCODER_HALF_PULSE_CM);
+    long slot_to = (long)floor(to / ENCODER_HALF_PULSE_CM);
+    long step = slot_to > slot_from ? 1 : -1;
+    for (long slot = slot_from; slot != slot_to; slot += step) {
+        long entered = slot + step;
+        double boundary = (step > 0 ? entered : slot) * ENCODER_HALF_PULSE_CM;
+        double fraction = (boundary - from) / (to - from);
+        uintptr_t edge = (uintptr_t)wheel->encoder_pin << 1 | (uintptr_t)(entered & 1);
+        sim_schedule(now_ns + (uint64_t)(fraction * STEP_NS), encoder_edge, (void *)edge);
+    }
+    return to - from;
+}
+
+static bool collides(double x, double y)
+{
+    if (x - CAR_RADIUS_CM < wall_min_x || x + CAR_RADIUS_CM > wall_max_x ||
+        y - CAR_RADIUS_CM < wall_min_y || y + CAR_RADIUS_CM > wall_max_y)
+        return true;
+    if (config.obstacle) {
+        double reach = config.obstacle_size / 2.0 + CAR_RADIUS_CM;
+        return fabs(x - config.obstacle_x) < reach && fabs(y - config.obstacle_y) < reach;
+    }
+    return false;
+}
+
+static void physics_step(void *context)
+{
+    uint64_t now = sim_now_ns();
+    double dl = wheel_step(&wheels[0], now);
+    double dr = wheel_step(&wheels[1], now);
+
+    // Differential drive: the left wheel ahead turns the car clockwise
+    world_pose_t *pose = &status.pose;
+    double distance = (dl + dr) / 2.0;
+    double heading = pose->heading + (dl - dr) / WORLD_WHEEL_BASE_CM * (180.0 / PI);
+    double psi = (pose->heading + heading) / 2.0 * (PI / 180.0);
+    double x = pose->x + distance * sin(psi);
+    double y = pose->y + distance * cos(psi);
+
+    pose->heading = fmod(heading + 360.0, 360.0);
+    pose->speed_left = wheels[0].speed;
+    pose->speed_right = wheels[1].speed;
+    if (collides(x, y)) {
+        // Wheels slip against the wall
+        status.collisions++;
+    } else {
+        pose->x = x;
+        pose->y = y;
+        status.odometer_cm += fabs(distance);
+    }
+
+    // Progress along the line, unwrapped, and whole laps either way
+    double along;
+    double line_distance = track_distance(pose->x, pose->y, &along);
+    double length = world_track_length();
+    double delta = along - last_progress_s;
+    if (delta > length / 2.0)
+        delta -= length;
+    if (delta < -length / 2.0)
+        delta += length;
+    last_progress_s = along;
+    status.progress_cm += delta;
+
+    uint32_t laps = (uint32_t)(fabs(status.progress_cm) / length);
+    if (laps > status.laps) {
+        if (status.laps < WORLD_MAX_LAPS)
+            status.lap_end_us[status.laps] = now / 1000;
+        status.laps = laps;
+    }
+
+    status.line_distance_sum += line_distance;
+    status.line_samples++;
+    if (line_distance > status.line_distance_max)
+        status.line_distance_max = line_distance;
+
+    sim_schedule(now + STEP_NS, physics_step, NULL);
+}
+
+void world_init(const world_config_t *world_config)
+{
+    config = *world_config;
+    rng_state = 0x9E3779B97F4A7C15ull * (config.seed + 1);
+    rng_state ^= rng_state >> 31;
+    if (!rng_state)
+        rng_state = 1;
+
+    memset(&status, 0, sizeof(status));
+    echo_busy = false;
+    wheels_blocked = false;
+
+    double half = WORLD_STRAIGHT_CM / 2.0;
+    double r = WORLD_TURN_RADIUS_CM;
+    wall_min_x = -half - r - WORLD_WALL_MARGIN_CM;
+    wall_max_x = half + r + WORLD_WALL_MARGIN_CM;
+    wall_min_y = -r - WORLD_WALL_MARGIN_CM;
+    wall_max_y = r + WORLD_WALL_MARGIN_CM;
+
+    // On the bottom straight heading east, the IR sensors over the line
+    status.pose.x = -WORLD_IR_FORWARD_CM;
+    status.pose.y = -r;
+    status.pose.heading = 90.0;
+    track_distance(status.pose.x, status.pose.y, &last_progress_s);
+
+    // No two motors are quite the same
+    wheels[0] = (wheel_t){
+        .pwm_pin = MOTOR_PWM_LEFT_PIN,
+        .forward_pin = MOTOR_DIR_L01_PIN,
+        .reverse_pin = MOTOR_DIR_L02_PIN,
+        .encoder_pin = ENCODER_LEFT_PIN,
+        .gain = 1.0 + 0.03 * (2.0 * rng_uniform() - 1.0),
+    };
+    wheels[1] = (wheel_t){
+        .pwm_pin = MOTOR_PWM_RIGHT_PIN,
+        .forward_pin = MOTOR_DIR_R01_PIN,
+        .reverse_pin = MOTOR_DIR_R02_PIN,
+        .encoder_pin = ENCODER_RIGHT_PIN,
+        .gain = 1.0 + 0.03 * (2.0 * rng_uniform() - 1.0),
+    };
+
+    sim_gpio_drive(ENCODER_LEFT_PIN, false);
+    sim_gpio_drive(ENCODER_RIGHT_PIN, false);
+    sim_gpio_drive(ULTRASONIC_ECHO_PIN, false);
+    sim_set_gpio_output_callback(gpio_output);
+    sim_set_adc_source(ir_source);
+    if (!config.no_compass)
+        lsm303_model_init();
+
+    sim_schedule(sim_now_ns() + STEP_NS, physics_step, NULL);
+}
+
+void world_get_status(world_status_t *out)
+{
+    *out = status;
+}
@@ -0,0 +1,83 @@
+#ifndef SIM_WORLD_H
+#define SIM_WORLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The car and its surroundings, driving the mock HAL (hal.h). Positions in
+// cm with x east and y north, headings in degrees clockwise from north as
+// the compass reads them. The floor is white with a closed black line: two
+// straights joined by semicircles around the origin, with walls around it
+// for the ultrasonic sensor. The car starts on the bottom straight heading
+// east, with its IR sensors over the line.
+
+// Track
+#define WORLD_STRAIGHT_CM 100.0
+#define WORLD_TURN_RADIUS_CM 40.0
+#define WORLD_LINE_WIDTH_CM 1.8
+#define WORLD_WALL_MARGIN_CM 40.0       // from the line to the walls
+
+// Car, matching encoder.h, motion.h and grid.h
+#define WORLD_WHEEL_BASE_CM 11.0
+#define WORLD_FULL_SPEED_CM_S 60.0      // at full duty, as SPEED_KF assumes
+#define WORLD_WHEEL_TAU_S 0.06          // first-order motor response
+#define WORLD_DEADBAND_DUTY 0.03        // static friction
+#define WORLD_IR_FORWARD_CM 8.0         // left/right sensors ahead of the axle
+#define WORLD_IR_LATERAL_CM 1.2         // and either side of the middle
+#define WORLD_IR_BOTTOM_FORWARD_CM 4.0
+#define WORLD_ULTRASONIC_FORWARD_CM 5.0
+
+typedef struct {
+    uint32_t seed;              // noise and wheel mismatch
+    bool obstacle;              // a square box in the way
+    double obstacle_x;
+    double obstacle_y;
+    double obstacle_size;
+    bool no_compass;            // nothing answers on the LSM303's addresses
+} world_config_t;
+
+typedef struct {
+    double x;
+    double y;
+    double heading;
+    double speed_left;          // cm/s
+    double speed_right;
+} world_pose_t;
+
+#define WORLD_MAX_LAPS 64
+
+typedef struct {
+    world_pose_t pose;
+    double odometer_cm;         // distance the middle of the car drove
+    double progress_cm;         // along the line, positive anticlockwise
+    uint32_t laps;              // whole laps either way
+    uint64_t lap_end_us[WORLD_MAX_LAPS];
+    double line_distance_max;   // car middle to the line, cm
+    double line_distance_sum;   // per sample, for the mean
+    uint32_t line_samples;
+    uint32_t pings;             // ultrasonic trigger pulses seen
+    uint32_t collisions;        // steps spent touching a wall or the box
+} world_status_t;
+
+// Reset the world, attach the sensors to the HAL and start the clock
+// events. After sim_init()
+void world_init(const world_config_t *config);
+
+void world_get_status(world_status_t *status);
+
+// Length of the line once round
+double world_track_length(void);
+
+// Car heading now, for the magnetometer model
+double world_heading(void);
+
+// Jam both wheels (a stuck gearbox, the car wedged on something), or free them
+void world_block_wheels(bool blocked);
+
+// Gaussian noise from the seeded generator
+double world_noise(double sigma);
+
+// The LSM303DLHC on IMU_I2C_PORT, turned with the car (lsm303_model.c)
+void lsm303_model_init(void);
+
+#endif
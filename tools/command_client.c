@@ -0,0 +1,336 @@
+// Host client for the robot's binary remote commands (driver/wifi/command.h).
+//
+//   cc -O2 -Wall -I driver/common -I driver/wifi -o command_client tools/command_client.c -lm
+//
+//   command_client [-t] host[:port] command [args]
+//       Send one command over UDP (-t: TCP) and wait for its ack. Options go
+//       before the host, so negative arguments are not taken for options:
+//         ping [count]        round trips, then min/avg/p99/max
+//         stop                abort and hold, manual mode
+//         drive cm            negative backwards
+//         turn degrees        positive clockwise
+//         heading degrees     compass heading
+//         speed left right    wheel targets, cm/s
+//         manual 0|1          1: remote control only, 0: behaviours back on
+//         stats               task, ISR and jitter statistics to the console and log
+//
+//   command_client -s [-p port]
+//       Stand-in for the robot: acknowledge frames on UDP and TCP like the
+//       firmware does, to test the client and the link without the car.
+//       Loopback check: command_client -s & command_client 127.0.0.1 ping 1000
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "command_codec.h"
+
+#define ACK_TIMEOUT_MS 500
+
+static const char *const opcode_names[COMMAND_OPCODE_COUNT] = {
+    [COMMAND_PING] = "ping",
+    [COMMAND_STOP] = "stop",
+    [COMMAND_DRIVE] = "drive",
+    [COMMAND_TURN_BY] = "turn",
+    [COMMAND_TURN_TO] = "heading",
+    [COMMAND_SET_SPEED] = "speed",
+    [COMMAND_MANUAL] = "manual",
+    [COMMAND_STATS] = "stats",
+};
+
+// Arguments each command takes, all Q16.16 on the wire except manual's flag
+static const int opcode_args[COMMAND_OPCODE_COUNT] = {
+    [COMMAND_DRIVE] = 1,
+    [COMMAND_TURN_BY] = 1,
+    [COMMAND_TURN_TO] = 1,
+    [COMMAND_SET_SPEED] = 2,
+    [COMMAND_MANUAL] = 1,
+};
+
+static uint32_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Whole frame off a stream, or 0 on end of stream or timeout
+static int read_frame(int sock, uint8_t frame[COMMAND_FRAME_SIZE])
+{
+    size_t have = 0;
+    while (have < COMMAND_FRAME_SIZE) {
+        ssize_t n = recv(sock, frame + have, COMMAND_FRAME_SIZE - have, 0);
+        if (n <= 0)
+            return 0;
+        have += (size_t)n;
+    }
+    return 1;
+}
+
+static int connect_to(const char *target, int tcp)
+{
+    char host[64];
+    unsigned port = COMMAND_PORT;
+    snprintf(host, sizeof(host), "%s", target);
+    char *colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = (unsigned)atoi(colon + 1);
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", host);
+        return -1;
+    }
+
+    // A connected UDP socket only sees datagrams from the robot
+    int sock = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return -1;
+    }
+    int one = 1;
+    if (tcp)
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = ACK_TIMEOUT_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+// Send one command and wait for the ack with its sequence number. Returns
+// the round-trip time in us, or -1 if no ack came
+static long round_trip(int sock, int tcp, command_frame_t *frame, command_frame_t *ack)
+{
+    uint8_t out[COMMAND_FRAME_SIZE];
+    uint8_t in[COMMAND_FRAME_SIZE];
+
+    frame->client_time_us = now_us();
+    command_put(out, frame);
+    if (send(sock, out, sizeof(out), 0) != sizeof(out)) {
+        perror("send");
+        return -1;
+    }
+
+    while (1) {
+        int got = tcp ? read_frame(sock, in) : recv(sock, in, sizeof(in), 0) == sizeof(in);
+        if (!got)
+            return -1;
+        // Acks of earlier, timed out commands can still arrive: skip them
+        if (command_get(in, ack) && (ack->flags & COMMAND_FLAG_ACK) && ack->sequence == frame->sequence)
+            return (long)(now_us() - ack->client_time_us);
+    }
+}
+
+static int ping(int sock, int tcp, unsigned count)
+{
+    uint32_t *rtt = malloc(count * sizeof(*rtt));
+    unsigned replies = 0;
+    unsigned long long total = 0;
+    unsigned long long robot_total = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        command_frame_t frame = {.opcode = COMMAND_PING, .sequence = i};
+        command_frame_t ack;
+        long us = round_trip(sock, tcp, &frame, &ack);
+        if (us < 0)
+            continue;
+        rtt[replies++] = (uint32_t)us;
+        total += (unsigned long)us;
+        robot_total += (uint32_t)ack.arg[0];
+    }
+
+    if (replies == 0) {
+        fprintf(stderr, "no replies\n");
+        free(rtt);
+        return 1;
+    }
+    qsort(rtt, replies, sizeof(*rtt), compare_u32);
+    printf("%u/%u replies, rtt min %u avg %llu p99 %u max %u us, robot avg %llu us\n",
+           replies, count, rtt[0], total / replies, rtt[(replies - 1) * 99 / 100], rtt[replies - 1],
+           robot_total / replies);
+    free(rtt);
+    return replies == count ? 0 : 1;
+}
+
+static int client(const char *target, int tcp, int argc, char **argv)
+{
+    int opcode = -1;
+    for (int i = 0; i < COMMAND_OPCODE_COUNT; i++) {
+        if (strcmp(argv[0], opcode_names[i]) == 0)
+            opcode = i;
+    }
+    if (opcode < 0) {
+        fprintf(stderr, "unknown command %s\n", argv[0]);
+        return 2;
+    }
+
+    int sock = connect_to(target, tcp);
+    if (sock < 0)
+        return 1;
+
+    if (opcode == COMMAND_PING)
+        return ping(sock, tcp, argc > 1 ? (unsigned)atoi(argv[1]) : 10);
+
+    if (argc - 1 < opcode_args[opcode]) {
+        fprintf(stderr, "%s takes %d argument(s)\n", argv[0], opcode_args[opcode]);
+        return 2;
+    }
+    command_frame_t frame = {.opcode = (uint8_t)opcode, .sequence = now_us()};
+    for (int i = 0; i < opcode_args[opcode]; i++) {
+        double value = atof(argv[1 + i]);
+        frame.arg[i] = opcode == COMMAND_MANUAL ? (int32_t)value : (int32_t)lround(value * 65536.0);
+    }
+
+    command_frame_t ack;
+    long us = round_trip(sock, tcp, &frame, &ack);
+    if (us < 0) {
+        fprintf(stderr, "no ack\n");
+        return 1;
+    }
+    static const char *const status_names[] = {"ok", "unknown", "busy"};
+    printf("%s: %s, rtt %ld us\n", argv[0], ack.status < 3 ? status_names[ack.status] : "?", us);
+    return ack.status == COMMAND_OK ? 0 : 1;
+}
+
+// Ack one frame in place the way the firmware does. 0 if it gets no ack
+static int serve_frame(uint8_t bytes[COMMAND_FRAME_SIZE])
+{
+    uint32_t received_us = now_us();
+    command_frame_t frame;
+    if (!command_get(bytes, &frame) || (frame.flags & COMMAND_FLAG_ACK))
+        return 0;
+
+    if (frame.opcode != COMMAND_PING && frame.opcode < COMMAND_OPCODE_COUNT)
+        fprintf(stderr, "%s %d %d\n", opcode_names[frame.opcode], frame.arg[0], frame.arg[1]);
+
+    frame.flags = COMMAND_FLAG_ACK;
+    frame.status = frame.opcode < COMMAND_OPCODE_COUNT ? COMMAND_OK : COMMAND_UNKNOWN;
+    frame.arg[0] = (int32_t)(now_us() - received_us);
+    frame.arg[1] = 0;
+    command_put(bytes, &frame);
+    return 1;
+}
+
+static int serve(unsigned port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int one = 1;
+    int udp = socket(AF_INET, SOCK_DGRAM, 0);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (udp < 0 || listener < 0 || bind(udp, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 1) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    // One TCP client at a time, the newest wins, as on the robot
+    int tcp = -1;
+    uint8_t partial[COMMAND_FRAME_SIZE];
+    size_t partial_length = 0;
+
+    fprintf(stderr, "listening on UDP and TCP %u\n", port);
+    while (1) {
+        struct pollfd fds[3] = {
+            {.fd = udp, .events = POLLIN},
+            {.fd = listener, .events = POLLIN},
+            {.fd = tcp, .events = POLLIN},
+        };
+        if (poll(fds, tcp >= 0 ? 3 : 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint8_t frame[COMMAND_FRAME_SIZE + 1];
+            struct sockaddr_in from;
+            socklen_t from_length = sizeof(from);
+            ssize_t n = recvfrom(udp, frame, sizeof(frame), 0, (struct sockaddr *)&from, &from_length);
+            if (n == COMMAND_FRAME_SIZE && serve_frame(frame))
+                sendto(udp, frame, COMMAND_FRAME_SIZE, 0, (struct sockaddr *)&from, from_length);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int accepted = accept(listener, NULL, NULL);
+            if (accepted >= 0) {
+                if (tcp >= 0)
+                    close(tcp);
+                tcp = accepted;
+                partial_length = 0;
+                setsockopt(tcp, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            continue;
+        }
+
+        if (tcp >= 0 && (fds[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t n = recv(tcp, partial + partial_length, sizeof(partial) - partial_length, 0);
+            if (n <= 0) {
+                close(tcp);
+                tcp = -1;
+                continue;
+            }
+            partial_length += (size_t)n;
+            if (partial_length == COMMAND_FRAME_SIZE) {
+                partial_length = 0;
+                // Out of step with the stream: drop the client
+                if (!serve_frame(partial) || send(tcp, partial, COMMAND_FRAME_SIZE, 0) != COMMAND_FRAME_SIZE) {
+                    close(tcp);
+                    tcp = -1;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned port = COMMAND_PORT;
+    int tcp = 0;
+    int server = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+tsp:")) != -1) {
+        switch (opt) {
+        case 't': tcp = 1; break;
+        case 's': server = 1; break;
+        case 'p': port = (unsigned)atoi(optarg); break;
+        default:
+            goto usage;
+        }
+    }
+
+    if (server)
+        return serve(port);
+    if (argc - optind >= 2)
+        return client(argv[optind], tcp, argc - optind - 1, argv + optind + 1);
+
+usage:
+    fprintf(stderr, "usage: %s [-t] host[:port] command [args] | -s [-p port]\n", argv[0]);
+    return 2;
+}
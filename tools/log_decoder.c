@@ -0,0 +1,274 @@
+// Host decoder for the robot's binary log (driver/log/log.h).
+//
+//   cc -O2 -Wall -I driver/common -I driver/log -I Partial_Integration
+//      -o log_decoder tools/log_decoder.c
+//
+//   log_decoder [file]
+//       Decode frames from a byte stream, the USB console by default:
+//       log_decoder /dev/ttyACM0. Anything that is not a valid frame (the
+//       status text) is passed through unchanged.
+//
+//   log_decoder -u [-p port]
+//       Decode frames sent over UDP (TELEMETRY_HOST builds).
+//
+// Format strings come from Partial_Integration/log_messages.h, so rebuild
+// the decoder when messages are added. Statistics go to stderr at the end.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log_codec.h"
+#include "log_messages.h"
+
+#define LOG_FORMAT(id, format) format,
+
+static const char *const formats[LOG_MESSAGE_COUNT] = {
+    LOG_MESSAGES(LOG_FORMAT)
+};
+
+#define CORES 2
+
+typedef struct {
+    unsigned long frames;
+    unsigned long records;
+    unsigned long lost_frames;  // sequence numbers never seen
+    unsigned long dropped;      // records the robot could not queue
+    unsigned long malformed;
+    unsigned long text_bytes;
+} decoder_stats_t;
+
+static decoder_stats_t stats;
+static uint16_t next_sequence[CORES];
+static int synced[CORES];
+
+// printf one argument with a conversion spec from the catalogue. Length
+// modifiers are dropped: every argument is 32 bits on the wire
+static void format_arg(const char *spec, size_t spec_length, char conversion, uint32_t arg)
+{
+    char buffer[32];
+    size_t n = 0;
+    int has_precision = 0;
+    for (size_t i = 0; i < spec_length && n < sizeof(buffer) - 5; i++) {
+        char c = spec[i];
+        if (c == 'l' || c == 'h' || c == 'z' || c == 'j' || c == 't')
+            continue;
+        if (c == '.')
+            has_precision = 1;
+        buffer[n++] = c;
+    }
+
+    switch (conversion) {
+    case 'd': case 'i':
+        buffer[n++] = conversion;
+        buffer[n] = '\0';
+        printf(buffer, (int)(int32_t)arg);
+        break;
+    case 'u': case 'x': case 'X': case 'o':
+        buffer[n++] = conversion;
+        buffer[n] = '\0';
+        printf(buffer, (unsigned)arg);
+        break;
+    case 'c':
+        buffer[n++] = 'c';
+        buffer[n] = '\0';
+        printf(buffer, (int)arg);
+        break;
+    case 'f': case 'e': case 'g': {
+        union { uint32_t u; float f; } bits = {.u = arg};
+        buffer[n++] = conversion;
+        buffer[n] = '\0';
+        printf(buffer, (double)bits.f);
+        break;
+    }
+    case 'q':
+        // Q16.16, three decimals unless the format says otherwise
+        if (!has_precision) {
+            memcpy(buffer + n, ".3", 2);
+            n += 2;
+        }
+        buffer[n++] = 'f';
+        buffer[n] = '\0';
+        printf(buffer, (int32_t)arg / 65536.0);
+        break;
+    default:
+        printf("<%%%c?>", conversion);
+        break;
+    }
+}
+
+static void print_record(const log_record_t *record, unsigned core)
+{
+    printf("[%10.6f c%u] ", record->timestamp_us / 1e6, core);
+    if (record->id >= LOG_MESSAGE_COUNT) {
+        printf("<unknown message %u>", record->id);
+        for (unsigned i = 0; i < record->arg_count; i++)
+            printf(" %d", (int32_t)record->arg[i]);
+        putchar('\n');
+        return;
+    }
+
+    const char *p = formats[record->id];
+    unsigned next_arg = 0;
+    while (*p) {
+        if (*p != '%') {
+            putchar(*p++);
+            continue;
+        }
+        if (p[1] == '%') {
+            putchar('%');
+            p += 2;
+            continue;
+        }
+        // Flags, width, precision and length up to the conversion
+        size_t length = strspn(p + 1, "-+ #0123456789.lhzjt") + 1;
+        char conversion = p[length];
+        if (!conversion)
+            break;
+        if (next_arg < record->arg_count)
+            format_arg(p, length, conversion, record->arg[next_arg++]);
+        else
+            printf("<missing>");
+        p += length + 1;
+    }
+    putchar('\n');
+}
+
+static void decode_frame(const uint8_t *frame, const log_header_t *header)
+{
+    unsigned core = header->core < CORES ? header->core : 0;
+    int16_t gap = (int16_t)(header->sequence - next_sequence[core]);
+    if (synced[core] && gap > 0)
+        stats.lost_frames += gap;
+    next_sequence[core] = header->sequence + 1;
+    synced[core] = 1;
+
+    const uint8_t *in = frame + LOG_HEADER_SIZE;
+    const uint8_t *end = frame + header->length - LOG_CRC_SIZE;
+    log_record_t record;
+    while (in < end) {
+        if (!(in = log_get_record(in, end, &record))) {
+            stats.malformed++;
+            break;
+        }
+        print_record(&record, header->core);
+        stats.records++;
+    }
+    if (header->dropped)
+        printf("[%u records dropped on core %u]\n", header->dropped, header->core);
+    stats.frames++;
+    stats.dropped += header->dropped;
+}
+
+// Bytes that start a frame which has not fully arrived yet
+static int partial_frame(const uint8_t *data, size_t available)
+{
+    if (available < 2 || get_le16(data) != LOG_MAGIC)
+        return available == 1 && data[0] == (LOG_MAGIC & 0xFF);
+    if (available < 4)
+        return 1;
+    uint16_t length = get_le16(data + 2);
+    return length >= LOG_HEADER_SIZE + LOG_CRC_SIZE && length <= LOG_FRAME_MAX && length > available;
+}
+
+static int decode_stream(int fd)
+{
+    uint8_t buffer[4 * LOG_FRAME_MAX];
+    size_t have = 0;
+    int eof = 0;
+
+    while (!eof || have > 0) {
+        if (!eof) {
+            ssize_t n = read(fd, buffer + have, sizeof(buffer) - have);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                eof = 1;
+            else
+                have += (size_t)n;
+        }
+
+        size_t used = 0;
+        while (used < have) {
+            log_header_t header;
+            size_t length = log_get_header(buffer + used, have - used, &header);
+            if (length > 0) {
+                decode_frame(buffer + used, &header);
+                used += length;
+            } else if (!eof && partial_frame(buffer + used, have - used)) {
+                break;
+            } else {
+                // Console text, or a frame damaged on the way
+                putchar(buffer[used++]);
+                stats.text_bytes++;
+            }
+        }
+        memmove(buffer, buffer + used, have - used);
+        have -= used;
+        fflush(stdout);
+    }
+    return 0;
+}
+
+static int decode_udp(unsigned port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    fprintf(stderr, "listening on UDP %u\n", port);
+    uint8_t frame[LOG_FRAME_MAX + 1];
+    while (1) {
+        ssize_t n = recv(sock, frame, sizeof(frame), 0);
+        log_header_t header;
+        if (n > 0 && log_get_header(frame, (size_t)n, &header) == (size_t)n)
+            decode_frame(frame, &header);
+        else if (n > 0)
+            stats.malformed++;
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned port = 5007;       // LOG_UDP_PORT
+    int udp = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "up:")) != -1) {
+        switch (opt) {
+        case 'u': udp = 1; break;
+        case 'p': port = (unsigned)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [file] | -u [-p port]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (udp)
+        return decode_udp(port);
+
+    int fd = optind < argc ? open(argv[optind], O_RDONLY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    int rc = decode_stream(fd);
+    fprintf(stderr, "%lu frames, %lu records, %lu frames lost, %lu records dropped, "
+            "%lu malformed, %lu text bytes\n",
+            stats.frames, stats.records, stats.lost_frames, stats.dropped,
+            stats.malformed, stats.text_bytes);
+    return rc;
+}
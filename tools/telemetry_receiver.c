@@ -0,0 +1,219 @@
+// Host receiver for the robot's binary UDP telemetry (driver/wifi/telemetry.h).
+//
+//   cc -O2 -Wall -I driver/wifi -o telemetry_receiver tools/telemetry_receiver.c
+//
+//   telemetry_receiver [-p port] [-q]
+//       Decode frames and print one CSV line per record (-q: statistics only).
+//       Statistics go to stderr once a second.
+//
+//   telemetry_receiver -g host[:port] [-r records_per_second] [-f fields]
+//       Stand-in for the robot: send synthetic frames in the same format, to
+//       measure receiver throughput and loss without the car.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+typedef struct {
+    unsigned long frames;
+    unsigned long lost;         // sequence numbers never seen
+    unsigned long late;         // out of order or duplicated
+    unsigned long malformed;
+    unsigned long records;
+    unsigned long sender_drops; // records the robot could not queue
+    unsigned long long bytes;
+} receiver_stats_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void decode_frame(const uint8_t *data, size_t length, receiver_stats_t *stats,
+                         int quiet, uint32_t *next_sequence, int *synced)
+{
+    telemetry_header_t header;
+    if (!telemetry_get_header(data, length, &header)) {
+        stats->malformed++;
+        return;
+    }
+
+    // Signed distance, so a late frame is not counted as a huge gap
+    int32_t gap = (int32_t)(header.sequence - *next_sequence);
+    if (*synced && gap < 0) {
+        stats->late++;
+    } else {
+        if (*synced)
+            stats->lost += gap;
+        *next_sequence = header.sequence + 1;
+        *synced = 1;
+    }
+
+    const uint8_t *in = data + TELEMETRY_HEADER_SIZE;
+    const uint8_t *end = data + length;
+    telemetry_record_t record = {0};
+    for (unsigned i = 0; i < header.record_count; i++) {
+        if (!(in = telemetry_get_record(in, end, &record, header.field_count))) {
+            stats->malformed++;
+            return;
+        }
+        stats->records++;
+        if (!quiet) {
+            printf("%u,%u", header.sequence, record.timestamp_us);
+            for (unsigned f = 0; f < header.field_count; f++)
+                printf(",%d", record.field[f]);
+            putchar('\n');
+        }
+    }
+
+    stats->frames++;
+    stats->sender_drops += header.dropped;
+    stats->bytes += length;
+}
+
+static int receive(unsigned port, int quiet)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = 200000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    receiver_stats_t stats = {0};
+    receiver_stats_t last = {0};
+    uint32_t next_sequence = 0;
+    int synced = 0;
+    double report_at = now_s() + 1.0;
+    uint8_t buffer[2048];
+
+    fprintf(stderr, "listening on UDP %u\n", port);
+    while (1) {
+        ssize_t length = recv(sock, buffer, sizeof(buffer), 0);
+        if (length > 0)
+            decode_frame(buffer, (size_t)length, &stats, quiet, &next_sequence, &synced);
+        else if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            perror("recv");
+
+        double now = now_s();
+        if (now >= report_at) {
+            unsigned long frames = stats.frames - last.frames;
+            unsigned long lost = stats.lost - last.lost;
+            fprintf(stderr, "%lu frames/s, %lu records/s, %.1f kB/s, %lu lost (%.2f%%), "
+                    "%lu late, %lu malformed, %lu sender drops\n",
+                    frames, stats.records - last.records, (stats.bytes - last.bytes) / 1000.0,
+                    lost, frames + lost ? 100.0 * lost / (frames + lost) : 0.0,
+                    stats.late - last.late, stats.malformed - last.malformed,
+                    stats.sender_drops - last.sender_drops);
+            fflush(stdout);
+            last = stats;
+            report_at = now + 1.0;
+        }
+    }
+}
+
+// Frames shaped like the robot's: a record per 5 ms, slowly changing fields
+static int generate(const char *target, unsigned rate, unsigned fields)
+{
+    char host[64];
+    unsigned port = TELEMETRY_PORT;
+    snprintf(host, sizeof(host), "%s", target);
+    char *colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        port = (unsigned)atoi(colon + 1);
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (sock < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad host %s\n", host);
+        return 1;
+    }
+
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    telemetry_record_t record = {0};
+    uint32_t sequence = 0;
+    unsigned long sent = 0;
+    double start = now_s();
+
+    fprintf(stderr, "sending %u records/s of %u fields to %s:%u\n", rate, fields, host, port);
+    while (1) {
+        uint8_t *out = frame + TELEMETRY_HEADER_SIZE;
+        telemetry_record_t prev = {0};
+        uint16_t count = 0;
+        while (count < TELEMETRY_BATCH_RECORDS &&
+               frame + sizeof(frame) - out >= TELEMETRY_RECORD_MAX_SIZE(fields)) {
+            record.timestamp_us += 5000;
+            for (unsigned f = 0; f < fields; f++)
+                record.field[f] += (int32_t)(rand() % 2001) - 1000;
+            out = telemetry_put_record(out, &record, &prev, fields);
+            prev = record;
+            count++;
+        }
+
+        telemetry_header_t header = {
+            .field_count = (uint8_t)fields,
+            .sequence = sequence++,
+            .record_count = count,
+        };
+        telemetry_put_header(frame, &header);
+        if (sendto(sock, frame, out - frame, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+            perror("sendto");
+        sent += count;
+
+        // Pace to the record rate
+        double due = start + (double)sent / rate;
+        double wait = due - now_s();
+        if (wait > 0)
+            usleep((useconds_t)(wait * 1e6));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned port = TELEMETRY_PORT;
+    unsigned rate = 200;
+    unsigned fields = 10;
+    int quiet = 0;
+    const char *target = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:qg:r:f:")) != -1) {
+        switch (opt) {
+        case 'p': port = (unsigned)atoi(optarg); break;
+        case 'q': quiet = 1; break;
+        case 'g': target = optarg; break;
+        case 'r': rate = (unsigned)atoi(optarg); break;
+        case 'f': fields = (unsigned)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-q] | -g host[:port] [-r rate] [-f fields]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rate == 0 || fields > TELEMETRY_MAX_FIELDS) {
+        fprintf(stderr, "rate must be > 0 and fields <= %d\n", TELEMETRY_MAX_FIELDS);
+        return 2;
+    }
+
+    return target ? generate(target, rate, fields) : receive(port, quiet);
+}